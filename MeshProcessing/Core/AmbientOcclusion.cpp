@@ -0,0 +1,210 @@
+#include "stdafx.h"
+#include "AmbientOcclusion.h"
+#include "Parallel.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const char kMagic[4] = { 'M', 'P', 'A', 'O' };
+	const uint32_t kVersion = 1;
+
+	struct AoHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		double max_distance;
+		int32_t samples, vertices;
+	};
+
+	// uniform in [0, 1) from a hash of three integers
+	double random01(uint32_t a, uint32_t b, uint32_t c)
+	{
+		uint64_t h = (uint64_t(a) << 32 | b) ^ (uint64_t(c) * 0x9e3779b97f4a7c15ULL);
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return double(h >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	// two unit vectors orthogonal to n and to each other (Duff et al. 2017)
+	void tangent_frame(const double* n, double* t, double* b)
+	{
+		double sign = n[2] >= 0 ? 1.0 : -1.0;
+		double a = -1.0 / (sign + n[2]);
+		double c = n[0] * n[1] * a;
+		t[0] = 1.0 + sign * n[0] * n[0] * a;
+		t[1] = sign * c;
+		t[2] = -sign * n[0];
+		b[0] = c;
+		b[1] = sign + n[1] * n[1] * a;
+		b[2] = -n[1];
+	}
+}
+
+AmbientOcclusion::AmbientOcclusion()
+: max_distance_(0), bias_(0), samples_(0), passes_(0), key_(0)
+{
+}
+
+void AmbientOcclusion::clear()
+{
+	bvh_.clear();
+	origin_.clear();
+	normal_.clear();
+	open_.clear();
+	max_distance_ = bias_ = 0;
+	samples_ = passes_ = 0;
+	key_ = 0;
+}
+
+void AmbientOcclusion::setup(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, const Eigen::MatrixXd& N,
+	double max_distance, uint64_t key)
+{
+	clear();
+	int nv = V.rows(), nf = F.rows();
+	if (nv == 0 || nf == 0 || N.rows() != nv) return;
+
+	bvh_.build(V, F);
+	key_ = key;
+	max_distance_ = Max(max_distance, 0.0);
+
+	// rays leave the surface a little above it, not to hit their own faces
+	double edges = 0;
+	for (int f = 0; f < nf; f++)
+		edges += (V.row(F(f, 0)) - V.row(F(f, 1))).norm();
+	bias_ = 1e-3 * edges / nf;
+
+	origin_.resize(size_t(nv) * 3);
+	normal_.resize(size_t(nv) * 3);
+	parallel_for(0, nv, [&](int b, int e) {
+		for (int v = b; v < e; v++)
+		{
+			Vec3d n = N.row(v).transpose();
+			double len = n.norm();
+			n = len > 0 ? Vec3d(n / len) : Vec3d(0, 0, 1);
+			for (int i = 0; i < 3; i++)
+			{
+				origin_[3 * size_t(v) + i] = V(v, i) + bias_ * n[i];
+				normal_[3 * size_t(v) + i] = n[i];
+			}
+		}
+	}, 1 << 14);
+	open_.assign(nv, 0.0f);
+}
+
+bool AmbientOcclusion::refine(int samples, const std::atomic<bool>* cancel)
+{
+	int nv = vertices();
+	if (nv == 0 || samples <= 0) return false;
+
+	int grid = (int)ceil(sqrt(double(samples)));
+	int count = grid * grid;
+	double t_max = max_distance_ > 0 ? max_distance_ : 1e300;
+	uint32_t pass = uint32_t(passes_);
+
+	// vertices cost more where the surface is busy; small chunks keep the
+	// cores evenly loaded
+	std::vector<float> open(nv, 0.0f);
+	TaskGroup group("occlusion");
+	parallel_for(group, 0, nv, [&](int b, int e) {
+		// the chunks not started yet are dropped
+		if (cancel && *cancel)
+		{
+			group.cancel();
+			return;
+		}
+		for (int v = b; v < e; v++)
+		{
+			const double* o = &origin_[3 * size_t(v)];
+			const double* n = &normal_[3 * size_t(v)];
+			double t[3], s[3];
+			tangent_frame(n, t, s);
+
+			int hits = 0;
+			for (int k = 0; k < count; k++)
+			{
+				// jittered in its stratum, cosine weighted (Malley)
+				double u1 = (k / grid + random01(v, pass, 2 * k)) / grid;
+				double u2 = (k % grid + random01(v, pass, 2 * k + 1)) / grid;
+				double r = sqrt(u1), phi = 2 * M_PI * u2;
+				double x = r * cos(phi), y = r * sin(phi), z = sqrt(Max(1.0 - u1, 0.0));
+				double d[3];
+				for (int i = 0; i < 3; i++)
+					d[i] = x * t[i] + y * s[i] + z * n[i];
+				if (!bvh_.occluded(o, d, bias_, t_max))
+					hits++;
+			}
+			open[v] = float(hits);
+		}
+	}, 64);
+	if (cancel && *cancel) return false;
+
+	for (int v = 0; v < nv; v++)
+		open_[v] += open[v];
+	samples_ += count;
+	passes_++;
+	return true;
+}
+
+void AmbientOcclusion::visibility(Eigen::VectorXd& A) const
+{
+	int nv = vertices();
+	A.setOnes(nv);
+	if (samples_ == 0) return;
+	for (int v = 0; v < nv; v++)
+		A(v) = open_[v] / samples_;
+}
+
+bool AmbientOcclusion::save(const std::string& filename) const
+{
+	FILE* fp = fopen(filename.c_str(), "wb");
+	if (!fp)
+	{
+		std::cerr << "ERROR (AmbientOcclusion::save): Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	AoHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kMagic, 4);
+	header.version = kVersion;
+	header.key = key_;
+	header.max_distance = max_distance_;
+	header.samples = samples_;
+	header.vertices = vertices();
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+		(open_.empty() || fwrite(&open_[0], sizeof(float), open_.size(), fp) == open_.size());
+	fclose(fp);
+	if (!ok) remove(filename.c_str());
+	return ok;
+}
+
+bool AmbientOcclusion::load(const std::string& filename)
+{
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if (!fp) return false;
+
+	AoHeader header;
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1 && memcmp(header.magic, kMagic, 4) == 0 &&
+		header.version == kVersion && header.key == key_ && header.max_distance == max_distance_ &&
+		header.vertices == vertices() && header.samples > 0;
+	std::vector<float> open;
+	if (ok)
+	{
+		open.resize(header.vertices);
+		ok = fread(&open[0], sizeof(float), open.size(), fp) == open.size();
+	}
+	fclose(fp);
+	if (!ok) return false;
+
+	open_.swap(open);
+	samples_ = header.samples;
+	// later passes draw new jitters
+	passes_ = header.samples;
+	return true;
+}
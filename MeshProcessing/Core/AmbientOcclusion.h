@@ -0,0 +1,57 @@
+#pragma once
+#include "stdafx.h"
+#include "MeshDistance.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Ambient occlusion of the vertices of a mesh, ray traced on the CPU.
+// Every vertex casts cosine weighted rays over the hemisphere of its normal,
+// one per cell of a square grid of strata, jittered, against a TriangleBVH
+// of the mesh. Passes add to what the previous ones gathered, so a pass
+// with few samples gives a first picture that later passes refine.
+// The rays of a vertex only depend on the vertex and the pass, so results
+// do not depend on the number of threads.
+class AmbientOcclusion
+{
+public:
+	AmbientOcclusion();
+
+	// start over on a mesh, N its vertex normals; rays stop at max_distance,
+	// or go on to any distance if it is 0. key names the mesh in the cache
+	// file, see mesh_data_key.
+	void setup(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, const Eigen::MatrixXd& N,
+		double max_distance, uint64_t key);
+	void clear();
+
+	uint64_t key() const { return key_; }
+	double max_distance() const { return max_distance_; }
+	int vertices() const { return (int)open_.size(); }
+
+	// rays cast from every vertex so far
+	int samples() const { return samples_; }
+
+	// one pass of samples more rays per vertex, rounded up to a square, on
+	// all cores. Returns false if cancel was set meanwhile; the pass is
+	// then dropped.
+	bool refine(int samples, const std::atomic<bool>* cancel = NULL);
+
+	// fraction of the unoccluded hemisphere at every vertex, 1 if nothing
+	// is in sight
+	void visibility(Eigen::VectorXd& A) const;
+
+	// binary cache of the gathered samples, "MPAO", version, key, distance,
+	// samples, vertex count then one float per vertex; load only takes a
+	// file of the current key, vertex count and distance
+	bool save(const std::string& filename) const;
+	bool load(const std::string& filename);
+
+private:
+	TriangleBVH bvh_;
+	std::vector<double> origin_, normal_;  // 3 per vertex
+	std::vector<float> open_;              // unoccluded rays per vertex
+	double max_distance_, bias_;
+	int samples_, passes_;
+	uint64_t key_;
+};
@@ -0,0 +1,47 @@
+#include "stdafx.h"
+#include "Arena.h"
+#include <cstdlib>
+
+Arena::Arena(memstats::Category category, size_t block_size)
+: block_size_(block_size), offset_(0), last_size_(0), used_(0), gauge_(category)
+{
+}
+
+Arena::~Arena()
+{
+	release();
+}
+
+void* Arena::allocate(size_t bytes, size_t align)
+{
+	if (bytes == 0) return NULL;
+
+	// malloc is aligned to 16 on the platforms we build for
+	size_t start = (offset_ + align - 1) & ~(align - 1);
+	if (blocks_.empty() || start + bytes > last_size_)
+	{
+		// large requests get a block of their own
+		last_size_ = Max(bytes, block_size_);
+		char* block = (char*)malloc(last_size_);
+		if (!block)
+		{
+			std::cerr << "ERROR (Arena::allocate): Out of memory for " << bytes << " bytes" << std::endl;
+			return NULL;
+		}
+		blocks_.push_back(block);
+		gauge_.set(gauge_.bytes() + last_size_);
+		start = 0;
+	}
+	offset_ = start + bytes;
+	used_ += bytes;
+	return blocks_.back() + start;
+}
+
+void Arena::release()
+{
+	for (size_t i = 0; i < blocks_.size(); i++)
+		free(blocks_[i]);
+	std::vector<char*>().swap(blocks_);
+	offset_ = last_size_ = used_ = 0;
+	gauge_.set(0);
+}
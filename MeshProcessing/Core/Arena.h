@@ -0,0 +1,39 @@
+#pragma once
+#include "stdafx.h"
+#include "MemoryStats.h"
+#include <vector>
+
+// Bump allocator for temporaries that die together. Blocks are only given
+// back by release(), all at once, and reported to memstats under the
+// category of the arena. Nothing is constructed or destroyed: use it for
+// plain data only.
+class Arena
+{
+public:
+	explicit Arena(memstats::Category category = memstats::SCRATCH, size_t block_size = 1 << 20);
+	~Arena();
+
+	// bytes aligned to align, a power of two up to 16
+	void* allocate(size_t bytes, size_t align = 16);
+
+	template <typename T>
+	T* allocate_array(size_t n) { return static_cast<T*>(allocate(n * sizeof(T), sizeof(T) < 16 ? sizeof(T) : 16)); }
+
+	// give every block back
+	void release();
+
+	size_t used() const { return used_; }
+	size_t reserved() const { return gauge_.bytes(); }
+
+private:
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+
+private:
+	std::vector<char*> blocks_;
+	size_t block_size_;
+	size_t offset_;         // in the last block
+	size_t last_size_;      // of the last block
+	size_t used_;
+	memstats::Gauge gauge_;
+};
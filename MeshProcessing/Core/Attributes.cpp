@@ -0,0 +1,222 @@
+#include "stdafx.h"
+#include "Attributes.h"
+#include <cmath>
+#include <fstream>
+
+const char* domain_name(AttributeDomain domain)
+{
+	static const char* names[DOMAIN_COUNT] = { "vertex", "face", "edge" };
+	return domain >= 0 && domain < DOMAIN_COUNT ? names[domain] : "";
+}
+
+const char* channel_type_name(ChannelType type)
+{
+	static const char* names[CHANNEL_TYPE_COUNT] = { "float", "uint8", "uint32" };
+	return type >= 0 && type < CHANNEL_TYPE_COUNT ? names[type] : "";
+}
+
+size_t channel_type_size(ChannelType type)
+{
+	static const size_t sizes[CHANNEL_TYPE_COUNT] = { sizeof(float), sizeof(uint8_t), sizeof(uint32_t) };
+	return sizes[type];
+}
+
+AttributeChannel::AttributeChannel(const std::string& name, AttributeDomain domain, ChannelType type,
+	int components, unsigned depends)
+: name_(name), domain_(domain), type_(type), components_(Max(components, 1)), rows_(0), depends_(depends),
+valid_(false)
+{
+}
+
+void AttributeChannel::resize(int rows)
+{
+	rows_ = Max(rows, 0);
+	size_t bytes = size_t(rows_) * components_ * channel_type_size(type_);
+	storage_.assign((bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t), 0);
+	valid_ = true;
+}
+
+void AttributeChannel::invalidate()
+{
+	std::vector<uint32_t>().swap(storage_);
+	rows_ = 0;
+	valid_ = false;
+}
+
+double AttributeChannel::value(int i, int c) const
+{
+	switch (type_)
+	{
+	case CHANNEL_FLOAT: return data<float>(c)[i];
+	case CHANNEL_UINT8: return data<uint8_t>(c)[i];
+	case CHANNEL_UINT32: return data<uint32_t>(c)[i];
+	default: return 0;
+	}
+}
+
+void AttributeChannel::get(Eigen::VectorXd& S, int c) const
+{
+	S.resize(rows_);
+	for (int i = 0; i < rows_; i++)
+		S(i) = value(i, c);
+}
+
+void AttributeChannel::set(const Eigen::MatrixXd& M)
+{
+	resize(M.rows());
+	int cols = Min((int)M.cols(), components_);
+	for (int c = 0; c < cols; c++)
+	{
+		switch (type_)
+		{
+		case CHANNEL_FLOAT:
+		{
+			float* d = data<float>(c);
+			for (int i = 0; i < rows_; i++) d[i] = (float)M(i, c);
+			break;
+		}
+		case CHANNEL_UINT8:
+		{
+			uint8_t* d = data<uint8_t>(c);
+			for (int i = 0; i < rows_; i++) d[i] = (uint8_t)Min(Max(floor(M(i, c) + 0.5), 0.0), 255.0);
+			break;
+		}
+		case CHANNEL_UINT32:
+		{
+			uint32_t* d = data<uint32_t>(c);
+			for (int i = 0; i < rows_; i++) d[i] = (uint32_t)Min(Max(floor(M(i, c) + 0.5), 0.0), 4294967295.0);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+AttributeChannel& AttributeRegistry::add(const std::string& name, AttributeDomain domain, ChannelType type,
+	int components, int rows, unsigned depends)
+{
+	for (size_t i = 0; i < channels_.size(); i++)
+	{
+		AttributeChannel& a = *channels_[i];
+		if (a.domain() != domain || a.name() != name) continue;
+		if (a.type() != type || a.components() != Max(components, 1) || a.depends() != depends)
+			channels_[i].reset(new AttributeChannel(name, domain, type, components, depends));
+		channels_[i]->resize(rows);
+		return *channels_[i];
+	}
+	channels_.push_back(std::unique_ptr<AttributeChannel>(new AttributeChannel(name, domain, type, components, depends)));
+	channels_.back()->resize(rows);
+	return *channels_.back();
+}
+
+AttributeChannel* AttributeRegistry::find(const std::string& name, AttributeDomain domain)
+{
+	for (size_t i = 0; i < channels_.size(); i++)
+	{
+		if (channels_[i]->domain() == domain && channels_[i]->name() == name)
+			return channels_[i].get();
+	}
+	return NULL;
+}
+
+const AttributeChannel* AttributeRegistry::find(const std::string& name, AttributeDomain domain) const
+{
+	return const_cast<AttributeRegistry*>(this)->find(name, domain);
+}
+
+bool AttributeRegistry::remove(const std::string& name, AttributeDomain domain)
+{
+	for (size_t i = 0; i < channels_.size(); i++)
+	{
+		if (channels_[i]->domain() == domain && channels_[i]->name() == name)
+		{
+			channels_.erase(channels_.begin() + i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void AttributeRegistry::clear()
+{
+	channels_.clear();
+}
+
+void AttributeRegistry::list(AttributeDomain domain, std::vector<int>& out) const
+{
+	out.clear();
+	for (size_t i = 0; i < channels_.size(); i++)
+	{
+		if (channels_[i]->domain() == domain && channels_[i]->valid())
+			out.push_back((int)i);
+	}
+}
+
+void AttributeRegistry::invalidate(unsigned dirty)
+{
+	for (size_t i = 0; i < channels_.size(); i++)
+	{
+		if (channels_[i]->valid() && (channels_[i]->depends() & dirty))
+			channels_[i]->invalidate();
+	}
+}
+
+size_t AttributeRegistry::bytes() const
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < channels_.size(); i++)
+		bytes += channels_[i]->bytes();
+	return bytes;
+}
+
+bool write_attributes(const std::string& filename, const AttributeRegistry& A, AttributeDomain domain,
+	const Eigen::VectorXi& source_map)
+{
+	std::vector<int> list;
+	A.list(domain, list);
+	if (list.empty())
+	{
+		std::cerr << "ERROR (write_attributes): No " << domain_name(domain) << " channels" << std::endl;
+		return false;
+	}
+
+	std::ofstream out(filename.c_str());
+	if (!out)
+	{
+		std::cerr << "ERROR (write_attributes): Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	int rows = A.channel(list[0]).rows();
+	for (size_t j = 1; j < list.size(); j++)
+		rows = Min(rows, A.channel(list[j]).rows());
+	bool mapped = domain == DOMAIN_VERTEX && source_map.rows() > 0;
+	int n = mapped ? source_map.rows() : rows;
+
+	out << "#";
+	for (size_t j = 0; j < list.size(); j++)
+	{
+		const AttributeChannel& a = A.channel(list[j]);
+		for (int c = 0; c < a.components(); c++)
+		{
+			out << " " << a.name();
+			if (a.components() > 1) out << "." << c;
+		}
+	}
+	out << "\n";
+
+	for (int s = 0; s < n; s++)
+	{
+		int i = mapped ? source_map(s) : s;
+		bool known = i >= 0 && i < rows;
+		for (size_t j = 0; j < list.size(); j++)
+		{
+			const AttributeChannel& a = A.channel(list[j]);
+			for (int c = 0; c < a.components(); c++)
+				out << (j + c > 0 ? " " : "") << (known ? a.value(i, c) : 0.0);
+		}
+		out << "\n";
+	}
+	return true;
+}
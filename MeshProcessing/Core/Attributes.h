@@ -0,0 +1,136 @@
+#pragma once
+#include "stdafx.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum AttributeDomain
+{
+	DOMAIN_VERTEX = 0,
+	DOMAIN_FACE,
+	DOMAIN_EDGE,    // the edges of MeshEdges, in its order
+	DOMAIN_COUNT
+};
+
+enum ChannelType
+{
+	CHANNEL_FLOAT = 0,
+	CHANNEL_UINT8,
+	CHANNEL_UINT32,
+	CHANNEL_TYPE_COUNT
+};
+
+const char* domain_name(AttributeDomain domain);
+const char* channel_type_name(ChannelType type);
+size_t channel_type_size(ChannelType type);
+
+// the ChannelType of a C++ type, for the typed accessors
+template <typename T> struct ChannelTypeOf;
+template <> struct ChannelTypeOf<float> { enum { value = CHANNEL_FLOAT }; };
+template <> struct ChannelTypeOf<uint8_t> { enum { value = CHANNEL_UINT8 }; };
+template <> struct ChannelTypeOf<uint32_t> { enum { value = CHANNEL_UINT32 }; };
+
+// A named per vertex, face or edge quantity of one compact type with one or
+// more components. Each component is a contiguous array of one value per
+// element, so the channel is a column major rows x components matrix.
+// A channel depends on some MeshData dirty flags; once one of them is
+// raised the values are released and the channel is stale until it is
+// filled again.
+class AttributeChannel
+{
+public:
+	AttributeChannel(const std::string& name, AttributeDomain domain, ChannelType type, int components,
+		unsigned depends);
+
+	const std::string& name() const { return name_; }
+	AttributeDomain domain() const { return domain_; }
+	ChannelType type() const { return type_; }
+	int components() const { return components_; }
+	int rows() const { return rows_; }
+	unsigned depends() const { return depends_; }
+
+	// false once stale
+	bool valid() const { return valid_; }
+
+	// rows zeroed values, the channel valid again
+	void resize(int rows);
+	// release the values
+	void invalidate();
+
+	// component c of every row; T must be the type of the channel
+	template <typename T> T* data(int c = 0)
+	{
+		assert((int)ChannelTypeOf<T>::value == (int)type_ && c >= 0 && c < components_);
+		return reinterpret_cast<T*>(storage_.data()) + size_t(c) * rows_;
+	}
+	template <typename T> const T* data(int c = 0) const
+	{
+		assert((int)ChannelTypeOf<T>::value == (int)type_ && c >= 0 && c < components_);
+		return reinterpret_cast<const T*>(storage_.data()) + size_t(c) * rows_;
+	}
+	void* raw() { return storage_.data(); }
+
+	// any type as a double, for colormaps and export
+	double value(int i, int c = 0) const;
+	// component c as doubles
+	void get(Eigen::VectorXd& S, int c = 0) const;
+	// fill from a rows x components matrix, converted to the channel type
+	// (rounded and clamped for the integer types)
+	void set(const Eigen::MatrixXd& M);
+
+	size_t bytes() const { return storage_.capacity() * sizeof(uint32_t); }
+
+private:
+	std::string name_;
+	AttributeDomain domain_;
+	ChannelType type_;
+	int components_;
+	int rows_;
+	unsigned depends_;
+	bool valid_;
+	std::vector<uint32_t> storage_;   // word aligned for every type
+};
+
+// The channels of a mesh, by domain and name. Channels keep their place in
+// the list, so an index stays valid until remove() or clear().
+class AttributeRegistry
+{
+public:
+	// the channel of that domain and name, created or reshaped if the type
+	// or components differ, sized to rows and valid
+	AttributeChannel& add(const std::string& name, AttributeDomain domain, ChannelType type, int components,
+		int rows, unsigned depends);
+	template <typename T> T* add(const std::string& name, AttributeDomain domain, int rows, unsigned depends)
+	{
+		return add(name, domain, (ChannelType)ChannelTypeOf<T>::value, 1, rows, depends).template data<T>();
+	}
+
+	// NULL if there is none
+	AttributeChannel* find(const std::string& name, AttributeDomain domain);
+	const AttributeChannel* find(const std::string& name, AttributeDomain domain) const;
+	bool remove(const std::string& name, AttributeDomain domain);
+	void clear();
+
+	int count() const { return (int)channels_.size(); }
+	AttributeChannel& channel(int i) { return *channels_[i]; }
+	const AttributeChannel& channel(int i) const { return *channels_[i]; }
+	// indices of the valid channels of a domain
+	void list(AttributeDomain domain, std::vector<int>& out) const;
+
+	// after the attributes named by the dirty flags changed, make the
+	// channels that depend on them stale
+	void invalidate(unsigned dirty);
+
+	size_t bytes() const;
+
+private:
+	std::vector<std::unique_ptr<AttributeChannel> > channels_;
+};
+
+// Text file of the valid channels of a domain, a header line naming the
+// columns (name, or name.c for each component) then a line per element.
+// For vertices, source_map gives the rows of the loaded file as in
+// write_curvature; rows dropped by the cleanup are written as zeros.
+bool write_attributes(const std::string& filename, const AttributeRegistry& A, AttributeDomain domain,
+	const Eigen::VectorXi& source_map);
@@ -0,0 +1,137 @@
+#include "stdafx.h"
+#include "CameraPath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <chrono>
+#endif
+
+namespace
+{
+	const char* kHeader = "# camera path 1";
+
+	// nearest rank percentile of sorted values
+	double percentile(const std::vector<double>& sorted, double p)
+	{
+		int n = (int)sorted.size();
+		int rank = (int)ceil(p / 100.0 * n);
+		return sorted[Min(Max(rank, 1), n) - 1];
+	}
+}
+
+CameraKey::CameraKey()
+: time(0), trans(0, 0, 0), draw_mode(0), width(0), height(0)
+{
+	for (int i = 0; i < 16; i++)
+		rotation[i] = (i % 5) ? 0.0 : 1.0;
+}
+
+bool CameraPath::save(const std::string& filename) const
+{
+	std::ofstream out(filename.c_str());
+	if (!out)
+	{
+		std::cerr << "ERROR (CameraPath::save): Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	out.precision(17);
+	out << kHeader << "\n";
+	for (size_t k = 0; k < keys_.size(); k++)
+	{
+		const CameraKey& key = keys_[k];
+		out << key.time;
+		for (int i = 0; i < 16; i++)
+			out << " " << key.rotation[i];
+		out << " " << key.trans[0] << " " << key.trans[1] << " " << key.trans[2]
+			<< " " << key.draw_mode << " " << key.width << " " << key.height << "\n";
+	}
+	return bool(out);
+}
+
+bool CameraPath::load(const std::string& filename)
+{
+	std::ifstream in(filename.c_str());
+	std::string line;
+	if (!in || !std::getline(in, line) || line.compare(0, strlen(kHeader), kHeader) != 0)
+	{
+		std::cerr << "ERROR (CameraPath::load): " << filename << " is not a camera path." << std::endl;
+		return false;
+	}
+
+	std::vector<CameraKey> keys;
+	while (std::getline(in, line))
+	{
+		if (line.empty() || line[0] == '#') continue;
+		std::istringstream fields(line);
+		CameraKey key;
+		fields >> key.time;
+		for (int i = 0; i < 16; i++)
+			fields >> key.rotation[i];
+		fields >> key.trans[0] >> key.trans[1] >> key.trans[2] >> key.draw_mode >> key.width >> key.height;
+		if (!fields)
+		{
+			std::cerr << "ERROR (CameraPath::load): Bad key " << keys.size() << " in " << filename << std::endl;
+			return false;
+		}
+		keys.push_back(key);
+	}
+	keys_.swap(keys);
+	return true;
+}
+
+FrameTimeStats frame_time_stats(const std::vector<double>& ms)
+{
+	FrameTimeStats stats;
+	stats.frames = (int)ms.size();
+	stats.mean = stats.p50 = stats.p95 = stats.p99 = stats.max = 0;
+	if (ms.empty()) return stats;
+
+	std::vector<double> sorted(ms);
+	std::sort(sorted.begin(), sorted.end());
+	double sum = 0;
+	for (size_t i = 0; i < sorted.size(); i++)
+		sum += sorted[i];
+	stats.mean = sum / sorted.size();
+	stats.p50 = percentile(sorted, 50);
+	stats.p95 = percentile(sorted, 95);
+	stats.p99 = percentile(sorted, 99);
+	stats.max = sorted.back();
+	return stats;
+}
+
+bool write_frame_times(const std::string& filename, const std::vector<double>& ms)
+{
+	std::ofstream out(filename.c_str());
+	if (!out)
+	{
+		std::cerr << "ERROR (write_frame_times): Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	FrameTimeStats stats = frame_time_stats(ms);
+	out << "# frames " << stats.frames << "\n# mean " << stats.mean << "\n# p50 " << stats.p50
+		<< "\n# p95 " << stats.p95 << "\n# p99 " << stats.p99 << "\n# max " << stats.max << "\n";
+	for (size_t i = 0; i < ms.size(); i++)
+		out << i << " " << ms[i] << "\n";
+	return bool(out);
+}
+
+double precise_seconds()
+{
+#ifdef _WIN32
+	// the standard clocks of VS2013 tick in milliseconds
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return double(count.QuadPart) / double(frequency.QuadPart);
+#else
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "stdafx.h"
+#include <string>
+#include <vector>
+
+// The view of one drawn frame: trackball state, draw mode and window size
+struct CameraKey
+{
+	double time;           // seconds since the recording started
+	double rotation[16];   // column major, like GlutViewer::rotation_matrix_
+	Vec3d trans;
+	int draw_mode;
+	int width, height;
+
+	CameraKey();
+};
+
+// Camera keys of a session, one per drawn frame, replayed frame by frame
+// so every replay draws the same views whatever the frame rate.
+// File format: a "# camera path 1" line, then one key per line:
+// time, the 16 rotation entries, trans, draw mode, width and height.
+class CameraPath
+{
+public:
+	void clear() { keys_.clear(); }
+	void add(const CameraKey& key) { keys_.push_back(key); }
+
+	bool empty() const { return keys_.empty(); }
+	int size() const { return (int)keys_.size(); }
+	const CameraKey& operator[](int i) const { return keys_[i]; }
+
+	bool save(const std::string& filename) const;
+	bool load(const std::string& filename);
+
+private:
+	std::vector<CameraKey> keys_;
+};
+
+// Distribution of frame times, in milliseconds
+struct FrameTimeStats
+{
+	int frames;
+	double mean, p50, p95, p99, max;
+};
+
+FrameTimeStats frame_time_stats(const std::vector<double>& ms);
+
+// one "frame milliseconds" line per frame, after a line per statistic
+bool write_frame_times(const std::string& filename, const std::vector<double>& ms);
+
+// wall clock seconds from the high resolution counter, for frame timing
+double precise_seconds();
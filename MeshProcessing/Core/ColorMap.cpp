@@ -0,0 +1,56 @@
+#include "stdafx.h"
+#include "ColorMap.h"
+
+static double clamp01(double t)
+{
+	return Min(Max(t, 0.0), 1.0);
+}
+
+Vec3d colormap(ColorMapType type, double t)
+{
+	t = clamp01(t);
+	switch (type)
+	{
+	case COLORMAP_HOT:
+		return Vec3d(clamp01(3 * t), clamp01(3 * t - 1), clamp01(3 * t - 2));
+
+	case COLORMAP_GREY:
+		return Vec3d(t, t, t);
+
+	case COLORMAP_COOLWARM:
+	{
+		// diverging blue - grey - red, after Moreland
+		const Vec3d cool(0.230, 0.299, 0.754);
+		const Vec3d mid(0.865, 0.865, 0.865);
+		const Vec3d warm(0.706, 0.016, 0.150);
+		return t < 0.5 ? Vec3d(cool + 2 * t * (mid - cool)) : Vec3d(mid + (2 * t - 1) * (warm - mid));
+	}
+
+	case COLORMAP_JET:
+	default:
+		return Vec3d(clamp01(1.5 - fabs(4 * t - 3)),
+			clamp01(1.5 - fabs(4 * t - 2)),
+			clamp01(1.5 - fabs(4 * t - 1)));
+	}
+}
+
+void colormap(ColorMapType type, const Eigen::VectorXd& S, double lo, double hi, Eigen::MatrixXd& C)
+{
+	double range = hi - lo;
+	if (range == 0) range = 1;
+
+	C.resize(S.rows(), 3);
+	for (int i = 0; i < S.rows(); i++)
+		C.row(i) = colormap(type, (S(i) - lo) / range);
+}
+
+void colormap_table(ColorMapType type, int n, std::vector<unsigned char>& rgb)
+{
+	rgb.resize(3 * n);
+	for (int i = 0; i < n; i++)
+	{
+		Vec3d c = colormap(type, n > 1 ? double(i) / (n - 1) : 0.0);
+		for (int j = 0; j < 3; j++)
+			rgb[3 * i + j] = (unsigned char)(c[j] * 255 + 0.5);
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+typedef enum { COLORMAP_JET = 0, COLORMAP_HOT, COLORMAP_GREY, COLORMAP_COOLWARM, COLORMAP_COUNT } ColorMapType;
+
+// color of t in [0, 1], t is clamped
+Vec3d colormap(ColorMapType type, double t);
+
+// colors of the scalars S, mapping [lo, hi] onto the colormap
+void colormap(ColorMapType type, const Eigen::VectorXd& S, double lo, double hi, Eigen::MatrixXd& C);
+
+// table of n RGB8 colors sampled uniformly from the colormap
+void colormap_table(ColorMapType type, int n, std::vector<unsigned char>& rgb);
@@ -0,0 +1,363 @@
+#include "stdafx.h"
+#include "Components.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+	unsigned last_stamp = 0;
+
+	// root of x, halving the path on the way. Parents only ever move to
+	// smaller indices, so the root of a set is its smallest vertex.
+	int find_root(std::atomic<int>* parent, int x)
+	{
+		for (;;)
+		{
+			int p = parent[x].load(std::memory_order_relaxed);
+			if (p == x) return x;
+			int gp = parent[p].load(std::memory_order_relaxed);
+			if (gp != p) parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+			x = gp;
+		}
+	}
+
+	void unite(std::atomic<int>* parent, int a, int b)
+	{
+		for (;;)
+		{
+			a = find_root(parent, a);
+			b = find_root(parent, b);
+			if (a == b) return;
+			if (a < b) std::swap(a, b);
+			// fails if another thread linked a meanwhile, then try again
+			int expected = a;
+			if (parent[a].compare_exchange_strong(expected, b)) return;
+		}
+	}
+
+	void merge(ComponentStats& into, const ComponentStats& part)
+	{
+		into.faces += part.faces;
+		into.vertices += part.vertices;
+		into.edges += part.edges;
+		into.area += part.area;
+		into.p_min = into.p_min.cwiseMin(part.p_min);
+		into.p_max = into.p_max.cwiseMax(part.p_max);
+		into.boundary_edges += part.boundary_edges;
+		into.boundary_loops += part.boundary_loops;
+		into.nonmanifold_edges += part.nonmanifold_edges;
+	}
+
+	// Sums over a run of items of one component, added to the totals when
+	// the component changes. The items of a component mostly come together,
+	// so the lock is rarely taken.
+	class RunTally
+	{
+	public:
+		RunTally(std::vector<ComponentStats>& totals, std::mutex& lock)
+		: totals_(totals), lock_(lock), component_(-1) {}
+		~RunTally() { flush(); }
+
+		ComponentStats& at(int c)
+		{
+			if (c != component_)
+			{
+				flush();
+				component_ = c;
+			}
+			return part_;
+		}
+
+	private:
+		void flush()
+		{
+			if (component_ < 0) return;
+			std::lock_guard<std::mutex> guard(lock_);
+			merge(totals_[component_], part_);
+			part_ = ComponentStats();
+		}
+
+		std::vector<ComponentStats>& totals_;
+		std::mutex& lock_;
+		int component_;
+		ComponentStats part_;
+	};
+
+	// corner k of face f repeats an earlier corner
+	bool repeated(const Eigen::MatrixXi& F, int f, int k)
+	{
+		return (k > 0 && F(f, k) == F(f, 0)) || (k > 1 && F(f, k) == F(f, 1));
+	}
+}
+
+ComponentStats::ComponentStats()
+: faces(0), vertices(0), edges(0), area(0),
+p_min(Vec3d::Constant(std::numeric_limits<double>::max())),
+p_max(Vec3d::Constant(-std::numeric_limits<double>::max())),
+boundary_edges(0), boundary_loops(0), nonmanifold_edges(0), euler(0), genus(-1)
+{
+}
+
+MeshComponents::MeshComponents()
+: hidden_(0), stamp_(0)
+{
+}
+
+void MeshComponents::clear()
+{
+	stats_.clear();
+	vertex_component_.clear();
+	order_.clear();
+	start_.clear();
+	visible_.clear();
+	runs_.clear();
+	hidden_ = 0;
+	stamp_ = ++last_stamp;
+}
+
+void MeshComponents::label(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F)
+{
+	clear();
+	int nv = V.rows(), nf = F.rows();
+	if (nv == 0 || nf == 0) return;
+
+	// union of the vertices of every face, and the face count of every vertex
+	std::unique_ptr<std::atomic<int>[]> parent(new std::atomic<int>[nv]);
+	std::unique_ptr<std::atomic<int>[]> degree(new std::atomic<int>[nv]);
+	parallel_for(0, nv, [&](int b, int e) {
+		for (int v = b; v < e; v++)
+		{
+			parent[v].store(v, std::memory_order_relaxed);
+			degree[v].store(0, std::memory_order_relaxed);
+		}
+	});
+	parallel_for(0, nf, [&](int b, int e) {
+		for (int f = b; f < e; f++)
+		{
+			unite(parent.get(), F(f, 0), F(f, 1));
+			unite(parent.get(), F(f, 0), F(f, 2));
+			for (int k = 0; k < 3; k++)
+				if (!repeated(F, f, k))
+					degree[F(f, k)].fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+
+	// number the roots in vertex order; a root comes before the rest of its set
+	vertex_component_.assign(nv, -1);
+	parallel_for(0, nv, [&](int b, int e) {
+		for (int v = b; v < e; v++)
+			if (degree[v].load(std::memory_order_relaxed))
+				vertex_component_[v] = find_root(parent.get(), v);
+	});
+	int count = 0;
+	for (int v = 0; v < nv; v++)
+	{
+		int r = vertex_component_[v];
+		if (r >= 0)
+			vertex_component_[v] = r == v ? count++ : vertex_component_[r];
+	}
+
+	// faces, area and bounds
+	std::vector<ComponentStats> stats(count);
+	std::mutex lock;
+	parallel_for(0, nf, [&](int b, int e) {
+		RunTally tally(stats, lock);
+		for (int f = b; f < e; f++)
+		{
+			ComponentStats& s = tally.at(vertex_component_[F(f, 0)]);
+			Vec3d a = V.row(F(f, 0)).transpose(), u = V.row(F(f, 1)).transpose(), w = V.row(F(f, 2)).transpose();
+			s.faces++;
+			s.area += 0.5 * (u - a).cross(w - a).norm();
+			s.p_min = s.p_min.cwiseMin(a).cwiseMin(u).cwiseMin(w);
+			s.p_max = s.p_max.cwiseMax(a).cwiseMax(u).cwiseMax(w);
+		}
+	}, 4096);
+
+	// largest first
+	std::vector<int> by_size(count), rank(count);
+	for (int c = 0; c < count; c++) by_size[c] = c;
+	std::stable_sort(by_size.begin(), by_size.end(), [&](int a, int b) { return stats[a].faces > stats[b].faces; });
+	stats_.resize(count);
+	for (int c = 0; c < count; c++)
+	{
+		rank[by_size[c]] = c;
+		stats_[c] = stats[by_size[c]];
+	}
+	parallel_for(0, nv, [&](int b, int e) {
+		for (int v = b; v < e; v++)
+			if (vertex_component_[v] >= 0)
+				vertex_component_[v] = rank[vertex_component_[v]];
+	});
+
+	// the faces component by component
+	start_.assign(count + 1, 0);
+	for (int c = 0; c < count; c++)
+		start_[c + 1] = start_[c] + stats_[c].faces;
+	{
+		std::vector<int> next(start_.begin(), start_.end() - 1);
+		order_.resize(nf);
+		for (int f = 0; f < nf; f++)
+			order_[next[vertex_component_[F(f, 0)]]++] = f;
+	}
+
+	// faces around each vertex
+	std::vector<int> vf_start(nv + 1, 0);
+	for (int v = 0; v < nv; v++)
+	{
+		vf_start[v + 1] = vf_start[v] + degree[v].load(std::memory_order_relaxed);
+		degree[v].store(vf_start[v], std::memory_order_relaxed);
+	}
+	std::vector<int> vf_faces(vf_start[nv]);
+	parallel_for(0, nf, [&](int b, int e) {
+		for (int f = b; f < e; f++)
+			for (int k = 0; k < 3; k++)
+				if (!repeated(F, f, k))
+					vf_faces[degree[F(f, k)].fetch_add(1, std::memory_order_relaxed)] = f;
+	});
+	degree.reset();
+
+	// edges from the neighbors of each vertex: an edge is counted at its
+	// smaller end, by the number of faces sharing it. The union-find is
+	// reused to join the boundary edges into loops.
+	parallel_for(0, nv, [&](int b, int e) {
+		for (int v = b; v < e; v++)
+			parent[v].store(v, std::memory_order_relaxed);
+	});
+	std::vector<char> on_boundary(nv, 0);
+	parallel_for(0, nv, [&](int b, int e) {
+		RunTally tally(stats_, lock);
+		std::vector<int> neighbors;
+		for (int v = b; v < e; v++)
+		{
+			if (vertex_component_[v] < 0) continue;
+			neighbors.clear();
+			for (int j = vf_start[v]; j < vf_start[v + 1]; j++)
+			{
+				int f = vf_faces[j];
+				for (int k = 0; k < 3; k++)
+				{
+					int u = F(f, k);
+					if (u != v && (k == 0 || u != F(f, k - 1)) && (k < 2 || u != F(f, 0)))
+						neighbors.push_back(u);
+				}
+			}
+			std::sort(neighbors.begin(), neighbors.end());
+
+			ComponentStats& s = tally.at(vertex_component_[v]);
+			s.vertices++;
+			for (size_t i = 0; i < neighbors.size();)
+			{
+				int u = neighbors[i];
+				size_t j = i;
+				while (j < neighbors.size() && neighbors[j] == u) j++;
+				int shared = int(j - i);
+				i = j;
+
+				if (shared == 1) on_boundary[v] = 1;
+				if (u < v) continue;
+				s.edges++;
+				if (shared == 1)
+				{
+					s.boundary_edges++;
+					unite(parent.get(), v, u);
+				}
+				else if (shared > 2)
+					s.nonmanifold_edges++;
+			}
+		}
+	}, 4096);
+
+	// one root per boundary loop
+	parallel_for(0, nv, [&](int b, int e) {
+		RunTally tally(stats_, lock);
+		for (int v = b; v < e; v++)
+			if (on_boundary[v] && find_root(parent.get(), v) == v)
+				tally.at(vertex_component_[v]).boundary_loops++;
+	}, 4096);
+
+	for (int c = 0; c < count; c++)
+	{
+		ComponentStats& s = stats_[c];
+		s.euler = s.vertices - s.edges + s.faces;
+		// chi = 2 - 2g - b on an orientable surface
+		int twice_genus = 2 - s.euler - s.boundary_loops;
+		s.genus = s.manifold() && twice_genus >= 0 && twice_genus % 2 == 0 ? twice_genus / 2 : -1;
+	}
+
+	visible_.assign(count, 1);
+	update_runs();
+}
+
+void MeshComponents::set_visible(int c, bool visible)
+{
+	if (c < 0 || c >= count() || visible_[c] == char(visible)) return;
+	visible_[c] = visible;
+	update_runs();
+}
+
+void MeshComponents::show_all()
+{
+	visible_.assign(count(), 1);
+	update_runs();
+}
+
+void MeshComponents::isolate(int c)
+{
+	if (c < 0 || c >= count()) return;
+	visible_.assign(count(), 0);
+	visible_[c] = 1;
+	update_runs();
+}
+
+void MeshComponents::hide_smaller(int min_faces)
+{
+	for (int c = 0; c < count(); c++)
+		if (stats_[c].faces < min_faces)
+			visible_[c] = 0;
+	update_runs();
+}
+
+void MeshComponents::follow(const MeshComponents& control)
+{
+	if (empty() || control.empty()) return;
+	int nv = (int)Min(vertex_component_.size(), control.vertex_component_.size());
+	for (int v = 0; v < nv; v++)
+	{
+		int c = vertex_component_[v], k = control.vertex_component_[v];
+		if (c >= 0 && k >= 0)
+			visible_[c] = control.visible_[k];
+	}
+	update_runs();
+}
+
+void MeshComponents::update_runs()
+{
+	runs_.clear();
+	hidden_ = 0;
+	for (int c = 0; c < count(); c++)
+	{
+		if (!visible_[c])
+		{
+			hidden_++;
+			continue;
+		}
+		// components in a row join the run before them
+		if (!runs_.empty() && runs_[runs_.size() - 2] + runs_.back() == start_[c])
+			runs_.back() += stats_[c].faces;
+		else
+		{
+			runs_.push_back(start_[c]);
+			runs_.push_back(stats_[c].faces);
+		}
+	}
+}
+
+size_t MeshComponents::bytes() const
+{
+	return stats_.capacity() * sizeof(ComponentStats) + visible_.capacity() +
+		(vertex_component_.capacity() + order_.capacity() + start_.capacity() + runs_.capacity()) * sizeof(int);
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+// Size and topology of one connected component, as of labeling
+struct ComponentStats
+{
+	int faces, vertices, edges;
+	double area;
+	Vec3d p_min, p_max;
+	int boundary_edges;
+	int boundary_loops;
+	int nonmanifold_edges;   // shared by more than two faces
+	int euler;               // V - E + F
+	int genus;               // of an orientable manifold, -1 otherwise
+
+	ComponentStats();
+	bool manifold() const { return nonmanifold_edges == 0; }
+	bool closed() const { return boundary_edges == 0; }
+};
+
+// Connected components of a triangle mesh, faces sharing a vertex being
+// connected. Labeling is a lock-free union-find over the vertices on all
+// cores; components are numbered by decreasing face count.
+// The faces are also listed component by component, so a renderer draws the
+// visible components as a few ranges of one index buffer, and hiding one
+// only changes those ranges.
+class MeshComponents
+{
+public:
+	MeshComponents();
+
+	void label(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F);
+	void clear();
+
+	int count() const { return (int)stats_.size(); }
+	bool empty() const { return stats_.empty(); }
+	const ComponentStats& stats(int c) const { return stats_[c]; }
+
+	// component of vertex v, -1 if no face uses it; a face is in the
+	// component of its vertices
+	int vertex_component(int v) const { return vertex_component_[v]; }
+	int vertices() const { return (int)vertex_component_.size(); }
+
+	// the faces of component c are face_order()[first_face(c) .. first_face(c + 1))
+	const std::vector<int>& face_order() const { return order_; }
+	int first_face(int c) const { return start_[c]; }
+
+	bool visible(int c) const { return visible_[c] != 0; }
+	void set_visible(int c, bool visible);
+	void show_all();
+	void isolate(int c);
+	// hide the components with fewer faces than min_faces
+	void hide_smaller(int min_faces);
+	int hidden() const { return hidden_; }
+
+	// (first, count) pairs in face_order() of the runs of visible components
+	const std::vector<int>& visible_runs() const { return runs_; }
+
+	// take the visibility of the components of a control mesh whose vertices
+	// are our first ones, as after subdivision
+	void follow(const MeshComponents& control);
+
+	// changes with every labeling, for the buffers built from face_order()
+	unsigned stamp() const { return stamp_; }
+
+	size_t bytes() const;
+
+private:
+	void update_runs();
+
+private:
+	std::vector<ComponentStats> stats_;
+	std::vector<int> vertex_component_;
+	std::vector<int> order_, start_;
+	std::vector<char> visible_;
+	std::vector<int> runs_;
+	int hidden_;
+	unsigned stamp_;
+};
@@ -0,0 +1,236 @@
+#include "stdafx.h"
+#include "CrossSection.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+
+namespace
+{
+	// a crossed edge, its end points sorted, and the segment end on it
+	struct SegmentEnd
+	{
+		uint64_t edge;
+		int slot;      // 2 * segment + 0 or 1
+		bool operator<(const SegmentEnd& o) const
+		{
+			return edge != o.edge ? edge < o.edge : slot < o.slot;
+		}
+	};
+
+	// planes k with lo < d[k] <= hi, those a face spanning [lo, hi] crosses
+	void plane_range(const std::vector<double>& d, double lo, double hi, int& first, int& last)
+	{
+		first = int(std::upper_bound(d.begin(), d.end(), lo) - d.begin());
+		last = int(std::upper_bound(d.begin(), d.end(), hi) - d.begin());
+	}
+
+	// cut the faces of one plane and chain the segments
+	void cut_plane(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, const std::vector<double>& h,
+		double d, const int* faces, int count, CrossSection& out)
+	{
+		std::vector<SegmentEnd> ends(2 * size_t(count));
+		for (int j = 0; j < count; j++)
+		{
+			int f = faces[j], n = 0;
+			for (int k = 0; k < 3 && n < 2; k++)
+			{
+				int a = F(f, k), b = F(f, (k + 1) % 3);
+				if ((h[a] >= d) == (h[b] >= d)) continue;
+				SegmentEnd& e = ends[2 * size_t(j) + n];
+				e.edge = uint64_t(Min(a, b)) << 32 | uint32_t(Max(a, b));
+				e.slot = 2 * j + n;
+				n++;
+			}
+		}
+
+		// the two ends on an edge are linked; an edge with one end, or more
+		// than two, ends its polylines
+		std::sort(ends.begin(), ends.end());
+		std::vector<int> link(ends.size(), -1);
+		std::vector<uint64_t> edge(ends.size());
+		for (size_t i = 0; i < ends.size();)
+		{
+			size_t n = 1;
+			while (i + n < ends.size() && ends[i + n].edge == ends[i].edge) n++;
+			for (size_t k = 0; k < n; k++)
+				edge[ends[i + k].slot] = ends[i].edge;
+			if (n == 2)
+			{
+				link[ends[i].slot] = ends[i + 1].slot;
+				link[ends[i + 1].slot] = ends[i].slot;
+			}
+			i += n;
+		}
+
+		std::vector<char> done(count, 0);
+		auto point = [&](int slot) {
+			int a = int(edge[slot] >> 32), b = int(edge[slot] & 0xffffffffu);
+			double t = (d - h[a]) / (h[b] - h[a]);
+			out.points.push_back((V.row(a) + t * (V.row(b) - V.row(a))).transpose());
+		};
+		auto trace = [&](int first) {
+			out.start.push_back((int)out.points.size());
+			point(first);
+			bool closed = false;
+			for (int slot = first;;)
+			{
+				done[slot / 2] = 1;
+				int exit = slot ^ 1, next = link[exit];
+				if (next == first)
+				{
+					closed = true;
+					break;
+				}
+				point(exit);
+				if (next < 0 || done[next / 2]) break;
+				slot = next;
+			}
+			out.closed.push_back(closed);
+		};
+
+		// open polylines from their free ends first, then the loops
+		for (int slot = 0; slot < 2 * count; slot++)
+		{
+			if (link[slot] < 0 && !done[slot / 2])
+				trace(slot);
+		}
+		for (int s = 0; s < count; s++)
+		{
+			if (!done[s])
+				trace(2 * s);
+		}
+		out.start.push_back((int)out.points.size());
+	}
+}
+
+void CrossSection::clear()
+{
+	points.clear();
+	start.clear();
+	closed.clear();
+}
+
+void slice_mesh(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, const Vec3d& normal,
+	const std::vector<double>& offsets, std::vector<CrossSection>& out)
+{
+	int np = (int)offsets.size(), nv = V.rows(), nf = F.rows();
+	out.assign(np, CrossSection());
+	double len = normal.norm();
+	if (len == 0) return;
+	Vec3d n = normal / len;
+	for (int k = 0; k < np; k++)
+	{
+		out[k].normal = n;
+		out[k].offset = offsets[k];
+	}
+	if (np == 0 || nf == 0) return;
+
+	// planes by increasing offset
+	std::vector<int> order(np);
+	for (int k = 0; k < np; k++) order[k] = k;
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return offsets[a] < offsets[b]; });
+	std::vector<double> d(np);
+	for (int k = 0; k < np; k++) d[k] = offsets[order[k]];
+
+	TaskGroup group("slice");
+	std::vector<double> h(nv);
+	parallel_for(group, 0, nv, [&](int b, int e) {
+		for (int v = b; v < e; v++)
+			h[v] = n[0] * V(v, 0) + n[1] * V(v, 1) + n[2] * V(v, 2);
+	}, 1 << 14);
+
+	// the faces of every plane, counted then placed
+	std::unique_ptr<std::atomic<int>[]> count(new std::atomic<int>[np + 1]);
+	for (int k = 0; k <= np; k++) count[k] = 0;
+	auto crossed = [&](int f, int& first, int& last) {
+		double a = h[F(f, 0)], b = h[F(f, 1)], c = h[F(f, 2)];
+		plane_range(d, Min(a, Min(b, c)), Max(a, Max(b, c)), first, last);
+	};
+	parallel_for(group, 0, nf, [&](int b, int e) {
+		for (int f = b; f < e; f++)
+		{
+			int first, last;
+			crossed(f, first, last);
+			for (int k = first; k < last; k++)
+				count[k].fetch_add(1, std::memory_order_relaxed);
+		}
+	}, 1 << 14);
+
+	std::vector<size_t> start(np + 1, 0);
+	for (int k = 0; k < np; k++)
+	{
+		start[k + 1] = start[k] + count[k];
+		count[k] = 0;
+	}
+	std::vector<int> faces(start[np]);
+	parallel_for(group, 0, nf, [&](int b, int e) {
+		for (int f = b; f < e; f++)
+		{
+			int first, last;
+			crossed(f, first, last);
+			for (int k = first; k < last; k++)
+				faces[start[k] + count[k].fetch_add(1, std::memory_order_relaxed)] = f;
+		}
+	}, 1 << 14);
+
+	// sorted faces make the polylines the same for any number of threads
+	parallel_for(group, 0, np, [&](int b, int e) {
+		for (int k = b; k < e; k++)
+		{
+			int* list = faces.empty() ? NULL : &faces[0] + start[k];
+			int m = int(start[k + 1] - start[k]);
+			std::sort(list, list + m);
+			cut_plane(V, F, h, d[k], list, m, out[order[k]]);
+		}
+	}, 1);
+}
+
+void stacked_offsets(const Eigen::MatrixXd& V, const Vec3d& normal, int count, std::vector<double>& offsets)
+{
+	offsets.clear();
+	double len = normal.norm();
+	if (V.rows() == 0 || count <= 0 || len == 0) return;
+
+	Eigen::VectorXd h = V * (normal / len);
+	double lo = h.minCoeff(), hi = h.maxCoeff();
+	offsets.resize(count);
+	for (int k = 0; k < count; k++)
+		offsets[k] = lo + (hi - lo) * (k + 0.5) / count;
+}
+
+bool write_cross_sections(const std::string& filename, const std::vector<CrossSection>& sections)
+{
+	std::ofstream out(filename.c_str());
+	if (!out)
+	{
+		std::cerr << "ERROR (write_cross_sections): Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	for (size_t k = 0; k < sections.size(); k++)
+	{
+		const std::vector<Vec3d>& P = sections[k].points;
+		for (size_t i = 0; i < P.size(); i++)
+			out << "v " << P[i][0] << " " << P[i][1] << " " << P[i][2] << "\n";
+	}
+
+	size_t base = 1;
+	for (size_t k = 0; k < sections.size(); k++)
+	{
+		const CrossSection& s = sections[k];
+		out << "g section" << k << "\n";
+		for (int p = 0; p < s.polylines(); p++)
+		{
+			out << "l";
+			for (int i = s.start[p]; i < s.start[p + 1]; i++)
+				out << " " << base + i;
+			if (s.closed[p]) out << " " << base + s.start[p];
+			out << "\n";
+		}
+		base += s.points.size();
+	}
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "stdafx.h"
+#include <string>
+#include <vector>
+
+// Cross-section of a mesh by the plane normal . x = offset: polylines
+// through points, polyline i being points[start[i] .. start[i + 1]).
+// A closed polyline does not repeat its first point.
+struct CrossSection
+{
+	Vec3d normal;
+	double offset;
+	std::vector<Vec3d> points;
+	std::vector<int> start;     // polylines() + 1 entries
+	std::vector<char> closed;
+
+	int polylines() const { return (int)closed.size(); }
+	void clear();
+};
+
+// The cross-sections of a mesh by the parallel planes normal . x = offsets[k],
+// out[k] for offsets[k]. Every face finds the planes between its lowest and
+// highest vertex by binary search in the sorted offsets, so the work grows
+// with the crossings rather than with faces times planes; the planes are
+// then cut and chained on all cores.
+// A vertex on a plane counts as above it, so a crossed face gives one
+// segment between two of its edges, and segments sharing an edge are
+// chained into polylines: loops on a closed manifold, open polylines ending
+// at boundaries and non-manifold edges.
+void slice_mesh(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, const Vec3d& normal,
+	const std::vector<double>& offsets, std::vector<CrossSection>& out);
+
+// count offsets evenly spread over the extent of V along normal, half a
+// step in from either end
+void stacked_offsets(const Eigen::MatrixXd& V, const Vec3d& normal, int count, std::vector<double>& offsets);
+
+// OBJ polylines: a "v" line per point and an "l" line per polyline, a
+// closed one ending on its first point again
+bool write_cross_sections(const std::string& filename, const std::vector<CrossSection>& sections);
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+#include "Curvature.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+const Eigen::VectorXd& CurvatureFields::field(CurvatureType type) const
+{
+	switch (type)
+	{
+	case CURVATURE_GAUSSIAN: return gaussian;
+	case CURVATURE_MAX: return k_max;
+	case CURVATURE_MIN: return k_min;
+	default: return mean;
+	}
+}
+
+void CurvatureFields::clear()
+{
+	mean.resize(0);
+	gaussian.resize(0);
+	k_max.resize(0);
+	k_min.resize(0);
+}
+
+void compute_curvature(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, const Eigen::MatrixXd& N,
+	CurvatureFields& C)
+{
+	int nv = V.rows(), nf = F.rows();
+	C.mean.setZero(nv);
+	C.gaussian.setZero(nv);
+	C.k_max.setZero(nv);
+	C.k_min.setZero(nv);
+	if (nv == 0 || nf == 0) return;
+
+	// faces around each vertex, with the corner of the vertex in the low bits
+	std::vector<int> start(nv + 1, 0), corners(3 * size_t(nf));
+	for (int f = 0; f < nf; f++)
+		for (int k = 0; k < 3; k++)
+			start[F(f, k) + 1]++;
+	for (int i = 0; i < nv; i++)
+		start[i + 1] += start[i];
+	std::vector<int> fill(start.begin(), start.end() - 1);
+	for (int f = 0; f < nf; f++)
+		for (int k = 0; k < 3; k++)
+			corners[fill[F(f, k)]++] = 4 * f + k;
+
+	parallel_for(0, nv, [&](int b, int e) {
+		std::vector<int> ring;
+		for (int i = b; i < e; i++)
+		{
+			Vec3d xi = V.row(i).transpose();
+			Vec3d laplace(0, 0, 0);
+			double area = 0, angles = 0;
+			ring.clear();
+
+			for (int c = start[i]; c < start[i + 1]; c++)
+			{
+				int f = corners[c] >> 2, k = corners[c] & 3;
+				int j = F(f, (k + 1) % 3), l = F(f, (k + 2) % 3);
+				Vec3d a = V.row(j).transpose() - xi;   // edge to the next corner
+				Vec3d d = V.row(l).transpose() - xi;   // edge to the previous corner
+				Vec3d jl = V.row(l).transpose() - V.row(j).transpose();
+
+				double twice_area = a.cross(d).norm();
+				if (twice_area <= 0) continue;
+
+				// cotangents of the angles at j and l, and the angle at i
+				double cot_j = (-a).dot(jl) / twice_area;
+				double cot_l = d.dot(jl) / twice_area;
+				double theta = atan2(twice_area, a.dot(d));
+				angles += theta;
+
+				laplace -= cot_l * a + cot_j * d;
+
+				// mixed Voronoi area
+				if (a.dot(d) < 0)
+					area += twice_area / 4;
+				else if ((-a).dot(jl) < 0 || d.dot(jl) < 0)
+					area += twice_area / 8;
+				else
+					area += (a.squaredNorm() * cot_l + d.squaredNorm() * cot_j) / 8;
+
+				ring.push_back(j);
+				ring.push_back(-1 - l);
+			}
+			if (area <= 0) continue;
+
+			// an edge that is crossed by one face only is on the boundary
+			bool boundary = false;
+			for (size_t r = 0; r < ring.size() && !boundary; r++)
+			{
+				int v = ring[r] >= 0 ? ring[r] : -1 - ring[r];
+				int in = 0, out = 0;
+				for (size_t s = 0; s < ring.size(); s++)
+				{
+					if (ring[s] == v) out++;
+					else if (ring[s] == -1 - v) in++;
+				}
+				boundary = in != out;
+			}
+
+			// laplace = 4 A H n
+			Vec3d hn = laplace / (4 * area);
+			double h = hn.norm();
+			if (i < N.rows() && hn.dot(N.row(i).transpose()) < 0) h = -h;
+			double k = ((boundary ? M_PI : 2 * M_PI) - angles) / area;
+			double disc = sqrt(Max(h * h - k, 0.0));
+
+			C.mean(i) = h;
+			C.gaussian(i) = k;
+			C.k_max(i) = h + disc;
+			C.k_min(i) = h - disc;
+		}
+	}, 4096);
+}
+
+void robust_range(const Eigen::VectorXd& S, double lo, double hi, double& min, double& max)
+{
+	min = max = 0;
+	int n = S.rows();
+	if (n == 0) return;
+	std::vector<double> values(S.data(), S.data() + n);
+	int a = Min(int(lo * (n - 1)), n - 1), b = Min(int(hi * (n - 1)), n - 1);
+	std::nth_element(values.begin(), values.begin() + a, values.end());
+	min = values[a];
+	std::nth_element(values.begin(), values.begin() + b, values.end());
+	max = values[b];
+}
+
+bool write_curvature(const std::string& filename, const CurvatureFields& C, const Eigen::VectorXi& source_map)
+{
+	std::ofstream out(filename.c_str());
+	if (!out)
+	{
+		std::cerr << "ERROR (write_curvature): Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	int n = source_map.rows() > 0 ? source_map.rows() : C.mean.rows();
+	out << "# mean gaussian k_max k_min\n";
+	for (int s = 0; s < n; s++)
+	{
+		int i = source_map.rows() > 0 ? source_map(s) : s;
+		if (i < 0 || i >= C.mean.rows())
+			out << "0 0 0 0\n";
+		else
+			out << C.mean(i) << " " << C.gaussian(i) << " " << C.k_max(i) << " " << C.k_min(i) << "\n";
+	}
+	return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "stdafx.h"
+#include <string>
+
+typedef enum { CURVATURE_MEAN = 0, CURVATURE_GAUSSIAN, CURVATURE_MAX, CURVATURE_MIN, CURVATURE_COUNT } CurvatureType;
+
+// Per vertex curvature of a triangle mesh
+struct CurvatureFields
+{
+	Eigen::VectorXd mean;      // H, positive on convex parts for outward normals
+	Eigen::VectorXd gaussian;  // K
+	Eigen::VectorXd k_max;     // principal curvatures, H +- sqrt(H^2 - K)
+	Eigen::VectorXd k_min;
+
+	const Eigen::VectorXd& field(CurvatureType type) const;
+	void clear();
+};
+
+// Discrete curvature (Meyer et al. 2003): mean curvature from the cotangent
+// Laplacian, Gaussian curvature from the angle defect, both over the mixed
+// Voronoi area of each vertex. N gives the sign of the mean curvature.
+// Runs on all cores, each vertex reads its own faces only.
+void compute_curvature(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, const Eigen::MatrixXd& N,
+	CurvatureFields& C);
+
+// Values of S between its lo and hi quantiles, to map curvature onto a
+// colormap without a few extreme vertices taking the whole range
+void robust_range(const Eigen::VectorXd& S, double lo, double hi, double& min, double& max);
+
+// Write "mean gaussian k_max k_min" per line. With a non empty source_map
+// (see MeshData::V_source_map), one line per vertex of the source file.
+bool write_curvature(const std::string& filename, const CurvatureFields& C, const Eigen::VectorXi& source_map);
@@ -0,0 +1,345 @@
+#include "stdafx.h"
+#include "Image.h"
+#include <algorithm>
+#include <fstream>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+
+#ifdef USE_STB_IMAGE
+#include <stb_image.h>
+#endif
+
+void Image::flip_rows()
+{
+	size_t stride = size_t(width) * channels;
+	for (int y = 0; y < height / 2; y++)
+	{
+		std::swap_ranges(data.begin() + y * stride, data.begin() + (y + 1) * stride,
+			data.begin() + (height - 1 - y) * stride);
+	}
+}
+
+static bool read_file(const std::string& filename, std::vector<unsigned char>& buf)
+{
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if (!in) return false;
+	in.seekg(0, std::ios::end);
+	std::streamoff size = in.tellg();
+	in.seekg(0, std::ios::beg);
+	buf.resize(size_t(size));
+	if (size > 0) in.read((char*)&buf[0], size);
+	return !in.fail();
+}
+
+static std::string extension(const std::string& filename)
+{
+	size_t pos = filename.find_last_of('.');
+	if (pos == std::string::npos) return "";
+	std::string ext = filename.substr(pos + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext;
+}
+
+// -----------
+// PPM, P6 (binary) and P3 (ascii)
+static bool ppm_token(const std::vector<unsigned char>& buf, size_t& pos, int& value)
+{
+	// skip white space and comments
+	while (pos < buf.size())
+	{
+		if (buf[pos] == '#')
+			while (pos < buf.size() && buf[pos] != '\n') pos++;
+		else if (isspace(buf[pos]))
+			pos++;
+		else
+			break;
+	}
+
+	if (pos >= buf.size() || !isdigit(buf[pos])) return false;
+	value = 0;
+	while (pos < buf.size() && isdigit(buf[pos]))
+	{
+		int digit = buf[pos++] - '0';
+		if (value > (INT_MAX - digit) / 10) return false;
+		value = value * 10 + digit;
+	}
+	return true;
+}
+
+static bool decode_ppm(const std::vector<unsigned char>& buf, Image& img)
+{
+	bool binary = buf[1] == '6';
+	size_t pos = 2;
+	int w, h, maxval;
+	if (!ppm_token(buf, pos, w) || !ppm_token(buf, pos, h) || !ppm_token(buf, pos, maxval) ||
+		w <= 0 || h <= 0 || maxval <= 0 || maxval > 65535)
+		return false;
+
+	// every sample takes a byte of the file at least, checked before the
+	// image is allocated
+	if (binary) pos++; // single white space after the header
+	int bytes = binary && maxval >= 256 ? 2 : 1;
+	uint64_t samples = uint64_t(w) * h * 3;
+	if (pos > buf.size() || samples * bytes > buf.size() - pos) return false;
+
+	img = Image(w, h, 3);
+	size_t n = img.data.size();
+	if (binary)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			int v = bytes == 1 ? buf[pos + i] : (buf[pos + 2 * i] << 8) | buf[pos + 2 * i + 1];
+			img.data[i] = (unsigned char)(v * 255 / maxval);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			int v;
+			if (!ppm_token(buf, pos, v)) return false;
+			img.data[i] = (unsigned char)(Min(v, maxval) * 255 / maxval);
+		}
+	}
+
+	// ppm is stored from top to bottom
+	img.flip_rows();
+	return true;
+}
+
+// -----------
+// TGA, uncompressed and RLE true color or grey
+static bool decode_tga(const std::vector<unsigned char>& buf, Image& img)
+{
+	if (buf.size() < 18) return false;
+	int id_length = buf[0];
+	int cmap_type = buf[1];
+	int type = buf[2];
+	int cmap_length = buf[5] | (buf[6] << 8);
+	int cmap_bits = buf[7];
+	int w = buf[12] | (buf[13] << 8);
+	int h = buf[14] | (buf[15] << 8);
+	int bpp = buf[16];
+	bool top_down = (buf[17] & 0x20) != 0;
+
+	bool grey = type == 3 || type == 11;
+	bool rle = type == 10 || type == 11;
+	if ((type != 2 && type != 3 && type != 10 && type != 11) || w <= 0 || h <= 0)
+		return false;
+	if ((grey && bpp != 8) || (!grey && bpp != 24 && bpp != 32))
+		return false;
+
+	size_t pos = 18 + id_length;
+	if (cmap_type == 1) pos += cmap_length * ((cmap_bits + 7) / 8);
+
+	// a run packet holds at most 128 pixels: bound the size by the file
+	// before the image is allocated
+	int src_channels = bpp / 8;
+	size_t n = size_t(w) * h;
+	if (pos > buf.size() || (rle ? uint64_t(n) > uint64_t(buf.size() - pos) * 128 :
+		uint64_t(n) * src_channels > buf.size() - pos))
+		return false;
+	img = Image(w, h, grey ? 3 : src_channels);
+
+	// convert one source pixel, BGR(A) or grey
+	unsigned char* dst = &img.data[0];
+	auto put = [&](const unsigned char* src)
+	{
+		if (grey)
+		{
+			dst[0] = dst[1] = dst[2] = src[0];
+		}
+		else
+		{
+			dst[0] = src[2]; dst[1] = src[1]; dst[2] = src[0];
+			if (src_channels == 4) dst[3] = src[3];
+		}
+		dst += img.channels;
+	};
+
+	size_t i = 0;
+	while (i < n)
+	{
+		if (!rle)
+		{
+			if (pos + src_channels > buf.size()) return false;
+			put(&buf[pos]);
+			pos += src_channels;
+			i++;
+			continue;
+		}
+
+		if (pos >= buf.size()) return false;
+		int header = buf[pos++];
+		int count = (header & 0x7f) + 1;
+		if (i + count > n) return false;
+		if (header & 0x80)
+		{
+			// run of one repeated pixel
+			if (pos + src_channels > buf.size()) return false;
+			for (int k = 0; k < count; k++) put(&buf[pos]);
+			pos += src_channels;
+		}
+		else
+		{
+			// run of raw pixels
+			if (pos + count * src_channels > buf.size()) return false;
+			for (int k = 0; k < count; k++, pos += src_channels) put(&buf[pos]);
+		}
+		i += count;
+	}
+
+	if (top_down) img.flip_rows();
+	return true;
+}
+
+// -----------
+// BMP, uncompressed 24 and 32 bit
+static int read_le(const std::vector<unsigned char>& buf, size_t pos, int bytes)
+{
+	unsigned int v = 0;
+	for (int i = bytes - 1; i >= 0; i--)
+		v = (v << 8) | buf[pos + i];
+	return (int)v;
+}
+
+static bool decode_bmp(const std::vector<unsigned char>& buf, Image& img)
+{
+	if (buf.size() < 54) return false;
+	size_t offset = read_le(buf, 10, 4);
+	int w = read_le(buf, 18, 4);
+	int h = read_le(buf, 22, 4);
+	int bpp = read_le(buf, 28, 2);
+	int compression = read_le(buf, 30, 4);
+
+	// 32 bit bitfields are accepted with the usual BGRA masks
+	if ((bpp != 24 && bpp != 32) || (compression != 0 && !(compression == 3 && bpp == 32)))
+		return false;
+
+	bool top_down = h < 0;
+	if (w <= 0 || h == 0 || h == INT_MIN) return false;
+	h = std::abs(h);
+
+	// in 64 bits, the rows must lie within the file
+	int src_channels = bpp / 8;
+	uint64_t stride = (uint64_t(w) * src_channels + 3) & ~uint64_t(3);
+	if (offset > buf.size() || stride * h > buf.size() - offset) return false;
+
+	img = Image(w, h, src_channels);
+	for (int y = 0; y < h; y++)
+	{
+		const unsigned char* src = &buf[offset + size_t(stride * y)];
+		unsigned char* dst = img.pixel(0, y);
+		for (int x = 0; x < w; x++, src += src_channels, dst += src_channels)
+		{
+			dst[0] = src[2]; dst[1] = src[1]; dst[2] = src[0];
+			if (src_channels == 4) dst[3] = src[3];
+		}
+	}
+
+	// bmp is stored from bottom to top unless the height is negative
+	if (top_down) img.flip_rows();
+	return true;
+}
+
+#ifdef USE_STB_IMAGE
+static bool decode_stb(const std::vector<unsigned char>& buf, Image& img)
+{
+	int w, h, n;
+	stbi_set_flip_vertically_on_load(1);
+	unsigned char* pixels = stbi_load_from_memory(&buf[0], (int)buf.size(), &w, &h, &n, 0);
+	if (pixels == NULL) return false;
+
+	// expand grey and grey+alpha to RGB(A)
+	img = Image(w, h, n == 2 || n == 4 ? 4 : 3);
+	size_t count = size_t(w) * h;
+	for (size_t i = 0; i < count; i++)
+	{
+		const unsigned char* src = pixels + i * n;
+		unsigned char* dst = &img.data[i * img.channels];
+		if (n <= 2)
+		{
+			dst[0] = dst[1] = dst[2] = src[0];
+			if (n == 2) dst[3] = src[1];
+		}
+		else
+		{
+			for (int k = 0; k < n; k++) dst[k] = src[k];
+		}
+	}
+	stbi_image_free(pixels);
+	return true;
+}
+#endif
+
+bool read_image(const std::string& filename, Image& img)
+{
+	std::vector<unsigned char> buf;
+	if (!read_file(filename, buf) || buf.size() < 2)
+	{
+		std::cerr << "ERROR (read_image): Can not read " << filename << std::endl;
+		return false;
+	}
+
+	bool ok = false;
+	std::string ext = extension(filename);
+	if (buf[0] == 'P' && (buf[1] == '6' || buf[1] == '3'))
+		ok = decode_ppm(buf, img);
+	else if (buf[0] == 'B' && buf[1] == 'M')
+		ok = decode_bmp(buf, img);
+	else if (ext == "tga")
+		ok = decode_tga(buf, img);
+#ifdef USE_STB_IMAGE
+	else
+		ok = decode_stb(buf, img);
+#endif
+
+	if (!ok)
+	{
+		std::cerr << "ERROR (read_image): Unsupported or corrupted image " << filename << std::endl;
+		img = Image();
+	}
+	return ok;
+}
+
+void pack_image(const Eigen::Matrix<char, Eigen::Dynamic, Eigen::Dynamic>& R,
+	const Eigen::Matrix<char, Eigen::Dynamic, Eigen::Dynamic>& G,
+	const Eigen::Matrix<char, Eigen::Dynamic, Eigen::Dynamic>& B, Image& img)
+{
+	// row i of the matrices is the texel row t = i
+	img = Image(R.cols(), R.rows(), 3);
+	for (int y = 0; y < img.height; y++)
+	{
+		for (int x = 0; x < img.width; x++)
+		{
+			unsigned char* p = img.pixel(x, y);
+			p[0] = (unsigned char)R(y, x);
+			p[1] = (unsigned char)G(y, x);
+			p[2] = (unsigned char)B(y, x);
+		}
+	}
+}
+
+const Image& checkerboard_image()
+{
+	static Image grid;
+	if (grid.empty())
+	{
+		int size = 128;
+		int size2 = size / 2;
+		grid = Image(size, size, 3);
+		for (int i = 0; i < size; ++i)
+		{
+			for (int j = 0; j < size; ++j)
+			{
+				unsigned char c = 0;
+				if ((i < size2 && j < size2) || (i >= size2 && j >= size2))
+					c = 255;
+				unsigned char* p = grid.pixel(j, i);
+				p[0] = p[1] = p[2] = c;
+			}
+		}
+	}
+	return grid;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+// 8 bit per channel image with packed RGB or RGBA pixels.
+// Rows are stored from bottom to top, the order OpenGL expects for textures.
+class Image
+{
+public:
+	Image() : width(0), height(0), channels(0) {}
+	Image(int _width, int _height, int _channels)
+		: width(_width), height(_height), channels(_channels),
+		data(size_t(_width) * _height * _channels, 0) {}
+
+	bool empty() const { return data.empty(); }
+	size_t bytes() const { return data.size(); }
+
+	unsigned char* pixel(int x, int y) { return &data[(size_t(y) * width + x) * channels]; }
+	const unsigned char* pixel(int x, int y) const { return &data[(size_t(y) * width + x) * channels]; }
+
+	// reverse the order of the rows
+	void flip_rows();
+
+public:
+	int width, height, channels;
+	std::vector<unsigned char> data;
+};
+
+// Decode an image file into packed RGB(A)8
+// Supports binary/ascii PPM, uncompressed/RLE TGA and uncompressed BMP;
+// PNG, JPEG and the rest are decoded by stb_image when USE_STB_IMAGE is defined
+bool read_image(const std::string& filename, Image& img);
+
+// Pack three channel matrices into an RGB image
+void pack_image(const Eigen::Matrix<char, Eigen::Dynamic, Eigen::Dynamic>& R,
+	const Eigen::Matrix<char, Eigen::Dynamic, Eigen::Dynamic>& G,
+	const Eigen::Matrix<char, Eigen::Dynamic, Eigen::Dynamic>& B, Image& img);
+
+// The default black and white checkerboard, generated once
+const Image& checkerboard_image();
@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include "ImageLoader.h"
+#include <algorithm>
+
+ImageLoader::ImageLoader()
+: quit_(false)
+{
+}
+
+ImageLoader::~ImageLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	cv_.notify_all();
+	if (worker_.joinable()) worker_.join();
+}
+
+void ImageLoader::request(const std::string& filename)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (decoding_ == filename || done_.count(filename) ||
+			std::find(queue_.begin(), queue_.end(), filename) != queue_.end())
+			return;
+		queue_.push_back(filename);
+
+		// the thread is only started once something has to be decoded
+		if (!worker_.joinable())
+			worker_ = std::thread(&ImageLoader::run, this);
+	}
+	cv_.notify_one();
+}
+
+bool ImageLoader::fetch(const std::string& filename, Image& img, bool& ok)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = done_.find(filename);
+	if (it == done_.end()) return false;
+
+	ok = it->second.first;
+	std::swap(img, it->second.second);
+	done_.erase(it);
+	return true;
+}
+
+std::vector<std::string> ImageLoader::finished()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::vector<std::string> names;
+	for (auto it = done_.begin(); it != done_.end(); ++it)
+		names.push_back(it->first);
+	return names;
+}
+
+int ImageLoader::pending()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (int)queue_.size() + (decoding_.empty() ? 0 : 1);
+}
+
+void ImageLoader::run()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		cv_.wait(lock, [this] { return quit_ || !queue_.empty(); });
+		if (quit_) break;
+
+		decoding_ = queue_.front();
+		queue_.pop_front();
+
+		// decode without holding the lock
+		lock.unlock();
+		Image img;
+		bool ok = read_image(decoding_, img);
+		lock.lock();
+
+		std::pair<bool, Image>& result = done_[decoding_];
+		result.first = ok;
+		std::swap(result.second, img);
+		decoding_.clear();
+	}
+}
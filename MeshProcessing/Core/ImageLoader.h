@@ -0,0 +1,44 @@
+#pragma once
+#include "stdafx.h"
+#include "Image.h"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// Decodes image files on a background thread.
+// Requests are queued by file name, the decoded images are picked up with fetch().
+class ImageLoader
+{
+public:
+	ImageLoader();
+	~ImageLoader();
+
+	// queue a file for decoding, ignored if it is already queued or decoded
+	void request(const std::string& filename);
+
+	// move the decoded image out of the loader
+	// returns false while the file is still queued or decoding,
+	// ok tells whether the decoding succeeded
+	bool fetch(const std::string& filename, Image& img, bool& ok);
+
+	// names of the files decoded and not fetched yet
+	std::vector<std::string> finished();
+
+	// number of files queued or decoding
+	int pending();
+
+private:
+	void run();
+
+private:
+	std::thread worker_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	bool quit_;
+
+	std::deque<std::string> queue_;
+	std::string decoding_;
+	std::map<std::string, std::pair<bool, Image> > done_;
+};
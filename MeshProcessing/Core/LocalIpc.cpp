@@ -0,0 +1,349 @@
+#include "stdafx.h"
+#include "LocalIpc.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+#ifdef _WIN32
+static std::string pipe_path(const std::string& name) { return "\\\\.\\pipe\\" + name; }
+static std::string mapping_name(const std::string& name) { return "Local\\" + name; }
+#else
+static std::string socket_path(const std::string& name)
+{
+	return name.empty() || name[0] == '/' ? name : "/tmp/" + name + ".sock";
+}
+static std::string shm_name(const std::string& name) { return "/" + name; }
+#endif
+
+// -----------
+SharedMemory::SharedMemory()
+: data_(NULL), size_(0), owner_(false)
+#ifdef _WIN32
+, mapping_(NULL)
+#else
+, fd_(-1)
+#endif
+{
+}
+
+SharedMemory::~SharedMemory()
+{
+	close();
+}
+
+bool SharedMemory::create(const std::string& name, size_t bytes)
+{
+	close();
+	if (bytes == 0) return false;
+
+#ifdef _WIN32
+	unsigned long long size = bytes;
+	mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		DWORD(size >> 32), DWORD(size & 0xffffffff), mapping_name(name).c_str());
+	if (mapping_ != NULL)
+		data_ = (unsigned char*)MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+#else
+	std::string path = shm_name(name);
+	fd_ = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd_ < 0 && errno == EEXIST)
+	{
+		// left over by a process that died
+		shm_unlink(path.c_str());
+		fd_ = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	}
+	if (fd_ >= 0 && ftruncate(fd_, off_t(bytes)) == 0)
+	{
+		void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+		if (p != MAP_FAILED) data_ = (unsigned char*)p;
+	}
+#endif
+
+	name_ = name;
+	owner_ = true;
+	size_ = bytes;
+	if (data_ == NULL)
+	{
+		std::cerr << "ERROR (SharedMemory): Can not create " << name << std::endl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool SharedMemory::open(const std::string& name)
+{
+	close();
+
+#ifdef _WIN32
+	mapping_ = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mapping_name(name).c_str());
+	if (mapping_ != NULL)
+		data_ = (unsigned char*)MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (data_ != NULL)
+	{
+		// the view covers whole pages
+		MEMORY_BASIC_INFORMATION info;
+		VirtualQuery(data_, &info, sizeof(info));
+		size_ = info.RegionSize;
+	}
+#else
+	fd_ = shm_open(shm_name(name).c_str(), O_RDWR, 0600);
+	struct stat st;
+	if (fd_ >= 0 && fstat(fd_, &st) == 0 && st.st_size > 0)
+	{
+		void* p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+		if (p != MAP_FAILED)
+		{
+			data_ = (unsigned char*)p;
+			size_ = size_t(st.st_size);
+		}
+	}
+#endif
+
+	name_ = name;
+	owner_ = false;
+	if (data_ == NULL)
+	{
+		std::cerr << "ERROR (SharedMemory): Can not open " << name << std::endl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+void SharedMemory::close()
+{
+#ifdef _WIN32
+	if (data_) UnmapViewOfFile(data_);
+	if (mapping_) CloseHandle(mapping_);
+	mapping_ = NULL;
+#else
+	if (data_) munmap(data_, size_);
+	if (fd_ >= 0) ::close(fd_);
+	if (fd_ >= 0 && owner_) shm_unlink(shm_name(name_).c_str());
+	fd_ = -1;
+#endif
+	data_ = NULL;
+	size_ = 0;
+	owner_ = false;
+	name_.clear();
+}
+
+// -----------
+LocalStream::LocalStream()
+#ifdef _WIN32
+: handle_(INVALID_HANDLE_VALUE), server_(false)
+#else
+: fd_(-1)
+#endif
+{
+}
+
+LocalStream::~LocalStream()
+{
+	close();
+}
+
+bool LocalStream::connect(const std::string& name)
+{
+	close();
+
+#ifdef _WIN32
+	std::string path = pipe_path(name);
+	for (int attempt = 0; attempt < 10; attempt++)
+	{
+		handle_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+		if (handle_ != INVALID_HANDLE_VALUE || GetLastError() != ERROR_PIPE_BUSY) break;
+		WaitNamedPipeA(path.c_str(), 1000);
+	}
+	server_ = false;
+#else
+	std::string path = socket_path(name);
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path)) return false;
+	strcpy(addr.sun_path, path.c_str());
+
+	fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd_ >= 0 && ::connect(fd_, (sockaddr*)&addr, sizeof(addr)) != 0)
+		close();
+#endif
+
+	return is_open();
+}
+
+void LocalStream::close()
+{
+#ifdef _WIN32
+	if (handle_ != INVALID_HANDLE_VALUE)
+	{
+		if (server_) DisconnectNamedPipe(handle_);
+		CloseHandle(handle_);
+	}
+	handle_ = INVALID_HANDLE_VALUE;
+#else
+	if (fd_ >= 0) ::close(fd_);
+	fd_ = -1;
+#endif
+}
+
+bool LocalStream::is_open() const
+{
+#ifdef _WIN32
+	return handle_ != INVALID_HANDLE_VALUE;
+#else
+	return fd_ >= 0;
+#endif
+}
+
+bool LocalStream::read(void* data, size_t bytes)
+{
+	char* p = (char*)data;
+	while (bytes > 0)
+	{
+#ifdef _WIN32
+		DWORD n = 0;
+		if (!ReadFile(handle_, p, DWORD(Min(bytes, size_t(1) << 20)), &n, NULL) || n == 0) return false;
+#else
+		ssize_t n = ::recv(fd_, p, bytes, 0);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+#endif
+		p += n;
+		bytes -= n;
+	}
+	return true;
+}
+
+bool LocalStream::write(const void* data, size_t bytes)
+{
+	const char* p = (const char*)data;
+	while (bytes > 0)
+	{
+#ifdef _WIN32
+		DWORD n = 0;
+		if (!WriteFile(handle_, p, DWORD(Min(bytes, size_t(1) << 20)), &n, NULL) || n == 0) return false;
+#else
+		int flags = 0;
+#ifdef MSG_NOSIGNAL
+		flags = MSG_NOSIGNAL;    // a closed peer is an error, not a signal
+#endif
+		ssize_t n = ::send(fd_, p, bytes, flags);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+#endif
+		p += n;
+		bytes -= n;
+	}
+	return true;
+}
+
+void LocalStream::shutdown()
+{
+#ifdef _WIN32
+	if (handle_ != INVALID_HANDLE_VALUE) CancelIoEx(handle_, NULL);
+#else
+	if (fd_ >= 0) ::shutdown(fd_, SHUT_RDWR);
+#endif
+}
+
+// -----------
+LocalListener::LocalListener()
+#ifndef _WIN32
+: fd_(-1)
+#endif
+{
+}
+
+LocalListener::~LocalListener()
+{
+	close();
+}
+
+bool LocalListener::listen(const std::string& name)
+{
+	close();
+	name_ = name;
+
+#ifdef _WIN32
+	// pipe instances are created by accept()
+	return true;
+#else
+	std::string path = socket_path(name);
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path)) return false;
+	strcpy(addr.sun_path, path.c_str());
+
+	unlink(path.c_str());
+	fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd_ < 0 || bind(fd_, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd_, 4) != 0)
+	{
+		std::cerr << "ERROR (LocalListener): Can not listen on " << path << std::endl;
+		close();
+		return false;
+	}
+	return true;
+#endif
+}
+
+void LocalListener::close()
+{
+#ifndef _WIN32
+	if (fd_ >= 0)
+	{
+		::close(fd_);
+		unlink(socket_path(name_).c_str());
+	}
+	fd_ = -1;
+#endif
+	name_.clear();
+}
+
+bool LocalListener::accept(LocalStream& stream)
+{
+	stream.close();
+	if (name_.empty()) return false;
+
+#ifdef _WIN32
+	HANDLE h = CreateNamedPipeA(pipe_path(name_).c_str(), PIPE_ACCESS_DUPLEX,
+		PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, PIPE_UNLIMITED_INSTANCES,
+		1 << 16, 1 << 16, 0, NULL);
+	if (h == INVALID_HANDLE_VALUE) return false;
+	if (!ConnectNamedPipe(h, NULL) && GetLastError() != ERROR_PIPE_CONNECTED)
+	{
+		CloseHandle(h);
+		return false;
+	}
+	stream.handle_ = h;
+	stream.server_ = true;
+#else
+	int fd;
+	do fd = ::accept(fd_, NULL, NULL);
+	while (fd < 0 && errno == EINTR);
+	if (fd < 0) return false;
+	stream.fd_ = fd;
+#endif
+	return true;
+}
+
+void LocalListener::wake()
+{
+	// a connection of our own
+	LocalStream stream;
+	stream.connect(name_);
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "stdafx.h"
+
+// Named shared memory segment: a file mapping backed by the page file on
+// Windows, a POSIX shm object elsewhere. The creator owns the name and
+// removes it on close.
+class SharedMemory
+{
+public:
+	SharedMemory();
+	~SharedMemory();
+
+	bool create(const std::string& name, size_t bytes);
+	bool open(const std::string& name);
+	void close();
+
+	bool is_open() const { return data_ != NULL; }
+	unsigned char* data() const { return data_; }
+	size_t size() const { return size_; }
+	const std::string& name() const { return name_; }
+
+private:
+	SharedMemory(const SharedMemory&);
+	SharedMemory& operator=(const SharedMemory&);
+
+private:
+	unsigned char* data_;
+	size_t size_;
+	std::string name_;
+	bool owner_;
+#ifdef _WIN32
+	void* mapping_;
+#else
+	int fd_;
+#endif
+};
+
+// Byte stream between two local processes: a named pipe on Windows,
+// a Unix domain socket elsewhere
+class LocalStream
+{
+public:
+	LocalStream();
+	~LocalStream();
+
+	// connect to a LocalListener
+	bool connect(const std::string& name);
+	void close();
+	bool is_open() const;
+
+	// blocking, all or nothing
+	bool read(void* data, size_t bytes);
+	bool write(const void* data, size_t bytes);
+
+	// make a read blocked in another thread return
+	void shutdown();
+
+private:
+	friend class LocalListener;
+	LocalStream(const LocalStream&);
+	LocalStream& operator=(const LocalStream&);
+
+private:
+#ifdef _WIN32
+	void* handle_;
+	bool server_;
+#else
+	int fd_;
+#endif
+};
+
+// Accepts LocalStream connections under a name
+class LocalListener
+{
+public:
+	LocalListener();
+	~LocalListener();
+
+	bool listen(const std::string& name);
+	void close();
+
+	// blocks until a client connects; false once closed
+	bool accept(LocalStream& stream);
+
+	// make an accept blocked in another thread return
+	void wake();
+
+private:
+	LocalListener(const LocalListener&);
+	LocalListener& operator=(const LocalListener&);
+
+private:
+	std::string name_;
+#ifndef _WIN32
+	int fd_;
+#endif
+};
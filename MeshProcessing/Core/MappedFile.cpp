@@ -0,0 +1,108 @@
+#include "stdafx.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+: data_(NULL), size_(0)
+#ifdef _WIN32
+, file_(INVALID_HANDLE_VALUE), mapping_(NULL)
+#else
+, fd_(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+	close();
+
+#ifdef _WIN32
+	file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file_ == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping_ != NULL)
+		data_ = (const unsigned char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+	size_ = size_t(size.QuadPart);
+#else
+	fd_ = ::open(filename.c_str(), O_RDONLY);
+	if (fd_ < 0) return false;
+
+	struct stat st;
+	if (fstat(fd_, &st) != 0 || st.st_size == 0)
+	{
+		close();
+		return false;
+	}
+
+	void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd_, 0);
+	if (p != MAP_FAILED) data_ = (const unsigned char*)p;
+	size_ = size_t(st.st_size);
+#endif
+
+	if (data_ == NULL)
+	{
+		std::cerr << "ERROR (MappedFile): Can not map " << filename << std::endl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (data_) UnmapViewOfFile(data_);
+	if (mapping_) CloseHandle(mapping_);
+	if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+	mapping_ = NULL;
+	file_ = INVALID_HANDLE_VALUE;
+#else
+	if (data_) munmap((void*)data_, size_);
+	if (fd_ >= 0) ::close(fd_);
+	fd_ = -1;
+#endif
+	data_ = NULL;
+	size_ = 0;
+}
+
+void MappedFile::prefetch(size_t offset, size_t bytes) const
+{
+	if (data_ == NULL || offset >= size_) return;
+	bytes = Min(bytes, size_ - offset);
+
+#ifndef _WIN32
+	// the kernel reads ahead in the background; madvise wants a page
+	// aligned start
+	size_t page = size_t(sysconf(_SC_PAGESIZE));
+	size_t start = offset / page * page;
+	madvise((void*)(data_ + start), bytes + offset - start, MADV_WILLNEED);
+#else
+	// no advice call: touch one byte per page
+	volatile unsigned char sink = 0;
+	for (size_t i = 0; i < bytes; i += 4096)
+		sink ^= data_[offset + i];
+	(void)sink;
+#endif
+}
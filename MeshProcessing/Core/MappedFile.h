@@ -0,0 +1,35 @@
+#pragma once
+#include "stdafx.h"
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const std::string& filename);
+	void close();
+
+	bool is_open() const { return data_ != NULL; }
+	const unsigned char* data() const { return data_; }
+	size_t size() const { return size_; }
+
+	// hint that a range is about to be read, so it is paged in ahead of time;
+	// returns at once where the system reads ahead in the background
+	void prefetch(size_t offset, size_t bytes) const;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+private:
+	const unsigned char* data_;
+	size_t size_;
+#ifdef _WIN32
+	void* file_;
+	void* mapping_;
+#else
+	int fd_;
+#endif
+};
@@ -0,0 +1,67 @@
+#include "stdafx.h"
+#include "MemoryStats.h"
+#include <atomic>
+#include <iomanip>
+
+namespace
+{
+	std::atomic<long long> current_bytes[memstats::CATEGORY_COUNT];
+	std::atomic<long long> peak_bytes[memstats::CATEGORY_COUNT];
+}
+
+namespace memstats
+{
+	void add(Category c, long long bytes)
+	{
+		long long now = (current_bytes[c] += bytes);
+		long long high = peak_bytes[c].load();
+		while (now > high && !peak_bytes[c].compare_exchange_weak(high, now))
+		{
+		}
+	}
+
+	size_t current(Category c)
+	{
+		return (size_t)Max(current_bytes[c].load(), 0LL);
+	}
+
+	size_t peak(Category c)
+	{
+		return (size_t)Max(peak_bytes[c].load(), 0LL);
+	}
+
+	const char* name(Category c)
+	{
+		static const char* names[CATEGORY_COUNT] = { "mesh", "search", "undo", "render", "scratch" };
+		return names[c];
+	}
+
+	void print(std::ostream& out)
+	{
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision(1);
+		for (int c = 0; c < CATEGORY_COUNT; c++)
+		{
+			out << std::setw(8) << name(Category(c)) << ": " << std::setw(8) << current(Category(c)) / 1048576.0
+				<< " MB, peak " << std::setw(8) << peak(Category(c)) / 1048576.0 << " MB" << std::endl;
+		}
+		out.flags(flags);
+	}
+
+	Gauge::Gauge(Category c)
+	: category_(c), bytes_(0)
+	{
+	}
+
+	Gauge::~Gauge()
+	{
+		set(0);
+	}
+
+	void Gauge::set(size_t bytes)
+	{
+		if (bytes != bytes_)
+			add(category_, (long long)bytes - (long long)bytes_);
+		bytes_ = bytes;
+	}
+}
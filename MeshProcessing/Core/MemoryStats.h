@@ -0,0 +1,49 @@
+#pragma once
+#include "stdafx.h"
+#include <ostream>
+
+// Bytes held by each subsystem, current and peak, for leak hunting and
+// sizing. Subsystems report what they hold; nothing is hooked globally.
+// Counters are atomic, any thread may report.
+namespace memstats
+{
+	typedef enum
+	{
+		MESH = 0,    // MeshData attributes
+		SEARCH,      // kd-trees and grids for picking
+		UNDO,        // undo/redo history
+		RENDER,      // vertex and index buffers
+		SCRATCH,     // arenas of load time temporaries
+		CATEGORY_COUNT
+	} Category;
+
+	// report bytes taken (positive) or given back (negative)
+	void add(Category c, long long bytes);
+
+	size_t current(Category c);
+	size_t peak(Category c);
+	const char* name(Category c);
+
+	// one line per subsystem, in MB
+	void print(std::ostream& out);
+
+	// A holder of a varying amount: set() reports the change since the last
+	// set(), and the destructor gives everything back
+	class Gauge
+	{
+	public:
+		explicit Gauge(Category c);
+		~Gauge();
+
+		void set(size_t bytes);
+		size_t bytes() const { return bytes_; }
+
+	private:
+		Gauge(const Gauge&);
+		Gauge& operator=(const Gauge&);
+
+	private:
+		Category category_;
+		size_t bytes_;
+	};
+}
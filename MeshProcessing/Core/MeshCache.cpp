@@ -0,0 +1,274 @@
+#include "stdafx.h"
+#include "MeshCache.h"
+#include "MeshData.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	enum Section
+	{
+		SECTION_V = 0, SECTION_F, SECTION_TC, SECTION_FTC, SECTION_SOURCE_MAP,
+		SECTION_F_NORMALS, SECTION_V_NORMALS, SECTION_F_CENTER, SECTION_COUNT
+	};
+
+	struct SectionHeader
+	{
+		uint64_t offset;
+		uint64_t rows;
+		uint32_t cols;
+		uint32_t scalar;   // bytes per entry
+	};
+
+	struct CacheHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		double p_min[3], p_max[3];
+		double avg_edge;
+		SectionHeader sections[SECTION_COUNT];
+	};
+
+	const char kMagic[4] = { 'M', 'P', 'M', 'C' };
+	// bump when the layout or anything derived from the mesh changes
+	const uint32_t kVersion = 1;
+	const size_t kAlign = 64;
+	const size_t kBlock = size_t(1) << 22;
+
+	uint64_t rotl(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	uint64_t mix(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// 64 bit hash of a block, four independent lanes so the multiplies overlap
+	uint64_t hash_block(const unsigned char* p, size_t bytes, uint64_t seed)
+	{
+		const uint64_t k1 = 0x9e3779b97f4a7c15ULL, k2 = 0xc2b2ae3d27d4eb4fULL;
+		uint64_t lane[4] = { seed, seed ^ k1, seed ^ k2, seed + k1 + k2 };
+		size_t i = 0;
+		for (; i + 32 <= bytes; i += 32)
+		{
+			for (int l = 0; l < 4; l++)
+			{
+				uint64_t w;
+				memcpy(&w, p + i + 8 * l, 8);
+				lane[l] = rotl(lane[l] ^ (w * k2), 31) * k1;
+			}
+		}
+		uint64_t h = rotl(lane[0], 1) + rotl(lane[1], 7) + rotl(lane[2], 12) + rotl(lane[3], 18);
+		for (; i < bytes; i++)
+			h = (h ^ p[i]) * k1;
+		return mix(h ^ bytes);
+	}
+
+	// memcpy of large arrays on all cores
+	void copy(void* to, const void* from, size_t bytes)
+	{
+		int blocks = int((bytes + kBlock - 1) / kBlock);
+		parallel_for(0, blocks, [&](int b, int e) {
+			size_t lo = size_t(b) * kBlock, hi = Min(size_t(e) * kBlock, bytes);
+			memcpy((char*)to + lo, (const char*)from + lo, hi - lo);
+		}, 1);
+	}
+
+	template <typename Matrix>
+	void describe(const Matrix& M, SectionHeader& s)
+	{
+		s.offset = 0;
+		s.rows = M.rows();
+		s.cols = (uint32_t)M.cols();
+		s.scalar = sizeof(typename Matrix::Scalar);
+	}
+
+	// every section has at most 3 columns and fewer than 2^31 rows, so the
+	// size below can not overflow
+	template <typename Matrix>
+	bool read_section(const MappedFile& file, const SectionHeader& s, Matrix& M)
+	{
+		if (s.scalar != sizeof(typename Matrix::Scalar) || s.rows > uint64_t(INT_MAX) || s.cols > 3 ||
+			(Matrix::ColsAtCompileTime == 1 && s.cols != 1) || s.offset > file.size())
+			return false;
+		uint64_t bytes = s.rows * s.cols * s.scalar;
+		if (bytes > file.size() - s.offset) return false;
+		M.resize(typename Matrix::Index(s.rows), typename Matrix::Index(s.cols));
+		if (bytes > 0) copy(M.data(), file.data() + s.offset, size_t(bytes));
+		return true;
+	}
+
+	// indices in [lo, hi)
+	template <typename Matrix>
+	bool in_range(const Matrix& M, int lo, int hi)
+	{
+		return M.size() == 0 || (M.minCoeff() >= lo && M.maxCoeff() < hi);
+	}
+
+	template <typename Matrix>
+	bool write_section(FILE* file, const Matrix& M, SectionHeader& s, uint64_t& offset)
+	{
+		static const char zeros[kAlign] = { 0 };
+		size_t pad = (kAlign - offset % kAlign) % kAlign;
+		if (pad > 0 && fwrite(zeros, 1, pad, file) != pad) return false;
+		offset += pad;
+
+		describe(M, s);
+		s.offset = offset;
+		size_t count = size_t(M.size());
+		if (count > 0 && fwrite(M.data(), s.scalar, count, file) != count) return false;
+		offset += count * s.scalar;
+		return true;
+	}
+}
+
+// blocks are hashed apart on all cores, then folded in order
+static uint64_t hash_blocks(const unsigned char* data, size_t bytes, uint64_t h)
+{
+	int blocks = int((bytes + kBlock - 1) / kBlock);
+	std::vector<uint64_t> hashes(blocks);
+	parallel_for(0, blocks, [&](int b, int e) {
+		for (int i = b; i < e; i++)
+		{
+			size_t lo = size_t(i) * kBlock;
+			hashes[i] = hash_block(data + lo, Min(kBlock, bytes - lo), uint64_t(i));
+		}
+	}, 1);
+
+	for (int i = 0; i < blocks; i++)
+		h = mix(h ^ hashes[i]) + uint64_t(i);
+	return mix(h ^ bytes);
+}
+
+bool mesh_file_key(const std::string& filename, const std::string& options, uint64_t& key)
+{
+	MappedFile file;
+	if (!file.open(filename)) return false;
+
+	uint64_t h = hash_block((const unsigned char*)options.data(), options.size(), kVersion);
+	key = hash_blocks(file.data(), file.size(), h);
+	return true;
+}
+
+uint64_t mesh_data_key(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F)
+{
+	uint64_t h = hash_blocks((const unsigned char*)V.data(), V.size() * sizeof(double), kVersion);
+	return hash_blocks((const unsigned char*)F.data(), F.size() * sizeof(int), h);
+}
+
+std::string mesh_cache_file(const std::string& filename)
+{
+	return filename + ".mpcache";
+}
+
+bool read_mesh_cache(const std::string& cache_file, uint64_t key, MeshCacheEntry& entry)
+{
+	// a missing cache is the normal case, MappedFile would report it
+	FILE* probe = fopen(cache_file.c_str(), "rb");
+	if (probe == NULL) return false;
+	fclose(probe);
+
+	MappedFile file;
+	if (!file.open(cache_file)) return false;
+
+	CacheHeader header;
+	if (file.size() < sizeof(header)) return false;
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, kMagic, 4) != 0 || header.version != kVersion || header.key != key)
+		return false;
+
+	const SectionHeader* s = header.sections;
+	bool ok = read_section(file, s[SECTION_V], entry.V) &&
+		read_section(file, s[SECTION_F], entry.F) &&
+		read_section(file, s[SECTION_TC], entry.TC) &&
+		read_section(file, s[SECTION_FTC], entry.FTC) &&
+		read_section(file, s[SECTION_SOURCE_MAP], entry.V_source_map) &&
+		read_section(file, s[SECTION_F_NORMALS], entry.F_normals) &&
+		read_section(file, s[SECTION_V_NORMALS], entry.V_normals) &&
+		read_section(file, s[SECTION_F_CENTER], entry.F_center);
+
+	// the viewer indexes with all of it unchecked
+	int nv = entry.V.rows(), nf = entry.F.rows();
+	ok = ok && nv > 0 && nf > 0 && entry.V.cols() == 3 && entry.F.cols() == 3 && in_range(entry.F, 0, nv) &&
+		entry.F_normals.rows() == nf && entry.F_normals.cols() == 3 &&
+		entry.V_normals.rows() == nv && entry.V_normals.cols() == 3 &&
+		entry.F_center.rows() == nf && entry.F_center.cols() == 3 &&
+		(entry.TC.rows() == 0 || entry.TC.cols() >= 2) &&
+		(entry.FTC.rows() == 0 || entry.FTC.cols() == 3) &&
+		in_range(entry.FTC, 0, entry.TC.rows()) && in_range(entry.V_source_map, -1, nv);
+	if (!ok)
+	{
+		std::cerr << "ERROR (read_mesh_cache): " << cache_file << " is damaged, the mesh is loaded again." << std::endl;
+		return false;
+	}
+
+	entry.p_min = Vec3d(header.p_min[0], header.p_min[1], header.p_min[2]);
+	entry.p_max = Vec3d(header.p_max[0], header.p_max[1], header.p_max[2]);
+	entry.avg_edge = header.avg_edge;
+	return true;
+}
+
+bool write_mesh_cache(const std::string& cache_file, uint64_t key, const MeshData& mesh,
+	const Eigen::MatrixXd& TC, const Eigen::MatrixXi& FTC)
+{
+	if (mesh.F.rows() == 0 || mesh.F_center.rows() != mesh.F.rows()) return false;
+
+	// written aside, then renamed: a reader never maps a partial cache
+	std::string temp = cache_file + ".tmp";
+	FILE* file = fopen(temp.c_str(), "wb");
+	if (file == NULL)
+	{
+		std::cerr << "ERROR (write_mesh_cache): Can not write " << temp << std::endl;
+		return false;
+	}
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kMagic, 4);
+	header.version = kVersion;
+	header.key = key;
+	for (int i = 0; i < 3; i++)
+	{
+		header.p_min[i] = mesh.p_min(i);
+		header.p_max[i] = mesh.p_max(i);
+	}
+	header.avg_edge = mesh.avg_edge;
+
+	// the header is written again once the offsets are known
+	uint64_t offset = sizeof(header);
+	SectionHeader* s = header.sections;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		write_section(file, mesh.V, s[SECTION_V], offset) &&
+		write_section(file, mesh.F, s[SECTION_F], offset) &&
+		write_section(file, TC, s[SECTION_TC], offset) &&
+		write_section(file, FTC, s[SECTION_FTC], offset) &&
+		write_section(file, mesh.V_source_map, s[SECTION_SOURCE_MAP], offset) &&
+		write_section(file, mesh.F_normals, s[SECTION_F_NORMALS], offset) &&
+		write_section(file, mesh.V_normals, s[SECTION_V_NORMALS], offset) &&
+		write_section(file, mesh.F_center, s[SECTION_F_CENTER], offset) &&
+		fseek(file, 0, SEEK_SET) == 0 &&
+		fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = fclose(file) == 0 && ok;
+
+	// rename does not replace an existing file everywhere
+	remove(cache_file.c_str());
+	if (!ok || rename(temp.c_str(), cache_file.c_str()) != 0)
+	{
+		std::cerr << "ERROR (write_mesh_cache): Can not write " << cache_file << std::endl;
+		remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "stdafx.h"
+#include <cstdint>
+#include <string>
+
+class MeshData;
+
+// What opening a mesh file produces: the mesh after cleanup, the texture
+// coordinates of the file and the quantities derived from the mesh
+struct MeshCacheEntry
+{
+	Eigen::MatrixXd V;
+	Eigen::MatrixXi F;
+	Eigen::MatrixXd TC;
+	Eigen::MatrixXi FTC;
+	Eigen::VectorXi V_source_map;
+
+	Eigen::MatrixXd F_normals;
+	Eigen::MatrixXd V_normals;
+	Eigen::MatrixXd F_center;
+	Vec3d p_min, p_max;
+	double avg_edge;
+};
+
+// Sidecar cache of a mesh file, "<file>.mpcache", so a file seen before
+// opens without parsing, cleanup or preprocessing.
+//
+// The key hashes the file content, the cache version and the load options,
+// so an edited file, other options or a newer build miss the cache.
+// Layout: a header (magic "MPMC", version, key, bounding box, average edge
+// length, then offset, rows, columns and scalar size of every section),
+// followed by the sections aligned on 64 bytes, each stored column major
+// exactly like the Eigen matrix it is read into.
+// Point clouds are not cached: their search grid is built with the normals.
+
+// Hash of the content of filename and of options; runs on all cores
+bool mesh_file_key(const std::string& filename, const std::string& options, uint64_t& key);
+
+// Hash of the content of V and F, for what is derived from a mesh in memory
+uint64_t mesh_data_key(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F);
+
+std::string mesh_cache_file(const std::string& filename);
+
+// false if there is no cache, it was written for another key or it is
+// damaged (sizes or indices out of range); the file is then parsed again
+bool read_mesh_cache(const std::string& cache_file, uint64_t key, MeshCacheEntry& entry);
+
+// the mesh as loaded, with the texture coordinates of its file (may be empty)
+bool write_mesh_cache(const std::string& cache_file, uint64_t key, const MeshData& mesh,
+	const Eigen::MatrixXd& TC, const Eigen::MatrixXi& FTC);
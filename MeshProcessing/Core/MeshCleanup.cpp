@@ -0,0 +1,214 @@
+#include "stdafx.h"
+#include "MeshCleanup.h"
+#include "PointCloud.h"
+#include "Parallel.h"
+#include "Arena.h"
+#include <cstring>
+
+CleanupOptions::CleanupOptions()
+: weld(true), weld_tolerance(0.0), remove_degenerate(true), remove_duplicates(true), remove_unreferenced(true)
+{
+}
+
+CleanupReport::CleanupReport()
+: welded_vertices(0), degenerate_faces(0), duplicate_faces(0), unreferenced_vertices(0)
+{
+}
+
+bool CleanupReport::changed() const
+{
+	return welded_vertices > 0 || degenerate_faces > 0 || duplicate_faces > 0 || unreferenced_vertices > 0;
+}
+
+namespace
+{
+	// representative of each vertex: the lowest numbered vertex within tol
+	void weld_vertices(const Eigen::MatrixXd& V, double tol, int* rep)
+	{
+		int n = V.rows();
+		PointGrid grid;
+		grid.build(V, tol, 1);
+		const std::vector<int>& order = grid.order();
+		double tol2 = tol * tol;
+
+		parallel_for(0, grid.cells(), [&](int b, int e) {
+			int nbs[27];
+			for (int c = b; c < e; c++)
+			{
+				int m = grid.neighbor_cells(c, nbs);
+				for (int j = grid.cell_begin(c); j < grid.cell_begin(c + 1); j++)
+				{
+					int i = order[j];
+					int best = i;
+					for (int l = 0; l < m; l++)
+					{
+						for (int k = grid.cell_begin(nbs[l]); k < grid.cell_begin(nbs[l] + 1); k++)
+						{
+							int o = order[k];
+							if (o >= best) continue;
+							double d2 = (V.row(o) - V.row(i)).squaredNorm();
+							if (d2 <= tol2) best = o;
+						}
+					}
+					rep[i] = best;
+				}
+			}
+		}, 64);
+
+		// chains end at a vertex that is its own representative
+		for (int i = 0; i < n; i++)
+			rep[i] = rep[rep[i]];
+	}
+
+	struct FaceKey
+	{
+		int v[3];
+		int face;
+		bool operator<(const FaceKey& o) const
+		{
+			if (v[0] != o.v[0]) return v[0] < o.v[0];
+			if (v[1] != o.v[1]) return v[1] < o.v[1];
+			if (v[2] != o.v[2]) return v[2] < o.v[2];
+			return face < o.face;
+		}
+	};
+}
+
+CleanupReport clean_mesh(Eigen::MatrixXd& V, Eigen::MatrixXi& F, const CleanupOptions& options)
+{
+	CleanupReport report;
+
+	// the per vertex and per face temporaries, reported as scratch memory
+	// and freed together on return
+	int nv = V.rows(), nf = F.rows();
+	Arena arena(memstats::SCRATCH);
+	int* rep = arena.allocate_array<int>(nv);
+	char* keep = arena.allocate_array<char>(nf);
+	char* used = arena.allocate_array<char>(nv);
+	int* clean = arena.allocate_array<int>(nv);
+	int* source_vertex = arena.allocate_array<int>(nv);
+	int* source_face = arena.allocate_array<int>(nf);
+	if (nv > 0 && (!rep || !used || !clean || !source_vertex)) return report;
+	if (nf > 0 && (!keep || !source_face)) return report;
+
+	for (int i = 0; i < nv; i++) rep[i] = i;
+	if (options.weld && nv > 0)
+	{
+		weld_vertices(V, Max(options.weld_tolerance, 0.0), rep);
+		for (int i = 0; i < nv; i++)
+			if (rep[i] != i) report.welded_vertices++;
+	}
+
+	// faces on the representatives, and the ones to keep
+	if (nf > 0) memset(keep, 1, nf);
+	parallel_for(0, nf, [&](int b, int e) {
+		for (int f = b; f < e; f++)
+		{
+			for (int k = 0; k < 3; k++)
+				F(f, k) = rep[F(f, k)];
+			if (!options.remove_degenerate) continue;
+
+			int a = F(f, 0), c = F(f, 1), d = F(f, 2);
+			if (a == c || c == d || d == a)
+				keep[f] = 0;
+			else
+			{
+				Vec3d e1 = (V.row(c) - V.row(a)).transpose();
+				Vec3d e2 = (V.row(d) - V.row(a)).transpose();
+				if (e1.cross(e2).squaredNorm() == 0) keep[f] = 0;
+			}
+		}
+	}, 1 << 14);
+	for (int f = 0; f < nf; f++)
+		if (!keep[f]) report.degenerate_faces++;
+
+	if (options.remove_duplicates && nf > 0)
+	{
+		// equal sorted vertex triples, the first face is kept
+		std::vector<FaceKey> keys(nf);
+		parallel_for(0, nf, [&](int b, int e) {
+			for (int f = b; f < e; f++)
+			{
+				FaceKey& key = keys[f];
+				key.face = f;
+				for (int k = 0; k < 3; k++) key.v[k] = F(f, k);
+				std::sort(key.v, key.v + 3);
+			}
+		}, 1 << 14);
+		parallel_sort(keys);
+
+		int previous = -1;
+		for (int j = 0; j < nf; j++)
+		{
+			const FaceKey& key = keys[j];
+			if (!keep[key.face]) continue;
+			if (previous >= 0 && std::equal(key.v, key.v + 3, keys[previous].v))
+			{
+				keep[key.face] = 0;
+				report.duplicate_faces++;
+			}
+			else
+				previous = j;
+		}
+	}
+
+	// compact the faces
+	int kept_faces = 0;
+	for (int f = 0; f < nf; f++)
+		if (keep[f]) source_face[kept_faces++] = f;
+	Eigen::MatrixXi CF(kept_faces, 3);
+	for (int j = 0; j < kept_faces; j++)
+		CF.row(j) = F.row(source_face[j]);
+
+	// and the vertices: representatives, used by a face unless those are kept too.
+	// A point cloud has no faces to use its vertices.
+	bool unreferenced = options.remove_unreferenced && nf > 0;
+	if (nv > 0) memset(used, 0, nv);
+	for (int i = 0; i < nv; i++)
+		if (rep[i] == i && !unreferenced) used[i] = 1;
+	for (int j = 0; j < kept_faces; j++)
+		for (int k = 0; k < 3; k++)
+			used[CF(j, k)] = 1;
+
+	int kept_vertices = 0;
+	for (int i = 0; i < nv; i++)
+	{
+		clean[i] = -1;
+		if (!used[i]) continue;
+		clean[i] = kept_vertices;
+		source_vertex[kept_vertices++] = i;
+	}
+	report.unreferenced_vertices = nv - report.welded_vertices - kept_vertices;
+
+	Eigen::MatrixXd CV(kept_vertices, 3);
+	parallel_for(0, kept_vertices, [&](int b, int e) {
+		for (int j = b; j < e; j++)
+			CV.row(j) = V.row(source_vertex[j]);
+	}, 1 << 14);
+	parallel_for(0, kept_faces, [&](int b, int e) {
+		for (int j = b; j < e; j++)
+			for (int k = 0; k < 3; k++)
+				CF(j, k) = clean[CF(j, k)];
+	}, 1 << 14);
+
+	report.vertex_map.resize(nv);
+	for (int i = 0; i < nv; i++)
+		report.vertex_map(i) = clean[rep[i]];
+	report.source_vertex = Eigen::Map<Eigen::VectorXi>(source_vertex, kept_vertices);
+	report.source_face = Eigen::Map<Eigen::VectorXi>(source_face, kept_faces);
+
+	V.swap(CV);
+	F.swap(CF);
+	return report;
+}
+
+void to_source_vertices(const CleanupReport& report, const Eigen::MatrixXd& X, Eigen::MatrixXd& out)
+{
+	int n = report.vertex_map.rows();
+	out.setZero(n, X.cols());
+	for (int i = 0; i < n; i++)
+	{
+		int j = report.vertex_map(i);
+		if (j >= 0 && j < X.rows()) out.row(i) = X.row(j);
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "stdafx.h"
+
+struct CleanupOptions
+{
+	CleanupOptions();
+
+	bool weld;                   // merge vertices closer than weld_tolerance
+	double weld_tolerance;       // absolute; 0 merges exact duplicates only
+	bool remove_degenerate;      // faces with a repeated vertex or no area
+	bool remove_duplicates;      // faces over the same three vertices
+	bool remove_unreferenced;    // vertices used by no face, unless there are no faces
+};
+
+struct CleanupReport
+{
+	CleanupReport();
+
+	int welded_vertices;
+	int degenerate_faces;
+	int duplicate_faces;
+	int unreferenced_vertices;
+
+	// clean vertex of each source vertex, -1 if it was dropped
+	Eigen::VectorXi vertex_map;
+	// source vertex and source face of each clean vertex and face
+	Eigen::VectorXi source_vertex;
+	Eigen::VectorXi source_face;
+
+	bool changed() const;
+};
+
+// Weld, drop degenerate and duplicate faces and unreferenced vertices,
+// then compact V and F in place; runs on all cores.
+// Vertices are welded to the lowest numbered vertex within the tolerance,
+// found through a spatial hash of cells of the tolerance size.
+CleanupReport clean_mesh(Eigen::MatrixXd& V, Eigen::MatrixXi& F, const CleanupOptions& options = CleanupOptions());
+
+// Per vertex data X of the clean mesh back on the source vertices, for
+// round trips: row i of the result is X.row(vertex_map(i)), or zeros for
+// dropped vertices
+void to_source_vertices(const CleanupReport& report, const Eigen::MatrixXd& X, Eigen::MatrixXd& out);
@@ -0,0 +1,670 @@
+#include "stdafx.h"
+#include "MeshData.h"
+#include "MeshCache.h"
+#include "Parallel.h"
+
+// Ambient color should be darker color
+static Eigen::MatrixXd material_ambient(const Eigen::MatrixXd& C)
+{
+  return 0.1*C;
+}
+
+// Specular color should be a less saturated and darker color: dampened  highlights
+static Eigen::MatrixXd material_specular(const Eigen::MatrixXd& C)
+{
+  const double grey = 0.3;
+  return grey+0.1*(C.array()-grey);
+}
+
+MeshData::MeshData()
+: search_arena_(memstats::SEARCH), mesh_memory_(memstats::MESH), search_memory_(memstats::SEARCH),
+  undo_memory_(memstats::UNDO)
+{
+  history.bind(UndoHistory::ATTR_V, &V);
+  history.bind(UndoHistory::ATTR_V_COLOR, &V_material_diffuse);
+  history.bind(UndoHistory::ATTR_F_COLOR, &F_material_diffuse);
+  history.bind(UndoHistory::ATTR_SEL_PTS, &selected_pts);
+  history.bind(UndoHistory::ATTR_SEL_FACES, &selected_faces);
+
+  ann_pts = ann_faces = NULL;
+  ann_kdTree_pt = NULL;
+  ann_kdTree_faces = NULL;
+  clear();
+};
+
+MeshData::~MeshData()
+{
+	// annClose() is left out: it frees the leaf shared by the trees of
+	// every MeshData, not just ours
+	release_search();
+}
+
+void MeshData::clear()
+{
+  V                       = Eigen::MatrixXd (0,3);
+  F                       = Eigen::MatrixXi (0,3);
+
+  F_material_ambient      = Eigen::MatrixXd (0,3);
+  F_material_diffuse      = Eigen::MatrixXd (0,3);
+  F_material_specular     = Eigen::MatrixXd (0,3);
+
+  V_material_ambient      = Eigen::MatrixXd (0,3);
+  V_material_diffuse      = Eigen::MatrixXd (0,3);
+  V_material_specular     = Eigen::MatrixXd (0,3);
+
+  F_normals               = Eigen::MatrixXd (0,3);
+  V_normals               = Eigen::MatrixXd (0,3);
+
+  V_scalar                = Eigen::VectorXd (0);
+  V_source_map            = Eigen::VectorXi (0);
+
+  V_uv                    = Eigen::MatrixXd (0,2);
+  F_uv                    = Eigen::MatrixXi (0,3);
+
+  texture                 = Image();
+  texture_file.clear();
+
+  face_based = false;
+
+  selected_pts.clear();
+  selected_faces.clear();
+
+  history.clear();
+  components.clear();
+  attributes.clear();
+  edges_.clear();
+
+  curvature_.clear();
+  curvature_valid_ = false;
+
+  release_search();
+  grid_.clear();
+  F_center = Eigen::MatrixXd (0,3);
+  moved_vertices.clear();
+  moved_faces.clear();
+
+  dirty = DIRTY_ALL;
+  update_memory_stats();
+}
+
+
+void MeshData::set_face_based(bool newvalue)
+{
+  if (face_based != newvalue)
+  {
+    face_based = newvalue;
+    dirty |= DIRTY_DIFFUSE;
+  }
+}
+
+// Helpers that draws the most common meshes
+void MeshData::set_mesh(const Eigen::MatrixXd& _V, const Eigen::MatrixXi& _F)
+{
+  // empty the mesh
+  clear(); 
+
+  // If V only has two columns, pad with a column of zeros
+  if (_V.cols() == 2)
+  {
+    V = Eigen::MatrixXd::Zero(_V.rows(),3);
+    V.block(0,0,_V.rows(),2) = _V;
+  }
+  else
+  {
+    V = _V;
+  }
+
+  // set the faces
+  F = _F;
+
+  init_mesh();
+}
+
+void MeshData::take_mesh(Eigen::MatrixXd& _V, Eigen::MatrixXi& _F)
+{
+  if (_V.cols() != 3)
+  {
+    set_mesh(_V, _F);
+    return;
+  }
+
+  // empty the mesh, then exchange the storage
+  clear();
+  V.swap(_V);
+  F.swap(_F);
+
+  init_mesh();
+}
+
+void MeshData::init_mesh()
+{
+  // the stages write fields of their own, so they run as tasks side by side
+  {
+    TaskGroup stages("set_mesh");
+
+    // calc bounding box
+    stages.run([this]() {
+      p_min = V.colwise().minCoeff();
+      p_max = V.colwise().maxCoeff();
+    });
+
+    // average edge lenght, or the point spacing set by compute_normals
+    if (!is_point_cloud())
+      stages.run([this]() { avg_edge = igl::avg_edge_length(V, F); });
+    stages.run([this]() { compute_normals(); });
+    stages.run([this]() {
+      uniform_colors(Vec3d(0.2, 0.2, 0.2),
+                     Vec3d(0.6, 0.5, 0),
+                     Vec3d(0.3, 0.3, 0.3));
+    });
+
+    // points are not textured
+    if (!is_point_cloud())
+      stages.run([this]() { default_uv(); });
+
+    // the kd-trees wait for the first selection
+    stages.run([this]() { compute_face_centers(); });
+    stages.wait();
+  }
+
+  if (!is_point_cloud())
+    grid_texture();
+  update_memory_stats();
+}
+
+void MeshData::take_cached(MeshCacheEntry& entry)
+{
+  clear();
+  V.swap(entry.V);
+  F.swap(entry.F);
+  V_source_map.swap(entry.V_source_map);
+  F_normals.swap(entry.F_normals);
+  V_normals.swap(entry.V_normals);
+  F_center.swap(entry.F_center);
+  p_min = entry.p_min;
+  p_max = entry.p_max;
+  avg_edge = entry.avg_edge;
+
+  uniform_colors(Vec3d(0.2, 0.2, 0.2),
+                 Vec3d(0.6, 0.5, 0),
+                 Vec3d(0.3, 0.3, 0.3));
+  grid_texture();
+  update_memory_stats();
+}
+
+void MeshData::set_vertices(const Eigen::MatrixXd& _V)
+{
+  history.record(UndoHistory::ATTR_V, _V);
+  V = _V;
+  curvature_valid_ = false;
+  attributes.invalidate(DIRTY_POSITION);
+  dirty |= DIRTY_POSITION;
+  assert(F.size() == 0 || F.maxCoeff() < V.rows());
+}
+
+void MeshData::set_normals(const Eigen::MatrixXd& N)
+{
+  if (N.rows() == V.rows())
+  {
+    set_face_based(false);
+    V_normals = N;
+    attributes.invalidate(DIRTY_NORMAL);
+    dirty |= DIRTY_NORMAL;
+  }
+  else if (N.rows() == F.rows() || N.rows() == F.rows()*3)
+  {
+    set_face_based(true);
+    F_normals = N;
+    attributes.invalidate(DIRTY_NORMAL);
+    dirty |= DIRTY_NORMAL;
+  }
+  else
+    std::cerr << "ERROR (set_normals): Please provide a normal per face, per corner or per vertex.";
+}
+
+void MeshData::set_colors(const Eigen::MatrixXd &C)
+{
+  using namespace Eigen;
+
+  // for constant color
+  if (C.rows() == 1)
+  {
+    MatrixXd VC = C.row(0).replicate(V_material_diffuse.rows(), 1);
+    MatrixXd FC = C.row(0).replicate(F_material_diffuse.rows(), 1);
+    history.begin_group();
+    history.record(UndoHistory::ATTR_V_COLOR, VC);
+    history.record(UndoHistory::ATTR_F_COLOR, FC);
+    history.end_group();
+
+    V_material_diffuse = VC;
+    F_material_diffuse = FC;
+    dirty |= DIRTY_DIFFUSE;
+  }
+  // for vertices color matrix
+  else if (C.rows() == V.rows())
+  {
+    set_face_based(false);
+    history.record(UndoHistory::ATTR_V_COLOR, C);
+    V_material_diffuse = C;
+    dirty |= DIRTY_DIFFUSE;
+  }
+  // for faces color matrix
+  else if (C.rows() == F.rows())
+  {
+    set_face_based(true);
+    history.record(UndoHistory::ATTR_F_COLOR, C);
+    F_material_diffuse = C;
+    dirty |= DIRTY_DIFFUSE;
+  }
+  else
+    std::cerr << "ERROR (set_colors): Please provide a single color, or a color per face or per vertex.";
+}
+
+void MeshData::set_scalars(const Eigen::VectorXd &S)
+{
+  if (S.rows() == V.rows())
+  {
+    V_scalar = S;
+    dirty |= DIRTY_SCALAR;
+  }
+  else
+    std::cerr << "ERROR (set_scalars): Please provide a scalar per vertex.";
+}
+
+void MeshData::update_materials()
+{
+  V_material_ambient = material_ambient(V_material_diffuse);
+  V_material_specular = material_specular(V_material_diffuse);
+  F_material_ambient = material_ambient(F_material_diffuse);
+  F_material_specular = material_specular(F_material_diffuse);
+  dirty |= DIRTY_AMBIENT | DIRTY_SPECULAR;
+}
+
+void MeshData::set_uv(const Eigen::MatrixXd& UV)
+{
+  if (UV.rows() == V.rows())
+  {
+    set_face_based(false);
+    V_uv = UV;
+    dirty |= DIRTY_UV;
+  }
+  else
+    std::cerr << "ERROR (set_UV): Please provide uv per vertex.";
+}
+
+void MeshData::set_uv(const Eigen::MatrixXd& UV_V, const Eigen::MatrixXi& UV_F)
+{
+  set_face_based(true);
+  V_uv = UV_V;
+  F_uv = UV_F;
+  dirty |= DIRTY_UV;
+}
+
+void MeshData::set_texture(
+  const Eigen::Matrix<char,Eigen::Dynamic,Eigen::Dynamic>& R,
+  const Eigen::Matrix<char,Eigen::Dynamic,Eigen::Dynamic>& G,
+  const Eigen::Matrix<char,Eigen::Dynamic,Eigen::Dynamic>& B)
+{
+  pack_image(R, G, B, texture);
+  texture_file.clear();
+  dirty |= DIRTY_TEXTURE;
+}
+
+void MeshData::set_texture(const Image& img)
+{
+  texture = img;
+  texture_file.clear();
+  dirty |= DIRTY_TEXTURE;
+}
+
+void MeshData::set_texture_file(const std::string& filename)
+{
+  texture = Image();
+  texture_file = filename;
+  dirty |= DIRTY_TEXTURE;
+}
+
+void MeshData::compute_normals()
+{
+  curvature_valid_ = false;
+  attributes.invalidate(DIRTY_NORMAL);
+
+  if (is_point_cloud())
+  {
+    // the grid is shared with the point selection
+    const int k = 10;
+    grid_.build(V, 0, k);
+    avg_edge = estimate_normals(V, grid_, k, V_normals);
+    F_normals.resize(0, 3);
+    dirty |= DIRTY_NORMAL;
+    return;
+  }
+
+  grid_.clear();
+  igl::per_face_normals(V, F, F_normals);
+  igl::per_vertex_normals(V, F, F_normals, V_normals);
+  dirty |= DIRTY_NORMAL;
+}
+
+const CurvatureFields& MeshData::curvature()
+{
+  if (!curvature_valid_)
+  {
+    compute_curvature(V, F, V_normals, curvature_);
+    curvature_valid_ = true;
+  }
+  return curvature_;
+}
+
+const MeshEdges& MeshData::edges()
+{
+  if (edges_.empty() && F.rows() > 0)
+  {
+    edges_.build(F);
+    update_memory_stats();
+  }
+  return edges_;
+}
+
+void MeshData::uniform_colors(Vec3d ambient, Vec3d diffuse, Vec3d specular)
+{
+  V_material_ambient.resize(V.rows(),3);
+  V_material_diffuse.resize(V.rows(),3);
+  V_material_specular.resize(V.rows(),3);
+  for (unsigned i=0; i<V.rows();++i)
+  {
+    V_material_ambient.row(i) = ambient;
+    V_material_diffuse.row(i) = diffuse;
+    V_material_specular.row(i) = specular;
+  }
+
+  F_material_ambient.resize(F.rows(),3);
+  F_material_diffuse.resize(F.rows(),3);
+  F_material_specular.resize(F.rows(),3);
+  for (unsigned i=0; i<F.rows();++i)
+  {
+    F_material_ambient.row(i) = ambient;
+    F_material_diffuse.row(i) = diffuse;
+    F_material_specular.row(i) = specular;
+  }
+}
+
+void MeshData::default_uv()
+{
+  if (V_uv.rows() == 0)
+  {
+    V_uv = V.block(0, 0, V.rows(), 2);
+    V_uv.col(0) = V_uv.col(0).array() - V_uv.col(0).minCoeff();
+    V_uv.col(0) = V_uv.col(0).array() / V_uv.col(0).maxCoeff();
+    V_uv.col(1) = V_uv.col(1).array() - V_uv.col(1).minCoeff();
+    V_uv.col(1) = V_uv.col(1).array() / V_uv.col(1).maxCoeff();
+    V_uv = V_uv.array() * 10;
+  }
+}
+
+void MeshData::grid_texture()
+{
+  default_uv();
+
+  // the checkerboard is generated once and shared by all meshes
+  if (texture.empty() && texture_file.empty())
+  {
+    texture = checkerboard_image();
+    dirty |= DIRTY_TEXTURE;
+  }
+}
+
+void MeshData::compute_face_centers()
+{
+	if (is_point_cloud())
+	{
+		F_center.resize(0, 3);
+		return;
+	}
+
+	int n = F.rows();
+	F_center.resize(n, 3);
+	parallel_for(0, n, [&](int b, int e) {
+		for (int i = b; i < e; i++)
+			F_center.row(i) = (V.row(F(i, 0)) + V.row(F(i, 1)) + V.row(F(i, 2))) / 3.0;
+	}, 1 << 14);
+}
+
+void MeshData::init_kdTree()
+{
+	// a point cloud is searched through grid_, built by compute_normals
+	if (is_point_cloud() || (ann_kdTree_pt && ann_kdTree_faces)) return;
+	release_search();
+
+	// the points of both trees come from search_arena_, released with the
+	// trees; they are copied on all cores, the trees are built one after the
+	// other as ANN shares an empty leaf it creates on the first build
+	TaskGroup group("kd-trees");
+	int nv = V.rows(), nf = F.rows();
+	ann_pts = search_arena_.allocate_array<ANNpoint>(nv);
+	ANNcoord* coords = search_arena_.allocate_array<ANNcoord>(3 * size_t(nv));
+	ann_faces = search_arena_.allocate_array<ANNpoint>(nf);
+	ANNcoord* face_coords = search_arena_.allocate_array<ANNcoord>(3 * size_t(nf));
+	parallel_for(group, 0, nv, [&](int b, int e) {
+		for (int i = b; i < e; i++)
+		{
+			ann_pts[i] = coords + 3 * size_t(i);
+			for (int j = 0; j < 3; j++)
+				ann_pts[i][j] = V(i, j);
+		}
+	}, 1 << 14);
+	parallel_for(group, 0, nf, [&](int b, int e) {
+		for (int i = b; i < e; i++)
+		{
+			ann_faces[i] = face_coords + 3 * size_t(i);
+			for (int j = 0; j < 3; j++)
+				ann_faces[i][j] = F_center(i, j);
+		}
+	}, 1 << 14);
+
+	ann_kdTree_pt = new ANNkd_tree(ann_pts, nv, 3);
+	ann_kdTree_faces = new ANNkd_tree(ann_faces, nf, 3);
+	update_memory_stats();
+}
+
+void MeshData::release_search()
+{
+	delete ann_kdTree_pt;
+	delete ann_kdTree_faces;
+	ann_kdTree_pt = ann_kdTree_faces = NULL;
+	ann_pts = ann_faces = NULL;
+	search_arena_.release();
+}
+
+size_t MeshData::memory_bytes() const
+{
+	size_t bytes = 0;
+	const Eigen::MatrixXd* dense[] = { &V, &F_normals, &F_center, &F_material_ambient, &F_material_diffuse,
+		&F_material_specular, &V_normals, &V_material_ambient, &V_material_diffuse, &V_material_specular, &V_uv };
+	for (size_t i = 0; i < sizeof(dense) / sizeof(dense[0]); i++)
+		bytes += dense[i]->size() * sizeof(double);
+	bytes += (F.size() + F_uv.size() + V_source_map.size()) * sizeof(int);
+	bytes += V_scalar.size() * sizeof(double);
+	bytes += (selected_pts.capacity() + selected_faces.capacity()) * sizeof(int);
+	bytes += texture.bytes();
+	const Eigen::VectorXd* fields[] = { &curvature_.mean, &curvature_.gaussian, &curvature_.k_max, &curvature_.k_min };
+	for (int i = 0; i < 4; i++)
+		bytes += fields[i]->size() * sizeof(double);
+	bytes += components.bytes() + edges_.bytes() + attributes.bytes();
+	return bytes;
+}
+
+size_t MeshData::search_bytes() const
+{
+	// ANN keeps an index per point and about two nodes of 24 to 48 bytes,
+	// the points themselves are in the arena
+	size_t points = ann_kdTree_pt ? V.rows() : 0;
+	if (ann_kdTree_faces) points += F.rows();
+	return points * (sizeof(ANNidx) + 72) + grid_.bytes();
+}
+
+void MeshData::update_memory_stats()
+{
+	mesh_memory_.set(memory_bytes());
+	search_memory_.set(search_bytes());
+	undo_memory_.set(history.bytes());
+}
+
+void MeshData::select_pt(Vec3d &pt)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		if (pt[i]<p_min[i] - avg_edge||
+			pt[i]> p_max[i] + avg_edge)
+			return;
+	}
+
+	if (is_point_cloud())
+	{
+		int idx;
+		double d2;
+		if (grid_.knn(pt.data(), 1, &idx, &d2) == 1 && d2 < 9 * avg_edge * avg_edge)
+		{
+			auto it = find(selected_pts.begin(), selected_pts.end(), idx);
+			history.record_list(UndoHistory::ATTR_SEL_PTS);
+			if (it == selected_pts.end())
+			{
+				selected_pts.push_back(idx);
+				std::cout << "Vertex : " << idx
+					<< "\t" << V(idx, 0) << "\t" << V(idx, 1) << "\t" << V(idx, 2) << std::endl;
+			}
+			else
+				selected_pts.erase(it);
+			dirty |= DIRTY_SELECTION;
+		}
+		return;
+	}
+
+	init_kdTree();
+	if (!ann_kdTree_pt) return;
+	ANNcoord queryPt[3] = { pt[0], pt[1], pt[2] };
+	ANNidx Idx[1];
+	ANNdist dist[1];
+	ann_kdTree_pt->annkSearch(queryPt, 1, Idx, dist);
+
+	if (*dist < 3 * avg_edge)
+	{
+		auto it = find(selected_pts.begin(), selected_pts.end(), *Idx);
+		history.record_list(UndoHistory::ATTR_SEL_PTS);
+		if (it == selected_pts.end() || selected_pts.empty())
+		{
+			selected_pts.push_back(*Idx);
+			std::cout << "Vertex : " << *Idx // << std::endl;
+				<< "\t" << V(*Idx, 0) << "\t" << V(*Idx, 1) << "\t" << V(*Idx, 2) << std::endl;
+		}
+		else
+			selected_pts.erase(it);
+		dirty |= DIRTY_SELECTION;
+
+	}
+}
+
+void MeshData::select_face(Vec3d &pt)
+{
+	if (F.rows() == 0) return;
+
+	init_kdTree();
+	if (!ann_kdTree_faces) return;
+	ANNcoord queryPt[3] = { pt[0], pt[1], pt[2] };
+	ANNidx Idx[1];
+	ANNdist dist[1];
+	ann_kdTree_faces->annkSearch(queryPt, 1, Idx, dist);
+
+	if (*dist < 3 * avg_edge)
+	{
+		auto it = find(selected_faces.begin(), selected_faces.end(), *Idx);
+		history.record_list(UndoHistory::ATTR_SEL_FACES);
+		if (it == selected_faces.end() || selected_faces.empty())
+		{
+			selected_faces.push_back(*Idx);
+			std::cout << "Face : " << *Idx //<< std::endl;
+				<< "\t" << F_center(*Idx, 0) << "\t" << F_center(*Idx, 1) << "\t" << F_center(*Idx, 2) << std::endl;
+		}
+		else
+			selected_faces.erase(it);
+		dirty |= DIRTY_SELECTION;
+
+	}
+}
+
+void MeshData::clear_selection()
+{
+	history.begin_group();
+	history.record_list(UndoHistory::ATTR_SEL_PTS);
+	history.record_list(UndoHistory::ATTR_SEL_FACES);
+	history.end_group();
+
+	selected_pts.clear();
+	selected_faces.clear();
+	dirty |= DIRTY_SELECTION;
+}
+
+bool MeshData::undo()
+{
+	return restore(history.undo());
+}
+
+bool MeshData::redo()
+{
+	return restore(history.redo());
+}
+
+int MeshData::domain_rows(AttributeDomain domain)
+{
+	switch (domain)
+	{
+	case DOMAIN_VERTEX: return V.rows();
+	case DOMAIN_FACE: return F.rows();
+	case DOMAIN_EDGE: return edges().count();
+	default: return 0;
+	}
+}
+
+void MeshData::vertices_moved(const std::vector<int>& vertices, const std::vector<int>& faces)
+{
+	for (size_t j = 0; j < vertices.size(); j++)
+	{
+		p_min = p_min.cwiseMin(V.row(vertices[j]).transpose());
+		p_max = p_max.cwiseMax(V.row(vertices[j]).transpose());
+	}
+	moved_vertices.insert(moved_vertices.end(), vertices.begin(), vertices.end());
+	moved_faces.insert(moved_faces.end(), faces.begin(), faces.end());
+
+	curvature_valid_ = false;
+	attributes.invalidate(DIRTY_POSITION | DIRTY_NORMAL);
+	release_search();
+	if (!selected_pts.empty() || !selected_faces.empty())
+		dirty |= DIRTY_SELECTION;
+}
+
+void MeshData::refresh_geometry()
+{
+	if (V.rows() == 0) return;
+	p_min = V.colwise().minCoeff();
+	p_max = V.colwise().maxCoeff();
+	attributes.invalidate(DIRTY_POSITION);
+	compute_normals();
+	compute_face_centers();
+	release_search();
+	dirty |= DIRTY_POSITION;
+	update_memory_stats();
+}
+
+bool MeshData::restore(unsigned mask)
+{
+	if (mask & (1u << UndoHistory::ATTR_V))
+		refresh_geometry();
+
+	if (mask & ((1u << UndoHistory::ATTR_V_COLOR) | (1u << UndoHistory::ATTR_F_COLOR)))
+		dirty |= DIRTY_DIFFUSE;
+
+	if (mask & ((1u << UndoHistory::ATTR_SEL_PTS) | (1u << UndoHistory::ATTR_SEL_FACES)))
+		dirty |= DIRTY_SELECTION;
+
+	return mask != 0;
+}
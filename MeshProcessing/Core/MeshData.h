@@ -0,0 +1,224 @@
+#pragma once
+#include "stdafx.h"
+#include "UndoHistory.h"
+#include "Image.h"
+#include "PointCloud.h"
+#include "Curvature.h"
+#include "Components.h"
+#include "MeshEdges.h"
+#include "Attributes.h"
+#include "Arena.h"
+#include "MemoryStats.h"
+
+struct MeshCacheEntry;
+
+class MeshData
+{
+public:
+	enum DirtyFlags
+	{
+		DIRTY_NONE           = 0x0000,
+		DIRTY_POSITION       = 0x0001,
+		DIRTY_UV             = 0x0002,
+		DIRTY_NORMAL         = 0x0004,
+		DIRTY_AMBIENT        = 0x0008,
+		DIRTY_DIFFUSE        = 0x0010,
+		DIRTY_SPECULAR       = 0x0020,
+		DIRTY_TEXTURE        = 0x0040,
+		DIRTY_FACE           = 0x0080,
+		DIRTY_MESH           = 0x00FF,
+		DIRTY_SELECTION      = 0x0100,
+		DIRTY_SCALAR         = 0x0200,
+		DIRTY_ALL            = 0x03FF
+	};
+
+	MeshData();
+	~MeshData();
+
+	// Empty all fields
+	void clear();
+
+	// Change the visualization mode, invalidating the cache if necessary
+	void set_face_based(bool newvalue);
+
+	// set new vertices and faces
+	void set_mesh(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F);
+	// set new vertices and faces, taking over their storage without a copy;
+	// V and F are left empty
+	void take_mesh(Eigen::MatrixXd& V, Eigen::MatrixXi& F);
+	// set a mesh read from its cache (see MeshCache.h) with its derived
+	// quantities, taking over the storage of the entry
+	void take_cached(MeshCacheEntry& entry);
+	// set new vertices and keep the faces unchanged
+	void set_vertices(const Eigen::MatrixXd& V);
+	// set vertices or face normals
+	void set_normals(const Eigen::MatrixXd& N);
+	// after sculpting moved rows of V in place and refreshed the normals and
+	// centers around them: grows the bounding box and queues the vertices and
+	// faces whose render data changed, see moved_vertices
+	void vertices_moved(const std::vector<int>& vertices, const std::vector<int>& faces);
+	// recompute the bounding box and normals after V was changed; the
+	// kd-trees are built again on the next selection
+	void refresh_geometry();
+
+	// Set the color of the mesh
+	// Inputs: C  #V|#F|1 by 3 list of colors
+	void set_colors(const Eigen::MatrixXd &C);
+
+	// Set a scalar field, displayed through a colormap
+	// Inputs: S  #V list of scalars
+	void set_scalars(const Eigen::VectorXd &S);
+
+	// Derive the ambient and specular colors from the diffuse ones
+	void update_materials();
+
+	// set the parameterization coordinate
+	void set_uv(const Eigen::MatrixXd& UV);
+	void set_uv(const Eigen::MatrixXd& UV_V, const Eigen::MatrixXi& UV_F);
+	void set_texture(const Eigen::Matrix<char, Eigen::Dynamic, Eigen::Dynamic>& R,
+		const Eigen::Matrix<char, Eigen::Dynamic, Eigen::Dynamic>& G,
+		const Eigen::Matrix<char, Eigen::Dynamic, Eigen::Dynamic>& B);
+	void set_texture(const Image& img);
+	// use an image file as texture, it is decoded and uploaded by the viewer
+	void set_texture_file(const std::string& filename);
+
+	// true for a point cloud: vertices without faces
+	bool is_point_cloud() const { return F.rows() == 0 && V.rows() > 0; }
+
+	// Computes the normals of the mesh; for a point cloud they are estimated
+	// from the neighbors, and avg_edge becomes the point spacing
+	void compute_normals();
+
+	// Curvature of the mesh, computed on first use and kept until the
+	// vertices or the normals change
+	const CurvatureFields& curvature();
+
+	// Unique edges of F, built on first use and kept until F changes
+	const MeshEdges& edges();
+
+	// Assigns uniform colors to all faces/vertices
+	void uniform_colors(Vec3d ambient, Vec3d diffuse, Vec3d specular);
+
+	// Generates a default grid texture
+	void grid_texture();
+
+	// select point
+	void select_pt(Vec3d &pt);
+
+	// select face
+	void select_face(Vec3d &pt);
+
+	// clear the selected points and faces
+	void clear_selection();
+
+	// undo/redo the last edit of V, the colors or the selection
+	bool undo();
+	bool redo();
+
+	// bytes held by the attributes, and by the search structures
+	size_t memory_bytes() const;
+	size_t search_bytes() const;
+	// report both and the undo history to memstats
+	void update_memory_stats();
+
+public:
+	Eigen::MatrixXd V; // Vertices of the current mesh (#V x 3)
+	Eigen::MatrixXi  F; // Faces of the mesh (#F x 3)
+
+	Vec3d p_min, p_max;
+	double avg_edge;
+
+	// Per face attributes
+	Eigen::MatrixXd F_normals; // One normal per face
+	Eigen::MatrixXd F_center;
+
+	// Ambient and specular colors are only refreshed by update_materials()
+	Eigen::MatrixXd F_material_ambient; // Per face ambient color
+	Eigen::MatrixXd F_material_diffuse; // Per face diffuse color
+	Eigen::MatrixXd F_material_specular; // Per face specular color
+
+	// Per vertex attributes
+	Eigen::MatrixXd V_normals; // One normal per vertex
+
+	// Vertex of each vertex of the loaded file, -1 if dropped by the cleanup;
+	// empty if the file was loaded as is
+	Eigen::VectorXi V_source_map;
+
+	Eigen::MatrixXd V_material_ambient; // Per vertex ambient color
+	Eigen::MatrixXd V_material_diffuse; // Per vertex diffuse color
+	Eigen::MatrixXd V_material_specular; // Per vertex specular color
+
+	Eigen::VectorXd V_scalar; // Per vertex scalar field
+
+	// UV parametrization
+	Eigen::MatrixXd V_uv; // UV vertices
+	Eigen::MatrixXi F_uv; // optional faces for UVs
+
+	// Texture, packed RGB(A)8; unused when texture_file is set
+	Image texture;
+	std::string texture_file;
+
+	// Marks dirty buffers that need to be uploaded to OpenGL
+	unsigned dirty;
+
+	// vertices and faces changed in place since the last upload, for a
+	// partial update without DIRTY_POSITION (see MeshRenderer::upload_moved);
+	// may hold repeats
+	std::vector<int> moved_vertices;
+	std::vector<int> moved_faces;
+
+	// Enable per-face or per-vertex properties
+	bool face_based;
+
+	// selected points
+	std::vector<int> selected_pts;
+
+	// selected faces
+	std::vector<int> selected_faces;
+
+	// edit history of V, the colors and the selection
+	UndoHistory history;
+
+	// connected components, labeled on request and kept until F changes;
+	// their statistics are those of V at labeling
+	MeshComponents components;
+
+	// named per vertex, face and edge channels; cleared with the mesh, and
+	// made stale by the changes of V and the normals they depend on
+	AttributeRegistry attributes;
+
+	// rows of a channel of a domain: the vertices, faces or edges()
+	int domain_rows(AttributeDomain domain);
+
+private:
+	// bounding box, normals, default colors and kd-tree of a new mesh
+	void init_mesh();
+	// planar texture coordinates from x and y, unless there are some
+	void default_uv();
+	// refresh the quantities derived from the attributes restored by undo/redo
+	bool restore(unsigned mask);
+
+	void compute_face_centers();
+	// build the kd-trees if they are missing, on the first selection
+	void init_kdTree();
+	// delete the kd-trees and give their points back
+	void release_search();
+	ANNpointArray ann_pts;
+	ANNkd_tree * ann_kdTree_pt;
+
+	ANNpointArray ann_faces;
+	ANNkd_tree * ann_kdTree_faces;
+
+	// points of the kd-trees, released together with the trees
+	Arena search_arena_;
+
+	// point cloud search structure, in place of the vertex kd-tree
+	PointGrid grid_;
+
+	memstats::Gauge mesh_memory_, search_memory_, undo_memory_;
+
+	CurvatureFields curvature_;
+	bool curvature_valid_;
+
+	MeshEdges edges_;
+};
@@ -0,0 +1,513 @@
+#include "stdafx.h"
+#include "MeshDistance.h"
+#include "Parallel.h"
+#include <algorithm>
+
+namespace
+{
+	const int leaf_size = 4;
+	// past this depth nodes are halved instead: with at most 2^31 triangles
+	// no leaf is deeper than 61, and the traversal stacks of 64 suffice
+	const int sah_depth = 32;
+
+	double dot3(const double* a, const double* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// closest point of triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+	void closest_on_triangle(const double* p, const double* a, const double* b, const double* c, double* out)
+	{
+		double ab[3], ac[3], ap[3];
+		for (int i = 0; i < 3; i++)
+		{
+			ab[i] = b[i] - a[i];
+			ac[i] = c[i] - a[i];
+			ap[i] = p[i] - a[i];
+		}
+		double d1 = dot3(ab, ap), d2 = dot3(ac, ap);
+		if (d1 <= 0 && d2 <= 0)
+		{
+			for (int i = 0; i < 3; i++) out[i] = a[i];
+			return;
+		}
+
+		double bp[3];
+		for (int i = 0; i < 3; i++) bp[i] = p[i] - b[i];
+		double d3 = dot3(ab, bp), d4 = dot3(ac, bp);
+		if (d3 >= 0 && d4 <= d3)
+		{
+			for (int i = 0; i < 3; i++) out[i] = b[i];
+			return;
+		}
+
+		double vc = d1 * d4 - d3 * d2;
+		if (vc <= 0 && d1 >= 0 && d3 <= 0)
+		{
+			double v = d1 / (d1 - d3);
+			for (int i = 0; i < 3; i++) out[i] = a[i] + v * ab[i];
+			return;
+		}
+
+		double cp[3];
+		for (int i = 0; i < 3; i++) cp[i] = p[i] - c[i];
+		double d5 = dot3(ab, cp), d6 = dot3(ac, cp);
+		if (d6 >= 0 && d5 <= d6)
+		{
+			for (int i = 0; i < 3; i++) out[i] = c[i];
+			return;
+		}
+
+		double vb = d5 * d2 - d1 * d6;
+		if (vb <= 0 && d2 >= 0 && d6 <= 0)
+		{
+			double w = d2 / (d2 - d6);
+			for (int i = 0; i < 3; i++) out[i] = a[i] + w * ac[i];
+			return;
+		}
+
+		double va = d3 * d6 - d5 * d4;
+		if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+		{
+			double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			for (int i = 0; i < 3; i++) out[i] = b[i] + w * (c[i] - b[i]);
+			return;
+		}
+
+		double denom = va + vb + vc;
+		if (denom == 0)
+		{
+			// degenerate triangle, the closest vertex will do
+			const double* v[3] = { a, b, c };
+			double best = 1e300;
+			for (int k = 0; k < 3; k++)
+			{
+				double d[3] = { p[0] - v[k][0], p[1] - v[k][1], p[2] - v[k][2] };
+				if (dot3(d, d) < best)
+				{
+					best = dot3(d, d);
+					for (int i = 0; i < 3; i++) out[i] = v[k][i];
+				}
+			}
+			return;
+		}
+		double v = vb / denom, w = vc / denom;
+		for (int i = 0; i < 3; i++) out[i] = a[i] + ab[i] * v + ac[i] * w;
+	}
+
+	// parameter of the hit of the ray o + t d with triangle abc, or -1
+	// (Moller and Trumbore 1997)
+	double ray_triangle(const double* o, const double* d, const double* a, const double* b, const double* c)
+	{
+		double e1[3], e2[3], s[3];
+		for (int i = 0; i < 3; i++)
+		{
+			e1[i] = b[i] - a[i];
+			e2[i] = c[i] - a[i];
+			s[i] = o[i] - a[i];
+		}
+		double p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+		double det = dot3(e1, p);
+		if (det == 0) return -1;
+		double inv = 1.0 / det;
+		double u = dot3(s, p) * inv;
+		if (u < 0 || u > 1) return -1;
+		double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+		double v = dot3(d, q) * inv;
+		if (v < 0 || u + v > 1) return -1;
+		return dot3(e2, q) * inv;
+	}
+
+	// whether the ray o + t d, inv_d = 1 / d, crosses the box for some t in (t0, t1)
+	bool ray_box(const double* o, const double* inv_d, const double* lo, const double* hi, double t0, double t1)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			double a = (lo[i] - o[i]) * inv_d[i], b = (hi[i] - o[i]) * inv_d[i];
+			if (a > b) std::swap(a, b);
+			t0 = Max(t0, a);
+			t1 = Min(t1, b);
+			if (t0 > t1) return false;
+		}
+		return true;
+	}
+
+	double box_dist2(const double* p, const double* lo, const double* hi)
+	{
+		double d = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			double t = Max(Max(lo[i] - p[i], p[i] - hi[i]), 0.0);
+			d += t * t;
+		}
+		return d;
+	}
+}
+
+// -----------
+TriangleBVH::TriangleBVH()
+{
+}
+
+void TriangleBVH::clear()
+{
+	nodes_.clear();
+	corners_.clear();
+	faces_.clear();
+}
+
+// a triangle during the build: its bounds and center
+struct TriangleBVH::Prim
+{
+	double lo[3], hi[3], c[3];
+	int face;
+};
+
+void TriangleBVH::build(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F)
+{
+	clear();
+	int nf = F.rows();
+	if (nf == 0) return;
+
+	std::vector<Prim> prims(nf);
+	parallel_for(0, nf, [&](int b, int e) {
+		for (int f = b; f < e; f++)
+		{
+			Prim& prim = prims[f];
+			prim.face = f;
+			for (int i = 0; i < 3; i++)
+			{
+				double a = V(F(f, 0), i), b = V(F(f, 1), i), c = V(F(f, 2), i);
+				prim.lo[i] = Min(a, Min(b, c));
+				prim.hi[i] = Max(a, Max(b, c));
+				prim.c[i] = (a + b + c) / 3.0;
+			}
+		}
+	}, 1 << 14);
+
+	nodes_.reserve(2 * (nf / leaf_size + 1));
+	build_nodes(nodes_, prims, 0, nf, 0);
+
+	// the corners in leaf order, so a leaf reads one contiguous block
+	faces_.resize(nf);
+	corners_.resize(size_t(nf) * 9);
+	parallel_for(0, nf, [&](int b, int e) {
+		for (int t = b; t < e; t++)
+		{
+			faces_[t] = prims[t].face;
+			for (int k = 0; k < 3; k++)
+				for (int i = 0; i < 3; i++)
+					corners_[size_t(t) * 9 + 3 * k + i] = V(F(faces_[t], k), i);
+		}
+	}, 1 << 14);
+}
+
+void TriangleBVH::build_nodes(std::vector<Node>& nodes, std::vector<Prim>& prims, int begin, int end, int depth)
+{
+	int n = (int)nodes.size();
+	nodes.push_back(Node());
+	Node node;
+	double lo[3] = { 1e300, 1e300, 1e300 }, hi[3] = { -1e300, -1e300, -1e300 };
+	for (int i = 0; i < 3; i++)
+	{
+		node.lo[i] = 1e300;
+		node.hi[i] = -1e300;
+	}
+	for (int t = begin; t < end; t++)
+	{
+		const Prim& prim = prims[t];
+		for (int i = 0; i < 3; i++)
+		{
+			node.lo[i] = Min(node.lo[i], prim.lo[i]);
+			node.hi[i] = Max(node.hi[i], prim.hi[i]);
+			lo[i] = Min(lo[i], prim.c[i]);
+			hi[i] = Max(hi[i], prim.c[i]);
+		}
+	}
+	node.first = begin;
+	node.count = 0;
+	node.right = -1;
+
+	if (end - begin <= leaf_size)
+	{
+		node.count = end - begin;
+		nodes[n] = node;
+		return;
+	}
+
+	// binned surface area heuristic over the centers, on every axis
+	const int bins = 16;
+	int best_axis = -1, best_bin = 0;
+	double best_cost = 1e300;
+	for (int axis = 0; axis < 3 && depth < sah_depth; axis++)
+	{
+		double extent = hi[axis] - lo[axis];
+		if (extent <= 0) continue;
+		int count[bins] = { 0 };
+		double blo[bins][3], bhi[bins][3];
+		for (int k = 0; k < bins; k++)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				blo[k][i] = 1e300;
+				bhi[k][i] = -1e300;
+			}
+		}
+		for (int t = begin; t < end; t++)
+		{
+			const Prim& prim = prims[t];
+			int k = Min(int((prim.c[axis] - lo[axis]) / extent * bins), bins - 1);
+			count[k]++;
+			for (int i = 0; i < 3; i++)
+			{
+				blo[k][i] = Min(blo[k][i], prim.lo[i]);
+				bhi[k][i] = Max(bhi[k][i], prim.hi[i]);
+			}
+		}
+
+		// area times count of the left side of each split, then of the right side
+		double left[bins];
+		double clo[3] = { 1e300, 1e300, 1e300 }, chi[3] = { -1e300, -1e300, -1e300 };
+		int nl = 0;
+		for (int k = 0; k < bins - 1; k++)
+		{
+			nl += count[k];
+			for (int i = 0; i < 3; i++)
+			{
+				clo[i] = Min(clo[i], blo[k][i]);
+				chi[i] = Max(chi[i], bhi[k][i]);
+			}
+			double e[3] = { Max(chi[0] - clo[0], 0.0), Max(chi[1] - clo[1], 0.0), Max(chi[2] - clo[2], 0.0) };
+			left[k] = nl * (e[0] * e[1] + e[1] * e[2] + e[2] * e[0]);
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			clo[i] = 1e300;
+			chi[i] = -1e300;
+		}
+		int nr = 0;
+		for (int k = bins - 1; k > 0; k--)
+		{
+			nr += count[k];
+			for (int i = 0; i < 3; i++)
+			{
+				clo[i] = Min(clo[i], blo[k][i]);
+				chi[i] = Max(chi[i], bhi[k][i]);
+			}
+			double e[3] = { Max(chi[0] - clo[0], 0.0), Max(chi[1] - clo[1], 0.0), Max(chi[2] - clo[2], 0.0) };
+			double cost = left[k - 1] + nr * (e[0] * e[1] + e[1] * e[2] + e[2] * e[0]);
+			if (nr < end - begin && cost < best_cost)
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = k;
+			}
+		}
+	}
+
+	int mid = begin;
+	if (best_axis >= 0)
+	{
+		int axis = best_axis;
+		double extent = hi[axis] - lo[axis];
+		mid = int(std::partition(prims.begin() + begin, prims.begin() + end, [&](const Prim& prim) {
+			return Min(int((prim.c[axis] - lo[axis]) / extent * bins), bins - 1) < best_bin;
+		}) - prims.begin());
+	}
+	else if (depth >= sah_depth)
+	{
+		// the median center on the widest axis
+		int axis = 0;
+		for (int i = 1; i < 3; i++)
+			if (hi[i] - lo[i] > hi[axis] - lo[axis]) axis = i;
+		mid = (begin + end) / 2;
+		std::nth_element(prims.begin() + begin, prims.begin() + mid, prims.begin() + end,
+			[&](const Prim& a, const Prim& b) { return a.c[axis] < b.c[axis]; });
+	}
+	// all centers coincide: split in the middle
+	if (mid == begin || mid == end)
+		mid = (begin + end) / 2;
+
+	// the right half of a large subtree is a task of its own, built into
+	// nodes of its own and appended
+	if (end - begin > (1 << 15))
+	{
+		std::vector<Node> right;
+		TaskGroup group("bvh");
+		group.run([&]() { build_nodes(right, prims, mid, end, depth + 1); });
+		build_nodes(nodes, prims, begin, mid, depth + 1);
+		group.wait();
+
+		int offset = (int)nodes.size();
+		for (size_t i = 0; i < right.size(); i++)
+		{
+			if (right[i].count == 0) right[i].right += offset;
+			nodes.push_back(right[i]);
+		}
+		node.right = offset;
+	}
+	else
+	{
+		build_nodes(nodes, prims, begin, mid, depth + 1);
+		node.right = (int)nodes.size();
+		build_nodes(nodes, prims, mid, end, depth + 1);
+	}
+	nodes[n] = node;
+}
+
+int TriangleBVH::closest_point(const double* p, double max_dist2, double* closest, double& dist2) const
+{
+	int face = -1;
+	dist2 = max_dist2;
+	if (nodes_.empty()) return -1;
+
+	// nodes to visit, with the distance to their box
+	int stack[64];
+	double near2[64];
+	int top = 0;
+	stack[top] = 0;
+	near2[top++] = box_dist2(p, nodes_[0].lo, nodes_[0].hi);
+	while (top > 0)
+	{
+		top--;
+		if (near2[top] >= dist2) continue;
+		const Node& node = nodes_[stack[top]];
+
+		if (node.count > 0)
+		{
+			for (int t = node.first; t < node.first + node.count; t++)
+			{
+				const double* c = &corners_[size_t(t) * 9];
+				double q[3];
+				closest_on_triangle(p, c, c + 3, c + 6, q);
+				double d[3] = { p[0] - q[0], p[1] - q[1], p[2] - q[2] };
+				double d2 = dot3(d, d);
+				if (d2 < dist2)
+				{
+					dist2 = d2;
+					face = faces_[t];
+					for (int i = 0; i < 3; i++) closest[i] = q[i];
+				}
+			}
+			continue;
+		}
+
+		// the nearer child is visited first
+		int l = int(&node - &nodes_[0]) + 1, r = node.right;
+		double dl = box_dist2(p, nodes_[l].lo, nodes_[l].hi);
+		double dr = box_dist2(p, nodes_[r].lo, nodes_[r].hi);
+		if (dl > dr)
+		{
+			std::swap(l, r);
+			std::swap(dl, dr);
+		}
+		if (dr < dist2)
+		{
+			stack[top] = r;
+			near2[top++] = dr;
+		}
+		if (dl < dist2)
+		{
+			stack[top] = l;
+			near2[top++] = dl;
+		}
+	}
+	return face;
+}
+
+bool TriangleBVH::occluded(const double* origin, const double* dir, double t_min, double t_max) const
+{
+	if (nodes_.empty()) return false;
+
+	// zero components give infinite slabs, which the comparisons handle
+	double inv_d[3];
+	for (int i = 0; i < 3; i++)
+		inv_d[i] = 1.0 / dir[i];
+
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes_[stack[--top]];
+		if (!ray_box(origin, inv_d, node.lo, node.hi, t_min, t_max)) continue;
+
+		if (node.count > 0)
+		{
+			for (int t = node.first; t < node.first + node.count; t++)
+			{
+				const double* c = &corners_[size_t(t) * 9];
+				double hit = ray_triangle(origin, dir, c, c + 3, c + 6);
+				if (hit > t_min && hit < t_max) return true;
+			}
+			continue;
+		}
+		stack[top++] = node.right;
+		stack[top++] = int(&node - &nodes_[0]) + 1;
+	}
+	return false;
+}
+
+void TriangleBVH::distances(const Eigen::MatrixXd& P, Eigen::VectorXd& D) const
+{
+	int n = P.rows();
+	D.setZero(n);
+	if (nodes_.empty()) return;
+
+	parallel_for(0, n, [&](int b, int e) {
+		// neighboring points have close closest points: the last one bounds the search
+		double last[3];
+		bool have_last = false;
+		for (int v = b; v < e; v++)
+		{
+			double p[3] = { P(v, 0), P(v, 1), P(v, 2) };
+			double bound = 1e300;
+			if (have_last)
+			{
+				double d[3] = { p[0] - last[0], p[1] - last[1], p[2] - last[2] };
+				bound = dot3(d, d) * (1 + 1e-9) + 1e-300;
+			}
+
+			double q[3], d2;
+			if (closest_point(p, bound, q, d2) < 0)
+			{
+				// the bound is reached by the last closest point itself
+				for (int i = 0; i < 3; i++) q[i] = last[i];
+				double d[3] = { p[0] - q[0], p[1] - q[1], p[2] - q[2] };
+				d2 = dot3(d, d);
+			}
+			for (int i = 0; i < 3; i++) last[i] = q[i];
+			have_last = true;
+			D(v) = sqrt(d2);
+		}
+	}, 1024);
+}
+
+// -----------
+DeviationStats compare_meshes(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F,
+	const Eigen::MatrixXd& RV, const Eigen::MatrixXi& RF, Eigen::VectorXd& D)
+{
+	DeviationStats stats = { 0, 0, 0, 0 };
+	D.resize(0);
+	if (V.rows() == 0 || RF.rows() == 0) return stats;
+
+	TriangleBVH reference;
+	reference.build(RV, RF);
+	reference.distances(V, D);
+
+	stats.max_error = D.maxCoeff();
+	stats.mean_error = D.mean();
+	stats.rms_error = sqrt(D.squaredNorm() / D.rows());
+	stats.hausdorff = stats.max_error;
+
+	// and the other way round
+	if (F.rows() > 0)
+	{
+		TriangleBVH mesh;
+		mesh.build(V, F);
+		Eigen::VectorXd back;
+		mesh.distances(RV, back);
+		if (back.rows() > 0) stats.hausdorff = Max(stats.hausdorff, back.maxCoeff());
+	}
+	return stats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+// Bounding volume hierarchy over the triangles of a mesh, for closest point
+// queries against the surface rather than against its vertices, and for
+// shadow rays. Queries only read the tree and can run from several threads
+// at once.
+class TriangleBVH
+{
+public:
+	TriangleBVH();
+
+	void build(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F);
+	void clear();
+	bool empty() const { return nodes_.empty(); }
+
+	// closest point of the surface to p, if closer than sqrt(max_dist2);
+	// returns its face, or -1 if there is none
+	int closest_point(const double* p, double max_dist2, double* closest, double& dist2) const;
+
+	// true if the ray origin + t dir hits a triangle for some t in
+	// (t_min, t_max); stops at the first hit found
+	bool occluded(const double* origin, const double* dir, double t_min, double t_max) const;
+
+	// distance of each row of P to the surface, on all cores
+	void distances(const Eigen::MatrixXd& P, Eigen::VectorXd& D) const;
+
+private:
+	// internal nodes have count 0, their children are the next node and node right
+	struct Node
+	{
+		double lo[3], hi[3];
+		int right;
+		int first, count;
+	};
+
+	struct Prim;
+	static void build_nodes(std::vector<Node>& nodes, std::vector<Prim>& prims, int begin, int end, int depth);
+
+private:
+	std::vector<Node> nodes_;
+	std::vector<double> corners_;  // 9 coordinates per triangle, in leaf order
+	std::vector<int> faces_;       // face of each triangle in leaf order
+};
+
+struct DeviationStats
+{
+	double hausdorff;    // symmetric, over the vertices of both meshes
+	double max_error;    // largest distance of the mesh to the reference
+	double mean_error;   // mean and RMS distance of the mesh vertices to the reference
+	double rms_error;
+};
+
+// Distance D of every vertex of (V, F) to the surface (RV, RF), and the
+// deviation statistics of the two. F may be empty for a point cloud, then
+// the Hausdorff distance is one sided.
+DeviationStats compare_meshes(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F,
+	const Eigen::MatrixXd& RV, const Eigen::MatrixXi& RF, Eigen::VectorXd& D);
@@ -0,0 +1,106 @@
+#include "stdafx.h"
+#include "MeshEdges.h"
+#include "Parallel.h"
+#include <cmath>
+
+namespace
+{
+	// an edge of a face, end points sorted
+	struct EdgeKey
+	{
+		int a, b, face;
+		bool operator<(const EdgeKey& o) const
+		{
+			if (a != o.a) return a < o.a;
+			if (b != o.b) return b < o.b;
+			return face < o.face;
+		}
+	};
+}
+
+void MeshEdges::clear()
+{
+	ends_.clear();
+	start_.clear();
+	faces_.clear();
+}
+
+void MeshEdges::build(const Eigen::MatrixXi& F)
+{
+	clear();
+	int nf = F.rows();
+	if (nf == 0) return;
+
+	std::vector<EdgeKey> keys(3 * size_t(nf));
+	parallel_for(0, nf, [&](int b, int e) {
+		for (int f = b; f < e; f++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				int u = F(f, k), v = F(f, (k + 1) % 3);
+				EdgeKey& key = keys[3 * size_t(f) + k];
+				key.a = Min(u, v);
+				key.b = Max(u, v);
+				key.face = f;
+			}
+		}
+	}, 1 << 14);
+	parallel_sort(keys);
+
+	// an edge per run of equal end points; those of degenerate faces are dropped
+	faces_.reserve(keys.size());
+	for (size_t j = 0; j < keys.size(); j++)
+	{
+		const EdgeKey& key = keys[j];
+		if (key.a == key.b) continue;
+		if (ends_.empty() || key.a != ends_[ends_.size() - 2] || key.b != ends_.back())
+		{
+			ends_.push_back(key.a);
+			ends_.push_back(key.b);
+			start_.push_back((int)faces_.size());
+		}
+		faces_.push_back(key.face);
+	}
+	start_.push_back((int)faces_.size());
+}
+
+void MeshEdges::features(const Eigen::MatrixXd& F_normals, double angle, std::vector<int>& out) const
+{
+	out.clear();
+	int ne = count();
+	if (ne == 0) return;
+
+	// the chunks collect their edges apart, then are joined in order
+	const int grain = 1 << 14;
+	std::vector<std::vector<int> > parts((ne + grain - 1) / grain);
+	double cos_max = cos(angle * M_PI / 180.0);
+	int nn = F_normals.rows();
+	parallel_for(0, ne, [&](int b, int e) {
+		std::vector<int>& part = parts[b / grain];
+		for (int i = b; i < e; i++)
+		{
+			if (face_count(i) != 2)
+			{
+				part.push_back(i);
+				continue;
+			}
+			int f = faces(i)[0], g = faces(i)[1];
+			if (f >= nn || g >= nn) continue;
+			double n2 = F_normals.row(f).squaredNorm() * F_normals.row(g).squaredNorm();
+			if (F_normals.row(f).dot(F_normals.row(g)) < cos_max * sqrt(n2))
+				part.push_back(i);
+		}
+	}, grain);
+
+	size_t total = 0;
+	for (size_t p = 0; p < parts.size(); p++)
+		total += parts[p].size();
+	out.reserve(total);
+	for (size_t p = 0; p < parts.size(); p++)
+		out.insert(out.end(), parts[p].begin(), parts[p].end());
+}
+
+size_t MeshEdges::bytes() const
+{
+	return (ends_.capacity() + start_.capacity() + faces_.capacity()) * sizeof(int);
+}
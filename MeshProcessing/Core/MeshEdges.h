@@ -0,0 +1,35 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+// Unique edges of a triangle mesh, from the edges of every face sorted on
+// all cores. Each edge keeps the faces along it, so boundaries (one face)
+// and non-manifold edges (more than two) are known, and creases are found
+// from the angle between the normals of the two faces of an edge.
+class MeshEdges
+{
+public:
+	void build(const Eigen::MatrixXi& F);
+	void clear();
+
+	int count() const { return (int)ends_.size() / 2; }
+	bool empty() const { return ends_.empty(); }
+
+	// end points of edge e, the first the smaller, edges in increasing order
+	const int* ends(int e) const { return &ends_[2 * size_t(e)]; }
+
+	// faces along edge e
+	int face_count(int e) const { return start_[e + 1] - start_[e]; }
+	const int* faces(int e) const { return &faces_[start_[e]]; }
+
+	// the boundary and non-manifold edges, and the edges whose two faces
+	// have normals more than angle degrees apart; in increasing order
+	void features(const Eigen::MatrixXd& F_normals, double angle, std::vector<int>& out) const;
+
+	size_t bytes() const;
+
+private:
+	std::vector<int> ends_;    // 2 per edge
+	std::vector<int> start_;   // faces of edge e in faces_[start_[e], start_[e + 1])
+	std::vector<int> faces_;
+};
@@ -0,0 +1,297 @@
+#include "stdafx.h"
+#include "MeshIpc.h"
+#include <cstring>
+#include <sstream>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+using namespace MeshIpc;
+
+namespace
+{
+	typedef Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor> RowsXd;
+	typedef Eigen::Matrix<int32_t, Eigen::Dynamic, 3, Eigen::RowMajor> RowsXi;
+
+	// 64 bits, so that no row counts wrap around on 32 bit builds
+	uint64_t payload_bytes(const Message& msg)
+	{
+		return uint64_t(msg.rows[0]) * 3 * sizeof(double) + uint64_t(msg.rows[1]) * 3 * sizeof(int32_t) +
+			uint64_t(msg.rows[2]) * 3 * sizeof(double);
+	}
+
+	Message message(Command command, size_t v_rows = 0, size_t f_rows = 0, size_t c_rows = 0)
+	{
+		Message msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.magic = MAGIC;
+		msg.command = command;
+		msg.rows[0] = uint32_t(v_rows);
+		msg.rows[1] = uint32_t(f_rows);
+		msg.rows[2] = uint32_t(c_rows);
+		return msg;
+	}
+}
+
+// -----------
+MeshIpcServer::MeshIpcServer()
+: connection_(NULL), quit_(false), waiting_(false), ok_(false)
+{
+}
+
+MeshIpcServer::~MeshIpcServer()
+{
+	stop();
+}
+
+bool MeshIpcServer::start(const std::string& name)
+{
+	stop();
+	if (!listener_.listen(name)) return false;
+
+	quit_ = false;
+	waiting_ = false;
+	worker_ = std::thread(&MeshIpcServer::run, this);
+	return true;
+}
+
+void MeshIpcServer::stop()
+{
+	if (!running()) return;
+	// unblock read(): the worker closes the connection only once it is
+	// unpublished, so its descriptor is still the client's here
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+		waiting_ = false;
+		if (connection_) connection_->shutdown();
+	}
+	cv_.notify_all();
+
+	// and accept()
+	listener_.wake();
+	worker_.join();
+
+	listener_.close();
+	segment_.close();
+}
+
+MeshIpc::Request* MeshIpcServer::pending()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return waiting_ ? &request_ : NULL;
+}
+
+void MeshIpcServer::reply(bool ok)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!waiting_) return;
+		ok_ = ok;
+		waiting_ = false;
+	}
+	cv_.notify_all();
+}
+
+void MeshIpcServer::run()
+{
+	// only this thread opens and closes the connection; stop() shuts it
+	// down through connection_
+	LocalStream stream;
+	while (listener_.accept(stream))
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (quit_) break;
+			connection_ = &stream;
+		}
+
+		// one client at a time, until it disconnects
+		Message msg, answer;
+		while (stream.read(&msg, sizeof(msg)))
+		{
+			if (!serve(msg, answer) || !stream.write(&answer, sizeof(answer))) break;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			connection_ = NULL;
+		}
+		stream.close();
+	}
+	stream.close();
+}
+
+bool MeshIpcServer::serve(const Message& msg, Message& answer)
+{
+	answer = msg;
+	answer.status = STATUS_BAD_MESSAGE;
+	answer.segment[sizeof(answer.segment) - 1] = 0;
+	if (msg.magic != MAGIC || msg.command < CMD_SET_MESH || msg.command > CMD_GET_SELECTION)
+		return true;
+
+	// clients keep their segment between calls
+	std::string name(answer.segment);
+	if (!name.empty() && (name != segment_.name() || !segment_.is_open()) && !segment_.open(name))
+		return true;
+	if (payload_bytes(msg) > segment_.size())
+		return true;
+
+	Request request;
+	request.command = Command(msg.command);
+	if (payload_bytes(msg) > 0)
+	{
+		const unsigned char* p = segment_.data();
+		request.V = Eigen::Map<const RowsXd>((const double*)p, msg.rows[0], 3);
+		p += size_t(msg.rows[0]) * 3 * sizeof(double);
+		request.F = Eigen::Map<const RowsXi>((const int32_t*)p, msg.rows[1], 3).cast<int>();
+		p += size_t(msg.rows[1]) * 3 * sizeof(int32_t);
+		request.C = Eigen::Map<const RowsXd>((const double*)p, msg.rows[2], 3);
+	}
+
+	// wait for the owner of the mesh to carry it out
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (quit_) return false;
+		std::swap(request_, request);
+		waiting_ = true;
+		while (waiting_) cv_.wait(lock);
+		if (quit_) return false;
+		std::swap(request_, request);
+	}
+	answer.status = ok_ ? STATUS_OK : STATUS_FAILED;
+
+	if (ok_ && msg.command == CMD_GET_SELECTION)
+	{
+		size_t n = request.selected_pts.size() + request.selected_faces.size();
+		answer.rows[0] = uint32_t(request.selected_pts.size());
+		answer.rows[1] = uint32_t(request.selected_faces.size());
+		answer.rows[2] = 0;
+		if (n * sizeof(int32_t) > segment_.size())
+		{
+			answer.status = STATUS_TOO_SMALL;
+			return true;
+		}
+
+		int32_t* out = (int32_t*)segment_.data();
+		for (size_t i = 0; i < request.selected_pts.size(); i++) *out++ = request.selected_pts[i];
+		for (size_t i = 0; i < request.selected_faces.size(); i++) *out++ = request.selected_faces[i];
+	}
+	return true;
+}
+
+// -----------
+MeshIpcClient::MeshIpcClient()
+: segments_(0)
+{
+}
+
+MeshIpcClient::~MeshIpcClient()
+{
+	disconnect();
+}
+
+bool MeshIpcClient::connect(const std::string& name)
+{
+	disconnect();
+	if (!stream_.connect(name))
+	{
+		std::cerr << "ERROR (MeshIpcClient): No viewer listening on " << name << std::endl;
+		return false;
+	}
+
+	// segment names can not contain path separators
+	name_ = name.substr(name.find_last_of("/\\") + 1);
+	return true;
+}
+
+void MeshIpcClient::disconnect()
+{
+	stream_.close();
+	segment_.close();
+}
+
+bool MeshIpcClient::reserve(size_t bytes)
+{
+	if (segment_.is_open() && segment_.size() >= bytes) return true;
+
+	// a new name each time, the server may still map the old segment
+	std::ostringstream name;
+	name << name_ << "_" << getpid() << "_" << segments_++;
+	if (name.str().size() >= sizeof(((Message*)0)->segment)) return false;
+	return segment_.create(name.str(), Max(Max(bytes, segment_.size() * 3 / 2), size_t(1) << 16));
+}
+
+bool MeshIpcClient::call(Message& msg)
+{
+	strncpy(msg.segment, segment_.name().c_str(), sizeof(msg.segment) - 1);
+	return send(msg);
+}
+
+bool MeshIpcClient::send(Message& msg)
+{
+	if (!stream_.is_open()) return false;
+	if (!stream_.write(&msg, sizeof(msg)) || !stream_.read(&msg, sizeof(msg)))
+	{
+		std::cerr << "ERROR (MeshIpcClient): Lost the connection" << std::endl;
+		disconnect();
+		return false;
+	}
+	return true;
+}
+
+bool MeshIpcClient::set_mesh(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F)
+{
+	if (V.cols() != 3 || F.cols() != 3) return false;
+	Message msg = message(CMD_SET_MESH, V.rows(), F.rows());
+	if (!reserve(size_t(payload_bytes(msg)))) return false;
+
+	unsigned char* p = segment_.data();
+	Eigen::Map<RowsXd>((double*)p, V.rows(), 3) = V;
+	p += size_t(V.rows()) * 3 * sizeof(double);
+	Eigen::Map<RowsXi>((int32_t*)p, F.rows(), 3) = F.cast<int32_t>();
+	return call(msg) && msg.status == STATUS_OK;
+}
+
+bool MeshIpcClient::set_vertices(const Eigen::MatrixXd& V)
+{
+	if (V.cols() != 3) return false;
+	Message msg = message(CMD_SET_VERTICES, V.rows());
+	if (!reserve(size_t(payload_bytes(msg)))) return false;
+
+	Eigen::Map<RowsXd>((double*)segment_.data(), V.rows(), 3) = V;
+	return call(msg) && msg.status == STATUS_OK;
+}
+
+bool MeshIpcClient::set_colors(const Eigen::MatrixXd& C)
+{
+	if (C.cols() != 3) return false;
+	Message msg = message(CMD_SET_COLORS, 0, 0, C.rows());
+	if (!reserve(size_t(payload_bytes(msg)))) return false;
+
+	Eigen::Map<RowsXd>((double*)segment_.data(), C.rows(), 3) = C;
+	return call(msg) && msg.status == STATUS_OK;
+}
+
+bool MeshIpcClient::get_selection(std::vector<int>& pts, std::vector<int>& faces)
+{
+	if (!reserve(1)) return false;
+	Message msg = message(CMD_GET_SELECTION);
+	if (!call(msg)) return false;
+	if (msg.status == STATUS_TOO_SMALL)
+	{
+		// grow to the size given in the reply and ask again
+		if (!reserve((size_t(msg.rows[0]) + msg.rows[1]) * sizeof(int32_t))) return false;
+		msg = message(CMD_GET_SELECTION);
+		if (!call(msg)) return false;
+	}
+	if (msg.status != STATUS_OK) return false;
+
+	const int32_t* in = (const int32_t*)segment_.data();
+	pts.assign(in, in + msg.rows[0]);
+	faces.assign(in + msg.rows[0], in + msg.rows[0] + msg.rows[1]);
+	return true;
+}
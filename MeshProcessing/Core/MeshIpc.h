@@ -0,0 +1,120 @@
+#pragma once
+#include "stdafx.h"
+#include "LocalIpc.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pushing meshes into a running viewer from another process.
+//
+// Commands go through a LocalStream as fixed size messages. The arrays
+// travel in a shared memory segment owned by the client and named in the
+// message, laid out back to back: V (rows[0] x 3 doubles), F (rows[1] x 3
+// int32), C (rows[2] x 3 doubles). Selections come back the same way, as
+// rows[0] point and rows[1] face indices (int32).
+namespace MeshIpc
+{
+	const uint32_t MAGIC = 0x4349504d;   // "MPIC"
+
+	enum Command
+	{
+		CMD_SET_MESH = 1,
+		CMD_SET_VERTICES,
+		CMD_SET_COLORS,
+		CMD_GET_SELECTION
+	};
+
+	enum Status
+	{
+		STATUS_OK = 0,
+		STATUS_FAILED = -1,      // rejected by the viewer, e.g. wrong sizes
+		STATUS_BAD_MESSAGE = -2,
+		STATUS_TOO_SMALL = -3    // the reply does not fit, rows tell what is needed
+	};
+
+	struct Message
+	{
+		uint32_t magic;
+		uint32_t command;
+		int32_t status;
+		uint32_t rows[3];
+		char segment[64];
+	};
+
+	// a command received by the server, with its arrays copied out of the segment
+	struct Request
+	{
+		Command command;
+		Eigen::MatrixXd V, C;
+		Eigen::MatrixXi F;
+		std::vector<int> selected_pts, selected_faces;  // filled for CMD_GET_SELECTION
+	};
+}
+
+// Viewer side. A thread receives the commands; they are carried out on the
+// thread calling pending()/reply(), i.e. the one owning the mesh and GL.
+class MeshIpcServer
+{
+public:
+	MeshIpcServer();
+	~MeshIpcServer();
+
+	bool start(const std::string& name);
+	void stop();
+	bool running() const { return worker_.joinable(); }
+
+	// the request waiting to be carried out, NULL if there is none
+	MeshIpc::Request* pending();
+	// answer the pending request
+	void reply(bool ok);
+
+private:
+	void run();
+	bool serve(const MeshIpc::Message& msg, MeshIpc::Message& answer);
+
+private:
+	LocalListener listener_;
+	SharedMemory segment_;
+	std::thread worker_;
+
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	LocalStream* connection_;  // the client being served, owned by the worker
+	bool quit_;
+	bool waiting_;           // request_ is waiting for reply()
+	bool ok_;
+	MeshIpc::Request request_;
+};
+
+// Producer side
+class MeshIpcClient
+{
+public:
+	MeshIpcClient();
+	~MeshIpcClient();
+
+	bool connect(const std::string& name);
+	void disconnect();
+	bool is_connected() const { return stream_.is_open(); }
+
+	bool set_mesh(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F);
+	bool set_vertices(const Eigen::MatrixXd& V);
+	bool set_colors(const Eigen::MatrixXd& C);
+	bool get_selection(std::vector<int>& pts, std::vector<int>& faces);
+
+	// send msg as it is, e.g. a malformed one, and read the reply into it;
+	// false if the connection is lost
+	bool send(MeshIpc::Message& msg);
+
+private:
+	bool reserve(size_t bytes);
+	bool call(MeshIpc::Message& msg);
+
+private:
+	LocalStream stream_;
+	SharedMemory segment_;
+	std::string name_;
+	int segments_;           // segments created so far, for unique names
+};
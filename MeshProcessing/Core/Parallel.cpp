@@ -0,0 +1,365 @@
+#include "stdafx.h"
+#include "Parallel.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+	long long now_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	struct Task
+	{
+		std::function<void()> fn;
+		TaskGroup* group;
+	};
+
+	struct TaskDeque
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	struct TimingTotal
+	{
+		int runs;
+		long long tasks, wall_ns, busy_ns;
+		TimingTotal() : runs(0), tasks(0), wall_ns(0), busy_ns(0) {}
+	};
+
+	// deque of the calling thread: 1 + its index for a worker, 0 for the others
+	THREAD_LOCAL int current_deque = 0;
+}
+
+class Scheduler
+{
+public:
+	// deques are made once, for every thread there may be, so that pushing
+	// and stealing never see them change
+	enum { MAX_THREADS = 256 };
+
+	Scheduler() : wanted_(0), spawned_(0), queued_(0), sleeping_(0), stopping_(false)
+	{
+		int n = (int)std::thread::hardware_concurrency();
+		hardware_ = Max(Min(n, (int)MAX_THREADS), 1);
+		for (int i = 0; i < MAX_THREADS; i++)
+			deques_[i].reset(new TaskDeque);
+	}
+	~Scheduler() { stop(); }
+
+	int threads() const
+	{
+		int n = wanted_;
+		return n > 0 ? n : hardware_;
+	}
+
+	// workers beyond the new count park once their task is done, others
+	// steal what they left queued; missing workers start with the next task
+	void set_threads(int n)
+	{
+		std::lock_guard<std::mutex> guard(sleep_lock_);
+		wanted_ = Min(Max(n, 0), (int)MAX_THREADS);
+		park_.notify_all();
+		wake_.notify_all();
+	}
+
+	void push(TaskGroup& group, const std::function<void()>& fn)
+	{
+		if (spawned_ < threads() - 1) spawn();
+		group.pending_++;
+		Task task = { fn, &group };
+		TaskDeque& q = *deques_[current_deque];
+		{
+			std::lock_guard<std::mutex> guard(q.lock);
+			q.tasks.push_back(std::move(task));
+		}
+		queued_++;
+		if (sleeping_ > 0)
+		{
+			std::lock_guard<std::mutex> guard(sleep_lock_);
+			wake_.notify_one();
+		}
+	}
+
+	// run one task, the last of our deque or the first of another; false if
+	// there is none
+	bool run_one()
+	{
+		if (queued_ == 0) return false;
+		int self = current_deque, n = 1 + spawned_;
+		Task task;
+		for (int i = 0; i < n; i++)
+		{
+			TaskDeque& q = *deques_[(self + i) % n];
+			std::lock_guard<std::mutex> guard(q.lock);
+			if (q.tasks.empty()) continue;
+			if (i == 0)
+			{
+				task = std::move(q.tasks.back());
+				q.tasks.pop_back();
+			}
+			else
+			{
+				task = std::move(q.tasks.front());
+				q.tasks.pop_front();
+			}
+			queued_--;
+			break;
+		}
+		if (!task.fn) return false;
+		execute(task);
+		return true;
+	}
+
+	void wait(TaskGroup& group)
+	{
+		while (group.pending_ > 0)
+		{
+			if (!run_one()) std::this_thread::yield();
+		}
+	}
+
+	void record(TaskGroup& group)
+	{
+		if (!group.name_) return;
+		std::lock_guard<std::mutex> guard(timing_lock_);
+		TimingTotal& t = timings_[group.name_];
+		t.runs++;
+		t.tasks += group.tasks_;
+		t.wall_ns += now_ns() - group.start_ns_;
+		t.busy_ns += group.busy_ns_;
+	}
+
+	void timings(std::vector<TaskTiming>& out)
+	{
+		std::lock_guard<std::mutex> guard(timing_lock_);
+		out.clear();
+		for (std::map<std::string, TimingTotal>::const_iterator it = timings_.begin(); it != timings_.end(); ++it)
+		{
+			TaskTiming t;
+			t.name = it->first;
+			t.runs = it->second.runs;
+			t.tasks = it->second.tasks;
+			t.wall_ms = it->second.wall_ns * 1e-6;
+			t.busy_ms = it->second.busy_ns * 1e-6;
+			out.push_back(t);
+		}
+	}
+
+	void reset_timings()
+	{
+		std::lock_guard<std::mutex> guard(timing_lock_);
+		timings_.clear();
+	}
+
+private:
+	// the calling thread is one of the threads, so there is one worker less;
+	// a worker's deque is counted before it starts
+	void spawn()
+	{
+		std::lock_guard<std::mutex> guard(config_);
+		while (spawned_ < threads() - 1)
+		{
+			int i = ++spawned_;
+			workers_.push_back(std::thread([this, i]() { work(i); }));
+		}
+	}
+
+	// at exit
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> guard(sleep_lock_);
+			stopping_ = true;
+			park_.notify_all();
+			wake_.notify_all();
+		}
+		for (size_t i = 0; i < workers_.size(); i++)
+			workers_[i].join();
+		workers_.clear();
+	}
+
+	void work(int index)
+	{
+		current_deque = index;
+		for (;;)
+		{
+			if (index < threads() && run_one()) continue;
+			std::unique_lock<std::mutex> guard(sleep_lock_);
+			if (index >= threads())
+			{
+				while (index >= threads() && !stopping_)
+					park_.wait(guard);
+			}
+			else
+			{
+				sleeping_++;
+				while (queued_ == 0 && index < threads() && !stopping_)
+					wake_.wait(guard);
+				sleeping_--;
+				// parked meanwhile: pass the wake up on
+				if (index >= threads() && queued_ > 0)
+					wake_.notify_one();
+			}
+			if (stopping_) return;
+		}
+	}
+
+	void execute(Task& task)
+	{
+		TaskGroup& group = *task.group;
+		if (!group.cancelled_)
+		{
+			long long start = now_ns();
+			task.fn();
+			group.busy_ns_ += now_ns() - start;
+			group.tasks_++;
+		}
+		// the group may be gone once this is 0
+		group.pending_--;
+	}
+
+private:
+	std::mutex config_;
+	int hardware_;
+	std::atomic<int> wanted_;
+	std::atomic<int> spawned_;    // workers started, never fewer
+	std::unique_ptr<TaskDeque> deques_[MAX_THREADS];
+	std::vector<std::thread> workers_;
+
+	std::atomic<int> queued_;
+	std::atomic<int> sleeping_;
+	std::mutex sleep_lock_;
+	std::condition_variable wake_;   // workers waiting for tasks
+	std::condition_variable park_;   // workers beyond the count
+	bool stopping_;
+
+	std::mutex timing_lock_;
+	std::map<std::string, TimingTotal> timings_;
+};
+
+namespace
+{
+	Scheduler scheduler;
+
+	// chunks [c0, c1) of the range: the upper halves are left to thieves,
+	// the first chunk is run here
+	void split(TaskGroup& group, int begin, int end, int grain, int c0, int c1,
+		const std::function<void(int, int)>& body)
+	{
+		while (c1 - c0 > 1)
+		{
+			int mid = c0 + (c1 - c0) / 2, top = c1;
+			group.run([&group, &body, begin, end, grain, mid, top]() {
+				split(group, begin, end, grain, mid, top, body);
+			});
+			c1 = mid;
+		}
+		if (group.cancelled()) return;
+		int b = begin + c0 * grain;
+		body(b, int(Min(int64_t(b) + grain, int64_t(end))));
+	}
+}
+
+TaskGroup::TaskGroup(const char* name)
+: name_(name), pending_(0), cancelled_(false), busy_ns_(0), tasks_(0), start_ns_(now_ns())
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	wait();
+	scheduler.record(*this);
+}
+
+void TaskGroup::run(const std::function<void()>& task)
+{
+	if (scheduler.threads() <= 1)
+	{
+		// nothing to share the work with
+		if (cancelled_) return;
+		long long start = now_ns();
+		task();
+		busy_ns_ += now_ns() - start;
+		tasks_++;
+		return;
+	}
+	scheduler.push(*this, task);
+}
+
+void TaskGroup::wait()
+{
+	scheduler.wait(*this);
+}
+
+int worker_count()
+{
+	return scheduler.threads();
+}
+
+void set_worker_count(int n)
+{
+	scheduler.set_threads(n);
+}
+
+void parallel_for(TaskGroup& group, int begin, int end, const std::function<void(int, int)>& body, int grain)
+{
+	if (end <= begin) return;
+	grain = Max(grain, 1);
+	int chunks = int((int64_t(end) - begin + grain - 1) / grain);
+	if (chunks == 1 || worker_count() <= 1)
+	{
+		group.run([&]() { body(begin, end); });
+		group.wait();
+		return;
+	}
+	split(group, begin, end, grain, 0, chunks, body);
+	group.wait();
+}
+
+void parallel_for(int begin, int end, const std::function<void(int, int)>& body, int grain)
+{
+	TaskGroup group;
+	parallel_for(group, begin, end, body, grain);
+}
+
+void task_timings(std::vector<TaskTiming>& out)
+{
+	scheduler.timings(out);
+}
+
+void reset_task_timings()
+{
+	scheduler.reset_timings();
+}
+
+void print_task_timings(std::ostream& out)
+{
+	std::vector<TaskTiming> timings;
+	task_timings(timings);
+	std::ios::fmtflags flags = out.flags();
+	out << std::fixed << std::setprecision(1);
+	for (size_t i = 0; i < timings.size(); i++)
+	{
+		const TaskTiming& t = timings[i];
+		out << std::left << std::setw(24) << t.name << std::right << std::setw(6) << t.runs << " runs "
+			<< std::setw(10) << t.tasks << " tasks " << std::setw(10) << t.wall_ms << " ms wall "
+			<< std::setw(10) << t.busy_ms << " ms busy  x" << (t.wall_ms > 0 ? t.busy_ms / t.wall_ms : 0.0) << "\n";
+	}
+	out.flags(flags);
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include "stdafx.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One task scheduler for the whole program: a pool of worker threads, each
+// with a deque of tasks. A worker pushes and pops its own tasks at the back
+// and, when it runs dry, steals from the front of the others, where the
+// larger, earlier split tasks are. Threads that are not workers (the GLUT
+// thread, background bakes) queue to a shared deque and run tasks while
+// they wait, so parallel loops nest and never leave a core to a blocked
+// thread.
+
+// threads running tasks, the waiting thread included
+int worker_count();
+// n threads, 0 for every core, at most 256. Safe while tasks run: workers
+// beyond the new count stop once their task is done, and what they left
+// queued is stolen by the others.
+void set_worker_count(int n);
+
+// Tasks run and waited for together. Cancelling drops the tasks not yet
+// started; running ones may poll cancelled() to stop early. A group named
+// by a string literal adds its wall and busy time to task_timings() when
+// it is destroyed.
+class TaskGroup
+{
+public:
+	explicit TaskGroup(const char* name = NULL);
+	// waits for the tasks
+	~TaskGroup();
+
+	void run(const std::function<void()>& task);
+	// returns once every task ran or was dropped, running tasks meanwhile
+	void wait();
+
+	void cancel() { cancelled_ = true; }
+	bool cancelled() const { return cancelled_; }
+
+private:
+	TaskGroup(const TaskGroup&);
+	TaskGroup& operator=(const TaskGroup&);
+	friend class Scheduler;
+
+private:
+	const char* name_;
+	std::atomic<int> pending_;
+	std::atomic<bool> cancelled_;
+	std::atomic<long long> busy_ns_;   // time spent in the tasks
+	std::atomic<int> tasks_;
+	long long start_ns_;
+};
+
+// Run body(chunk_begin, chunk_end) over [begin, end) split into chunks of
+// about grain items, on all cores; returns once every chunk is done.
+// The range is halved recursively: a worker keeps the lower half and leaves
+// the upper one to thieves, so neighboring chunks tend to run on the same
+// core, one after the other. Chunks start at begin + a multiple of grain,
+// unless a single thread runs the whole range in one call.
+void parallel_for(int begin, int end, const std::function<void(int, int)>& body, int grain = 1024);
+// the same as tasks of group: once it is cancelled the chunks not yet
+// started are skipped, and their time counts for its name
+void parallel_for(TaskGroup& group, int begin, int end, const std::function<void(int, int)>& body,
+	int grain = 1024);
+
+// map(chunk_begin, chunk_end) for every chunk of grain items, the results
+// joined in chunk order from identity, so the result does not depend on the
+// number of threads
+template <typename T, typename Map, typename Join>
+T parallel_reduce(int begin, int end, const T& identity, Map map, Join join, int grain = 1024)
+{
+	if (end <= begin) return identity;
+	grain = Max(grain, 1);
+	int chunks = int((int64_t(end) - begin + grain - 1) / grain);
+	std::vector<T> parts(chunks, identity);
+	parallel_for(0, chunks, [&](int b, int e) {
+		for (int c = b; c < e; c++)
+		{
+			int lo = begin + c * grain;
+			parts[c] = map(lo, int(Min(int64_t(lo) + grain, int64_t(end))));
+		}
+	}, 1);
+
+	T result = identity;
+	for (int c = 0; c < chunks; c++)
+		result = join(result, parts[c]);
+	return result;
+}
+
+// std::sort on all cores: the parts are sorted, then merged pairwise
+template <typename T>
+void parallel_sort(std::vector<T>& items)
+{
+	int n = (int)items.size();
+	int parts = worker_count();
+	int chunk = Max((n + parts - 1) / parts, 1);
+	parallel_for(0, parts, [&](int b, int e) {
+		for (int p = b; p < e; p++)
+		{
+			int lo = Min(p * chunk, n), hi = Min(lo + chunk, n);
+			std::sort(items.begin() + lo, items.begin() + hi);
+		}
+	}, 1);
+
+	for (int width = chunk; width < n; width *= 2)
+	{
+		int pairs = (n + 2 * width - 1) / (2 * width);
+		parallel_for(0, pairs, [&](int b, int e) {
+			for (int p = b; p < e; p++)
+			{
+				int lo = p * 2 * width;
+				int mid = Min(lo + width, n), hi = Min(lo + 2 * width, n);
+				std::inplace_merge(items.begin() + lo, items.begin() + mid, items.begin() + hi);
+			}
+		}, 1);
+	}
+}
+
+// time of the named task groups since the last reset, by name
+struct TaskTiming
+{
+	std::string name;
+	int runs;           // groups waited for
+	long long tasks;
+	double wall_ms;     // from the creation of a group to its destruction
+	double busy_ms;     // in its tasks, over all threads
+};
+void task_timings(std::vector<TaskTiming>& out);
+void reset_task_timings();
+// a line per name, with the average parallelism busy / wall
+void print_task_timings(std::ostream& out);
@@ -0,0 +1,496 @@
+#include "stdafx.h"
+#include "Parameterization.h"
+#include "Parallel.h"
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <vector>
+
+typedef Eigen::SparseMatrix<double> SparseMatrix;
+typedef Eigen::Triplet<double> Triplet;
+// the unknowns are numbered in nested dissection order, see dissect()
+typedef Eigen::SimplicialLDLT<SparseMatrix, Eigen::Lower, Eigen::NaturalOrdering<int> > Factorization;
+
+struct Parameterizer::Cache
+{
+	// topology, valid while F and the method are the same
+	Eigen::MatrixXi F;
+	ParamMethod method;
+	int nv;
+	std::vector<int> edge_a, edge_b;       // unique edges
+	std::vector<int> edge_first;           // corners facing edge e: edge_corner[edge_first[e] ..]
+	std::vector<int> edge_corner;          // 3 * face + corner
+	std::vector<int> boundary_from, boundary_to;  // edges of one face, along the face
+	std::vector<int> pinned;               // in order along the loop for the harmonic map
+	std::vector<int> unknown;              // unknown of each vertex, -1 if pinned
+	int free_count;
+
+	// system
+	SparseMatrix A;
+	std::vector<Triplet> triplets;
+	Factorization solver;
+	bool analyzed;
+	bool factored;
+	Eigen::MatrixXd X;                     // previous solution, #V x 2, empty if none
+};
+
+namespace
+{
+	struct EdgeKey
+	{
+		int a, b, corner;
+		bool operator<(const EdgeKey& o) const
+		{
+			if (a != o.a) return a < o.a;
+			if (b != o.b) return b < o.b;
+			return corner < o.corner;
+		}
+	};
+
+	int find_root(std::vector<int>& parent, int i)
+	{
+		while (parent[i] != i) i = parent[i] = parent[parent[i]];
+		return i;
+	}
+
+	// Nested dissection of the vertices ids by their positions: a part is
+	// split at the median of its longest side, and the vertices of the lower
+	// half next to the upper half come after both halves. Factoring in this
+	// order fills much less than a minimum degree ordering on meshes.
+	void dissect(const Eigen::MatrixXd& V, const std::vector<int>& start, const std::vector<int>& adjacent,
+		int* ids, int count, std::vector<char>& upper, std::vector<int>& order)
+	{
+		if (count <= 64)
+		{
+			order.insert(order.end(), ids, ids + count);
+			return;
+		}
+
+		Vec3d lo = V.row(ids[0]).transpose(), hi = lo;
+		for (int j = 1; j < count; j++)
+		{
+			lo = lo.cwiseMin(V.row(ids[j]).transpose());
+			hi = hi.cwiseMax(V.row(ids[j]).transpose());
+		}
+		int axis;
+		(hi - lo).maxCoeff(&axis);
+
+		int half = count / 2;
+		std::nth_element(ids, ids + half, ids + count, [&](int a, int b) { return V(a, axis) < V(b, axis); });
+		for (int j = half; j < count; j++) upper[ids[j]] = 1;
+		int* separator = std::partition(ids, ids + half, [&](int v) {
+			for (int k = start[v]; k < start[v + 1]; k++)
+				if (upper[adjacent[k]]) return false;
+			return true;
+		});
+		for (int j = half; j < count; j++) upper[ids[j]] = 0;
+
+		dissect(V, start, adjacent, ids, int(separator - ids), upper, order);
+		dissect(V, start, adjacent, ids + half, count - half, upper, order);
+		order.insert(order.end(), separator, ids + half);
+	}
+
+	// x = A^-1 b by CG preconditioned with the factorization of a nearby
+	// matrix, from the given x; returns the iterations, or -1 without convergence
+	int preconditioned_cg(const SparseMatrix& A, const Factorization& M,
+		const Eigen::VectorXd& b, Eigen::VectorXd& x, int max_iterations, double tolerance)
+	{
+		double target = tolerance * Max(b.norm(), 1e-300);
+		Eigen::VectorXd r = b - A * x;
+		if (r.norm() <= target) return 0;
+		Eigen::VectorXd z = M.solve(r);
+		Eigen::VectorXd p = z;
+		double rz = r.dot(z);
+		for (int k = 1; k <= max_iterations; k++)
+		{
+			Eigen::VectorXd Ap = A * p;
+			double alpha = rz / p.dot(Ap);
+			x += alpha * p;
+			r -= alpha * Ap;
+			if (r.norm() <= target) return k;
+			z = M.solve(r);
+			double rz_next = r.dot(z);
+			p = z + (rz_next / rz) * p;
+			rz = rz_next;
+		}
+		return -1;
+	}
+}
+
+Parameterizer::Parameterizer()
+: cache_(NULL), iterations_(0), factored_(false)
+{
+}
+
+Parameterizer::~Parameterizer()
+{
+	clear();
+}
+
+void Parameterizer::clear()
+{
+	delete cache_;
+	cache_ = NULL;
+}
+
+bool Parameterizer::setup(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, ParamMethod method)
+{
+	clear();
+	int nv = V.rows(), nf = F.rows();
+	if (nv == 0 || nf == 0)
+	{
+		std::cerr << "ERROR (Parameterizer): The mesh has no faces." << std::endl;
+		return false;
+	}
+
+	Cache* c = new Cache;
+	c->F = F;
+	c->method = method;
+	c->nv = nv;
+	c->analyzed = c->factored = false;
+
+	// unique edges from the sorted face edges, with the corners facing them
+	std::vector<EdgeKey> keys(3 * size_t(nf));
+	parallel_for(0, nf, [&](int b, int e) {
+		for (int f = b; f < e; f++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				int u = F(f, (k + 1) % 3), v = F(f, (k + 2) % 3);
+				EdgeKey& key = keys[3 * size_t(f) + k];
+				key.a = Min(u, v);
+				key.b = Max(u, v);
+				key.corner = 3 * f + k;
+			}
+		}
+	}, 1 << 14);
+	parallel_sort(keys);
+
+	c->edge_corner.resize(keys.size());
+	for (size_t j = 0; j < keys.size(); j++)
+	{
+		if (j == 0 || keys[j].a != keys[j - 1].a || keys[j].b != keys[j - 1].b)
+		{
+			c->edge_first.push_back((int)j);
+			c->edge_a.push_back(keys[j].a);
+			c->edge_b.push_back(keys[j].b);
+		}
+		c->edge_corner[j] = keys[j].corner;
+
+		// the edge of a single face is on the boundary, oriented along the face
+		bool last = j + 1 == keys.size() || keys[j + 1].a != keys[j].a || keys[j + 1].b != keys[j].b;
+		if (last && (int)j == c->edge_first.back())
+		{
+			int f = keys[j].corner / 3, k = keys[j].corner % 3;
+			c->boundary_from.push_back(F(f, (k + 1) % 3));
+			c->boundary_to.push_back(F(f, (k + 2) % 3));
+		}
+	}
+	c->edge_first.push_back((int)keys.size());
+	int ne = (int)c->edge_a.size();
+
+	// one connected part with a boundary
+	std::vector<int> parent(nv);
+	for (int i = 0; i < nv; i++) parent[i] = i;
+	for (int e = 0; e < ne; e++)
+		parent[find_root(parent, c->edge_a[e])] = find_root(parent, c->edge_b[e]);
+	int root = find_root(parent, F(0, 0)), parts = 0;
+	std::vector<char> used(nv, 0);
+	for (int f = 0; f < nf; f++)
+		for (int k = 0; k < 3; k++) used[F(f, k)] = 1;
+	for (int i = 0; i < nv; i++)
+		if (used[i] && find_root(parent, i) != root) parts++;
+	if (parts > 0 || c->boundary_from.empty())
+	{
+		std::cerr << "ERROR (Parameterizer): Please provide a single connected patch with a boundary." << std::endl;
+		delete c;
+		return false;
+	}
+
+	if (method == PARAM_HARMONIC)
+	{
+		// the longest boundary loop, by its number of edges
+		std::vector<int> next(nv, -1);
+		for (size_t j = 0; j < c->boundary_from.size(); j++)
+			if (next[c->boundary_from[j]] < 0) next[c->boundary_from[j]] = c->boundary_to[j];
+		std::vector<char> seen(nv, 0);
+		for (size_t j = 0; j < c->boundary_from.size(); j++)
+		{
+			int start = c->boundary_from[j];
+			if (seen[start]) continue;
+			std::vector<int> loop;
+			for (int v = start; v >= 0 && !seen[v]; v = next[v])
+			{
+				seen[v] = 1;
+				loop.push_back(v);
+			}
+			if (loop.size() > c->pinned.size()) c->pinned.swap(loop);
+		}
+	}
+	else
+	{
+		// two boundary vertices far apart
+		int a = c->boundary_from[0], b = a;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			double best = -1;
+			int from = b;
+			for (size_t j = 0; j < c->boundary_from.size(); j++)
+			{
+				int v = c->boundary_from[j];
+				double d = (V.row(v) - V.row(from)).squaredNorm();
+				if (d > best)
+				{
+					best = d;
+					b = v;
+				}
+			}
+			if (pass == 0) a = b;
+		}
+		c->pinned.push_back(a);
+		c->pinned.push_back(b);
+	}
+
+	// vertices of no face stay at the origin, like the pinned ones
+	c->unknown.assign(nv, 0);
+	for (int i = 0; i < nv; i++)
+		if (!used[i]) c->unknown[i] = -1;
+	for (size_t j = 0; j < c->pinned.size(); j++)
+		c->unknown[c->pinned[j]] = -1;
+	std::vector<int> ids;
+	for (int i = 0; i < nv; i++)
+		if (c->unknown[i] >= 0) ids.push_back(i);
+	c->free_count = (int)ids.size();
+
+	// number the unknowns in nested dissection order
+	std::vector<int> start(nv + 1, 0), adjacent(2 * size_t(ne));
+	for (int e = 0; e < ne; e++)
+	{
+		start[c->edge_a[e] + 1]++;
+		start[c->edge_b[e] + 1]++;
+	}
+	for (int i = 0; i < nv; i++)
+		start[i + 1] += start[i];
+	std::vector<int> fill(start.begin(), start.end() - 1);
+	for (int e = 0; e < ne; e++)
+	{
+		adjacent[fill[c->edge_a[e]]++] = c->edge_b[e];
+		adjacent[fill[c->edge_b[e]]++] = c->edge_a[e];
+	}
+	std::vector<char> upper(nv, 0);
+	std::vector<int> order;
+	order.reserve(ids.size());
+	if (!ids.empty())
+		dissect(V, start, adjacent, &ids[0], (int)ids.size(), upper, order);
+	for (size_t j = 0; j < order.size(); j++)
+		c->unknown[order[j]] = (int)j;
+
+	cache_ = c;
+	return true;
+}
+
+bool Parameterizer::compute(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, ParamMethod method, Eigen::MatrixXd& UV)
+{
+	iterations_ = 0;
+	factored_ = false;
+
+	bool same = cache_ && cache_->method == method && cache_->nv == V.rows() &&
+		cache_->F.rows() == F.rows() && cache_->F == F;
+	if (!same && !setup(V, F, method)) return false;
+	Cache& c = *cache_;
+
+	int nv = V.rows(), nf = F.rows();
+	int ne = (int)c.edge_a.size();
+	int n = c.free_count;
+	bool lscm = method == PARAM_LSCM;
+
+	// positions of the pinned vertices
+	Eigen::MatrixXd P = Eigen::MatrixXd::Zero(nv, 2);
+	if (lscm)
+	{
+		int a = c.pinned[0], b = c.pinned[1];
+		P(b, 0) = (V.row(b) - V.row(a)).norm();
+	}
+	else
+	{
+		int m = (int)c.pinned.size();
+		std::vector<double> arc(m + 1, 0.0);
+		for (int j = 0; j < m; j++)
+			arc[j + 1] = arc[j] + (V.row(c.pinned[(j + 1) % m]) - V.row(c.pinned[j])).norm();
+		for (int j = 0; j < m; j++)
+		{
+			double t = 2 * M_PI * arc[j] / Max(arc[m], 1e-300);
+			P(c.pinned[j], 0) = cos(t);
+			P(c.pinned[j], 1) = sin(t);
+		}
+	}
+
+	// cotangent of the angle at each corner
+	std::vector<double> cot(3 * size_t(nf));
+	parallel_for(0, nf, [&](int b, int e) {
+		for (int f = b; f < e; f++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				Vec3d x = V.row(F(f, k)).transpose();
+				Vec3d d1 = V.row(F(f, (k + 1) % 3)).transpose() - x;
+				Vec3d d2 = V.row(F(f, (k + 2) % 3)).transpose() - x;
+				double twice_area = d1.cross(d2).norm();
+				cot[3 * size_t(f) + k] = twice_area > 0 ? d1.dot(d2) / twice_area : 0.0;
+			}
+		}
+	}, 1 << 14);
+
+	// Dirichlet energy per coordinate; LSCM subtracts the area of the map,
+	// half the sum of u_i v_j - u_j v_i over the boundary edges i -> j.
+	// Every edge and boundary edge writes its own triplets, so the pattern
+	// only depends on the topology.
+	if (n == 0)
+	{
+		// nothing to solve, e.g. a single triangle with a harmonic map
+		c.X = P;
+		Eigen::RowVector2d lo = P.colwise().minCoeff(), hi = P.colwise().maxCoeff();
+		UV = (P.rowwise() - lo) * (10.0 / Max(Max(hi(0) - lo(0), hi(1) - lo(1)), 1e-300));
+		return true;
+	}
+
+	// LSCM interleaves u and v, so both follow the vertex ordering
+	int unknowns = lscm ? 2 : 1;
+	int per_edge = lscm ? 8 : 4;
+	int boundary_edges = lscm ? (int)c.boundary_from.size() : 0;
+	c.triplets.assign(size_t(per_edge) * ne + 4 * size_t(boundary_edges), Triplet(0, 0, 0.0));
+	int columns = lscm ? 1 : 2;
+	Eigen::MatrixXd B = Eigen::MatrixXd::Zero(lscm ? 2 * n : n, columns);
+
+	// cotangent weight of each edge, and its triplets
+	std::vector<double> weight(ne);
+	parallel_for(0, ne, [&](int b, int e) {
+		for (int edge = b; edge < e; edge++)
+		{
+			double w = 0;
+			for (int j = c.edge_first[edge]; j < c.edge_first[edge + 1]; j++)
+				w += 0.5 * cot[c.edge_corner[j]];
+			weight[edge] = w;
+
+			int i = c.unknown[c.edge_a[edge]], k = c.unknown[c.edge_b[edge]];
+			for (int coord = 0; coord < (lscm ? 2 : 1); coord++)
+			{
+				Triplet* t = &c.triplets[size_t(per_edge) * edge + 4 * coord];
+				int si = unknowns * i + coord, sk = unknowns * k + coord;
+				if (i >= 0) t[0] = Triplet(si, si, w);
+				if (k >= 0) t[1] = Triplet(sk, sk, w);
+				if (i >= 0 && k >= 0)
+				{
+					t[2] = Triplet(si, sk, -w);
+					t[3] = Triplet(sk, si, -w);
+				}
+			}
+		}
+	}, 1 << 14);
+
+	for (int edge = 0; edge < ne; edge++)
+	{
+		int a = c.edge_a[edge], b = c.edge_b[edge];
+		int i = c.unknown[a], k = c.unknown[b];
+		if ((i >= 0) == (k >= 0)) continue;
+		int row = i >= 0 ? i : k, pin = i >= 0 ? b : a;
+		for (int coord = 0; coord < 2; coord++)
+		{
+			if (lscm) B(2 * row + coord, 0) += weight[edge] * P(pin, coord);
+			else B(row, coord) += weight[edge] * P(pin, coord);
+		}
+	}
+
+	if (lscm)
+	{
+		// -dArea: Q(u_i, v_j) = Q(v_j, u_i) = -1/2 and Q(u_j, v_i) = Q(v_i, u_j) = 1/2
+		size_t base = size_t(per_edge) * ne;
+		for (int j = 0; j < boundary_edges; j++)
+		{
+			int vi = c.boundary_from[j], vj = c.boundary_to[j];
+			int entries[4][5] = { { vi, 0, vj, 1, -1 }, { vj, 1, vi, 0, -1 }, { vj, 0, vi, 1, 1 }, { vi, 1, vj, 0, 1 } };
+			for (int q = 0; q < 4; q++)
+			{
+				int rv = entries[q][0], rc = entries[q][1], cv = entries[q][2], cc = entries[q][3];
+				double value = 0.5 * entries[q][4];
+				int r = c.unknown[rv], col = c.unknown[cv];
+				if (r < 0) continue;
+				if (col >= 0)
+					c.triplets[base + 4 * j + q] = Triplet(2 * r + rc, 2 * col + cc, value);
+				else
+					B(2 * r + rc, 0) -= value * P(cv, cc);
+			}
+		}
+	}
+
+	int size = lscm ? 2 * n : n;
+	c.A.resize(size, size);
+	c.A.setFromTriplets(c.triplets.begin(), c.triplets.end());
+
+	// warm start from the previous solution through the previous factorization
+	Eigen::MatrixXd X(size, columns);
+	bool solved = false;
+	if (c.factored && c.X.rows() == nv)
+	{
+		solved = true;
+		for (int i = 0; i < nv; i++)
+		{
+			int u = c.unknown[i];
+			if (u < 0) continue;
+			if (lscm)
+			{
+				X(2 * u, 0) = c.X(i, 0);
+				X(2 * u + 1, 0) = c.X(i, 1);
+			}
+			else
+				X.row(u) = c.X.row(i);
+		}
+		for (int col = 0; col < columns && solved; col++)
+		{
+			Eigen::VectorXd x = X.col(col);
+			int k = preconditioned_cg(c.A, c.solver, B.col(col), x, 30, 1e-10);
+			solved = k >= 0;
+			iterations_ += Max(k, 0);
+			X.col(col) = x;
+		}
+	}
+
+	if (!solved)
+	{
+		if (!c.analyzed)
+		{
+			c.solver.analyzePattern(c.A);
+			c.analyzed = true;
+		}
+		c.solver.factorize(c.A);
+		if (c.solver.info() != Eigen::Success)
+		{
+			std::cerr << "ERROR (Parameterizer): The system could not be factored." << std::endl;
+			c.factored = false;
+			return false;
+		}
+		c.factored = factored_ = true;
+		iterations_ = 0;
+		X = c.solver.solve(B);
+	}
+
+	// back to the vertices
+	c.X = P;
+	for (int i = 0; i < nv; i++)
+	{
+		int u = c.unknown[i];
+		if (u < 0) continue;
+		if (lscm)
+		{
+			c.X(i, 0) = X(2 * u, 0);
+			c.X(i, 1) = X(2 * u + 1, 0);
+		}
+		else
+			c.X.row(i) = X.row(u);
+	}
+
+	// like the grid coordinates: the longer side spans [0, 10]
+	Eigen::RowVector2d lo = c.X.colwise().minCoeff(), hi = c.X.colwise().maxCoeff();
+	double extent = Max(hi(0) - lo(0), hi(1) - lo(1));
+	UV = (c.X.rowwise() - lo) * (10.0 / Max(extent, 1e-300));
+	return true;
+}
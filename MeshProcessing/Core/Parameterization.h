@@ -0,0 +1,43 @@
+#pragma once
+#include "stdafx.h"
+
+typedef enum { PARAM_HARMONIC = 0, PARAM_LSCM, PARAM_COUNT } ParamMethod;
+
+// Parameterization of a mesh patch: one connected part with a boundary.
+//  - harmonic: cotangent weights, the longest boundary loop pinned on the
+//    unit circle by arc length, other boundaries free
+//  - LSCM: least squares conformal maps, two far apart boundary vertices pinned
+// The topology and the symbolic factorization are kept until the faces or
+// the method change. After an edit of V, the previous factorization
+// preconditions CG from the previous solution, and the system is only
+// factored again when that does not converge quickly.
+// The unknowns are ordered by a nested dissection of the vertex positions,
+// which keeps the fill of the factor low. Assembly runs on all cores.
+class Parameterizer
+{
+public:
+	Parameterizer();
+	~Parameterizer();
+
+	// UV is #V x 2, scaled to fit [0, 10] like the default grid texture
+	// coordinates; returns false, leaving UV alone, if the mesh is not a patch
+	bool compute(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, ParamMethod method, Eigen::MatrixXd& UV);
+	void clear();
+
+	// CG iterations of the last compute, 0 if it was solved directly
+	int iterations() const { return iterations_; }
+	// the last compute factored the system
+	bool factored() const { return factored_; }
+
+private:
+	Parameterizer(const Parameterizer&);
+	Parameterizer& operator=(const Parameterizer&);
+
+	struct Cache;
+	bool setup(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, ParamMethod method);
+
+private:
+	Cache* cache_;
+	int iterations_;
+	bool factored_;
+};
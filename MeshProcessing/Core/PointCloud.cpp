@@ -0,0 +1,385 @@
+#include "stdafx.h"
+#include "PointCloud.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <mutex>
+#include <queue>
+
+namespace
+{
+	typedef std::pair<uint64_t, int> KeyedPoint;
+
+	// bounded max-heap on dist2 kept in the output arrays
+	void heap_push(int* idx, double* dist2, int& size, int k, int i, double d)
+	{
+		int pos;
+		if (size < k)
+		{
+			pos = size++;
+			while (pos > 0 && dist2[(pos - 1) / 2] < d)
+			{
+				dist2[pos] = dist2[(pos - 1) / 2];
+				idx[pos] = idx[(pos - 1) / 2];
+				pos = (pos - 1) / 2;
+			}
+		}
+		else
+		{
+			if (d >= dist2[0]) return;
+			pos = 0;
+			for (;;)
+			{
+				int child = 2 * pos + 1;
+				if (child >= size) break;
+				if (child + 1 < size && dist2[child + 1] > dist2[child]) child++;
+				if (dist2[child] <= d) break;
+				dist2[pos] = dist2[child];
+				idx[pos] = idx[child];
+				pos = child;
+			}
+		}
+		dist2[pos] = d;
+		idx[pos] = i;
+	}
+}
+
+// -----------
+PointGrid::PointGrid()
+: V_(NULL), cell_(1.0)
+{
+	dims_[0] = dims_[1] = dims_[2] = 0;
+}
+
+void PointGrid::clear()
+{
+	V_ = NULL;
+	keys_.clear();
+	start_.clear();
+	order_.clear();
+}
+
+void PointGrid::build(const Eigen::MatrixXd& V, double cell, int k)
+{
+	clear();
+	int n = V.rows();
+	if (n == 0) return;
+	V_ = &V;
+
+	origin_ = V.colwise().minCoeff().transpose();
+	Vec3d extent = V.colwise().maxCoeff().transpose() - origin_;
+	if (cell <= 0)
+		cell = extent.norm() * sqrt(double(Max(k, 1)) / n);
+
+	// 21 bits per axis in the keys
+	cell = Max(cell, extent.maxCoeff() / ((1 << 21) - 2));
+	cell_ = cell > 0 ? cell : 1.0;
+	for (int a = 0; a < 3; a++)
+		dims_[a] = int(extent[a] / cell_) + 1;
+
+	std::vector<KeyedPoint> items(n);
+	parallel_for(0, n, [&](int b, int e) {
+		for (int i = b; i < e; i++)
+		{
+			double p[3] = { V(i, 0), V(i, 1), V(i, 2) };
+			int x, y, z;
+			coords(p, x, y, z);
+			items[i] = KeyedPoint(key(x, y, z), i);
+		}
+	}, 1 << 16);
+	parallel_sort(items);
+
+	order_.resize(n);
+	for (int j = 0; j < n; j++)
+	{
+		order_[j] = items[j].second;
+		if (j == 0 || items[j].first != items[j - 1].first)
+		{
+			keys_.push_back(items[j].first);
+			start_.push_back(j);
+		}
+	}
+	start_.push_back(n);
+}
+
+uint64_t PointGrid::key(int x, int y, int z) const
+{
+	return (uint64_t(x) << 42) | (uint64_t(y) << 21) | uint64_t(z);
+}
+
+void PointGrid::coords(const double* p, int& x, int& y, int& z) const
+{
+	int c[3];
+	for (int a = 0; a < 3; a++)
+		c[a] = Max(0, Min(int((p[a] - origin_[a]) / cell_), dims_[a] - 1));
+	x = c[0]; y = c[1]; z = c[2];
+}
+
+int PointGrid::find(int x, int y, int z) const
+{
+	if (x < 0 || y < 0 || z < 0 || x >= dims_[0] || y >= dims_[1] || z >= dims_[2]) return -1;
+	uint64_t k = key(x, y, z);
+	std::vector<uint64_t>::const_iterator it = std::lower_bound(keys_.begin(), keys_.end(), k);
+	return it != keys_.end() && *it == k ? int(it - keys_.begin()) : -1;
+}
+
+int PointGrid::neighbor_cells(int c, int* out) const
+{
+	const uint64_t mask = (1 << 21) - 1;
+	int x = int(keys_[c] >> 42), y = int((keys_[c] >> 21) & mask), z = int(keys_[c] & mask);
+	int n = 0;
+	for (int dx = -1; dx <= 1; dx++)
+		for (int dy = -1; dy <= 1; dy++)
+			for (int dz = -1; dz <= 1; dz++)
+			{
+				int nb = find(x + dx, y + dy, z + dz);
+				if (nb >= 0) out[n++] = nb;
+			}
+	return n;
+}
+
+int PointGrid::knn(const double* p, int k, int* idx, double* dist2, double max_dist2) const
+{
+	if (keys_.empty() || k <= 0) return 0;
+	const Eigen::MatrixXd& V = *V_;
+
+	// nothing in reach if the grid itself is not
+	double out2 = 0;
+	for (int a = 0; a < 3; a++)
+	{
+		double t = Max(origin_[a] - p[a], p[a] - (origin_[a] + dims_[a] * cell_));
+		if (t > 0) out2 += t * t;
+	}
+	if (out2 > max_dist2) return 0;
+
+	int c[3];
+	coords(p, c[0], c[1], c[2]);
+
+	int found = 0;
+	int max_r = Max(dims_[0], Max(dims_[1], dims_[2]));
+	for (int r = 0; r <= max_r; r++)
+	{
+		// the shell of cells at distance r, within the grid
+		int lo[3], hi[3];
+		for (int a = 0; a < 3; a++)
+		{
+			lo[a] = Max(c[a] - r, 0) - c[a];
+			hi[a] = Min(c[a] + r, dims_[a] - 1) - c[a];
+		}
+		for (int dx = lo[0]; dx <= hi[0]; dx++)
+		{
+			for (int dy = lo[1]; dy <= hi[1]; dy++)
+			{
+				bool side = dx == -r || dx == r || dy == -r || dy == r;
+				for (int dz = lo[2]; dz <= hi[2]; dz++)
+				{
+					if (!side && dz != -r && dz != r)
+					{
+						// skip the inside of the shell
+						if (dz < r) dz = r - 1;
+						continue;
+					}
+					int cell = find(c[0] + dx, c[1] + dy, c[2] + dz);
+					if (cell < 0) continue;
+					for (int j = start_[cell]; j < start_[cell + 1]; j++)
+					{
+						int i = order_[j];
+						double d = 0;
+						for (int a = 0; a < 3; a++)
+						{
+							double t = V(i, a) - p[a];
+							d += t * t;
+						}
+						if (d <= max_dist2) heap_push(idx, dist2, found, k, i, d);
+					}
+				}
+			}
+		}
+
+		// the cells of the next shells are at least r cells away
+		double gap = r * cell_;
+		if (gap * gap >= max_dist2) break;
+
+		// done when nothing outside the searched block can be closer; a side
+		// of the block at the border of the grid has nothing beyond it
+		double reach = 1e300;
+		for (int a = 0; a < 3; a++)
+		{
+			if (c[a] - r > 0)
+				reach = Min(reach, p[a] - (origin_[a] + (c[a] - r) * cell_));
+			if (c[a] + r + 1 < dims_[a])
+				reach = Min(reach, origin_[a] + (c[a] + r + 1) * cell_ - p[a]);
+		}
+		if (reach == 1e300) break;
+		if (found == k && dist2[0] <= reach * reach) break;
+	}
+
+	// closest first
+	for (int a = 1; a < found; a++)
+	{
+		double d = dist2[a];
+		int i = idx[a], b = a;
+		for (; b > 0 && dist2[b - 1] > d; b--)
+		{
+			dist2[b] = dist2[b - 1];
+			idx[b] = idx[b - 1];
+		}
+		dist2[b] = d;
+		idx[b] = i;
+	}
+	return found;
+}
+
+// -----------
+double estimate_normals(const Eigen::MatrixXd& V, int k, Eigen::MatrixXd& N)
+{
+	PointGrid grid;
+	grid.build(V, 0, k);
+	return estimate_normals(V, grid, k, N);
+}
+
+double estimate_normals(const Eigen::MatrixXd& V, const PointGrid& grid, int k, Eigen::MatrixXd& N)
+{
+	int n = V.rows();
+	N.setZero(n, 3);
+	if (n == 0 || grid.cells() == 0) return 0;
+	k = Max(Min(k, n), 1);
+
+	const std::vector<int>& order = grid.order();
+
+	// PCA normals, one batch per cell: the candidates of the cell and its
+	// neighbors are gathered once for all its points
+	int nc = grid.cells();
+	std::mutex mutex;
+	double spacing = 0;
+	int spaced = 0;
+	parallel_for(0, nc, [&](int b, int e) {
+		std::vector<int> idx(k), candidates;
+		std::vector<double> d2(k), xyz;
+		int nbs[27];
+		double sum = 0;
+		int count = 0;
+		for (int c = b; c < e; c++)
+		{
+			candidates.clear();
+			xyz.clear();
+			int m = grid.neighbor_cells(c, nbs);
+			for (int l = 0; l < m; l++)
+			{
+				for (int j = grid.cell_begin(nbs[l]); j < grid.cell_begin(nbs[l] + 1); j++)
+				{
+					int i = order[j];
+					candidates.push_back(i);
+					xyz.push_back(V(i, 0));
+					xyz.push_back(V(i, 1));
+					xyz.push_back(V(i, 2));
+				}
+			}
+
+			for (int j = grid.cell_begin(c); j < grid.cell_begin(c + 1); j++)
+			{
+				int i = order[j];
+				double p[3] = { V(i, 0), V(i, 1), V(i, 2) };
+				int found = 0;
+				for (size_t l = 0; l < candidates.size(); l++)
+				{
+					double dx = xyz[3 * l] - p[0], dy = xyz[3 * l + 1] - p[1], dz = xyz[3 * l + 2] - p[2];
+					heap_push(&idx[0], &d2[0], found, k, candidates[l], dx * dx + dy * dy + dz * dz);
+				}
+
+				// points farther than a cell may be missing from the block
+				if (found < k || d2[0] > grid.cell_size() * grid.cell_size())
+					found = grid.knn(p, k, &idx[0], &d2[0]);
+
+				// the nearest neighbor other than the point itself
+				if (found > 1)
+				{
+					double nearest = 1e300;
+					for (int l = 0; l < found; l++)
+						if (idx[l] != i) nearest = Min(nearest, d2[l]);
+					sum += sqrt(nearest);
+					count++;
+				}
+
+				Vec3d mean(0, 0, 0);
+				for (int l = 0; l < found; l++) mean += V.row(idx[l]).transpose();
+				mean /= Max(found, 1);
+				Eigen::Matrix3d cov = Eigen::Matrix3d::Zero();
+				for (int l = 0; l < found; l++)
+				{
+					Vec3d q = V.row(idx[l]).transpose() - mean;
+					cov += q * q.transpose();
+				}
+				Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> es;
+				es.computeDirect(cov);
+				N.row(i) = es.eigenvectors().col(0).transpose();
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		spacing += sum;
+		spaced += count;
+	}, 64);
+
+	// one normal per cell: its point normals aligned with the first one, averaged
+	Eigen::MatrixXd CN(nc, 3);
+	std::vector<double> top(nc);
+	parallel_for(0, nc, [&](int b, int e) {
+		for (int c = b; c < e; c++)
+		{
+			Vec3d first = N.row(order[grid.cell_begin(c)]).transpose();
+			Vec3d sum(0, 0, 0);
+			top[c] = -1e300;
+			for (int j = grid.cell_begin(c); j < grid.cell_begin(c + 1); j++)
+			{
+				Vec3d q = N.row(order[j]).transpose();
+				sum += q.dot(first) < 0 ? -q : q;
+				top[c] = Max(top[c], V(order[j], 2));
+			}
+			double len = sum.norm();
+			CN.row(c) = (len > 0 ? Vec3d(sum / len) : first).transpose();
+		}
+	}, 1024);
+
+	// orient the cells along a maximum |n_a . n_b| spanning tree, growing
+	// from the highest cell of each connected part
+	std::vector<int> seeds(nc);
+	for (int c = 0; c < nc; c++) seeds[c] = c;
+	std::sort(seeds.begin(), seeds.end(), [&](int a, int b) { return top[a] > top[b]; });
+
+	typedef std::pair<double, std::pair<int, int> > Edge;   // |dot|, cell, parent
+	std::vector<char> oriented(nc, 0);
+	std::priority_queue<Edge> queue;
+	int nbs[27];
+	for (int s = 0; s < nc; s++)
+	{
+		int seed = seeds[s];
+		if (oriented[seed]) continue;
+		if (CN(seed, 2) < 0) CN.row(seed) *= -1;
+		queue.push(Edge(1.0, std::make_pair(seed, seed)));
+
+		while (!queue.empty())
+		{
+			int c = queue.top().second.first, parent = queue.top().second.second;
+			queue.pop();
+			if (oriented[c]) continue;
+			if (CN.row(c).dot(CN.row(parent)) < 0) CN.row(c) *= -1;
+			oriented[c] = 1;
+
+			int m = grid.neighbor_cells(c, nbs);
+			for (int l = 0; l < m; l++)
+			{
+				if (!oriented[nbs[l]])
+					queue.push(Edge(fabs(CN.row(c).dot(CN.row(nbs[l]))), std::make_pair(nbs[l], c)));
+			}
+		}
+	}
+
+	// points follow their cell
+	parallel_for(0, nc, [&](int b, int e) {
+		for (int c = b; c < e; c++)
+			for (int j = grid.cell_begin(c); j < grid.cell_begin(c + 1); j++)
+				if (N.row(order[j]).dot(CN.row(c)) < 0) N.row(order[j]) *= -1;
+	}, 1024);
+
+	return spaced > 0 ? spacing / spaced : 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "stdafx.h"
+#include <cstdint>
+#include <vector>
+
+// Uniform grid over a point set for k nearest neighbor queries.
+// Unlike the ANN kd-tree, queries can run from several threads at once.
+// The points are sorted by cell, so the points of a cell, and the queries
+// of consecutive sorted points, share the cache.
+class PointGrid
+{
+public:
+	PointGrid();
+
+	// cell <= 0 picks a size holding about k points on a surface
+	void build(const Eigen::MatrixXd& V, double cell = 0, int k = 8);
+	void clear();
+
+	// k nearest points of p within sqrt(max_dist2), closest first; returns
+	// how many were found. A bound keeps queries far from the points cheap.
+	int knn(const double* p, int k, int* idx, double* dist2, double max_dist2 = 1e300) const;
+
+	// points sorted by cell; the points of cell c are order()[cell_begin(c) .. cell_begin(c + 1))
+	const std::vector<int>& order() const { return order_; }
+	int cells() const { return (int)keys_.size(); }
+	double cell_size() const { return cell_; }
+	int cell_begin(int c) const { return start_[c]; }
+
+	// cell c and its 26 neighbors that hold points
+	int neighbor_cells(int c, int* out) const;
+
+	size_t bytes() const
+	{
+		return keys_.capacity() * sizeof(uint64_t) + (start_.capacity() + order_.capacity()) * sizeof(int);
+	}
+
+private:
+	uint64_t key(int x, int y, int z) const;
+	int find(int x, int y, int z) const;
+	void coords(const double* p, int& x, int& y, int& z) const;
+
+private:
+	const Eigen::MatrixXd* V_;
+	Vec3d origin_;
+	double cell_;
+	int dims_[3];
+	std::vector<uint64_t> keys_;   // sorted keys of the occupied cells
+	std::vector<int> start_;       // first point of each cell in order_, plus the end
+	std::vector<int> order_;
+};
+
+// Unit normals of a point cloud by PCA over the k nearest neighbors,
+// computed on all cores. Normals are oriented consistently by propagating
+// over a minimum spanning tree of the grid cells, starting from the top of
+// each connected part, where the normal points up.
+// Returns the point spacing: the mean distance to the nearest neighbor.
+double estimate_normals(const Eigen::MatrixXd& V, int k, Eigen::MatrixXd& N);
+// same, reusing a grid built over V
+double estimate_normals(const Eigen::MatrixXd& V, const PointGrid& grid, int k, Eigen::MatrixXd& N);
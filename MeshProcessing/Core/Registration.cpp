@@ -0,0 +1,252 @@
+#include "stdafx.h"
+#include "Registration.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// the normal equations of the point to plane step, upper triangle only
+	struct IcpSums
+	{
+		double A[6][6];
+		double b[6];
+		double sse;        // squared point to plane distances
+		double radius2;    // largest squared distance of a kept sample to the center
+		int pairs, rejected;
+
+		IcpSums() : sse(0), radius2(0), pairs(0), rejected(0)
+		{
+			for (int r = 0; r < 6; r++)
+			{
+				b[r] = 0;
+				for (int c = 0; c < 6; c++) A[r][c] = 0;
+			}
+		}
+
+		IcpSums& operator+=(const IcpSums& o)
+		{
+			for (int r = 0; r < 6; r++)
+			{
+				b[r] += o.b[r];
+				for (int c = r; c < 6; c++) A[r][c] += o.A[r][c];
+			}
+			sse += o.sse;
+			radius2 = Max(radius2, o.radius2);
+			pairs += o.pairs;
+			rejected += o.rejected;
+			return *this;
+		}
+	};
+}
+
+RigidTransform RigidTransform::then(const RigidTransform& next) const
+{
+	RigidTransform T;
+	T.R = next.R * R;
+	T.t = next.R * t + next.t;
+	return T;
+}
+
+void RigidTransform::apply(Eigen::MatrixXd& V, bool rotate) const
+{
+	const RigidTransform& T = *this;
+	parallel_for(0, V.rows(), [&](int b, int e) {
+		for (int i = b; i < e; i++)
+		{
+			Vec3d x = T.R * Vec3d(V.row(i).transpose());
+			if (!rotate) x += T.t;
+			V.row(i) = x.transpose();
+		}
+	}, 1 << 14);
+}
+
+IcpRegistration::IcpRegistration()
+: size_(0), iteration_(0), done_(true), search2_(0)
+{
+}
+
+void IcpRegistration::set_reference(const Eigen::MatrixXd& RV, const Eigen::MatrixXd& RN)
+{
+	RV_ = RV;
+	RN_ = RN;
+	grid_.build(RV_);
+	size_ = RV_.rows() ? (RV_.colwise().maxCoeff() - RV_.colwise().minCoeff()).norm() : 0.0;
+	done_ = true;
+
+	// the coarse level: a vertex of every cell of a grid holding about 64
+	// vertices per cell
+	coarse_grid_.clear();
+	PointGrid cells;
+	cells.build(RV_, 0, 64);
+	int nc = cells.cells();
+	CV_.resize(nc, 3);
+	CN_.resize(RN_.rows() == RV_.rows() ? nc : 0, 3);
+	for (int c = 0; c < nc; c++)
+	{
+		int v = cells.order()[cells.cell_begin(c)];
+		CV_.row(c) = RV_.row(v);
+		if (CN_.rows()) CN_.row(c) = RN_.row(v);
+	}
+	coarse_grid_.build(CV_);
+}
+
+void IcpRegistration::start(const Eigen::MatrixXd& V, const Eigen::MatrixXd& N, const IcpOptions& options)
+{
+	options_ = options;
+	transform_ = RigidTransform();
+	iteration_ = 0;
+
+	// every (n / m)-th vertex, from the middle of each stride
+	int n = V.rows(), m = Min(Max(options.samples, 1), n);
+	bool normals = N.rows() == n;
+	P_.resize(m, 3);
+	N_.resize(normals ? m : 0, 3);
+	for (int i = 0; i < m; i++)
+	{
+		int v = int((i + 0.5) * n / m);
+		P_.row(i) = V.row(v);
+		if (normals) N_.row(i) = N.row(v);
+	}
+	match_.assign(m, -1);
+	dist2_.assign(m, 0.0);
+	search2_ = options.max_distance * size_;
+	search2_ *= search2_;
+	done_ = m == 0 || RV_.rows() == 0 || RN_.rows() != RV_.rows();
+}
+
+bool IcpRegistration::step(IcpIteration& out)
+{
+	if (done_) return false;
+	const RigidTransform T = transform_;
+	auto moved = [&](int i) { return Vec3d(T.R * Vec3d(P_.row(i).transpose()) + T.t); };
+
+	// coarse to fine: the first iterations, far from the reference where
+	// the searches are long, use every 16th, 8th, ... sample and match them
+	// to the coarse level of the reference
+	int stride = iteration_ < 4 ? 16 >> iteration_ : 1;
+	int m = (P_.rows() + stride - 1) / stride;
+	bool coarse = stride > 1;
+	const PointGrid& grid = coarse ? coarse_grid_ : grid_;
+	const Eigen::MatrixXd& RV = coarse ? CV_ : RV_;
+	const Eigen::MatrixXd& RN = coarse ? CN_ : RN_;
+
+	// nearest reference vertex of the samples
+	TaskGroup group("icp");
+	parallel_for(group, 0, m, [&](int b, int e) {
+		for (int k = b; k < e; k++)
+		{
+			int i = k * stride;
+			Vec3d x = moved(i);
+			int j;
+			double d2;
+			if (grid.knn(x.data(), 1, &j, &d2, search2_) == 1)
+			{
+				match_[i] = j;
+				dist2_[i] = d2;
+			}
+			else
+				match_[i] = -1;
+		}
+	}, 1024);
+
+	// outliers: beyond reject times the median distance
+	std::vector<double> d2;
+	d2.reserve(m);
+	for (int k = 0; k < m; k++)
+		if (match_[k * stride] >= 0) d2.push_back(dist2_[k * stride]);
+	if (d2.empty())
+	{
+		done_ = true;
+		return false;
+	}
+	std::nth_element(d2.begin(), d2.begin() + d2.size() / 2, d2.end());
+	double max_d2 = options_.reject * options_.reject * d2[d2.size() / 2];
+	double cell = grid.cell_size();
+	search2_ = Min(search2_, Max(4 * max_d2, cell * cell));
+	double min_cos = cos(options_.max_angle * M_PI / 180.0);
+	bool normals = N_.rows() == P_.rows();
+
+	// rotations about the center of the samples keep the system well
+	// conditioned far from the origin
+	Vec3d center = T.R * Vec3d(P_.colwise().mean().transpose()) + T.t;
+
+	IcpSums S = parallel_reduce(0, m, IcpSums(), [&](int b, int e) {
+		IcpSums s;
+		for (int k = b; k < e; k++)
+		{
+			int i = k * stride, j = match_[i];
+			if (j < 0) continue;
+			Vec3d n = RN.row(j).transpose();
+			bool keep = dist2_[i] <= max_d2 && n.squaredNorm() > 0;
+			if (keep && normals)
+			{
+				double c = (T.R * Vec3d(N_.row(i).transpose())).dot(n);
+				keep = (options_.oriented ? c : fabs(c)) >= min_cos;
+			}
+			if (!keep)
+			{
+				s.rejected++;
+				continue;
+			}
+
+			Vec3d x = moved(i), p = x - center;
+			double r = (x - Vec3d(RV.row(j).transpose())).dot(n);
+			Vec3d pn = p.cross(n);
+			double a[6] = { pn[0], pn[1], pn[2], n[0], n[1], n[2] };
+			for (int u = 0; u < 6; u++)
+			{
+				s.b[u] -= a[u] * r;
+				for (int v = u; v < 6; v++) s.A[u][v] += a[u] * a[v];
+			}
+			s.sse += r * r;
+			s.radius2 = Max(s.radius2, p.squaredNorm());
+			s.pairs++;
+		}
+		return s;
+	}, [](IcpSums a, const IcpSums& b) { return a += b; }, 4096);
+
+	out.iteration = iteration_ + 1;
+	out.pairs = S.pairs;
+	out.rejected = S.rejected + (m - (int)d2.size());
+	out.rms = S.pairs ? sqrt(S.sse / S.pairs) : 0.0;
+	out.motion = 0;
+	out.converged = false;
+	out.transform = transform_;
+	if (S.pairs < 6)
+	{
+		done_ = true;
+		return false;
+	}
+
+	// x = (rotation vector, translation) of the linearized step
+	Eigen::Matrix<double, 6, 6> A;
+	Eigen::Matrix<double, 6, 1> rhs;
+	for (int u = 0; u < 6; u++)
+	{
+		rhs[u] = S.b[u];
+		for (int v = u; v < 6; v++) A(u, v) = A(v, u) = S.A[u][v];
+	}
+	Eigen::Matrix<double, 6, 1> x = A.ldlt().solve(rhs);
+	if (!x.allFinite())
+	{
+		done_ = true;
+		return false;
+	}
+
+	Vec3d w = x.head<3>(), t = x.tail<3>();
+	double angle = w.norm();
+	RigidTransform delta;
+	if (angle > 0)
+		delta.R = Eigen::AngleAxisd(angle, w / angle).toRotationMatrix();
+	delta.t = center - delta.R * center + t;
+	transform_ = transform_.then(delta);
+	iteration_++;
+
+	// only the full set of samples can tell convergence
+	out.motion = angle * sqrt(S.radius2) + t.norm();
+	out.converged = stride == 1 && out.motion <= options_.tolerance * size_;
+	out.transform = transform_;
+	done_ = out.converged || iteration_ >= options_.max_iterations;
+	return true;
+}
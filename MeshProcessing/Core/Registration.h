@@ -0,0 +1,92 @@
+#pragma once
+#include "stdafx.h"
+#include "PointCloud.h"
+#include <vector>
+
+// Rigid motion x -> R x + t
+struct RigidTransform
+{
+	Eigen::Matrix3d R;
+	Vec3d t;
+
+	RigidTransform() : R(Eigen::Matrix3d::Identity()), t(0, 0, 0) {}
+
+	// this motion followed by next
+	RigidTransform then(const RigidTransform& next) const;
+	// the rows of V moved, on all cores; with rotate, they are directions
+	// (normals) and only turn
+	void apply(Eigen::MatrixXd& V, bool rotate = false) const;
+};
+
+struct IcpOptions
+{
+	int max_iterations;
+	int samples;           // vertices of the mesh matched per iteration
+	double max_distance;   // farthest match at the start, relative to the reference size
+	double reject;         // pairs farther than reject times the median distance are dropped
+	double max_angle;      // and pairs whose normals differ by more, in degrees
+	bool oriented;         // false when either side has normals of arbitrary sign
+	double tolerance;      // converged once no sample moves more, relative to the reference size
+
+	IcpOptions() : max_iterations(50), samples(100000), max_distance(0.1), reject(3.0), max_angle(60.0),
+		oriented(true), tolerance(1e-5) {}
+};
+
+struct IcpIteration
+{
+	int iteration;         // from 1
+	int pairs;             // pairs kept
+	int rejected;          // pairs dropped as outliers
+	double rms;            // point to plane RMS distance of the kept pairs, before the step
+	double motion;         // largest sample motion of the step
+	bool converged;
+	RigidTransform transform;   // from the start, this step included
+};
+
+// Point to plane ICP of a mesh onto a reference. The reference vertices,
+// with their normals, go into a PointGrid; each iteration matches a fixed,
+// evenly strided subset of the mesh vertices to their nearest reference
+// vertex on all cores, drops the pairs beyond reject times the median
+// distance or whose normals disagree, and solves the linearized 6x6 system
+// for the step that minimizes the squared distances to the tangent planes.
+// The first iterations match a sparser subset to a coarse level of the
+// reference, one vertex per cell of about 64, where the long searches of a
+// rough start are cheap. The search stops at max_distance, then at twice
+// the rejection distance of the last iteration.
+// The mesh itself is not changed; see transform().
+class IcpRegistration
+{
+public:
+	IcpRegistration();
+
+	// the reference and its unit normals, one per vertex
+	void set_reference(const Eigen::MatrixXd& RV, const Eigen::MatrixXd& RN);
+	// match V, with its unit normals N (empty if it has none), starting from
+	// the identity
+	void start(const Eigen::MatrixXd& V, const Eigen::MatrixXd& N, const IcpOptions& options);
+
+	// one iteration, out.converged on the one that converges; false if no
+	// step was made: already converged or past the last iteration, or too
+	// few pairs left to solve
+	bool step(IcpIteration& out);
+
+	const RigidTransform& transform() const { return transform_; }
+	int iterations() const { return iteration_; }
+
+private:
+	Eigen::MatrixXd RV_, RN_;
+	PointGrid grid_;       // over RV_
+	Eigen::MatrixXd CV_, CN_;  // the coarse level, about a 64th of the vertices
+	PointGrid coarse_grid_;
+	double size_;          // bounding box diagonal of the reference
+
+	IcpOptions options_;
+	Eigen::MatrixXd P_, N_;    // the samples, as first given
+	RigidTransform transform_;
+	int iteration_;
+	bool done_;
+
+	double search2_;               // squared search radius
+	std::vector<int> match_;       // reference vertex of each sample, -1 if none
+	std::vector<double> dist2_;
+};
@@ -0,0 +1,379 @@
+#include "stdafx.h"
+#include "Sculpt.h"
+#include "MeshData.h"
+#include "Parallel.h"
+#include <cmath>
+
+namespace
+{
+	// cell coordinates are offset to stay positive, 21 bits each
+	const int kOffset = 1 << 20;
+	const int kMaxCoord = (1 << 21) - 1;
+
+	// smooth falloff, 1 at the center and 0 with a flat tangent at the radius
+	double falloff(double d, double radius)
+	{
+		double t = d / radius;
+		if (t >= 1) return 0;
+		double s = 1 - t * t;
+		return s * s;
+	}
+
+	Vec3d face_cross(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, int f)
+	{
+		Vec3d a = V.row(F(f, 0)).transpose();
+		Vec3d b = V.row(F(f, 1)).transpose();
+		Vec3d c = V.row(F(f, 2)).transpose();
+		return (b - a).cross(c - a);
+	}
+}
+
+// -----------
+RadiusGrid::RadiusGrid()
+: origin_(0, 0, 0), cell_(1)
+{
+}
+
+void RadiusGrid::clear()
+{
+	cells_.clear();
+	cell_key_.clear();
+	slot_.clear();
+}
+
+uint64_t RadiusGrid::key(int x, int y, int z) const
+{
+	x = Min(Max(x + kOffset, 0), kMaxCoord);
+	y = Min(Max(y + kOffset, 0), kMaxCoord);
+	z = Min(Max(z + kOffset, 0), kMaxCoord);
+	return (uint64_t(x) << 42) | (uint64_t(y) << 21) | uint64_t(z);
+}
+
+uint64_t RadiusGrid::key(const double* p) const
+{
+	return key(int(floor((p[0] - origin_[0]) / cell_)), int(floor((p[1] - origin_[1]) / cell_)),
+		int(floor((p[2] - origin_[2]) / cell_)));
+}
+
+void RadiusGrid::insert(int i, uint64_t k)
+{
+	std::vector<int>& points = cells_[k];
+	slot_[i] = (int)points.size();
+	points.push_back(i);
+	cell_key_[i] = k;
+}
+
+void RadiusGrid::build(const Eigen::MatrixXd& V, double cell)
+{
+	clear();
+	int n = V.rows();
+	if (n == 0) return;
+
+	origin_ = V.colwise().minCoeff().transpose();
+	cell_ = Max(cell, 1e-12);
+	cell_key_.resize(n);
+	slot_.resize(n);
+	cells_.reserve(n / 4 + 1);
+	for (int i = 0; i < n; i++)
+	{
+		double p[3] = { V(i, 0), V(i, 1), V(i, 2) };
+		insert(i, key(p));
+	}
+}
+
+void RadiusGrid::move(const Eigen::MatrixXd& V, int i)
+{
+	double p[3] = { V(i, 0), V(i, 1), V(i, 2) };
+	uint64_t k = key(p);
+	if (k == cell_key_[i]) return;
+
+	// the last point of the old cell takes the free slot
+	std::vector<int>& points = cells_[cell_key_[i]];
+	int last = points.back();
+	points[slot_[i]] = last;
+	slot_[last] = slot_[i];
+	points.pop_back();
+	insert(i, k);
+}
+
+void RadiusGrid::query(const Eigen::MatrixXd& V, const Vec3d& center, double radius, std::vector<int>& out) const
+{
+	int lo[3], hi[3];
+	for (int a = 0; a < 3; a++)
+	{
+		lo[a] = int(floor((center[a] - radius - origin_[a]) / cell_));
+		hi[a] = int(floor((center[a] + radius - origin_[a]) / cell_));
+	}
+
+	double r2 = radius * radius;
+	for (int x = lo[0]; x <= hi[0]; x++)
+		for (int y = lo[1]; y <= hi[1]; y++)
+			for (int z = lo[2]; z <= hi[2]; z++)
+			{
+				auto it = cells_.find(key(x, y, z));
+				if (it == cells_.end()) continue;
+				const std::vector<int>& points = it->second;
+				for (size_t j = 0; j < points.size(); j++)
+				{
+					int i = points[j];
+					double dx = V(i, 0) - center[0], dy = V(i, 1) - center[1], dz = V(i, 2) - center[2];
+					if (dx * dx + dy * dy + dz * dz <= r2) out.push_back(i);
+				}
+			}
+}
+
+// -----------
+Sculptor::Sculptor()
+: nv_(0), nf_(0), type_(BRUSH_NONE), radius_(1), strength_(0.5), last_(0, 0, 0), mark_(0)
+{
+}
+
+void Sculptor::clear()
+{
+	vf_start_.clear();
+	vf_faces_.clear();
+	nv_ = nf_ = 0;
+	grid_.clear();
+	type_ = BRUSH_NONE;
+	region_.clear();
+}
+
+void Sculptor::setup(const MeshData& mesh, double radius)
+{
+	const Eigen::MatrixXi& F = mesh.F;
+	int nv = mesh.V.rows(), nf = F.rows();
+	if (vf_start_.empty() || nv != nv_ || nf != nf_)
+	{
+		clear();
+		nv_ = nv;
+		nf_ = nf;
+		vf_start_.assign(nv + 1, 0);
+		for (int f = 0; f < nf; f++)
+			for (int k = 0; k < 3; k++) vf_start_[F(f, k) + 1]++;
+		for (int i = 0; i < nv; i++)
+			vf_start_[i + 1] += vf_start_[i];
+		vf_faces_.resize(vf_start_[nv]);
+		std::vector<int> fill(vf_start_.begin(), vf_start_.end() - 1);
+		for (int f = 0; f < nf; f++)
+			for (int k = 0; k < 3; k++) vf_faces_[fill[F(f, k)]++] = f;
+
+		vertex_mark_.assign(nv, 0);
+		face_mark_.assign(nf, 0);
+		mark_ = 0;
+	}
+
+	// cells about the brush size keep a query to a few cells
+	double cell = grid_.cell_size();
+	if (grid_.empty() || cell < radius / 2 || cell > 2 * radius)
+		grid_.build(mesh.V, radius);
+}
+
+bool Sculptor::begin_stroke(MeshData& mesh, BrushType type, const Vec3d& center, double radius, double strength)
+{
+	end_stroke(mesh);
+	if (type == BRUSH_NONE || mesh.F.rows() == 0 || radius <= 0) return false;
+
+	setup(mesh, radius);
+	type_ = type;
+	radius_ = radius;
+	strength_ = Min(Max(strength, 0.0), 1.0);
+	last_ = center;
+	mesh.history.begin_group();
+
+	// grab holds on to the vertices under the stroke start
+	if (type_ == BRUSH_GRAB)
+		gather(mesh, center);
+	else
+		stroke_to(mesh, center);
+	return true;
+}
+
+void Sculptor::gather(const MeshData& mesh, const Vec3d& center)
+{
+	region_.clear();
+	grid_.query(mesh.V, center, radius_, region_);
+	weight_.resize(region_.size());
+	for (size_t j = 0; j < region_.size(); j++)
+		weight_[j] = falloff((mesh.V.row(region_[j]).transpose() - center).norm(), radius_);
+}
+
+void Sculptor::stroke_to(MeshData& mesh, const Vec3d& center)
+{
+	if (!in_stroke()) return;
+	if (type_ != BRUSH_GRAB)
+		gather(mesh, center);
+	Vec3d delta = center - last_;
+	last_ = center;
+	if (region_.empty()) return;
+
+	Eigen::MatrixXd& V = mesh.V;
+	const Eigen::MatrixXi& F = mesh.F;
+	const Eigen::MatrixXd& N = mesh.V_normals;
+	int n = (int)region_.size();
+	mesh.history.record_rows(UndoHistory::ATTR_V, region_);
+
+	// the plane of flatten: weighted center and normal under the brush
+	Vec3d plane_point(0, 0, 0), plane_normal(0, 0, 0);
+	if (type_ == BRUSH_FLATTEN)
+	{
+		double total = 0;
+		for (int j = 0; j < n; j++)
+		{
+			plane_point += weight_[j] * V.row(region_[j]).transpose();
+			plane_normal += weight_[j] * N.row(region_[j]).transpose();
+			total += weight_[j];
+		}
+		if (total <= 0 || plane_normal.norm() == 0) return;
+		plane_point /= total;
+		plane_normal.normalize();
+	}
+
+	// new positions from the old ones, then written back
+	double step = strength_ * 0.1 * radius_;
+	moved_.resize(3 * size_t(n));
+	parallel_for(0, n, [&](int b, int e) {
+		for (int j = b; j < e; j++)
+		{
+			int v = region_[j];
+			double w = weight_[j];
+			Vec3d p = V.row(v).transpose();
+			switch (type_)
+			{
+			case BRUSH_GRAB:
+				p += w * delta;
+				break;
+			case BRUSH_INFLATE:
+				p += w * step * N.row(v).transpose();
+				break;
+			case BRUSH_SMOOTH:
+			{
+				// average of the other corners of the faces around v
+				Vec3d sum(0, 0, 0);
+				int count = 0;
+				for (int k = vf_start_[v]; k < vf_start_[v + 1]; k++)
+				{
+					int f = vf_faces_[k];
+					for (int c = 0; c < 3; c++)
+						if (F(f, c) != v)
+						{
+							sum += V.row(F(f, c)).transpose();
+							count++;
+						}
+				}
+				if (count > 0) p += w * strength_ * (sum / count - p);
+				break;
+			}
+			case BRUSH_FLATTEN:
+				p -= w * strength_ * (p - plane_point).dot(plane_normal) * plane_normal;
+				break;
+			default:
+				break;
+			}
+			moved_[3 * size_t(j)] = p[0];
+			moved_[3 * size_t(j) + 1] = p[1];
+			moved_[3 * size_t(j) + 2] = p[2];
+		}
+	}, 1024);
+
+	for (int j = 0; j < n; j++)
+	{
+		int v = region_[j];
+		for (int c = 0; c < 3; c++)
+			V(v, c) = moved_[3 * size_t(j) + c];
+		grid_.move(V, v);
+	}
+
+	refresh(mesh);
+}
+
+void Sculptor::refresh(MeshData& mesh)
+{
+	const Eigen::MatrixXd& V = mesh.V;
+	const Eigen::MatrixXi& F = mesh.F;
+
+	if (++mark_ == 0)
+	{
+		std::fill(vertex_mark_.begin(), vertex_mark_.end(), 0u);
+		std::fill(face_mark_.begin(), face_mark_.end(), 0u);
+		mark_ = 1;
+	}
+
+	// faces of the moved vertices get new normals and centers
+	std::vector<int> faces;
+	for (size_t j = 0; j < region_.size(); j++)
+	{
+		int v = region_[j];
+		for (int k = vf_start_[v]; k < vf_start_[v + 1]; k++)
+		{
+			int f = vf_faces_[k];
+			if (face_mark_[f] == mark_) continue;
+			face_mark_[f] = mark_;
+			faces.push_back(f);
+		}
+	}
+	int touched = (int)faces.size();
+	bool centers = mesh.F_center.rows() == F.rows();
+	parallel_for(0, touched, [&](int b, int e) {
+		for (int j = b; j < e; j++)
+		{
+			int f = faces[j];
+			Vec3d n = face_cross(V, F, f);
+			double length = n.norm();
+			if (length > 0) mesh.F_normals.row(f) = n.transpose() / length;
+			if (centers) mesh.F_center.row(f) = (V.row(F(f, 0)) + V.row(F(f, 1)) + V.row(F(f, 2))) / 3.0;
+		}
+	}, 1024);
+
+	// their corners get new vertex normals, area weighted
+	std::vector<int> vertices;
+	for (int j = 0; j < touched; j++)
+		for (int c = 0; c < 3; c++)
+		{
+			int v = F(faces[j], c);
+			if (vertex_mark_[v] == mark_) continue;
+			vertex_mark_[v] = mark_;
+			vertices.push_back(v);
+		}
+	parallel_for(0, (int)vertices.size(), [&](int b, int e) {
+		for (int j = b; j < e; j++)
+		{
+			int v = vertices[j];
+			Vec3d n(0, 0, 0);
+			for (int k = vf_start_[v]; k < vf_start_[v + 1]; k++)
+				n += face_cross(V, F, vf_faces_[k]);
+			double length = n.norm();
+			if (length > 0) mesh.V_normals.row(v) = n.transpose() / length;
+		}
+	}, 1024);
+
+	// and the faces around those hold the changed vertex normals
+	for (size_t j = 0; j < vertices.size(); j++)
+	{
+		int v = vertices[j];
+		for (int k = vf_start_[v]; k < vf_start_[v + 1]; k++)
+		{
+			int f = vf_faces_[k];
+			if (face_mark_[f] == mark_) continue;
+			face_mark_[f] = mark_;
+			faces.push_back(f);
+		}
+	}
+
+	mesh.vertices_moved(vertices, faces);
+}
+
+void Sculptor::end_stroke(MeshData& mesh)
+{
+	if (!in_stroke()) return;
+	type_ = BRUSH_NONE;
+	region_.clear();
+	mesh.history.end_group();
+
+	// samples only grow the bounding box
+	if (mesh.V.rows() > 0)
+	{
+		mesh.p_min = mesh.V.colwise().minCoeff();
+		mesh.p_max = mesh.V.colwise().maxCoeff();
+	}
+	mesh.update_memory_stats();
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "stdafx.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class MeshData;
+
+typedef enum { BRUSH_NONE = -1, BRUSH_GRAB = 0, BRUSH_INFLATE, BRUSH_SMOOTH, BRUSH_FLATTEN, BRUSH_COUNT } BrushType;
+
+// Hash grid of points for fixed radius queries. A point that moves is
+// taken out of its old cell and put in the new one, so the grid follows
+// edits without being built again.
+class RadiusGrid
+{
+public:
+	RadiusGrid();
+
+	void build(const Eigen::MatrixXd& V, double cell);
+	void clear();
+	bool empty() const { return cell_key_.empty(); }
+	double cell_size() const { return cell_; }
+
+	// point i of V is now at V.row(i)
+	void move(const Eigen::MatrixXd& V, int i);
+
+	// points of V within radius of center, appended to out
+	void query(const Eigen::MatrixXd& V, const Vec3d& center, double radius, std::vector<int>& out) const;
+
+private:
+	uint64_t key(const double* p) const;
+	uint64_t key(int x, int y, int z) const;
+	void insert(int i, uint64_t k);
+
+private:
+	Vec3d origin_;
+	double cell_;
+	std::unordered_map<uint64_t, std::vector<int> > cells_;
+	std::vector<uint64_t> cell_key_;  // cell of each point
+	std::vector<int> slot_;           // position of each point in its cell
+};
+
+// Sculpt brushes on a MeshData. A stroke is a series of samples; each
+// sample moves the vertices within the radius with a smooth falloff, then
+// refreshes the face and vertex normals and face centers around them only,
+// and queues the changed rows for the renderer (MeshData::vertices_moved).
+//  - grab: the vertices under the stroke start follow the cursor
+//  - inflate: along the vertex normals
+//  - smooth: towards the average of their neighbors
+//  - flatten: onto the average plane under the brush
+// A stroke is one undo step. The vertex to face adjacency and the grid are
+// kept between strokes; clear() them when V or F change elsewhere.
+class Sculptor
+{
+public:
+	Sculptor();
+
+	void clear();
+
+	// center is on the surface; radius in model units, strength in [0, 1]
+	bool begin_stroke(MeshData& mesh, BrushType type, const Vec3d& center, double radius, double strength);
+	// next sample: the cursor on the surface, or for grab anywhere in space
+	void stroke_to(MeshData& mesh, const Vec3d& center);
+	void end_stroke(MeshData& mesh);
+	bool in_stroke() const { return type_ != BRUSH_NONE; }
+
+	// vertices moved by the last sample
+	int moved() const { return (int)region_.size(); }
+
+private:
+	void setup(const MeshData& mesh, double radius);
+	void gather(const MeshData& mesh, const Vec3d& center);
+	void refresh(MeshData& mesh);
+
+private:
+	// faces around each vertex
+	std::vector<int> vf_start_, vf_faces_;
+	int nv_, nf_;
+	RadiusGrid grid_;
+
+	BrushType type_;
+	double radius_, strength_;
+	Vec3d last_;
+
+	// vertices under the brush and their falloff weights
+	std::vector<int> region_;
+	std::vector<double> weight_;
+	std::vector<double> moved_;   // new positions of region_, 3 per vertex
+
+	// marks of the current sample, so sets are built without sorting
+	std::vector<unsigned> vertex_mark_, face_mark_;
+	unsigned mark_;
+};
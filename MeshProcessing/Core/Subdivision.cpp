@@ -0,0 +1,346 @@
+#include "stdafx.h"
+#include "Subdivision.h"
+#include "Parallel.h"
+
+namespace
+{
+	// sparse rows of weights, CSR like LoopSubdivision
+	struct Stencils
+	{
+		std::vector<int> start;
+		std::vector<int> index;
+		std::vector<double> weight;
+
+		int rows() const { return start.empty() ? 0 : (int)start.size() - 1; }
+		void swap(Stencils& o)
+		{
+			start.swap(o.start);
+			index.swap(o.index);
+			weight.swap(o.weight);
+		}
+	};
+
+	// an edge of a face, from its corner k to the next one
+	struct EdgeKey
+	{
+		int a, b;      // sorted end points
+		int face, corner;
+		bool operator<(const EdgeKey& o) const
+		{
+			if (a != o.a) return a < o.a;
+			if (b != o.b) return b < o.b;
+			if (face != o.face) return face < o.face;
+			return corner < o.corner;
+		}
+	};
+
+	// Loop vertex weight of the ring of an interior vertex of valence n
+	double loop_beta(int n)
+	{
+		double c = 3.0 / 8 + cos(2 * M_PI / n) / 4;
+		return (5.0 / 8 - c * c) / n;
+	}
+
+	// One Loop step of the faces F over nv vertices: the stencils of the
+	// new vertices over the old ones, the nv old vertices first then one
+	// per edge, and the new faces
+	void loop_step(int nv, const Eigen::MatrixXi& F, Stencils& S, Eigen::MatrixXi& NF)
+	{
+		int nf = F.rows();
+
+		// edges are the runs of equal end points among the sorted face edges
+		std::vector<EdgeKey> keys(3 * size_t(nf));
+		parallel_for(0, nf, [&](int b, int e) {
+			for (int f = b; f < e; f++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					int u = F(f, k), v = F(f, (k + 1) % 3);
+					EdgeKey& key = keys[3 * size_t(f) + k];
+					key.a = Min(u, v);
+					key.b = Max(u, v);
+					key.face = f;
+					key.corner = k;
+				}
+			}
+		}, 1 << 14);
+		parallel_sort(keys);
+
+		std::vector<int> edge_first;
+		std::vector<int> corner_edge(3 * size_t(nf));
+		for (size_t j = 0; j < keys.size(); j++)
+		{
+			if (j == 0 || keys[j].a != keys[j - 1].a || keys[j].b != keys[j - 1].b)
+				edge_first.push_back((int)j);
+			corner_edge[3 * size_t(keys[j].face) + keys[j].corner] = (int)edge_first.size() - 1;
+		}
+		int ne = (int)edge_first.size();
+		edge_first.push_back((int)keys.size());
+
+		// edges around each vertex
+		std::vector<int> vstart(nv + 1, 0), vedges(2 * size_t(ne));
+		for (int e = 0; e < ne; e++)
+		{
+			vstart[keys[edge_first[e]].a + 1]++;
+			vstart[keys[edge_first[e]].b + 1]++;
+		}
+		for (int i = 0; i < nv; i++)
+			vstart[i + 1] += vstart[i];
+		std::vector<int> fill(vstart.begin(), vstart.end() - 1);
+		for (int e = 0; e < ne; e++)
+		{
+			vedges[fill[keys[edge_first[e]].a]++] = e;
+			vedges[fill[keys[edge_first[e]].b]++] = e;
+		}
+
+		// an edge of one face, or of more than two, is a boundary
+		auto boundary = [&](int e) { return edge_first[e + 1] - edge_first[e] != 2; };
+		auto other = [&](int e, int v) { const EdgeKey& k = keys[edge_first[e]]; return k.a == v ? k.b : k.a; };
+
+		// rows: a vertex keeps its weight and adds its ring or its two
+		// boundary neighbors; an edge point weighs the ends and the opposite corners
+		int rows = nv + ne;
+		S.start.assign(rows + 1, 0);
+		parallel_for(0, rows, [&](int b, int e) {
+			for (int r = b; r < e; r++)
+			{
+				int size = 1;
+				if (r < nv)
+				{
+					int boundaries = 0;
+					for (int j = vstart[r]; j < vstart[r + 1]; j++)
+						if (boundary(vedges[j])) boundaries++;
+					if (boundaries == 0) size += vstart[r + 1] - vstart[r];
+					else if (boundaries == 2) size += 2;
+				}
+				else
+					size = boundary(r - nv) ? 2 : 4;
+				S.start[r + 1] = size;
+			}
+		}, 1 << 14);
+		for (int r = 0; r < rows; r++)
+			S.start[r + 1] += S.start[r];
+		S.index.resize(S.start[rows]);
+		S.weight.resize(S.start[rows]);
+
+		parallel_for(0, rows, [&](int b, int e) {
+			for (int r = b; r < e; r++)
+			{
+				int* index = &S.index[S.start[r]];
+				double* weight = &S.weight[S.start[r]];
+				int size = S.start[r + 1] - S.start[r];
+				if (r < nv)
+				{
+					index[0] = r;
+					weight[0] = 1;
+					if (size == 1) continue;
+
+					int n = vstart[r + 1] - vstart[r];
+					bool interior = true;
+					for (int j = vstart[r]; j < vstart[r + 1]; j++)
+						if (boundary(vedges[j])) interior = false;
+					double w = interior ? loop_beta(n) : 1.0 / 8;
+					weight[0] = interior ? 1 - n * w : 3.0 / 4;
+					int m = 1;
+					for (int j = vstart[r]; j < vstart[r + 1]; j++)
+					{
+						int edge = vedges[j];
+						if (!interior && !boundary(edge)) continue;
+						index[m] = other(edge, r);
+						weight[m] = w;
+						m++;
+					}
+				}
+				else
+				{
+					int edge = r - nv;
+					const EdgeKey& k = keys[edge_first[edge]];
+					index[0] = k.a;
+					index[1] = k.b;
+					if (size == 2)
+					{
+						weight[0] = weight[1] = 0.5;
+						continue;
+					}
+					weight[0] = weight[1] = 3.0 / 8;
+					for (int j = 0; j < 2; j++)
+					{
+						const EdgeKey& side = keys[edge_first[edge] + j];
+						index[2 + j] = F(side.face, (side.corner + 2) % 3);
+						weight[2 + j] = 1.0 / 8;
+					}
+				}
+			}
+		}, 4096);
+
+		// each face becomes its three corners and the middle
+		NF.resize(4 * nf, 3);
+		parallel_for(0, nf, [&](int b, int e) {
+			for (int f = b; f < e; f++)
+			{
+				int a = F(f, 0), c = F(f, 1), d = F(f, 2);
+				int ac = nv + corner_edge[3 * size_t(f)];
+				int cd = nv + corner_edge[3 * size_t(f) + 1];
+				int da = nv + corner_edge[3 * size_t(f) + 2];
+				NF.row(4 * f) << a, ac, da;
+				NF.row(4 * f + 1) << ac, c, cd;
+				NF.row(4 * f + 2) << da, cd, d;
+				NF.row(4 * f + 3) << ac, cd, da;
+			}
+		}, 1 << 14);
+	}
+
+	// C = A B: the rows of A are over the rows of B, those of B over cols points
+	void compose(const Stencils& A, const Stencils& B, int cols, Stencils& C)
+	{
+		int rows = A.rows();
+		C.start.assign(rows + 1, 0);
+
+		// every chunk fills a scratch array over the cols points: chunks of
+		// at least cols / 4 rows keep that below the stencil work
+		int grain = Max(4096, cols / 4);
+
+		// sizes first, to write the rows in place afterwards
+		parallel_for(0, rows, [&](int b, int e) {
+			std::vector<int> mark(cols, -1);
+			for (int r = b; r < e; r++)
+			{
+				int size = 0;
+				for (int j = A.start[r]; j < A.start[r + 1]; j++)
+				{
+					int s = A.index[j];
+					for (int k = B.start[s]; k < B.start[s + 1]; k++)
+						if (mark[B.index[k]] != r)
+						{
+							mark[B.index[k]] = r;
+							size++;
+						}
+				}
+				C.start[r + 1] = size;
+			}
+		}, grain);
+		for (int r = 0; r < rows; r++)
+			C.start[r + 1] += C.start[r];
+		C.index.resize(C.start[rows]);
+		C.weight.resize(C.start[rows]);
+
+		parallel_for(0, rows, [&](int b, int e) {
+			std::vector<int> slot(cols, -1);
+			for (int r = b; r < e; r++)
+			{
+				int first = C.start[r], m = first;
+				for (int j = A.start[r]; j < A.start[r + 1]; j++)
+				{
+					int s = A.index[j];
+					for (int k = B.start[s]; k < B.start[s + 1]; k++)
+					{
+						int c = B.index[k];
+						if (slot[c] < first)
+						{
+							slot[c] = m;
+							C.index[m] = c;
+							C.weight[m] = 0;
+							m++;
+						}
+						C.weight[slot[c]] += A.weight[j] * B.weight[k];
+					}
+				}
+			}
+		}, grain);
+	}
+
+	// columns of X (rows x cols, column major) through the stencils into out
+	void apply(const std::vector<int>& start, const std::vector<int>& index, const std::vector<double>& weight,
+		const double* x, int rows, int cols, double* out)
+	{
+		int n = (int)start.size() - 1;
+		parallel_for(0, n, [&](int b, int e) {
+			for (int c = 0; c < cols; c++)
+			{
+				const double* xc = x + size_t(c) * rows;
+				double* oc = out + size_t(c) * n;
+				for (int i = b; i < e; i++)
+				{
+					double s = 0;
+					for (int k = start[i]; k < start[i + 1]; k++)
+						s += weight[k] * xc[index[k]];
+					oc[i] = s;
+				}
+			}
+		}, 4096);
+	}
+}
+
+LoopSubdivision::LoopSubdivision()
+: levels_(0), control_points_(0)
+{
+}
+
+void LoopSubdivision::clear()
+{
+	start_.clear();
+	index_.clear();
+	weight_.clear();
+	F_.resize(0, 3);
+	levels_ = 0;
+	control_points_ = 0;
+}
+
+void LoopSubdivision::build(int nv, const Eigen::MatrixXi& F, int levels)
+{
+	clear();
+	levels_ = Max(levels, 0);
+	control_points_ = nv;
+
+	// level 0 is the control points themselves
+	Stencils S;
+	S.start.resize(nv + 1);
+	S.index.resize(nv);
+	S.weight.assign(nv, 1.0);
+	for (int i = 0; i <= nv; i++) S.start[i] = i;
+	for (int i = 0; i < nv; i++) S.index[i] = i;
+
+	Eigen::MatrixXi faces = F;
+	int n = nv;
+	for (int l = 0; l < levels_ && faces.rows() > 0; l++)
+	{
+		Stencils step, next;
+		Eigen::MatrixXi refined;
+		loop_step(n, faces, step, refined);
+		compose(step, S, nv, next);
+		S.swap(next);
+		faces.swap(refined);
+		n = step.rows();
+	}
+
+	start_.swap(S.start);
+	index_.swap(S.index);
+	weight_.swap(S.weight);
+	F_.swap(faces);
+}
+
+void LoopSubdivision::evaluate(const Eigen::MatrixXd& X, Eigen::MatrixXd& out) const
+{
+	if (X.rows() != control_points_)
+	{
+		std::cerr << "ERROR (LoopSubdivision::evaluate): Please provide a row per control point." << std::endl;
+		out.resize(0, X.cols());
+		return;
+	}
+	out.resize(refined_points(), X.cols());
+	if (out.size() > 0)
+		apply(start_, index_, weight_, X.data(), X.rows(), X.cols(), out.data());
+}
+
+void LoopSubdivision::evaluate(const Eigen::VectorXd& X, Eigen::VectorXd& out) const
+{
+	if (X.rows() != control_points_)
+	{
+		std::cerr << "ERROR (LoopSubdivision::evaluate): Please provide a row per control point." << std::endl;
+		out.resize(0);
+		return;
+	}
+	out.resize(refined_points());
+	if (out.size() > 0)
+		apply(start_, index_, weight_, X.data(), X.rows(), 1, out.data());
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+// Loop subdivision split in two passes. build() works on the faces only and
+// keeps, for every refined vertex, the weights of the control points it is
+// made of. evaluate() then only sums weighted control points, so editing the
+// control points of a fixed topology costs one sparse product per edit.
+// Boundary edges and vertices follow the cubic B-spline boundary rules;
+// non-manifold edges are treated as boundaries and vertices with more than
+// two boundary edges stay where they are.
+class LoopSubdivision
+{
+public:
+	LoopSubdivision();
+
+	// stencils of `levels` subdivision steps of the faces F over nv control points
+	void build(int nv, const Eigen::MatrixXi& F, int levels);
+	void clear();
+	bool empty() const { return start_.empty(); }
+
+	int levels() const { return levels_; }
+	int control_points() const { return control_points_; }
+	int refined_points() const { return start_.empty() ? 0 : (int)start_.size() - 1; }
+
+	// faces of the refined mesh
+	const Eigen::MatrixXi& faces() const { return F_; }
+
+	// refined rows from per control point rows X (positions, colors, scalars...),
+	// on all cores
+	void evaluate(const Eigen::MatrixXd& X, Eigen::MatrixXd& out) const;
+	void evaluate(const Eigen::VectorXd& X, Eigen::VectorXd& out) const;
+
+private:
+	// one row per refined vertex: control points index_ and weights weight_
+	// in [start_[i], start_[i + 1])
+	std::vector<int> start_;
+	std::vector<int> index_;
+	std::vector<double> weight_;
+
+	Eigen::MatrixXi F_;
+	int levels_;
+	int control_points_;
+};
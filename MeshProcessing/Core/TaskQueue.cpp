@@ -0,0 +1,51 @@
+#include "stdafx.h"
+#include "TaskQueue.h"
+
+TaskQueue::TaskQueue()
+: owner_(std::this_thread::get_id()), posted_(0), done_(0)
+{
+}
+
+void TaskQueue::invoke(const std::function<void()>& f)
+{
+	if (std::this_thread::get_id() == owner_)
+	{
+		f();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	tasks_.push_back(f);
+	unsigned long long ticket = ++posted_;
+	while (done_ < ticket) cv_.wait(lock);
+}
+
+void TaskQueue::post(const std::function<void()>& f)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	tasks_.push_back(f);
+	++posted_;
+}
+
+int TaskQueue::run_pending()
+{
+	int n = 0;
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (!tasks_.empty())
+	{
+		std::function<void()> f;
+		f.swap(tasks_.front());
+		tasks_.pop_front();
+
+		// tasks may post more tasks
+		lock.unlock();
+		f();
+		lock.lock();
+
+		++done_;
+		++n;
+	}
+	lock.unlock();
+	if (n > 0) cv_.notify_all();
+	return n;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "stdafx.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs functions on one owner thread (the one that created the queue),
+// for other threads that must not touch its data, e.g. the mesh and GL
+// state of the viewer.
+class TaskQueue
+{
+public:
+	TaskQueue();
+
+	// run f on the owner thread and wait for it; runs it right away
+	// when called from the owner thread
+	void invoke(const std::function<void()>& f);
+
+	// run f on the owner thread later
+	void post(const std::function<void()>& f);
+
+	// called by the owner thread; returns the number of functions run
+	int run_pending();
+
+private:
+	std::thread::id owner_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::deque<std::function<void()> > tasks_;
+	unsigned long long posted_, done_;
+};
@@ -0,0 +1,258 @@
+#include "stdafx.h"
+#include "UndoHistory.h"
+
+UndoHistory::UndoHistory()
+: group_depth_(0), budget_(size_t(256) << 20), bytes_(0), enabled_(true)
+{
+	for (int i = 0; i < ATTR_COUNT; i++)
+	{
+		mats_[i] = NULL;
+		lists_[i] = NULL;
+	}
+}
+
+void UndoHistory::bind(Attribute attr, Eigen::MatrixXd* M)
+{
+	mats_[attr] = M;
+}
+
+void UndoHistory::bind(Attribute attr, std::vector<int>* L)
+{
+	lists_[attr] = L;
+}
+
+void UndoHistory::clear()
+{
+	undo_.clear();
+	redo_.clear();
+	pending_ = Step();
+	pending_keys_.clear();
+	group_depth_ = 0;
+	bytes_ = 0;
+}
+
+void UndoHistory::set_budget(size_t bytes)
+{
+	budget_ = bytes;
+	enforce_budget();
+}
+
+void UndoHistory::begin_group()
+{
+	group_depth_++;
+}
+
+void UndoHistory::end_group()
+{
+	if (group_depth_ > 0 && --group_depth_ == 0)
+		commit();
+}
+
+void UndoHistory::record(Attribute attr, const Eigen::MatrixXd& _new)
+{
+	Eigen::MatrixXd* M = mats_[attr];
+	if (!enabled_ || M == NULL) return;
+
+	if (M->rows() != _new.rows() || M->cols() != _new.cols())
+	{
+		// the size changes, keep the whole matrix
+		Chunk c;
+		c.attr = attr;
+		c.index = -1;
+		c.values = *M;
+		push_chunk(c);
+	}
+	else
+	{
+		// keep only the blocks that differ
+		int rows = M->rows();
+		for (int r0 = 0; r0 < rows; r0 += kChunkRows)
+		{
+			int n = Min(kChunkRows, rows - r0);
+			if (M->middleRows(r0, n) == _new.middleRows(r0, n)) continue;
+
+			Chunk c;
+			c.attr = attr;
+			c.index = r0 / kChunkRows;
+			c.values = M->middleRows(r0, n);
+			push_chunk(c);
+		}
+	}
+
+	if (group_depth_ == 0) commit();
+}
+
+void UndoHistory::record_rows(Attribute attr, const std::vector<int>& rows)
+{
+	Eigen::MatrixXd* M = mats_[attr];
+	if (!enabled_ || M == NULL) return;
+
+	std::set<int> blocks;
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		if (rows[i] >= 0 && rows[i] < M->rows())
+			blocks.insert(rows[i] / kChunkRows);
+	}
+
+	for (auto it = blocks.begin(); it != blocks.end(); ++it)
+	{
+		// the oldest content of a block is the one to restore, skip the copy
+		if (pending_keys_.count(std::make_pair(int(attr), *it))) continue;
+
+		int r0 = *it * kChunkRows;
+		int n = Min(kChunkRows, (int)M->rows() - r0);
+
+		Chunk c;
+		c.attr = attr;
+		c.index = *it;
+		c.values = M->middleRows(r0, n);
+		push_chunk(c);
+	}
+
+	if (group_depth_ == 0) commit();
+}
+
+void UndoHistory::record_list(Attribute attr)
+{
+	std::vector<int>* L = lists_[attr];
+	if (!enabled_ || L == NULL) return;
+
+	Chunk c;
+	c.attr = attr;
+	c.index = -1;
+	c.list = *L;
+	push_chunk(c);
+
+	if (group_depth_ == 0) commit();
+}
+
+unsigned UndoHistory::undo()
+{
+	if (group_depth_ > 0) return 0;
+	return apply(undo_, redo_, true);
+}
+
+unsigned UndoHistory::redo()
+{
+	if (group_depth_ > 0) return 0;
+	return apply(redo_, undo_, false);
+}
+
+size_t UndoHistory::Chunk::bytes() const
+{
+	return sizeof(Chunk) + values.size()*sizeof(double) + list.size()*sizeof(int);
+}
+
+void UndoHistory::push_chunk(Chunk& c)
+{
+	std::pair<int, int> key(c.attr, c.index);
+	if (c.index < 0)
+	{
+		// a whole copy supersedes the blocks recorded so far, since the
+		// blocks recorded after it refer to the new layout
+		auto it = pending_keys_.lower_bound(std::make_pair(c.attr, 0));
+		while (it != pending_keys_.end() && it->first == c.attr)
+			it = pending_keys_.erase(it);
+	}
+	else if (pending_keys_.count(key))
+	{
+		// the oldest content of a block is the one to restore
+		return;
+	}
+	else
+	{
+		pending_keys_.insert(key);
+	}
+
+	pending_.bytes += c.bytes();
+	pending_.chunks.push_back(Chunk());
+	std::swap(pending_.chunks.back(), c);
+}
+
+void UndoHistory::commit()
+{
+	pending_keys_.clear();
+	if (pending_.chunks.empty()) return;
+
+	// a new edit invalidates the redo stack
+	for (size_t i = 0; i < redo_.size(); i++)
+		bytes_ -= redo_[i].bytes;
+	redo_.clear();
+
+	bytes_ += pending_.bytes;
+	undo_.push_back(Step());
+	std::swap(undo_.back(), pending_);
+	pending_ = Step();
+
+	enforce_budget();
+}
+
+void UndoHistory::swap_chunk(Chunk& c)
+{
+	if (lists_[c.attr] != NULL)
+	{
+		lists_[c.attr]->swap(c.list);
+		return;
+	}
+
+	Eigen::MatrixXd* M = mats_[c.attr];
+	if (M == NULL) return;
+
+	if (c.index < 0)
+	{
+		M->swap(c.values);
+	}
+	else
+	{
+		int r0 = c.index * kChunkRows;
+		int n = c.values.rows();
+		Eigen::MatrixXd current = M->middleRows(r0, n);
+		M->middleRows(r0, n) = c.values;
+		c.values.swap(current);
+	}
+}
+
+unsigned UndoHistory::apply(std::deque<Step>& from, std::deque<Step>& to, bool reverse)
+{
+	if (from.empty()) return 0;
+
+	Step step;
+	std::swap(step, from.back());
+	from.pop_back();
+	bytes_ -= step.bytes;
+
+	// swapping stores the current content in the chunk, so the same step
+	// turns into its own inverse
+	unsigned mask = 0;
+	int n = step.chunks.size();
+	step.bytes = 0;
+	for (int i = 0; i < n; i++)
+	{
+		Chunk& c = step.chunks[reverse ? n - 1 - i : i];
+		swap_chunk(c);
+		mask |= 1u << c.attr;
+		step.bytes += c.bytes();
+	}
+
+	bytes_ += step.bytes;
+	to.push_back(Step());
+	std::swap(to.back(), step);
+
+	enforce_budget();
+	return mask;
+}
+
+void UndoHistory::enforce_budget()
+{
+	// drop the oldest undo steps first, then the farthest redo steps
+	while (bytes_ > budget_ && !undo_.empty())
+	{
+		bytes_ -= undo_.front().bytes;
+		undo_.pop_front();
+	}
+	while (bytes_ > budget_ && !redo_.empty())
+	{
+		bytes_ -= redo_.front().bytes;
+		redo_.pop_front();
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "stdafx.h"
+#include <deque>
+#include <set>
+#include <vector>
+
+// Undo/redo history for the editable attributes of MeshData.
+// Dense attributes are split into blocks of rows; an edit stores only the
+// blocks whose content actually changed, and undo/redo swap them in place.
+// The depth of the history is bounded by a memory budget, not by a count.
+class UndoHistory
+{
+public:
+	enum Attribute
+	{
+		ATTR_V = 0,      // vertex positions
+		ATTR_V_COLOR,    // per vertex diffuse color
+		ATTR_F_COLOR,    // per face diffuse color
+		ATTR_SEL_PTS,    // selected vertices
+		ATTR_SEL_FACES,  // selected faces
+		ATTR_COUNT
+	};
+
+	// number of rows stored per block
+	static const int kChunkRows = 4096;
+
+public:
+	UndoHistory();
+
+	// attach the storage that undo/redo write back into
+	void bind(Attribute attr, Eigen::MatrixXd* M);
+	void bind(Attribute attr, std::vector<int>* L);
+
+	// drop all steps
+	void clear();
+
+	// enable or disable recording, e.g. during playback
+	void set_enabled(bool enabled) { enabled_ = enabled; }
+	bool enabled() const { return enabled_; }
+
+	// memory budget in bytes, shared by the undo and the redo stack
+	void set_budget(size_t bytes);
+	size_t budget() const { return budget_; }
+	size_t bytes() const { return bytes_; }
+
+	// merge all records between begin_group and end_group into a single step
+	void begin_group();
+	void end_group();
+
+	// record the blocks of the bound matrix that differ from _new
+	// call it before the bound matrix is overwritten with _new
+	void record(Attribute attr, const Eigen::MatrixXd& _new);
+
+	// record the blocks containing the given rows of the bound matrix
+	// call it before the rows are modified in place
+	void record_rows(Attribute attr, const std::vector<int>& rows);
+
+	// record a whole index list before it is modified
+	void record_list(Attribute attr);
+
+	bool can_undo() const { return !undo_.empty(); }
+	bool can_redo() const { return !redo_.empty(); }
+	int undo_depth() const { return (int)undo_.size(); }
+	int redo_depth() const { return (int)redo_.size(); }
+
+	// restore the previous state; returns the bitmask (1 << Attribute) of
+	// the attributes written back, 0 if there is nothing to undo
+	unsigned undo();
+	unsigned redo();
+
+private:
+	struct Chunk
+	{
+		int attr;
+		int index;                  // block index, -1 for a whole matrix or list
+		Eigen::MatrixXd values;     // block rows or the whole matrix
+		std::vector<int> list;      // whole index list
+		size_t bytes() const;
+	};
+
+	struct Step
+	{
+		std::vector<Chunk> chunks;
+		size_t bytes;
+		Step() : bytes(0) {}
+	};
+
+	void push_chunk(Chunk& c);
+	void commit();
+	void swap_chunk(Chunk& c);
+	unsigned apply(std::deque<Step>& from, std::deque<Step>& to, bool reverse);
+	void enforce_budget();
+
+private:
+	Eigen::MatrixXd* mats_[ATTR_COUNT];
+	std::vector<int>* lists_[ATTR_COUNT];
+
+	std::deque<Step> undo_;
+	std::deque<Step> redo_;
+
+	// step under construction and the blocks it already holds
+	Step pending_;
+	std::set<std::pair<int, int> > pending_keys_;
+	int group_depth_;
+
+	size_t budget_;
+	size_t bytes_;
+	bool enabled_;
+};
@@ -0,0 +1,363 @@
+#include "stdafx.h"
+#include "VertexSequence.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+namespace
+{
+	struct SequenceHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t vertices;
+		uint32_t frames;
+	};
+
+	const char kMagic[4] = { 'M', 'P', 'V', 'S' };
+	const uint32_t kVersion = 1;
+}
+
+VertexSequence::VertexSequence()
+: vertices_(0), frames_(0), quit_(false), cursor_(0), read_ahead_(8)
+{
+}
+
+VertexSequence::~VertexSequence()
+{
+	close();
+}
+
+bool VertexSequence::open(const std::string& filename, const Eigen::MatrixXi& F)
+{
+	close();
+	if (!file_.open(filename)) return false;
+
+	SequenceHeader header;
+	bool ok = file_.size() >= sizeof(header);
+	if (ok)
+	{
+		memcpy(&header, file_.data(), sizeof(header));
+		ok = memcmp(header.magic, kMagic, 4) == 0 && header.version == kVersion &&
+			header.vertices > 0 && header.frames > 0 &&
+			file_.size() >= sizeof(header) + size_t(header.frames) * header.vertices * 3 * sizeof(float);
+	}
+	if (!ok)
+	{
+		std::cerr << "ERROR (VertexSequence): " << filename << " is not a vertex sequence cache." << std::endl;
+		file_.close();
+		return false;
+	}
+	if (F.size() > 0 && F.maxCoeff() >= int(header.vertices))
+	{
+		std::cerr << "ERROR (VertexSequence): The sequence has " << header.vertices
+			<< " vertices, which does not match the faces." << std::endl;
+		file_.close();
+		return false;
+	}
+
+	vertices_ = header.vertices;
+	frames_ = header.frames;
+	F_ = F;
+
+	quit_ = false;
+	cursor_ = 0;
+	worker_ = std::thread(&VertexSequence::run, this);
+	return true;
+}
+
+void VertexSequence::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	cv_.notify_all();
+	if (worker_.joinable()) worker_.join();
+
+	ready_.clear();
+	free_.clear();
+	file_.close();
+	vertices_ = 0;
+	frames_ = 0;
+}
+
+void VertexSequence::set_read_ahead(int frames)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		read_ahead_ = Max(frames, 1);
+	}
+	cv_.notify_all();
+}
+
+void VertexSequence::request(int i)
+{
+	if (frames_ == 0) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		cursor_ = ((i % frames_) + frames_) % frames_;
+
+		// drop the frames that fell out of the window
+		for (auto it = ready_.begin(); it != ready_.end();)
+		{
+			int d = (it->first - cursor_ + frames_) % frames_;
+			if (d >= read_ahead_)
+			{
+				free_.push_back(SequenceFrame());
+				std::swap(free_.back(), it->second);
+				it = ready_.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+	cv_.notify_all();
+}
+
+bool VertexSequence::fetch(int i, SequenceFrame& frame)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = ready_.find(i);
+	if (it == ready_.end()) return false;
+
+	// the storage of the previous frame is reused by the worker
+	if (!frame.positions.empty() && (int)free_.size() < read_ahead_)
+	{
+		free_.push_back(SequenceFrame());
+		std::swap(free_.back(), frame);
+	}
+	std::swap(frame, it->second);
+	ready_.erase(it);
+	return true;
+}
+
+void VertexSequence::frame_vertices(int i, Eigen::MatrixXd& V) const
+{
+	const float* p = positions(i);
+	V.resize(vertices_, 3);
+	for (int r = 0; r < vertices_; r++)
+		for (int c = 0; c < 3; c++)
+			V(r, c) = p[3 * r + c];
+}
+
+const float* VertexSequence::positions(int i) const
+{
+	size_t offset = sizeof(SequenceHeader) + size_t(i) * vertices_ * 3 * sizeof(float);
+	return (const float*)(file_.data() + offset);
+}
+
+void VertexSequence::prepare(int i, SequenceFrame& frame) const
+{
+	size_t n = size_t(vertices_) * 3;
+	frame.index = i;
+	frame.positions.resize(n);
+	frame.normals.assign(n, 0.0f);
+
+	// reading the mapped pages here keeps page faults off the render thread,
+	// while the pages of the next frame are read ahead
+	const float* p = positions(i);
+	if (frames_ > 1)
+		file_.prefetch((const unsigned char*)positions((i + 1) % frames_) - file_.data(), n * sizeof(float));
+	memcpy(&frame.positions[0], p, n * sizeof(float));
+
+	// area weighted vertex normals
+	const float* x = &frame.positions[0];
+	float* N = &frame.normals[0];
+	for (int f = 0; f < F_.rows(); f++)
+	{
+		int a = F_(f, 0), b = F_(f, 1), c = F_(f, 2);
+		float e1[3], e2[3];
+		for (int k = 0; k < 3; k++)
+		{
+			e1[k] = x[3 * b + k] - x[3 * a + k];
+			e2[k] = x[3 * c + k] - x[3 * a + k];
+		}
+		float n0 = e1[1] * e2[2] - e1[2] * e2[1];
+		float n1 = e1[2] * e2[0] - e1[0] * e2[2];
+		float n2 = e1[0] * e2[1] - e1[1] * e2[0];
+		int v[3] = { a, b, c };
+		for (int k = 0; k < 3; k++)
+		{
+			N[3 * v[k]] += n0;
+			N[3 * v[k] + 1] += n1;
+			N[3 * v[k] + 2] += n2;
+		}
+	}
+	for (int v = 0; v < vertices_; v++)
+	{
+		float* nv = N + 3 * v;
+		float len = sqrt(nv[0] * nv[0] + nv[1] * nv[1] + nv[2] * nv[2]);
+		if (len > 0)
+		{
+			nv[0] /= len; nv[1] /= len; nv[2] /= len;
+		}
+	}
+}
+
+void VertexSequence::run()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (!quit_)
+	{
+		// first frame of the window that is not prepared yet
+		int next = -1;
+		for (int k = 0; k < read_ahead_ && k < frames_; k++)
+		{
+			int i = (cursor_ + k) % frames_;
+			if (!ready_.count(i))
+			{
+				next = i;
+				break;
+			}
+		}
+		if (next < 0)
+		{
+			cv_.wait(lock);
+			continue;
+		}
+
+		SequenceFrame frame;
+		if (!free_.empty())
+		{
+			std::swap(frame, free_.back());
+			free_.pop_back();
+		}
+
+		lock.unlock();
+		prepare(next, frame);
+		lock.lock();
+
+		// the cursor may have moved meanwhile
+		int d = (next - cursor_ + frames_) % frames_;
+		if (d < read_ahead_)
+			std::swap(ready_[next], frame);
+		else
+		{
+			free_.push_back(SequenceFrame());
+			std::swap(free_.back(), frame);
+		}
+	}
+}
+
+// -----------
+VertexSequence::Writer::Writer()
+: file_(NULL), vertices_(0), frames_(0)
+{
+}
+
+VertexSequence::Writer::~Writer()
+{
+	close();
+}
+
+bool VertexSequence::Writer::open(const std::string& filename, int vertices)
+{
+	close();
+	file_ = fopen(filename.c_str(), "wb");
+	if (file_ == NULL)
+	{
+		std::cerr << "ERROR (VertexSequence): Can not write " << filename << std::endl;
+		return false;
+	}
+
+	vertices_ = vertices;
+	frames_ = 0;
+
+	// the frame count is written by close()
+	SequenceHeader header;
+	memcpy(header.magic, kMagic, 4);
+	header.version = kVersion;
+	header.vertices = vertices;
+	header.frames = 0;
+	return fwrite(&header, sizeof(header), 1, file_) == 1;
+}
+
+bool VertexSequence::Writer::append(const Eigen::MatrixXd& V)
+{
+	if (file_ == NULL || V.rows() != vertices_ || V.cols() < 3) return false;
+
+	std::vector<float> buf(size_t(vertices_) * 3);
+	for (int r = 0; r < vertices_; r++)
+		for (int c = 0; c < 3; c++)
+			buf[3 * r + c] = (float)V(r, c);
+
+	if (fwrite(&buf[0], sizeof(float), buf.size(), file_) != buf.size()) return false;
+	frames_++;
+	return true;
+}
+
+bool VertexSequence::Writer::close()
+{
+	if (file_ == NULL) return false;
+
+	uint32_t frames = frames_;
+	bool ok = fseek(file_, offsetof(SequenceHeader, frames), SEEK_SET) == 0 &&
+		fwrite(&frames, sizeof(frames), 1, file_) == 1;
+	ok = fclose(file_) == 0 && ok;
+	file_ = NULL;
+	return ok;
+}
+
+// -----------
+bool VertexSequence::build_cache(const std::string& first_frame, std::string& cache_file,
+	const Eigen::VectorXi& vertex_map)
+{
+	// split name into prefix, frame number and extension
+	size_t dot = first_frame.find_last_of('.');
+	size_t slash = first_frame.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = first_frame.size();
+	size_t start = dot;
+	while (start > 0 && isdigit((unsigned char)first_frame[start - 1])) start--;
+	if (start == dot)
+	{
+		std::cerr << "ERROR (VertexSequence): " << first_frame << " is not a numbered frame." << std::endl;
+		return false;
+	}
+
+	std::string prefix = first_frame.substr(0, start);
+	std::string ext = first_frame.substr(dot);
+	int width = int(dot - start);
+	int number = atoi(first_frame.substr(start, width).c_str());
+
+	cache_file = prefix + ".vseq";
+	Writer writer;
+	int nv = -1;
+	for (;; number++)
+	{
+		std::ostringstream name;
+		name << prefix << std::setw(width) << std::setfill('0') << number << ext;
+		if (!std::ifstream(name.str().c_str())) break;
+
+		Eigen::MatrixXd V;
+		Eigen::MatrixXi F;
+		if (!igl::read_triangle_mesh(name.str(), V, F)) break;
+		if (vertex_map.rows() > 0)
+		{
+			if (V.rows() != vertex_map.rows())
+			{
+				std::cerr << "ERROR (VertexSequence): " << name.str() << " does not match the first frame." << std::endl;
+				break;
+			}
+			// backwards, so welded vertices take the position of the lowest one
+			Eigen::MatrixXd CV(vertex_map.maxCoeff() + 1, 3);
+			for (int i = V.rows() - 1; i >= 0; i--)
+				if (vertex_map(i) >= 0) CV.row(vertex_map(i)) = V.row(i);
+			V.swap(CV);
+		}
+		if (nv < 0)
+		{
+			nv = V.rows();
+			if (!writer.open(cache_file, nv)) return false;
+		}
+		if (!writer.append(V))
+		{
+			std::cerr << "ERROR (VertexSequence): " << name.str() << " does not match the first frame." << std::endl;
+			break;
+		}
+	}
+
+	return writer.close();
+}
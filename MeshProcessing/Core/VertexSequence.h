@@ -0,0 +1,96 @@
+#pragma once
+#include "stdafx.h"
+#include "MappedFile.h"
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One frame of a vertex sequence, ready for upload:
+// positions and vertex normals as packed floats
+struct SequenceFrame
+{
+	int index;
+	std::vector<float> positions;
+	std::vector<float> normals;
+	SequenceFrame() : index(-1) {}
+};
+
+// Animated vertex positions sharing one set of faces, streamed from a
+// memory-mapped cache file. A background thread pages in the frames ahead
+// of the playback position and computes their normals.
+//
+// Cache layout: a 16 byte header ("MPVS", version, #V, #frames as uint32),
+// followed by the frames, each #V x 3 float32 positions.
+class VertexSequence
+{
+public:
+	VertexSequence();
+	~VertexSequence();
+
+	// map a cache file; F are the faces shared by all frames
+	bool open(const std::string& filename, const Eigen::MatrixXi& F);
+	void close();
+
+	bool is_open() const { return file_.is_open(); }
+	int frames() const { return frames_; }
+	int vertices() const { return vertices_; }
+
+	// number of frames prepared ahead of the requested one
+	void set_read_ahead(int frames);
+
+	// start preparing frame i and the following ones
+	void request(int i);
+
+	// take frame i if it is prepared; returns false otherwise.
+	// the storage previously held by frame is reused for later frames
+	bool fetch(int i, SequenceFrame& frame);
+
+	// positions of frame i in double precision
+	void frame_vertices(int i, Eigen::MatrixXd& V) const;
+
+public:
+	// write a cache file from frames given one by one
+	class Writer
+	{
+	public:
+		Writer();
+		~Writer();
+		bool open(const std::string& filename, int vertices);
+		bool append(const Eigen::MatrixXd& V);
+		bool close();
+	private:
+		FILE* file_;
+		int vertices_;
+		int frames_;
+	};
+
+	// build a cache from the numbered mesh files following the given one,
+	// e.g. anim_0001.obj, anim_0002.obj, ...; returns the cache file name.
+	// vertex_map, if given, is the clean vertex of each file vertex or -1,
+	// as in CleanupReport, and every frame is written through it
+	static bool build_cache(const std::string& first_frame, std::string& cache_file,
+		const Eigen::VectorXi& vertex_map = Eigen::VectorXi());
+
+private:
+	const float* positions(int i) const;
+	void prepare(int i, SequenceFrame& frame) const;
+	void run();
+
+private:
+	MappedFile file_;
+	int vertices_;
+	int frames_;
+	Eigen::MatrixXi F_;
+
+	std::thread worker_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	bool quit_;
+
+	int cursor_;                              // first frame wanted
+	int read_ahead_;                          // frames prepared from the cursor on
+	std::map<int, SequenceFrame> ready_;      // prepared frames
+	std::vector<SequenceFrame> free_;         // storage to reuse
+};
@@ -0,0 +1,39 @@
+// stdafx.h : include file for the MeshCore library.
+// Only standard, Eigen, ANN and libigl geometry headers: no GL, GLUT or
+// AntTweakBar, so the library links into headless tools and services.
+//
+
+#pragma once
+
+#include <iostream>
+#include <string>
+
+// eigen
+#include <Eigen/dense>
+
+// ann
+#include <ANN/ANN.h>
+
+// libigl
+#include <igl/write_triangle_mesh.h>
+#include <igl/read_triangle_mesh.h>
+#include <igl/readOBJ.h>
+#include <igl/per_face_normals.h>
+#include <igl/per_vertex_normals.h>
+#include <igl/avg_edge_length.h>
+
+
+typedef Eigen::Vector3d Vec3d;
+typedef Eigen::Vector2i Vec2i;
+
+template <typename T>
+T Min(T a, T b)
+{
+	return a > b ? b : a;
+}
+
+template <typename T>
+T Max(T a, T b)
+{
+	return a > b ? a : b;
+}
@@ -0,0 +1,79 @@
+#include "stdafx.h"
+#include "GLBuffer.h"
+#include <cstring>
+
+GLBuffer::GLBuffer(GLenum target, GLenum usage)
+: target_(target), usage_(usage), id_(0), size_(0), memory_(memstats::RENDER)
+{
+}
+
+GLBuffer::~GLBuffer()
+{
+	release();
+}
+
+void GLBuffer::set_target(GLenum target, GLenum usage)
+{
+	target_ = target;
+	usage_ = usage;
+}
+
+void GLBuffer::upload(const void* data, size_t bytes)
+{
+	size_ = bytes;
+	memory_.set(bytes);
+	if (glext::has_buffers())
+	{
+		if (!id_) glext::GenBuffers(1, &id_);
+		glext::BindBuffer(target_, id_);
+		glext::BufferData(target_, bytes, data, usage_);
+		glext::BindBuffer(target_, 0);
+	}
+	else
+	{
+		client_.resize(bytes);
+		if (bytes) memcpy(&client_[0], data, bytes);
+	}
+}
+
+void GLBuffer::update(size_t offset, const void* data, size_t bytes)
+{
+	if (offset + bytes > size_ || bytes == 0) return;
+	if (id_)
+	{
+		glext::BindBuffer(target_, id_);
+		glext::BufferSubData(target_, offset, bytes, data);
+		glext::BindBuffer(target_, 0);
+	}
+	else
+	{
+		memcpy(&client_[offset], data, bytes);
+	}
+}
+
+const void* GLBuffer::bind() const
+{
+	if (id_)
+	{
+		glext::BindBuffer(target_, id_);
+		return NULL;
+	}
+	return client_.empty() ? NULL : &client_[0];
+}
+
+void GLBuffer::unbind() const
+{
+	if (id_) glext::BindBuffer(target_, 0);
+}
+
+void GLBuffer::release()
+{
+	if (id_)
+	{
+		glext::DeleteBuffers(1, &id_);
+		id_ = 0;
+	}
+	std::vector<char>().swap(client_);
+	size_ = 0;
+	memory_.set(0);
+}
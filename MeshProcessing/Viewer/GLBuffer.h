@@ -0,0 +1,44 @@
+#pragma once
+#include "stdafx.h"
+#include "GLExt.h"
+#include "MemoryStats.h"
+#include <vector>
+
+// Vertex or index data for gl*Pointer/glDrawElements.
+// Lives in a buffer object, or in client memory when those are not supported.
+class GLBuffer
+{
+public:
+	GLBuffer(GLenum target = GL_ARRAY_BUFFER, GLenum usage = GL_STATIC_DRAW);
+	~GLBuffer();
+
+	void set_target(GLenum target, GLenum usage);
+
+	// replace the whole content
+	void upload(const void* data, size_t bytes);
+
+	// overwrite a range of the content
+	void update(size_t offset, const void* data, size_t bytes);
+
+	// bind the buffer and return the pointer to give to gl*Pointer or glDrawElements
+	const void* bind() const;
+	void unbind() const;
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	// free the storage
+	void release();
+
+private:
+	GLBuffer(const GLBuffer&);
+	GLBuffer& operator=(const GLBuffer&);
+
+private:
+	GLenum target_;
+	GLenum usage_;
+	GLuint id_;
+	size_t size_;
+	std::vector<char> client_;
+	memstats::Gauge memory_;
+};
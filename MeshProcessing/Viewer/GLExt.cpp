@@ -0,0 +1,174 @@
+#include "stdafx.h"
+#include "GLExt.h"
+#include <cstdlib>
+#include <cstring>
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#include <GL/glx.h>
+#endif
+
+namespace glext
+{
+	void (APIENTRY *GenBuffers)(GLsizei n, GLuint* buffers) = NULL;
+	void (APIENTRY *DeleteBuffers)(GLsizei n, const GLuint* buffers) = NULL;
+	void (APIENTRY *BindBuffer)(GLenum target, GLuint buffer) = NULL;
+	void (APIENTRY *BufferData)(GLenum target, ptrdiff_t size, const void* data, GLenum usage) = NULL;
+	void (APIENTRY *BufferSubData)(GLenum target, ptrdiff_t offset, ptrdiff_t size, const void* data) = NULL;
+
+	GLuint (APIENTRY *CreateShader)(GLenum type) = NULL;
+	void (APIENTRY *DeleteShader)(GLuint shader) = NULL;
+	void (APIENTRY *ShaderSource)(GLuint shader, GLsizei count, const char** strings, const GLint* lengths) = NULL;
+	void (APIENTRY *CompileShader)(GLuint shader) = NULL;
+	void (APIENTRY *GetShaderiv)(GLuint shader, GLenum pname, GLint* param) = NULL;
+	void (APIENTRY *GetShaderInfoLog)(GLuint shader, GLsizei size, GLsizei* length, char* log) = NULL;
+	GLuint (APIENTRY *CreateProgram)() = NULL;
+	void (APIENTRY *DeleteProgram)(GLuint program) = NULL;
+	void (APIENTRY *AttachShader)(GLuint program, GLuint shader) = NULL;
+	void (APIENTRY *LinkProgram)(GLuint program) = NULL;
+	void (APIENTRY *GetProgramiv)(GLuint program, GLenum pname, GLint* param) = NULL;
+	void (APIENTRY *GetProgramInfoLog)(GLuint program, GLsizei size, GLsizei* length, char* log) = NULL;
+	void (APIENTRY *UseProgram)(GLuint program) = NULL;
+	GLint (APIENTRY *GetUniformLocation)(GLuint program, const char* name) = NULL;
+	void (APIENTRY *Uniform1i)(GLint location, GLint v) = NULL;
+	void (APIENTRY *Uniform1f)(GLint location, GLfloat v) = NULL;
+	void (APIENTRY *GenerateMipmap)(GLenum target) = NULL;
+
+	static bool initialized = false;
+	static bool buffers = false;
+	static bool shaders = false;
+	static bool mipmaps = false;
+
+	// some drivers return an entry point for any name: the version or the
+	// extension must say it exists
+	static bool supported(int major, const char* extension)
+	{
+		const char* version = (const char*)glGetString(GL_VERSION);
+		const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+		return (version && atoi(version) >= major) || (extensions && strstr(extensions, extension));
+	}
+
+	// core name first, then the ARB extension name
+	static void* get_proc(const char* name)
+	{
+		std::string arb = std::string(name) + "ARB";
+		void* p = NULL;
+#if defined(_WIN32)
+		p = (void*)wglGetProcAddress(name);
+		if (p == NULL) p = (void*)wglGetProcAddress(arb.c_str());
+#elif !defined(__APPLE__)
+		p = (void*)glXGetProcAddress((const GLubyte*)name);
+		if (p == NULL) p = (void*)glXGetProcAddress((const GLubyte*)arb.c_str());
+#endif
+		return p;
+	}
+
+	template <typename T>
+	static bool load(T& fn, const char* name)
+	{
+		fn = (T)get_proc(name);
+		return fn != NULL;
+	}
+
+	bool init()
+	{
+		if (initialized) return buffers;
+		initialized = true;
+
+		buffers = load(GenBuffers, "glGenBuffers") &&
+			load(DeleteBuffers, "glDeleteBuffers") &&
+			load(BindBuffer, "glBindBuffer") &&
+			load(BufferData, "glBufferData") &&
+			load(BufferSubData, "glBufferSubData");
+
+		shaders = load(CreateShader, "glCreateShader") &&
+			load(DeleteShader, "glDeleteShader") &&
+			load(ShaderSource, "glShaderSource") &&
+			load(CompileShader, "glCompileShader") &&
+			load(GetShaderiv, "glGetShaderiv") &&
+			load(GetShaderInfoLog, "glGetShaderInfoLog") &&
+			load(CreateProgram, "glCreateProgram") &&
+			load(DeleteProgram, "glDeleteProgram") &&
+			load(AttachShader, "glAttachShader") &&
+			load(LinkProgram, "glLinkProgram") &&
+			load(GetProgramiv, "glGetProgramiv") &&
+			load(GetProgramInfoLog, "glGetProgramInfoLog") &&
+			load(UseProgram, "glUseProgram") &&
+			load(GetUniformLocation, "glGetUniformLocation") &&
+			load(Uniform1i, "glUniform1i") &&
+			load(Uniform1f, "glUniform1f");
+
+		mipmaps = (supported(3, "GL_ARB_framebuffer_object") && load(GenerateMipmap, "glGenerateMipmap")) ||
+			(supported(3, "GL_EXT_framebuffer_object") && load(GenerateMipmap, "glGenerateMipmapEXT"));
+
+		if (!buffers)
+			std::cerr << "WARNING (glext): Buffer objects are not supported, using client memory." << std::endl;
+		return buffers;
+	}
+
+	bool has_buffers()
+	{
+		return init();
+	}
+
+	bool has_shaders()
+	{
+		init();
+		return shaders;
+	}
+
+	bool has_generate_mipmap()
+	{
+		init();
+		return mipmaps;
+	}
+
+	static GLuint compile(GLenum type, const char* source)
+	{
+		GLuint shader = CreateShader(type);
+		ShaderSource(shader, 1, &source, NULL);
+		CompileShader(shader);
+
+		GLint ok = 0;
+		GetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+		if (!ok)
+		{
+			char log[1024];
+			GetShaderInfoLog(shader, sizeof(log), NULL, log);
+			std::cerr << "ERROR (glext): Shader compilation failed\n" << log << std::endl;
+			DeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+
+	GLuint build_program(const char* vertex_source, const char* fragment_source)
+	{
+		if (!has_shaders()) return 0;
+		GLuint vs = compile(GL_VERTEX_SHADER, vertex_source);
+		GLuint fs = compile(GL_FRAGMENT_SHADER, fragment_source);
+		GLuint program = 0;
+		if (vs && fs)
+		{
+			program = CreateProgram();
+			AttachShader(program, vs);
+			AttachShader(program, fs);
+			LinkProgram(program);
+
+			GLint ok = 0;
+			GetProgramiv(program, GL_LINK_STATUS, &ok);
+			if (!ok)
+			{
+				char log[1024];
+				GetProgramInfoLog(program, sizeof(log), NULL, log);
+				std::cerr << "ERROR (glext): Program link failed\n" << log << std::endl;
+				DeleteProgram(program);
+				program = 0;
+			}
+		}
+
+		// the program keeps them alive
+		if (vs) DeleteShader(vs);
+		if (fs) DeleteShader(fs);
+		return program;
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "stdafx.h"
+#include <cstddef>
+
+// Entry points above OpenGL 1.1, where the Windows headers stop.
+// They are resolved at run time, the first time init() is called with a current context.
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER                   0x8892
+#define GL_ELEMENT_ARRAY_BUFFER           0x8893
+#define GL_STREAM_DRAW                    0x88E0
+#define GL_STATIC_DRAW                    0x88E4
+#define GL_DYNAMIC_DRAW                   0x88E8
+#endif
+
+#ifndef GL_VERTEX_SHADER
+#define GL_FRAGMENT_SHADER                0x8B30
+#define GL_VERTEX_SHADER                  0x8B31
+#define GL_COMPILE_STATUS                 0x8B81
+#define GL_LINK_STATUS                    0x8B82
+#define GL_VERTEX_PROGRAM_POINT_SIZE      0x8642
+#define GL_POINT_SPRITE                   0x8861
+#endif
+
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE                  0x812F
+#endif
+
+namespace glext
+{
+	// resolve the entry points; returns false if buffer objects are not supported
+	bool init();
+
+	// true if buffer objects can be used, resolves the entry points on first use
+	bool has_buffers();
+
+	extern void (APIENTRY *GenBuffers)(GLsizei n, GLuint* buffers);
+	extern void (APIENTRY *DeleteBuffers)(GLsizei n, const GLuint* buffers);
+	extern void (APIENTRY *BindBuffer)(GLenum target, GLuint buffer);
+	extern void (APIENTRY *BufferData)(GLenum target, ptrdiff_t size, const void* data, GLenum usage);
+	extern void (APIENTRY *BufferSubData)(GLenum target, ptrdiff_t offset, ptrdiff_t size, const void* data);
+
+	// true if GLSL programs (OpenGL 2.0) can be used
+	bool has_shaders();
+
+	// compile and link a program, 0 on failure
+	GLuint build_program(const char* vertex_source, const char* fragment_source);
+
+	extern GLuint (APIENTRY *CreateShader)(GLenum type);
+	extern void (APIENTRY *DeleteShader)(GLuint shader);
+	extern void (APIENTRY *ShaderSource)(GLuint shader, GLsizei count, const char** strings, const GLint* lengths);
+	extern void (APIENTRY *CompileShader)(GLuint shader);
+	extern void (APIENTRY *GetShaderiv)(GLuint shader, GLenum pname, GLint* param);
+	extern void (APIENTRY *GetShaderInfoLog)(GLuint shader, GLsizei size, GLsizei* length, char* log);
+	extern GLuint (APIENTRY *CreateProgram)();
+	extern void (APIENTRY *DeleteProgram)(GLuint program);
+	extern void (APIENTRY *AttachShader)(GLuint program, GLuint shader);
+	extern void (APIENTRY *LinkProgram)(GLuint program);
+	extern void (APIENTRY *GetProgramiv)(GLuint program, GLenum pname, GLint* param);
+	extern void (APIENTRY *GetProgramInfoLog)(GLuint program, GLsizei size, GLsizei* length, char* log);
+	extern void (APIENTRY *UseProgram)(GLuint program);
+	extern GLint (APIENTRY *GetUniformLocation)(GLuint program, const char* name);
+	extern void (APIENTRY *Uniform1i)(GLint location, GLint v);
+	extern void (APIENTRY *Uniform1f)(GLint location, GLfloat v);
+
+	// true if mipmaps can be generated on the GPU (OpenGL 3.0 or framebuffer objects)
+	bool has_generate_mipmap();
+
+	extern void (APIENTRY *GenerateMipmap)(GLenum target);
+}
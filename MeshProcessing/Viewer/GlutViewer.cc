@@ -41,6 +41,10 @@ GlutViewer::GlutViewer(const char* _title, int _width, int _height)
 	// not full screen
 	fullscreen_ = false;
 
+	recording_ = false;
+	record_start_ = 0;
+	replay_frame_ = REPLAY_OFF;
+
 	current_viewer_ = this;
 }
   
@@ -57,6 +61,7 @@ void GlutViewer::launch(void)
 	setup_view();
 	setup_anttweakbar();
 	setup_scene(Vec3d(0.0, 0.0, 0.0), 1);
+	setup_session();
 
 	glutMainLoop();
 }
@@ -98,11 +103,15 @@ void GlutViewer::setup_anttweakbar(void)
 	TwDefine(" TweakBar size='200 400' color='76 76 127' refresh=0.5"); // change default tweak bar size and color
 
 	// draw mode
-	TwEnumVal DrawmodeEV[4] = { { HIDDEN_LINE, "Hidden Line" }, { WIRE_FRAME, "Wire Frame" },
-	{ SOLID_FLAT, "Solid Flat" }, { SOLID_SMOOTH, "Solid Smooth" } };
-	TwType DrwamodeType = TwDefineEnum("DrawMode", DrawmodeEV, 4);
+	TwEnumVal DrawmodeEV[5] = { { HIDDEN_LINE, "Hidden Line" }, { WIRE_FRAME, "Wire Frame" },
+	{ SOLID_FLAT, "Solid Flat" }, { SOLID_SMOOTH, "Solid Smooth" }, { FEATURE_EDGES, "Feature Edges" } };
+	TwType DrwamodeType = TwDefineEnum("DrawMode", DrawmodeEV, 5);
 	TwAddVarRW(bar_, "Draw Mode", DrwamodeType, &draw_mode_, "group = 'Draw'");
 
+	// camera paths
+	TwAddVarCB(bar_, "Record Camera", TW_TYPE_BOOLCPP, tw_set_recording, tw_get_recording, this, "group = 'Camera'");
+	TwAddButton(bar_, "Replay Camera", tw_replay, this, "group = 'Camera'");
+
 	
 	// 	Called after glutMainLoop ends
 	atexit(terminate__);
@@ -224,7 +233,7 @@ void GlutViewer::draw()
 		glDepthRange(0.0, 1.0);
 		glutWireTeapot(0.5);
 	}
-	else if (draw_mode_ == SOLID_SMOOTH)
+	else if (draw_mode_ == SOLID_SMOOTH || draw_mode_ == FEATURE_EDGES)
 	{
 		glEnable(GL_LIGHTING);
 		glShadeModel(GL_SMOOTH);
@@ -388,16 +397,121 @@ void GlutViewer::keyboard(int key, int x, int y)
 void GlutViewer::passivemotion(int x, int y) {}
 void GlutViewer::visibility(int visible) {}
 void GlutViewer::idle(void) {} 
+void GlutViewer::timer(int) {}
+
+void GlutViewer::start_timer(int msecs, int value)
+{
+	glutTimerFunc(msecs, timer__, value);
+}
+
+// -----------
+// camera recording and replay
+void GlutViewer::start_recording()
+{
+	if (is_replaying()) return;
+	path_.clear();
+	recording_ = true;
+	record_start_ = precise_seconds();
+	glutPostRedisplay();
+}
+
+bool GlutViewer::stop_recording(const std::string& _filename)
+{
+	if (!recording_) return false;
+	recording_ = false;
+	std::cout << "Recorded " << path_.size() << " frames" << std::endl;
+	return path_.save(_filename);
+}
+
+void GlutViewer::record_frame()
+{
+	CameraKey key;
+	key.time = precise_seconds() - record_start_;
+	for (int i = 0; i < 16; i++)
+		key.rotation[i] = rotation_matrix_[i];
+	key.trans = trans_;
+	key.draw_mode = draw_mode_;
+	key.width = width_;
+	key.height = height_;
+	path_.add(key);
+}
+
+bool GlutViewer::start_replay(const std::string& _path_file, const std::string& _report_file)
+{
+	if (recording_ || is_replaying()) return false;
+	if (!path_.load(_path_file)) return false;
+	if (path_.empty())
+	{
+		std::cerr << "ERROR (start_replay): " << _path_file << " has no frames." << std::endl;
+		return false;
+	}
+
+	// the views only match in a window of the recorded size
+	if (path_[0].width != width_ || path_[0].height != height_)
+		glutReshapeWindow(path_[0].width, path_[0].height);
+
+	frame_ms_.clear();
+	frame_ms_.reserve(path_.size());
+	replay_report_ = _report_file;
+	replay_frame_ = REPLAY_WARMUP;
+	glutPostRedisplay();
+	return true;
+}
+
+void GlutViewer::replay_frame()
+{
+	const CameraKey& key = path_[Max(replay_frame_, 0)];
+	for (int i = 0; i < 16; i++)
+		rotation_matrix_[i] = key.rotation[i];
+	trans_ = key.trans;
+	draw_mode_ = (DrawMode)key.draw_mode;
+
+	// time the frame alone: the previous one is finished first
+	glFinish();
+	double start = precise_seconds();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	apply_modelview_matrix();
+	draw();
+	glFinish();
+	double ms = 1000.0 * (precise_seconds() - start);
+	glutSwapBuffers();
+
+	// the first frame uploads the buffers, it is drawn again timed
+	if (replay_frame_ >= 0) frame_ms_.push_back(ms);
+	if (++replay_frame_ < path_.size())
+	{
+		glutPostRedisplay();
+		return;
+	}
+
+	replay_frame_ = REPLAY_OFF;
+	FrameTimeStats stats = frame_time_stats(frame_ms_);
+	std::cout << "Replay: " << stats.frames << " frames, mean " << stats.mean << " ms, p50 " << stats.p50
+		<< " ms, p95 " << stats.p95 << " ms, p99 " << stats.p99 << " ms, max " << stats.max << " ms" << std::endl;
+	if (!replay_report_.empty())
+		write_frame_times(replay_report_, frame_ms_);
+	replay_finished(stats);
+	glutPostRedisplay();
+}
 
 // -----------
 // static function, just interface
 void GlutViewer::display__(void) 
 {
+	if (current_viewer_->is_replaying())
+	{
+		current_viewer_->replay_frame();
+		return;
+	}
+
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	current_viewer_->apply_modelview_matrix();
 	current_viewer_->draw();
 	TwDraw();	// Draw tweak bars
 	glutSwapBuffers();
+
+	if (current_viewer_->recording_)
+		current_viewer_->record_frame();
 }
 
 void GlutViewer::idle__(void) {
@@ -464,8 +578,41 @@ void GlutViewer::visibility__(int visible) {
 	current_viewer_->visibility(visible);
 }
 
+void GlutViewer::timer__(int value) {
+	current_viewer_->timer(value);
+}
+
 void GlutViewer::terminate__()
 {
 	//TwTerminate();
 
-}
\ No newline at end of file
+}
+
+void GlutViewer::tw_set_recording(const void *_value, void *_clientData)
+{
+	GlutViewer* viewer = (GlutViewer*)_clientData;
+	if (*(const bool*)_value)
+		viewer->start_recording();
+	else if (viewer->recording_)
+	{
+		std::string filename = igl::file_dialog_save();
+		if (filename.empty()) viewer->recording_ = false;
+		else viewer->stop_recording(filename);
+	}
+}
+
+void GlutViewer::tw_get_recording(void *_value, void *_clientData)
+{
+	GlutViewer* viewer = (GlutViewer*)_clientData;
+	*(bool*)_value = viewer->recording_;
+}
+
+void GlutViewer::tw_replay(void *_clientData)
+{
+	std::string filename = igl::file_dialog_open();
+	if (!filename.empty())
+	{
+		GlutViewer* viewer = (GlutViewer*)_clientData;
+		viewer->start_replay(filename);
+	}
+}
@@ -1,8 +1,9 @@
 
 #pragma once
 #include "stdafx.h"
+#include "CameraPath.h"
 
-typedef enum { HIDDEN_LINE = 1, WIRE_FRAME, SOLID_FLAT, SOLID_SMOOTH} DrawMode;
+typedef enum { HIDDEN_LINE = 1, WIRE_FRAME, SOLID_FLAT, SOLID_SMOOTH, FEATURE_EDGES } DrawMode;
 
 class GlutViewer
 {
@@ -25,6 +26,25 @@ protected:
 	virtual void passivemotion(int x, int y);
 	virtual void visibility(int visible);
 	virtual void idle(void); 
+	virtual void timer(int value);
+
+	// call timer(value) once after the given delay
+	void start_timer(int msecs, int value = 0);
+
+	// called by launch() once the window and the tweak bar exist
+	virtual void setup_session() {}
+
+	// record the view of every drawn frame, until stop_recording saves them
+	void start_recording();
+	bool stop_recording(const std::string& _filename);
+	bool is_recording() const { return recording_; }
+
+	// draw the frames of a camera path one after the other, once untimed then
+	// timed up to glFinish; the frame times are printed and, if report_file
+	// is given, written there
+	bool start_replay(const std::string& _path_file, const std::string& _report_file = "");
+	bool is_replaying() const { return replay_frame_ > REPLAY_OFF; }
+	virtual void replay_finished(const FrameTimeStats&) {}
 
 private:
 	void rotation(int x, int y);
@@ -35,6 +55,9 @@ private:
 	void apply_modelview_matrix();
 	Vec3d map_to_sphere(const Vec2i& _point);
 
+	void record_frame();
+	void replay_frame();
+
 private:
 	static void display__(void);
 	static void idle__(void); 
@@ -45,7 +68,11 @@ private:
 	static void reshape__(int w, int h); 
 	static void special__(int key, int x, int y);   
 	static void visibility__(int visible);
+	static void timer__(int value);
 	static void terminate__();
+	static void TW_CALL tw_set_recording(const void *_value, void *_clientData);
+	static void TW_CALL tw_get_recording(void *_value, void *_clientData);
+	static void TW_CALL tw_replay(void *_clientData);
 
 protected:
 	// screen width and height and title
@@ -83,4 +110,14 @@ private:
 
 	bool fullscreen_;
 	int  bak_left_, bak_top_, bak_width_, bak_height_;
+
+	// camera recording and replay; replay_frame_ is the key drawn next,
+	// REPLAY_WARMUP for the untimed first frame
+	enum { REPLAY_OFF = -2, REPLAY_WARMUP = -1 };
+	CameraPath path_;
+	bool recording_;
+	double record_start_;
+	int replay_frame_;
+	std::vector<double> frame_ms_;
+	std::string replay_report_;
 };
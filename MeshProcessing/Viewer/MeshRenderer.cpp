@@ -0,0 +1,992 @@
+#include "stdafx.h"
+#include "MeshRenderer.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+	// Splats: the point sprite covers the disc of the point, and fragments
+	// outside the disc tilted along the normal are discarded.
+	// Lit by a two sided headlight, colored like the triangles.
+	const char* splat_vertex_shader =
+		"#version 120\n"
+		"uniform float radius;\n"
+		"uniform float scale;\n"
+		"varying vec3 normal;\n"
+		"varying float scalar;\n"
+		"void main()\n"
+		"{\n"
+		"	vec4 eye = gl_ModelViewMatrix * gl_Vertex;\n"
+		"	gl_Position = gl_ProjectionMatrix * eye;\n"
+		"	gl_ClipVertex = eye;\n"
+		"	gl_PointSize = max(2.0 * radius * scale / max(-eye.z, 1e-6), 1.0);\n"
+		"	normal = gl_NormalMatrix * gl_Normal;\n"
+		"	scalar = (gl_TextureMatrix[0] * vec4(gl_MultiTexCoord0.x, 0.0, 0.0, 1.0)).x;\n"
+		"	gl_FrontColor = gl_Color;\n"
+		"}\n";
+
+	const char* splat_fragment_shader =
+		"#version 120\n"
+		"uniform sampler1D colormap;\n"
+		"uniform int use_colormap;\n"
+		"varying vec3 normal;\n"
+		"varying float scalar;\n"
+		"void main()\n"
+		"{\n"
+		"	vec2 c = 2.0 * gl_PointCoord - 1.0;\n"
+		"	c.y = -c.y;\n"
+		"	vec3 n = normalize(normal);\n"
+		"	float dz = -(n.x * c.x + n.y * c.y) / max(abs(n.z), 0.3);\n"
+		"	if (dot(c, c) + dz * dz > 1.0) discard;\n"
+		"	vec4 base = use_colormap != 0 ? texture1D(colormap, scalar) : gl_Color;\n"
+		"	gl_FragColor = vec4(base.rgb * (0.2 + 0.8 * abs(n.z)), 1.0);\n"
+		"}\n";
+
+	// Selection markers: spheres drawn on point sprites. The fragment finds
+	// its point on the sphere, shades it with a headlight and writes its depth,
+	// so markers cut into the surface like real spheres.
+	const char* marker_vertex_shader =
+		"#version 120\n"
+		"uniform float radius;\n"
+		"uniform float scale;\n"
+		"varying vec3 center;\n"
+		"void main()\n"
+		"{\n"
+		"	vec4 eye = gl_ModelViewMatrix * gl_Vertex;\n"
+		"	center = eye.xyz / eye.w;\n"
+		"	gl_Position = gl_ProjectionMatrix * eye;\n"
+		"	gl_PointSize = max(2.0 * radius * scale / max(-center.z, 1e-6), 1.0);\n"
+		"	gl_FrontColor = gl_Color;\n"
+		"}\n";
+
+	const char* marker_fragment_shader =
+		"#version 120\n"
+		"uniform float radius;\n"
+		"varying vec3 center;\n"
+		"void main()\n"
+		"{\n"
+		"	vec2 c = 2.0 * gl_PointCoord - 1.0;\n"
+		"	c.y = -c.y;\n"
+		"	float r2 = dot(c, c);\n"
+		"	if (r2 > 1.0) discard;\n"
+		"	vec3 n = vec3(c, sqrt(1.0 - r2));\n"
+		"	vec4 clip = gl_ProjectionMatrix * vec4(center + radius * n, 1.0);\n"
+		"	float z = 0.5 * clip.z / clip.w + 0.5;\n"
+		"	gl_FragDepth = gl_DepthRange.near + gl_DepthRange.diff * z;\n"
+		"	gl_FragColor = vec4(gl_Color.rgb * (0.3 + 0.7 * n.z), 1.0);\n"
+		"}\n";
+
+	// reverse the low bits of i
+	uint32_t reverse_bits(uint32_t i, int bits)
+	{
+		static unsigned char table[256];
+		static bool ready = false;
+		if (!ready)
+		{
+			for (int b = 0; b < 256; b++)
+			{
+				unsigned char r = 0;
+				for (int j = 0; j < 8; j++)
+					if (b & (1 << j)) r |= (unsigned char)(1 << (7 - j));
+				table[b] = r;
+			}
+			ready = true;
+		}
+		uint32_t r = (uint32_t(table[i & 0xff]) << 24) | (uint32_t(table[(i >> 8) & 0xff]) << 16) |
+			(uint32_t(table[(i >> 16) & 0xff]) << 8) | uint32_t(table[i >> 24]);
+		return bits == 0 ? 0 : r >> (32 - bits);
+	}
+
+	// call put(j, i) for the points i < n in bit reversed order, j being
+	// the position in that order; runs on all cores
+	template <typename Put>
+	void for_each_reversed(int n, const Put& put)
+	{
+		int bits = 0;
+		while ((int64_t(1) << bits) < n) bits++;
+		reverse_bits(0, bits);
+
+		// positions of the blocks are known once the points < n in each are counted
+		const int block = 1 << 16;
+		int64_t total = int64_t(1) << bits;
+		int blocks = int((total + block - 1) / block);
+		std::vector<int> first(blocks + 1, 0);
+		parallel_for(0, blocks, [&](int b, int e) {
+			for (int k = b; k < e; k++)
+			{
+				int count = 0;
+				int64_t hi = Min(total, int64_t(k + 1) * block);
+				for (int64_t j = int64_t(k) * block; j < hi; j++)
+					if ((int)reverse_bits(uint32_t(j), bits) < n) count++;
+				first[k + 1] = count;
+			}
+		}, 1);
+		for (int k = 0; k < blocks; k++)
+			first[k + 1] += first[k];
+
+		parallel_for(0, blocks, [&](int b, int e) {
+			for (int k = b; k < e; k++)
+			{
+				int pos = first[k];
+				int64_t hi = Min(total, int64_t(k + 1) * block);
+				for (int64_t j = int64_t(k) * block; j < hi; j++)
+				{
+					int i = (int)reverse_bits(uint32_t(j), bits);
+					if (i < n) put(pos++, i);
+				}
+			}
+		}, 1);
+	}
+}
+
+MeshRenderer::MeshRenderer()
+: parts_stamp_(0), frame_(-1), marker_count_(0), selected_count_(0), selection_valid_(false),
+marker_program_(0), marker_tried_(false), edge_count_(0), edges_valid_(false), edge_angle_(0), edge_parts_stamp_(0),
+overlay_count_(0), splat_program_(0), splat_tried_(false), colormap_texture_(0), colormap_(COLORMAP_JET),
+colormap_dirty_(true), scalar_lo_(0.0), scalar_hi_(1.0)
+{
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		valid_[i] = false;
+		buffers_[i].set_target(GL_ARRAY_BUFFER, GL_STATIC_DRAW);
+	}
+	buffers_[IDX].set_target(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+	buffers_[PART_IDX].set_target(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+	buffers_[C_PART_IDX].set_target(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+	selected_idx_.set_target(GL_ELEMENT_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+	marker_pos_.set_target(GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+	sphere_idx_.set_target(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+	edge_idx_.set_target(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+	overlay_idx_.set_target(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+
+	// colors and scalars change often
+	buffers_[COL].set_target(GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+	buffers_[SCAL].set_target(GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+	buffers_[C_COL].set_target(GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+	buffers_[C_SCAL].set_target(GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+	buffers_[P_COL].set_target(GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+	buffers_[P_SCAL].set_target(GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+
+	// animation frames are written once and drawn once
+	for (int i = 0; i < 2; i++)
+	{
+		frame_pos_[i].set_target(GL_ARRAY_BUFFER, GL_STREAM_DRAW);
+		frame_nrm_[i].set_target(GL_ARRAY_BUFFER, GL_STREAM_DRAW);
+	}
+}
+
+unsigned MeshRenderer::invalidate(unsigned dirty)
+{
+	const unsigned handled = MeshData::DIRTY_POSITION | MeshData::DIRTY_UV | MeshData::DIRTY_NORMAL |
+		MeshData::DIRTY_AMBIENT | MeshData::DIRTY_DIFFUSE | MeshData::DIRTY_SPECULAR |
+		MeshData::DIRTY_FACE | MeshData::DIRTY_SCALAR | MeshData::DIRTY_SELECTION;
+
+	// markers sit on the vertices, selected faces index the triangles
+	if (dirty & (MeshData::DIRTY_SELECTION | MeshData::DIRTY_POSITION | MeshData::DIRTY_FACE))
+		selection_valid_ = false;
+
+	if (dirty & MeshData::DIRTY_FACE)
+	{
+		// new topology, every stream has to be rebuilt
+		for (int i = 0; i < STREAM_COUNT; i++) valid_[i] = false;
+		edges_valid_ = false;
+		return dirty & handled;
+	}
+
+	// feature edges follow the face normals
+	if ((dirty & (MeshData::DIRTY_POSITION | MeshData::DIRTY_NORMAL)) && edge_angle_ > 0)
+		edges_valid_ = false;
+
+	if (dirty & MeshData::DIRTY_POSITION)
+		valid_[POS] = valid_[C_POS] = valid_[P_POS] = false;
+	if (dirty & MeshData::DIRTY_NORMAL)
+		valid_[NRM] = valid_[C_FNRM] = valid_[C_VNRM] = valid_[P_NRM] = false;
+	if (dirty & MeshData::DIRTY_DIFFUSE)
+		valid_[COL] = valid_[C_COL] = valid_[P_COL] = false;
+	if (dirty & MeshData::DIRTY_SCALAR)
+		valid_[SCAL] = valid_[C_SCAL] = valid_[P_SCAL] = false;
+	if (dirty & MeshData::DIRTY_UV)
+		valid_[UV] = valid_[C_UV] = false;
+
+	return dirty & handled;
+}
+
+void MeshRenderer::set_colormap(ColorMapType type)
+{
+	if (type != colormap_)
+	{
+		colormap_ = type;
+		colormap_dirty_ = true;
+	}
+}
+
+void MeshRenderer::set_scalar_range(double lo, double hi)
+{
+	scalar_lo_ = lo;
+	scalar_hi_ = hi;
+}
+
+void MeshRenderer::upload_frame(const float* positions, const float* normals, int nv)
+{
+	frame_ = frame_ == 0 ? 1 : 0;
+	size_t bytes = size_t(nv) * 3 * sizeof(float);
+	frame_pos_[frame_].upload(positions, bytes);
+	frame_nrm_[frame_].upload(normals, bytes);
+}
+
+void MeshRenderer::end_frames()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		frame_pos_[i].release();
+		frame_nrm_[i].release();
+	}
+	frame_ = -1;
+}
+
+void MeshRenderer::release()
+{
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		buffers_[i].release();
+		valid_[i] = false;
+	}
+	end_frames();
+	if (colormap_texture_)
+	{
+		glDeleteTextures(1, &colormap_texture_);
+		colormap_texture_ = 0;
+	}
+	colormap_dirty_ = true;
+	marker_pos_.release();
+	selected_idx_.release();
+	edge_idx_.release();
+	edge_count_ = 0;
+	edges_valid_ = false;
+	overlay_pos_.release();
+	overlay_idx_.release();
+	overlay_count_ = 0;
+	sphere_pos_.release();
+	sphere_idx_.release();
+	marker_count_ = selected_count_ = 0;
+	selection_valid_ = false;
+	if (marker_program_)
+		glext::DeleteProgram(marker_program_);
+	marker_program_ = 0;
+	marker_tried_ = false;
+	if (splat_program_)
+		glext::DeleteProgram(splat_program_);
+	splat_program_ = 0;
+	splat_tried_ = false;
+}
+
+const void* MeshRenderer::use(const MeshData& mesh, Stream s)
+{
+	if (!valid_[s])
+	{
+		build(mesh, s);
+		valid_[s] = true;
+	}
+	return buffers_[s].bind();
+}
+
+// row r of M as floats, or the fallback when M has no such row
+static void put_row(const Eigen::MatrixXd& M, int r, int cols, float* out, float fallback = 0.0f)
+{
+	bool valid = r < M.rows() && M.cols() >= cols;
+	for (int j = 0; j < cols; j++)
+		out[j] = valid ? (float)M(r, j) : fallback;
+}
+
+static void put_color(const Eigen::MatrixXd& C, int r, unsigned char* out)
+{
+	for (int j = 0; j < 3; j++)
+	{
+		double c = r < C.rows() ? C(r, j) : 0.6;
+		out[j] = (unsigned char)(Min(Max(c, 0.0), 1.0) * 255 + 0.5);
+	}
+	out[3] = 255;
+}
+
+// sorted unique items, split into runs [first, last] with short gaps
+static void moved_runs(std::vector<int> items, std::vector<Vec2i>& runs)
+{
+	std::sort(items.begin(), items.end());
+	items.erase(std::unique(items.begin(), items.end()), items.end());
+
+	// rewriting a few unchanged entries is cheaper than another call
+	const int gap = 32;
+	runs.clear();
+	for (size_t j = 0; j < items.size(); j++)
+	{
+		if (runs.empty() || items[j] > runs.back()[1] + gap)
+			runs.push_back(Vec2i(items[j], items[j]));
+		else
+			runs.back()[1] = items[j];
+	}
+}
+
+void MeshRenderer::upload_moved(const MeshData& mesh)
+{
+	if (mesh.moved_vertices.empty() && mesh.moved_faces.empty()) return;
+	valid_[P_POS] = valid_[P_NRM] = false;
+	selection_valid_ = false;
+	if (edge_angle_ > 0 && !mesh.moved_faces.empty())
+		edges_valid_ = false;
+
+	std::vector<Vec2i> runs;
+	std::vector<float> f;
+
+	// indexed streams, one entry per vertex
+	moved_runs(mesh.moved_vertices, runs);
+	for (int s = POS; s <= NRM; s++)
+	{
+		if (!valid_[s]) continue;
+		const Eigen::MatrixXd& M = s == POS ? mesh.V : mesh.V_normals;
+		for (size_t r = 0; r < runs.size(); r++)
+		{
+			int first = runs[r][0], count = runs[r][1] - first + 1;
+			f.resize(size_t(count) * 3);
+			for (int i = 0; i < count; i++)
+				put_row(M, first + i, 3, &f[size_t(i) * 3]);
+			buffers_[s].update(size_t(first) * 3 * sizeof(float), &f[0], f.size() * sizeof(float));
+		}
+	}
+
+	// unrolled streams, three corners per face
+	moved_runs(mesh.moved_faces, runs);
+	const Eigen::MatrixXi& F = mesh.F;
+	for (int s = C_POS; s <= C_VNRM; s++)
+	{
+		if (!valid_[s]) continue;
+		for (size_t r = 0; r < runs.size(); r++)
+		{
+			int first = runs[r][0], count = runs[r][1] - first + 1;
+			f.resize(size_t(count) * 9);
+			for (int i = 0; i < count; i++)
+			{
+				int face = first + i;
+				for (int j = 0; j < 3; j++)
+				{
+					float* out = &f[(3 * size_t(i) + j) * 3];
+					if (s == C_POS) put_row(mesh.V, F(face, j), 3, out);
+					else if (s == C_VNRM) put_row(mesh.V_normals, F(face, j), 3, out);
+					else put_row(mesh.F_normals, face, 3, out);
+				}
+			}
+			buffers_[s].update(size_t(first) * 9 * sizeof(float), &f[0], f.size() * sizeof(float));
+		}
+	}
+}
+
+void MeshRenderer::build_points(const MeshData& mesh, Stream s)
+{
+	const Eigen::MatrixXd& V = mesh.V;
+	int nv = V.rows();
+	GLBuffer& buffer = buffers_[s];
+
+	switch (s)
+	{
+	case P_POS:
+	{
+		std::vector<float> f(size_t(nv) * 3);
+		for_each_reversed(nv, [&](int j, int i) { put_row(V, i, 3, &f[size_t(j) * 3]); });
+		buffer.upload(f.empty() ? NULL : &f[0], f.size() * sizeof(float));
+		break;
+	}
+	case P_NRM:
+	{
+		// signed bytes, padded to 4 for alignment
+		const Eigen::MatrixXd& N = mesh.V_normals;
+		std::vector<signed char> b(size_t(nv) * 4, 0);
+		for_each_reversed(nv, [&](int j, int i) {
+			for (int a = 0; a < 3 && i < N.rows(); a++)
+				b[size_t(j) * 4 + a] = (signed char)(Min(Max(N(i, a), -1.0), 1.0) * 127);
+		});
+		buffer.upload(b.empty() ? NULL : &b[0], b.size());
+		break;
+	}
+	case P_COL:
+	{
+		std::vector<unsigned char> b(size_t(nv) * 4);
+		for_each_reversed(nv, [&](int j, int i) { put_color(mesh.V_material_diffuse, i, &b[size_t(j) * 4]); });
+		buffer.upload(b.empty() ? NULL : &b[0], b.size());
+		break;
+	}
+	case P_SCAL:
+	{
+		std::vector<float> f(nv, 0.0f);
+		const Eigen::VectorXd& S = mesh.V_scalar;
+		for_each_reversed(nv, [&](int j, int i) { if (i < S.rows()) f[j] = (float)S(i); });
+		buffer.upload(f.empty() ? NULL : &f[0], f.size() * sizeof(float));
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void MeshRenderer::build(const MeshData& mesh, Stream s)
+{
+	if (s >= P_POS)
+	{
+		build_points(mesh, s);
+		return;
+	}
+
+	const Eigen::MatrixXd& V = mesh.V;
+	const Eigen::MatrixXi& F = mesh.F;
+	int nv = V.rows();
+	int nf = F.rows();
+	int nc = 3 * nf;
+
+	bool face_colors = mesh.face_based && mesh.F_material_diffuse.rows() == nf;
+	bool corner_uv = mesh.F_uv.rows() == nf;
+
+	std::vector<float> f;
+	std::vector<unsigned char> b;
+	std::vector<unsigned int> idx;
+
+	switch (s)
+	{
+	case POS:
+	case NRM:
+	case UV:
+	{
+		int cols = s == UV ? 2 : 3;
+		const Eigen::MatrixXd& M = s == POS ? V : (s == NRM ? mesh.V_normals : mesh.V_uv);
+		f.resize(size_t(nv) * cols);
+		for (int i = 0; i < nv; i++)
+			put_row(M, i, cols, &f[size_t(i) * cols]);
+		break;
+	}
+	case COL:
+		b.resize(size_t(nv) * 4);
+		for (int i = 0; i < nv; i++)
+			put_color(mesh.V_material_diffuse, i, &b[size_t(i) * 4]);
+		break;
+	case SCAL:
+		f.resize(nv, 0.0f);
+		for (int i = 0; i < nv && i < mesh.V_scalar.rows(); i++)
+			f[i] = (float)mesh.V_scalar(i);
+		break;
+	case IDX:
+		idx.resize(nc);
+		for (int i = 0; i < nf; i++)
+			for (int j = 0; j < 3; j++)
+				idx[3 * i + j] = F(i, j);
+		break;
+	case PART_IDX:
+	case C_PART_IDX:
+	{
+		const std::vector<int>& order = mesh.components.face_order();
+		idx.resize(nc);
+		for (int i = 0; i < nf && i < (int)order.size(); i++)
+			for (int j = 0; j < 3; j++)
+				idx[3 * i + j] = s == PART_IDX ? F(order[i], j) : 3 * order[i] + j;
+		break;
+	}
+	case C_POS:
+	case C_VNRM:
+	case C_FNRM:
+	case C_UV:
+	{
+		int cols = s == C_UV ? 2 : 3;
+		f.resize(size_t(nc) * cols);
+		for (int i = 0; i < nf; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				float* out = &f[(3 * size_t(i) + j) * cols];
+				if (s == C_POS) put_row(V, F(i, j), 3, out);
+				else if (s == C_VNRM) put_row(mesh.V_normals, F(i, j), 3, out);
+				else if (s == C_FNRM) put_row(mesh.F_normals, i, 3, out);
+				else put_row(mesh.V_uv, corner_uv ? mesh.F_uv(i, j) : F(i, j), 2, out);
+			}
+		}
+		break;
+	}
+	case C_COL:
+		b.resize(size_t(nc) * 4);
+		for (int i = 0; i < nf; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				unsigned char* out = &b[(3 * size_t(i) + j) * 4];
+				if (face_colors) put_color(mesh.F_material_diffuse, i, out);
+				else put_color(mesh.V_material_diffuse, F(i, j), out);
+			}
+		}
+		break;
+	case C_SCAL:
+		f.resize(nc, 0.0f);
+		for (int i = 0; i < nc; i++)
+		{
+			int iv = F(i / 3, i % 3);
+			if (iv < mesh.V_scalar.rows()) f[i] = (float)mesh.V_scalar(iv);
+		}
+		break;
+	default:
+		break;
+	}
+
+	GLBuffer& buffer = buffers_[s];
+	if (!f.empty()) buffer.upload(&f[0], f.size() * sizeof(float));
+	else if (!b.empty()) buffer.upload(&b[0], b.size());
+	else if (!idx.empty()) buffer.upload(&idx[0], idx.size() * sizeof(unsigned int));
+	else buffer.release();
+}
+
+void MeshRenderer::draw(const MeshData& mesh, Shading shading, ColorSource color, GLuint texture)
+{
+	int nf = mesh.F.rows();
+	if (nf == 0) return;
+
+	// hidden components leave runs of faces to draw
+	const MeshComponents& parts = mesh.components;
+	bool partial = parts.hidden() > 0 && (int)parts.face_order().size() == nf;
+	if (partial && parts.visible_runs().empty()) return;
+	if (partial && parts.stamp() != parts_stamp_)
+	{
+		valid_[PART_IDX] = valid_[C_PART_IDX] = false;
+		parts_stamp_ = parts.stamp();
+	}
+
+	// per face colors and per corner uvs need the unrolled layout
+	bool face_colors = color == COLOR_DIFFUSE && mesh.face_based && mesh.F_material_diffuse.rows() == nf;
+	bool corner_uv = color == COLOR_TEXTURE && mesh.F_uv.rows() == nf;
+	bool corner = shading == SHADE_FLAT || face_colors || corner_uv;
+	// animation frames only come with per vertex positions and normals
+	if (frame_ >= 0) corner = face_colors = false;
+	if (color == COLOR_TEXTURE && !texture) color = COLOR_DIFFUSE;
+
+	glPushAttrib(GL_ENABLE_BIT | GL_LIGHTING_BIT | GL_TEXTURE_BIT | GL_CURRENT_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glShadeModel(shading == SHADE_FLAT ? GL_FLAT : GL_SMOOTH);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	if (frame_ >= 0)
+	{
+		glVertexPointer(3, GL_FLOAT, 0, frame_pos_[frame_].bind());
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glNormalPointer(GL_FLOAT, 0, frame_nrm_[frame_].bind());
+	}
+	else
+	{
+		glVertexPointer(3, GL_FLOAT, 0, use(mesh, corner ? C_POS : POS));
+
+		Stream normals = !corner ? NRM : (shading == SHADE_FLAT ? C_FNRM : C_VNRM);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glNormalPointer(GL_FLOAT, 0, use(mesh, normals));
+	}
+
+	if (color != COLOR_NONE)
+	{
+		glEnable(GL_COLOR_MATERIAL);
+		glColorMaterial(GL_FRONT, GL_DIFFUSE);
+		glColor3f(1.0, 1.0, 1.0);
+	}
+
+	if (color == COLOR_DIFFUSE)
+	{
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, use(mesh, corner ? C_COL : COL));
+	}
+	else if (color == COLOR_SCALAR)
+	{
+		bind_colormap();
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(1, GL_FLOAT, 0, use(mesh, corner ? C_SCAL : SCAL));
+	}
+	else if (color == COLOR_TEXTURE)
+	{
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, 0, use(mesh, corner ? C_UV : UV));
+	}
+	buffers_[POS].unbind();
+
+	if (partial)
+	{
+		Stream s = corner ? C_PART_IDX : PART_IDX;
+		const char* indices = (const char*)use(mesh, s);
+		const std::vector<int>& runs = parts.visible_runs();
+		for (size_t r = 0; r < runs.size(); r += 2)
+			glDrawElements(GL_TRIANGLES, 3 * runs[r + 1], GL_UNSIGNED_INT, indices + 3 * sizeof(GLuint) * size_t(runs[r]));
+		buffers_[s].unbind();
+	}
+	else if (corner)
+	{
+		glDrawArrays(GL_TRIANGLES, 0, 3 * nf);
+	}
+	else
+	{
+		const void* indices = use(mesh, IDX);
+		glDrawElements(GL_TRIANGLES, 3 * nf, GL_UNSIGNED_INT, indices);
+		buffers_[IDX].unbind();
+	}
+
+	if (color == COLOR_SCALAR)
+		unbind_colormap();
+
+	glPopClientAttrib();
+	glPopAttrib();
+}
+
+void MeshRenderer::build_selection(const MeshData& mesh)
+{
+	int nv = mesh.V.rows(), nf = mesh.F.rows();
+
+	std::vector<float> pos;
+	pos.reserve(mesh.selected_pts.size() * 3);
+	for (size_t i = 0; i < mesh.selected_pts.size(); i++)
+	{
+		int v = mesh.selected_pts[i];
+		if (v < 0 || v >= nv) continue;
+		pos.resize(pos.size() + 3);
+		put_row(mesh.V, v, 3, &pos[pos.size() - 3]);
+	}
+	marker_count_ = int(pos.size() / 3);
+	if (pos.empty()) marker_pos_.release();
+	else marker_pos_.upload(&pos[0], pos.size() * sizeof(float));
+
+	std::vector<unsigned int> idx;
+	idx.reserve(mesh.selected_faces.size() * 3);
+	for (size_t i = 0; i < mesh.selected_faces.size(); i++)
+	{
+		int f = mesh.selected_faces[i];
+		if (f < 0 || f >= nf) continue;
+		for (int j = 0; j < 3; j++)
+			idx.push_back(mesh.F(f, j));
+	}
+	selected_count_ = int(idx.size() / 3);
+	if (idx.empty()) selected_idx_.release();
+	else selected_idx_.upload(&idx[0], idx.size() * sizeof(unsigned int));
+
+	selection_valid_ = true;
+}
+
+void MeshRenderer::draw_selected_points(const MeshData& mesh)
+{
+	if (!selection_valid_) build_selection(mesh);
+	if (marker_count_ == 0) return;
+
+	double radius = Min((mesh.p_max - mesh.p_min).norm()*0.01, mesh.avg_edge/3);
+
+	if (!marker_tried_)
+	{
+		marker_program_ = glext::build_program(marker_vertex_shader, marker_fragment_shader);
+		marker_tried_ = true;
+	}
+
+	glPushAttrib(GL_ENABLE_BIT | GL_LIGHTING_BIT | GL_CURRENT_BIT | GL_POINT_BIT | GL_TRANSFORM_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glColor3d(0.8, 0.0, 0.0);
+
+	if (marker_program_)
+	{
+		// pixels per unit at unit depth, from the projection and the viewport
+		GLint viewport[4];
+		GLdouble proj[16];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glGetDoublev(GL_PROJECTION_MATRIX, proj);
+		double scale = 0.5 * viewport[3] * proj[5];
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, 0, marker_pos_.bind());
+		marker_pos_.unbind();
+
+		glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+		glEnable(GL_POINT_SPRITE);
+		glDisable(GL_LIGHTING);
+		glext::UseProgram(marker_program_);
+		glext::Uniform1f(glext::GetUniformLocation(marker_program_, "radius"), (GLfloat)radius);
+		glext::Uniform1f(glext::GetUniformLocation(marker_program_, "scale"), (GLfloat)scale);
+		glDrawArrays(GL_POINTS, 0, marker_count_);
+		glext::UseProgram(0);
+	}
+	else
+	{
+		// a 15 x 15 unit sphere like gluSphere, its positions are its normals
+		const int slices = 15, stacks = 15;
+		if (sphere_pos_.empty())
+		{
+			std::vector<float> p;
+			for (int i = 0; i <= stacks; i++)
+			{
+				double phi = M_PI * i / stacks;
+				for (int j = 0; j <= slices; j++)
+				{
+					double theta = 2 * M_PI * j / slices;
+					p.push_back(float(sin(phi) * cos(theta)));
+					p.push_back(float(sin(phi) * sin(theta)));
+					p.push_back(float(cos(phi)));
+				}
+			}
+			std::vector<unsigned int> t;
+			for (int i = 0; i < stacks; i++)
+			{
+				for (int j = 0; j < slices; j++)
+				{
+					unsigned int a = i * (slices + 1) + j, b = a + slices + 1;
+					unsigned int quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+					t.insert(t.end(), quad, quad + 6);
+				}
+			}
+			sphere_pos_.upload(&p[0], p.size() * sizeof(float));
+			sphere_idx_.upload(&t[0], t.size() * sizeof(unsigned int));
+		}
+
+		glEnable(GL_COLOR_MATERIAL);
+		glColorMaterial(GL_FRONT_AND_BACK, GL_DIFFUSE);
+		glEnable(GL_NORMALIZE);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		const void* p = sphere_pos_.bind();
+		glVertexPointer(3, GL_FLOAT, 0, p);
+		glNormalPointer(GL_FLOAT, 0, p);
+		sphere_pos_.unbind();
+		const void* indices = sphere_idx_.bind();
+		int count = 6 * slices * stacks;
+
+		// only the offset changes between instances
+		glMatrixMode(GL_MODELVIEW);
+		for (size_t i = 0; i < mesh.selected_pts.size(); i++)
+		{
+			int v = mesh.selected_pts[i];
+			if (v < 0 || v >= mesh.V.rows()) continue;
+			glPushMatrix();
+			glTranslated(mesh.V(v, 0), mesh.V(v, 1), mesh.V(v, 2));
+			glScaled(radius, radius, radius);
+			glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, indices);
+			glPopMatrix();
+		}
+		sphere_idx_.unbind();
+	}
+
+	glPopClientAttrib();
+	glPopAttrib();
+}
+
+void MeshRenderer::draw_selected_faces(const MeshData& mesh)
+{
+	if (!selection_valid_) build_selection(mesh);
+	if (selected_count_ == 0) return;
+
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glDisable(GL_LIGHTING);
+	glColor4d(0.7, 0.0, 0.0, 0.7);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, use(mesh, POS));
+	buffers_[POS].unbind();
+	const void* indices = selected_idx_.bind();
+	glDrawElements(GL_TRIANGLES, 3 * selected_count_, GL_UNSIGNED_INT, indices);
+	selected_idx_.unbind();
+
+	glPopClientAttrib();
+	glPopAttrib();
+}
+
+void MeshRenderer::build_edges(const MeshData& mesh, const MeshEdges& edges, double feature_angle)
+{
+	const MeshComponents& parts = mesh.components;
+	bool partial = parts.hidden() > 0 && parts.vertices() == mesh.V.rows();
+
+	std::vector<int> chosen;
+	if (feature_angle > 0)
+		edges.features(mesh.F_normals, feature_angle, chosen);
+	int n = feature_angle > 0 ? (int)chosen.size() : edges.count();
+
+	std::vector<unsigned int> idx;
+	idx.reserve(2 * size_t(n));
+	for (int i = 0; i < n; i++)
+	{
+		const int* ends = edges.ends(feature_angle > 0 ? chosen[i] : i);
+		if (partial && !parts.visible(parts.vertex_component(ends[0]))) continue;
+		idx.push_back(ends[0]);
+		idx.push_back(ends[1]);
+	}
+	if (idx.empty()) edge_idx_.release();
+	else edge_idx_.upload(&idx[0], idx.size() * sizeof(unsigned int));
+	edge_count_ = (int)idx.size() / 2;
+
+	edges_valid_ = true;
+	edge_angle_ = feature_angle;
+	edge_parts_stamp_ = parts.stamp();
+	if (partial) edge_runs_ = parts.visible_runs();
+	else edge_runs_.clear();
+}
+
+void MeshRenderer::draw_edges(const MeshData& mesh, const MeshEdges& edges, double feature_angle)
+{
+	if (mesh.F.rows() == 0 || edges.empty()) return;
+
+	// the lines skip the hidden components
+	const MeshComponents& parts = mesh.components;
+	bool partial = parts.hidden() > 0 && parts.vertices() == mesh.V.rows();
+	bool parts_changed = parts.stamp() != edge_parts_stamp_ ||
+		(partial ? parts.visible_runs() != edge_runs_ : !edge_runs_.empty());
+	if (!edges_valid_ || feature_angle != edge_angle_ || parts_changed)
+		build_edges(mesh, edges, feature_angle);
+	if (edge_count_ == 0) return;
+
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	if (frame_ >= 0)
+		glVertexPointer(3, GL_FLOAT, 0, frame_pos_[frame_].bind());
+	else
+		glVertexPointer(3, GL_FLOAT, 0, use(mesh, POS));
+	buffers_[POS].unbind();
+
+	const void* indices = edge_idx_.bind();
+	glDrawElements(GL_LINES, 2 * edge_count_, GL_UNSIGNED_INT, indices);
+	edge_idx_.unbind();
+	glPopClientAttrib();
+}
+
+void MeshRenderer::set_overlay(const std::vector<float>& points, const std::vector<unsigned int>& lines)
+{
+	overlay_count_ = (int)lines.size() / 2;
+	if (overlay_count_ == 0)
+	{
+		overlay_pos_.release();
+		overlay_idx_.release();
+		return;
+	}
+	overlay_pos_.upload(&points[0], points.size() * sizeof(float));
+	overlay_idx_.upload(&lines[0], lines.size() * sizeof(unsigned int));
+}
+
+void MeshRenderer::draw_overlay()
+{
+	if (overlay_count_ == 0) return;
+
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, overlay_pos_.bind());
+	overlay_pos_.unbind();
+
+	const void* indices = overlay_idx_.bind();
+	glDrawElements(GL_LINES, 2 * overlay_count_, GL_UNSIGNED_INT, indices);
+	overlay_idx_.unbind();
+	glPopClientAttrib();
+}
+
+void MeshRenderer::bind_colormap()
+{
+	if (colormap_dirty_ || !colormap_texture_)
+	{
+		std::vector<unsigned char> table;
+		colormap_table(colormap_, 256, table);
+		if (!colormap_texture_) glGenTextures(1, &colormap_texture_);
+		glBindTexture(GL_TEXTURE_1D, colormap_texture_);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB, 256, 0, GL_RGB, GL_UNSIGNED_BYTE, &table[0]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		colormap_dirty_ = false;
+	}
+	glEnable(GL_TEXTURE_1D);
+	glBindTexture(GL_TEXTURE_1D, colormap_texture_);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	// the range is applied by the texture matrix, the scalars are never touched
+	double range = scalar_hi_ - scalar_lo_;
+	if (range == 0) range = 1;
+	glMatrixMode(GL_TEXTURE);
+	glPushMatrix();
+	glLoadIdentity();
+	glScaled(1.0 / range, 1.0, 1.0);
+	glTranslated(-scalar_lo_, 0.0, 0.0);
+	glMatrixMode(GL_MODELVIEW);
+}
+
+void MeshRenderer::unbind_colormap()
+{
+	glMatrixMode(GL_TEXTURE);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+}
+
+void MeshRenderer::draw_points(const MeshData& mesh, ColorSource color, double radius, double scale, int budget)
+{
+	int nv = mesh.V.rows();
+	if (nv == 0) return;
+	int count = budget > 0 ? Min(budget, nv) : nv;
+	if (color == COLOR_TEXTURE) color = COLOR_DIFFUSE;
+
+	if (!splat_tried_)
+	{
+		splat_program_ = glext::build_program(splat_vertex_shader, splat_fragment_shader);
+		splat_tried_ = true;
+	}
+
+	glPushAttrib(GL_ENABLE_BIT | GL_LIGHTING_BIT | GL_TEXTURE_BIT | GL_CURRENT_BIT | GL_POINT_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, use(mesh, P_POS));
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(GL_BYTE, 4, use(mesh, P_NRM));
+
+	glColor3f(0.6f, 0.5f, 0.0f);
+	if (color == COLOR_DIFFUSE)
+	{
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, use(mesh, P_COL));
+	}
+	else if (color == COLOR_SCALAR)
+	{
+		bind_colormap();
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(1, GL_FLOAT, 0, use(mesh, P_SCAL));
+	}
+	buffers_[P_POS].unbind();
+
+	if (splat_program_)
+	{
+		glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+		glEnable(GL_POINT_SPRITE);
+		glDisable(GL_LIGHTING);
+		glext::UseProgram(splat_program_);
+		glext::Uniform1f(glext::GetUniformLocation(splat_program_, "radius"), (GLfloat)radius);
+		glext::Uniform1f(glext::GetUniformLocation(splat_program_, "scale"), (GLfloat)scale);
+		glext::Uniform1i(glext::GetUniformLocation(splat_program_, "colormap"), 0);
+		glext::Uniform1i(glext::GetUniformLocation(splat_program_, "use_colormap"), color == COLOR_SCALAR);
+		glDrawArrays(GL_POINTS, 0, count);
+		glext::UseProgram(0);
+	}
+	else
+	{
+		// one size for all points, taken at the depth of the center
+		GLdouble mv[16];
+		glGetDoublev(GL_MODELVIEW_MATRIX, mv);
+		Vec3d c = 0.5 * (mesh.p_min + mesh.p_max);
+		double depth = -(mv[2] * c[0] + mv[6] * c[1] + mv[10] * c[2] + mv[14]);
+		double size = depth > 0 ? 2 * radius * scale / depth : 1.0;
+		glPointSize((GLfloat)Min(Max(size, 1.0), 64.0));
+		glEnable(GL_POINT_SMOOTH);
+		if (color != COLOR_NONE)
+		{
+			glEnable(GL_COLOR_MATERIAL);
+			glColorMaterial(GL_FRONT, GL_DIFFUSE);
+			if (color == COLOR_SCALAR) glColor3f(1.0, 1.0, 1.0);
+		}
+		glDrawArrays(GL_POINTS, 0, count);
+	}
+
+	if (color == COLOR_SCALAR)
+		unbind_colormap();
+
+	glPopClientAttrib();
+	glPopAttrib();
+}
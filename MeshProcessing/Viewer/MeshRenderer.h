@@ -0,0 +1,137 @@
+#pragma once
+#include "stdafx.h"
+#include "GLBuffer.h"
+#include "ColorMap.h"
+#include "MeshData.h"
+
+// Draws the triangles of a MeshData from one buffer per attribute.
+// Streams are built on first use and rebuilt one by one from the dirty flags,
+// so changing the colors only touches the color stream, and changing the
+// scalar range or the colormap touches none.
+class MeshRenderer
+{
+public:
+	typedef enum { SHADE_FLAT = 0, SHADE_SMOOTH } Shading;
+	typedef enum { COLOR_NONE = 0, COLOR_DIFFUSE, COLOR_SCALAR, COLOR_TEXTURE } ColorSource;
+
+	MeshRenderer();
+
+	// drop the streams affected by the MeshData dirty flags;
+	// returns the flags it handled, for the caller to clear
+	unsigned invalidate(unsigned dirty);
+
+	// rewrite the positions and normals of mesh.moved_vertices and
+	// mesh.moved_faces in the streams that are built, in runs of nearby
+	// entries; the point streams are dropped
+	void upload_moved(const MeshData& mesh);
+
+	// draw the triangles; texture is the 2D texture used by COLOR_TEXTURE.
+	// With hidden mesh.components, only the runs of visible ones are drawn,
+	// from index buffers kept until the components are labeled again.
+	void draw(const MeshData& mesh, Shading shading, ColorSource color, GLuint texture = 0);
+
+	// draw the unique edges as lines, or with feature_angle > 0 only the
+	// feature edges (see MeshEdges::features), leaving out those of hidden
+	// components. The line indices are kept until the faces, the visible
+	// components or the angle change, and for feature edges the normals.
+	void draw_edges(const MeshData& mesh, const MeshEdges& edges, double feature_angle = 0);
+
+	// lines drawn over the mesh, such as cross-sections: points as 3 floats
+	// each, and GL_LINES pairs of point indices; kept until set again
+	void set_overlay(const std::vector<float>& points, const std::vector<unsigned int>& lines);
+	void draw_overlay();
+
+	// draw the vertices as splats of the given radius, discs facing along
+	// their normals. scale is the viewport height in pixels over the height
+	// of the view frustum at unit depth. The point streams are in bit reversed
+	// order, so drawing only the first budget points (0 for all) still covers
+	// the whole cloud evenly.
+	// Falls back to round points of a fixed size without GLSL.
+	void draw_points(const MeshData& mesh, ColorSource color, double radius, double scale, int budget = 0);
+
+	// draw the selected points as spheres, and the selected faces.
+	// Both come from buffers rebuilt only on DIRTY_SELECTION or new geometry.
+	// The spheres are impostors: one point sprite each, shaded and depth
+	// corrected by a shader. Without GLSL, one shared sphere mesh is drawn
+	// at every point.
+	void draw_selected_points(const MeshData& mesh);
+	void draw_selected_faces(const MeshData& mesh);
+
+	// colormap and scalar range used by COLOR_SCALAR
+	void set_colormap(ColorMapType type);
+	void set_scalar_range(double lo, double hi);
+
+	// stream positions and normals of an animation frame (#V x 3 floats each).
+	// Two buffer pairs are used in turn, so a frame is written while the
+	// previous one may still be read by the GPU. Until end_frames() the
+	// triangles are drawn from the last frame, with the indexed layout.
+	void upload_frame(const float* positions, const float* normals, int nv);
+	void end_frames();
+	bool playing_frames() const { return frame_ >= 0; }
+
+	// free all streams
+	void release();
+
+private:
+	typedef enum
+	{
+		// indexed, one entry per vertex
+		POS = 0, NRM, COL, SCAL, UV, IDX,
+		// unrolled, one entry per face corner
+		C_POS, C_FNRM, C_VNRM, C_COL, C_SCAL, C_UV,
+		// triangles component by component, into the indexed and the
+		// unrolled streams (see MeshComponents)
+		PART_IDX, C_PART_IDX,
+		// points, in bit reversed order
+		P_POS, P_NRM, P_COL, P_SCAL,
+		STREAM_COUNT
+	} Stream;
+
+	// bind a stream, building it first if necessary
+	const void* use(const MeshData& mesh, Stream s);
+	void build(const MeshData& mesh, Stream s);
+	void build_points(const MeshData& mesh, Stream s);
+	void build_selection(const MeshData& mesh);
+	void build_edges(const MeshData& mesh, const MeshEdges& edges, double feature_angle);
+
+	// bind the colormap to the 1D texture target and push the texture matrix
+	// mapping the scalar range to [0, 1]
+	void bind_colormap();
+	void unbind_colormap();
+
+private:
+	GLBuffer buffers_[STREAM_COUNT];
+	bool valid_[STREAM_COUNT];
+	unsigned parts_stamp_;       // labeling of the PART_IDX streams
+
+	GLBuffer frame_pos_[2], frame_nrm_[2];
+	int frame_;                  // buffer pair of the last frame, -1 if none
+
+	// selection: marker positions and the indices of the selected faces
+	GLBuffer marker_pos_, selected_idx_;
+	int marker_count_, selected_count_;
+	bool selection_valid_;
+	GLuint marker_program_;
+	bool marker_tried_;
+	GLBuffer sphere_pos_, sphere_idx_;  // unit sphere, for the markers without GLSL
+
+	// lines of draw_edges, indices into POS
+	GLBuffer edge_idx_;
+	int edge_count_;
+	bool edges_valid_;
+	double edge_angle_;          // 0 for all edges
+	unsigned edge_parts_stamp_;
+	std::vector<int> edge_runs_; // visible components of the lines
+
+	// lines of set_overlay
+	GLBuffer overlay_pos_, overlay_idx_;
+	int overlay_count_;
+
+	GLuint splat_program_;
+	bool splat_tried_;           // compiling was attempted
+
+	GLuint colormap_texture_;
+	ColorMapType colormap_;
+	bool colormap_dirty_;
+	double scalar_lo_, scalar_hi_;
+};
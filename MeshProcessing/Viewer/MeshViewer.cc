@@ -1,174 +1,1706 @@
 #include "stdafx.h"
 #include "MeshViewer.hh"
+#include "PythonScript.h"
+#include "Parallel.h"
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+// directory part of a path, including the trailing separator
+static std::string dir_name(const std::string& path)
+{
+	size_t pos = path.find_last_of("/\\");
+	return pos == std::string::npos ? std::string() : path.substr(0, pos + 1);
+}
+
+// diffuse texture map of the first material of an obj file, empty if there is none
+static std::string obj_texture_file(const std::string& obj_file)
+{
+	// mtllib comes before the geometry
+	std::ifstream obj(obj_file.c_str());
+	std::string line, mtl_file;
+	while (mtl_file.empty() && std::getline(obj, line))
+	{
+		if (line.compare(0, 2, "v ") == 0 || line.compare(0, 2, "f ") == 0) break;
+		if (line.compare(0, 7, "mtllib ") == 0)
+			mtl_file = dir_name(obj_file) + line.substr(7);
+	}
+	if (mtl_file.empty()) return "";
+
+	std::ifstream mtl(mtl_file.c_str());
+	while (std::getline(mtl, line))
+	{
+		std::istringstream ss(line);
+		std::string key, token, map;
+		ss >> key;
+		if (key != "map_Kd") continue;
+
+		// the file name is the last token, options come before it
+		while (ss >> token) map = token;
+		if (!map.empty()) return dir_name(mtl_file) + map;
+	}
+	return "";
+}
 
 // -----------
 MeshViewer::MeshViewer(const char* _title, int _width, int _height)
-:GlutViewer(_title, _width, _height), select_flag(false)
+:GlutViewer(_title, _width, _height), show_scalar_(false), colormap_(COLORMAP_JET), scalar_min_(0.0),
+scalar_max_(1.0), clean_on_load_(true), weld_tolerance_(1e-6f), use_cache_(true), mesh_texture_(0),
+show_texture_(false), frame_index_(0), playing_(false), playback_timer_(false), loop_(true),
+target_fps_(30.0f), playback_fps_(0.0f), fps_frames_(0), fps_time_(0), splat_size_(1.0f),
+interactive_points_(2000000), curvature_shown_(-1), channel_(-1), feature_angle_(30.0f),
+subdivision_levels_(0), param_method_(-1), param_follow_(false), param_choice_(PARAM_LSCM),
+occlusion_cancel_(false), occlusion_generation_(0), occlusion_target_(256), occlusion_samples_(0),
+occlusion_distance_(0.1f), align_cancel_(false), align_posted_(0), align_generation_(0), align_moved_(false),
+align_iteration_(0), align_pairs_(0), align_rms_(0), component_(0), component_count_(0),
+min_component_faces_(100), clip_(false), clip_normal_(0, 0, 1), clip_position_(0.5f), slice_count_(1),
+section_loops_(0), brush_(BRUSH_NONE), brush_radius_(0.05f), brush_strength_(0.5f), stroke_depth_(0),
+bench_budget_(0), polling_(false), select_flag(false)
 {
+	deviation_.hausdorff = deviation_.max_error = deviation_.mean_error = deviation_.rms_error = 0;
+	channel_name_[0] = 0;
+}
+
+MeshViewer::~MeshViewer()
+{
+	stop_occlusion();
+	stop_alignment();
 }
 
 // -----------
 void MeshViewer::open_mesh(const char* _filename)
 {
-	Eigen::MatrixXd V;
-	Eigen::MatrixXi F;
-	igl::read_triangle_mesh(_filename, V, F);
-	
-	set_mesh(V, F);
+	Eigen::MatrixXd V, TC, N;
+	Eigen::MatrixXi F, FTC, FN;
+
+	std::string filename(_filename);
+	int time = glutGet(GLUT_ELAPSED_TIME);
+
+	// the cache is only valid for the options it was written with
+	uint64_t key = 0;
+	std::ostringstream load_options;
+	load_options << clean_on_load_ << " " << weld_tolerance_;
+	std::string cache_file = mesh_cache_file(filename);
+	bool keyed = use_cache_ && mesh_file_key(filename, load_options.str(), key);
+	MeshCacheEntry cached;
+	if (keyed && read_mesh_cache(cache_file, key, cached))
+	{
+		TC.swap(cached.TC);
+		FTC.swap(cached.FTC);
+		reset_mesh_state();
+		mesh_.take_cached(cached);
+		mesh_file_ = filename;
+		setup_scene((mesh_.p_min + mesh_.p_max)*0.5, (mesh_.p_min - mesh_.p_max).norm() / 2.0);
+		use_file_uv(TC, FTC, filename);
+		std::cout << "Loaded " << filename << " from its cache in " << glutGet(GLUT_ELAPSED_TIME) - time << " ms" << std::endl;
+		return;
+	}
+
+	bool obj = filename.size() > 4 &&
+		(filename.substr(filename.size() - 4) == ".obj" || filename.substr(filename.size() - 4) == ".OBJ");
+	if (obj)
+		igl::readOBJ(filename, V, TC, N, F, FTC, FN);
+	else
+		igl::read_triangle_mesh(filename, V, F);
+
+	// weld the private vertices of triangle soups (STL), drop degenerate
+	// and duplicate faces and unused vertices
+	CleanupReport cleanup;
+	if (clean_on_load_ && V.rows() > 0)
+	{
+		CleanupOptions options;
+		options.weld_tolerance = weld_tolerance_ * (V.colwise().maxCoeff() - V.colwise().minCoeff()).norm();
+		// vertices duplicated for per vertex texture coordinates are seams
+		options.weld = TC.rows() != V.rows();
+		cleanup = clean_mesh(V, F, options);
+		if (cleanup.changed())
+		{
+			std::cout << "Cleanup: " << cleanup.welded_vertices << " vertices welded, "
+				<< cleanup.unreferenced_vertices << " unreferenced vertices, "
+				<< cleanup.degenerate_faces << " degenerate and " << cleanup.duplicate_faces << " duplicate faces removed" << std::endl;
+			if (TC.rows() == cleanup.vertex_map.rows())
+			{
+				Eigen::MatrixXd CTC(V.rows(), TC.cols());
+				for (int i = 0; i < V.rows(); i++) CTC.row(i) = TC.row(cleanup.source_vertex(i));
+				TC.swap(CTC);
+			}
+			if (FTC.rows() > 0)
+			{
+				Eigen::MatrixXi CFTC(F.rows(), 3);
+				for (int f = 0; f < F.rows(); f++) CFTC.row(f) = FTC.row(cleanup.source_face(f));
+				FTC.swap(CFTC);
+			}
+		}
+	}
+
+	// the mesh takes over V and F, no second copy is held while it loads
+	take_mesh(V, F);
+	mesh_file_ = filename;
+	if (cleanup.changed())
+		mesh_.V_source_map = cleanup.vertex_map;
+
+	use_file_uv(TC, FTC, filename);
+	if (keyed && !mesh_.is_point_cloud())
+		write_mesh_cache(cache_file, key, mesh_, TC, FTC);
+}
+
+// keep the parameterization and the texture of textured obj files
+void MeshViewer::use_file_uv(const Eigen::MatrixXd& TC, const Eigen::MatrixXi& FTC, const std::string& filename)
+{
+	if (TC.rows() > 0)
+	{
+		if (FTC.rows() == mesh_.F.rows())
+			mesh_.set_uv(TC.leftCols(2), FTC);
+		else if (TC.rows() == mesh_.V.rows())
+			mesh_.set_uv(TC.leftCols(2));
+
+		std::string texture = obj_texture_file(filename);
+		if (!texture.empty()) open_texture(texture.c_str());
+	}
+}
+
+void MeshViewer::open_texture(const char* _filename)
+{
+	mesh_.set_texture_file(_filename);
+	show_texture_ = true;
+
+	// poll until the image is decoded
+	if (!textures_.get(_filename))
+		start_timer(50, TIMER_TEXTURE);
 }
 
 void MeshViewer::set_mesh(Eigen::MatrixXd &_V, Eigen::MatrixXi &_F)
 {
+	reset_mesh_state();
 	mesh_.set_mesh(_V, _F);
 
 	Vec3d p1 = _V.colwise().minCoeff();
 	Vec3d p2 = _V.colwise().maxCoeff();
 	setup_scene((p1 + p2)*0.5, (p1 - p2).norm() / 2.0);
+}
+
+void MeshViewer::take_mesh(Eigen::MatrixXd &_V, Eigen::MatrixXi &_F)
+{
+	reset_mesh_state();
+	mesh_.take_mesh(_V, _F);
+
+	setup_scene((mesh_.p_min + mesh_.p_max)*0.5, (mesh_.p_min - mesh_.p_max).norm() / 2.0);
+}
+
+// a new mesh ends the playback and the displays of the previous one
+void MeshViewer::reset_mesh_state()
+{
+	playing_ = false;
+	sequence_.close();
+	renderer_.end_frames();
+	sculptor_.clear();
+	stop_occlusion();
+	occlusion_.clear();
+	occlusion_samples_ = 0;
+	occlusion_base_.resize(0, 3);
+	stop_alignment();
+	align_base_.resize(0, 3);
+	mesh_file_.clear();
+	component_ = component_count_ = 0;
+	component_stats_ = ComponentStats();
+	sections_.clear();
+	show_sections();
+
+	curvature_shown_ = -1;
+	channel_ = -1;
+	channel_name_[0] = 0;
+	param_method_ = -1;
+	parameterizer_.clear();
+	show_scalar_ = false;
+}
 
-	create_display_list();
+void MeshViewer::update_mesh()
+{
+	mesh_.refresh_geometry();
+	mesh_.dirty |= MeshData::DIRTY_ALL & ~MeshData::DIRTY_TEXTURE;
+	glutPostRedisplay();
 }
 
 void MeshViewer::set_color(Eigen::MatrixXd &C)
 {
 	mesh_.set_colors(C);
-	create_display_list();
+	show_scalar_ = false;
+	glutPostRedisplay();
 }
 
-void MeshViewer::draw()
+void MeshViewer::set_scalar(Eigen::VectorXd &S)
 {
-	if (!mesh_.V.rows())
+	mesh_.set_scalars(S);
+	curvature_shown_ = -1;
+	if (S.rows() > 0 && S.rows() == mesh_.V.rows())
 	{
-		GlutViewer::draw();
-		return;
+		set_scalar_range(S.minCoeff(), S.maxCoeff());
+		show_scalar_ = true;
 	}
-	if (draw_mode_ == HIDDEN_LINE)
+}
+
+void MeshViewer::set_scalar_range(double _min, double _max)
+{
+	scalar_min_ = _min;
+	scalar_max_ = _max;
+	glutPostRedisplay();
+}
+
+void MeshViewer::undo()
+{
+	mesh_.undo();
+	glutPostRedisplay();
+}
+
+void MeshViewer::redo()
+{
+	mesh_.redo();
+	glutPostRedisplay();
+}
+
+bool MeshViewer::open_sequence(const char* _filename)
+{
+	std::string filename(_filename), cache = filename;
+	bool vseq = filename.size() > 5 && filename.substr(filename.size() - 5) == ".vseq";
+	if (!vseq)
 	{
-		glDisable(GL_LIGHTING);
-		glColor3f(0.298, 0.298, 0.502);
-		glDepthRange(0.01, 1.0);
-		glCallList(draw_list_+2);
+		// the first frame gives the faces; the others go through the same
+		// cleanup
+		open_mesh(_filename);
+		if (!VertexSequence::build_cache(filename, cache, mesh_.V_source_map)) return false;
+	}
 
-		glColor3f(0.7, 0.7, 0.7);
-		glDepthRange(0.0, 1.0);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		glCallList(draw_list_+2);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	play(false);
+	if (!sequence_.open(cache, mesh_.F)) return false;
+	if (sequence_.vertices() != mesh_.V.rows())
+	{
+		std::cerr << "ERROR (open_sequence): The sequence does not match the current mesh." << std::endl;
+		sequence_.close();
+		return false;
 	}
 
-	if (draw_mode_ == WIRE_FRAME)
+	std::cout << "Sequence " << cache << ": " << sequence_.frames() << " frames" << std::endl;
+	seek(0);
+	return true;
+}
+
+void MeshViewer::play(bool _on)
+{
+	if (_on && !sequence_.is_open()) return;
+	if (_on == playing_) return;
+	playing_ = _on;
+
+	if (playing_)
 	{
-		glEnable(GL_LIGHTING);
-		glPolygonOffset(1, 1);
-		glEnable(GL_POLYGON_OFFSET_FILL);
-		glCallList(draw_list_);
-		glDisable(GL_POLYGON_OFFSET_FILL);		
+		sequence_.request(frame_index_ + 1);
+		fps_frames_ = 0;
+		fps_time_ = glutGet(GLUT_ELAPSED_TIME);
+		if (!playback_timer_)
+		{
+			playback_timer_ = true;
+			start_timer(0, TIMER_PLAYBACK);
+		}
+	}
+	else
+	{
+		sync_frame();
+	}
+}
 
-		glDisable(GL_LIGHTING);
-		glColor3f(0.2, 0.2, 0.2);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		glCallList(draw_list_ + 2);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+void MeshViewer::seek(int i)
+{
+	if (!sequence_.is_open()) return;
+	frame_index_ = Max(0, Min(i, sequence_.frames() - 1));
+
+	if (playing_)
+		sequence_.request(frame_index_ + 1);
+	else
+		sync_frame();
+}
+
+void MeshViewer::step_playback()
+{
+	if (!playing_ || !sequence_.is_open())
+	{
+		playback_timer_ = false;
+		return;
 	}
 
-    if (draw_mode_ == SOLID_FLAT)
+	int next = frame_index_ + 1;
+	if (next >= sequence_.frames())
 	{
-		glEnable(GL_LIGHTING);
-		glDepthRange(0.01, 1.0);
-		glCallList(draw_list_);		
+		if (!loop_)
+		{
+			playback_timer_ = false;
+			play(false);
+			return;
+		}
+		next = 0;
 	}
 
-	if (draw_mode_ == SOLID_SMOOTH)
+	// a frame that is not ready yet is waited for, not skipped
+	if (sequence_.fetch(next, frame_))
 	{
-		glEnable(GL_LIGHTING);
-		glDepthRange(0.01, 1.0);
-		glCallList(draw_list_+1);
+		renderer_.upload_frame(&frame_.positions[0], &frame_.normals[0], sequence_.vertices());
+		frame_index_ = next;
+		sequence_.request(next + 1);
+		fps_frames_++;
+		glutPostRedisplay();
 	}
 
-	glEnable(GL_LIGHTING);
-	mesh_.draw_select_pts();
-	//glPolygonOffset(1, 1);
-	glDepthRange(0.0, 1.0);
-	mesh_.draw_select_faces();
+	int now = glutGet(GLUT_ELAPSED_TIME);
+	if (now - fps_time_ >= 1000)
+	{
+		playback_fps_ = fps_frames_ * 1000.0f / (now - fps_time_);
+		fps_frames_ = 0;
+		fps_time_ = now;
+	}
+
+	start_timer(int(1000.0f / Max(target_fps_, 1.0f)), TIMER_PLAYBACK);
 }
 
-void MeshViewer::mouse(int button, int state, int x, int y)
+void MeshViewer::sync_frame()
 {
+	renderer_.end_frames();
+	if (!sequence_.is_open()) return;
 
-	// select point
-	int modifier = glutGetModifiers();
-	if (( modifier == GLUT_ACTIVE_CTRL ||modifier == GLUT_ACTIVE_ALT) && state == GLUT_DOWN)
+	// the mesh follows the frame on screen, without filling the undo history
+	Eigen::MatrixXd V;
+	sequence_.frame_vertices(frame_index_, V);
+	bool history = mesh_.history.enabled();
+	mesh_.history.set_enabled(false);
+	mesh_.set_vertices(V);
+	mesh_.history.set_enabled(history);
+	mesh_.refresh_geometry();
+	glutPostRedisplay();
+}
+
+void MeshViewer::show_curvature(CurvatureType _type)
+{
+	if (mesh_.F.rows() == 0) return;
+	Eigen::VectorXd S = mesh_.curvature().field(_type);
+	set_scalar(S);
+
+	// a few extreme vertices would take the whole colormap
+	double lo, hi;
+	robust_range(S, 0.02, 0.98, lo, hi);
+	set_scalar_range(lo, hi);
+	curvature_shown_ = _type;
+}
+
+bool MeshViewer::export_curvature(const char* _filename)
+{
+	if (mesh_.F.rows() == 0) return false;
+	return write_curvature(_filename, mesh_.curvature(), mesh_.V_source_map);
+}
+
+bool MeshViewer::show_channel(int _i)
+{
+	AttributeRegistry& A = mesh_.attributes;
+	channel_ = -1;
+	channel_name_[0] = 0;
+	if (_i < 0 || _i >= A.count()) return false;
+
+	const AttributeChannel& a = A.channel(_i);
+	std::ostringstream name;
+	name << a.name() << " (" << domain_name(a.domain()) << ", " << channel_type_name(a.type());
+	if (a.components() > 1) name << " x" << a.components();
+	name << (a.valid() ? ")" : ", stale)");
+	strncpy(channel_name_, name.str().c_str(), sizeof(channel_name_) - 1);
+	channel_name_[sizeof(channel_name_) - 1] = 0;
+	channel_ = _i;
+
+	if (!a.valid() || a.rows() != mesh_.domain_rows(a.domain()))
 	{
-		GLdouble winX = double(x);
-		GLdouble winY = double(viewport_[3] - y);
-		GLfloat winZ = 0.0;
-		GLdouble pt[3];
-		glReadPixels((int)winX, (int)winY, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &winZ);
-		gluUnProject(winX, winY, (GLdouble)winZ, modelview_matrix_, projection_matrix_, viewport_, &pt[0], &pt[1], &pt[2]);
+		std::cerr << "ERROR (show_channel): " << a.name() << " is stale." << std::endl;
+		return false;
+	}
+	if (a.domain() == DOMAIN_EDGE)
+	{
+		std::cerr << "ERROR (show_channel): Edge channels are not drawn." << std::endl;
+		return false;
+	}
+
+	Eigen::VectorXd S;
+	a.get(S);
+	double lo, hi;
+	robust_range(S, 0.02, 0.98, lo, hi);
+	if (a.domain() == DOMAIN_VERTEX)
+	{
+		set_scalar(S);
+		set_scalar_range(lo, hi);
+	}
+	else
+	{
+		Eigen::MatrixXd C;
+		colormap(colormap_, S, lo, hi, C);
+		set_color(C);
+	}
+	glutPostRedisplay();
+	return true;
+}
+
+bool MeshViewer::export_channels(const char* _filename, AttributeDomain _domain)
+{
+	return write_attributes(_filename, mesh_.attributes, _domain, mesh_.V_source_map);
+}
 
-		//std::cout << winX << " " << winY << " " << winZ << std::endl;
-		//std::cout << pt[0] << " " << pt[1] << " " << pt[2] << std::endl;
+bool MeshViewer::parameterize(ParamMethod _method)
+{
+	param_method_ = -1;
+	if (mesh_.F.rows() == 0) return false;
 
-		if (modifier == GLUT_ACTIVE_CTRL)
-			mesh_.select_pt(Vec3d(pt));
+	Eigen::MatrixXd UV;
+	int time = glutGet(GLUT_ELAPSED_TIME);
+	if (!parameterizer_.compute(mesh_.V, mesh_.F, _method, UV))
+		return false;
+	std::cout << "Parameterization: " << glutGet(GLUT_ELAPSED_TIME) - time << " ms" << std::endl;
+
+	mesh_.set_uv(UV);
+	param_method_ = _method;
+	glutPostRedisplay();
+	return true;
+}
+
+void MeshViewer::update_parameterization(unsigned changed)
+{
+	if (param_method_ < 0) return;
+
+	// other texture coordinates or faces end the parameterization
+	if ((changed & MeshData::DIRTY_FACE) || mesh_.face_based || mesh_.V_uv.rows() != mesh_.V.rows())
+	{
+		param_method_ = -1;
+		parameterizer_.clear();
+		return;
+	}
+	if (!param_follow_ || !(changed & MeshData::DIRTY_POSITION)) return;
+
+	Eigen::MatrixXd UV;
+	if (parameterizer_.compute(mesh_.V, mesh_.F, (ParamMethod)param_method_, UV))
+		mesh_.set_uv(UV);
+	else
+		param_method_ = -1;
+}
+
+bool MeshViewer::bake_occlusion()
+{
+	stop_occlusion();
+	int nv = mesh_.V.rows();
+	if (mesh_.F.rows() == 0 || mesh_.V_normals.rows() != nv) return false;
+	occlusion_samples_ = 0;
+
+	// the colors the occlusion darkens, taken once per mesh
+	if (occlusion_base_.rows() != nv)
+	{
+		if (!mesh_.face_based && mesh_.V_material_diffuse.rows() == nv)
+			occlusion_base_ = mesh_.V_material_diffuse;
 		else
-			mesh_.select_face(Vec3d(pt));
+			occlusion_base_ = Eigen::RowVector3d(0.8, 0.8, 0.8).replicate(nv, 1);
 	}
-	else{
-		GlutViewer::mouse(button, state, x, y);
+
+	uint64_t key = mesh_data_key(mesh_.V, mesh_.F);
+	double distance = occlusion_distance_ * (mesh_.p_max - mesh_.p_min).norm();
+	std::string file = use_cache_ && !mesh_file_.empty() ? mesh_file_ + ".mpao" : std::string();
+
+	// the thread works on a copy of the mesh, which may change meanwhile
+	struct Snapshot { Eigen::MatrixXd V, N; Eigen::MatrixXi F; };
+	std::shared_ptr<Snapshot> mesh;
+	if (occlusion_.key() != key || occlusion_.max_distance() != distance || occlusion_.vertices() != nv)
+	{
+		mesh = std::make_shared<Snapshot>();
+		mesh->V = mesh_.V;
+		mesh->F = mesh_.F;
+		mesh->N = mesh_.V_normals;
 	}
 
+	unsigned generation = occlusion_generation_;
+	int target = occlusion_target_;
+	occlusion_thread_ = std::thread([this, mesh, key, distance, file, generation, target]() {
+		AmbientOcclusion& ao = occlusion_;
+		if (mesh)
+		{
+			ao.setup(mesh->V, mesh->F, mesh->N, distance, key);
+			if (!file.empty()) ao.load(file);
+		}
+
+		int loaded = ao.samples();
+		for (;;)
+		{
+			if (ao.samples() > 0)
+			{
+				Eigen::VectorXd A;
+				ao.visibility(A);
+				int samples = ao.samples();
+				tasks_.post([this, generation, A, samples]() { show_occlusion(generation, A, samples); });
+			}
+			if (occlusion_cancel_ || ao.samples() >= target) break;
+			// a quick first look, then larger passes
+			if (!ao.refine(ao.samples() == 0 ? 16 : 64, &occlusion_cancel_)) break;
+		}
+		if (!file.empty() && ao.samples() > loaded)
+			ao.save(file);
+	});
+	start_polling();
+	return true;
 }
 
-void MeshViewer::create_display_list()
+void MeshViewer::stop_occlusion()
 {
-	glDeleteLists(draw_list_, 3);
-	draw_list_ = glGenLists(3);
+	if (!occlusion_thread_.joinable()) return;
+	occlusion_cancel_ = true;
+	occlusion_thread_.join();
+	occlusion_cancel_ = false;
+	occlusion_generation_++;
+}
+
+void MeshViewer::show_occlusion(unsigned _generation, const Eigen::VectorXd& _A, int _samples)
+{
+	int nv = mesh_.V.rows();
+	if (_generation != occlusion_generation_ || _A.rows() != nv || occlusion_base_.rows() != nv) return;
 
-	glNewList(draw_list_, GL_COMPILE);
-	mesh_.draw_mesh(0);
-	glEndList();
+	mesh_.attributes.add("occlusion", DOMAIN_VERTEX, CHANNEL_FLOAT, 1, nv,
+		MeshData::DIRTY_POSITION | MeshData::DIRTY_NORMAL).set(_A);
 
-	glNewList(draw_list_+1, GL_COMPILE);
-	mesh_.draw_mesh(1);
-	glEndList();
+	Eigen::MatrixXd C = occlusion_base_.array().colwise() * _A.array();
+	// one undo step for the whole bake
+	bool first = occlusion_samples_ == 0;
+	bool recording = mesh_.history.enabled();
+	mesh_.history.set_enabled(recording && first);
+	set_color(C);
+	mesh_.history.set_enabled(recording);
 
-	glNewList(draw_list_+2, GL_COMPILE);
-	mesh_.draw_mesh(2);
-	glEndList();
+	occlusion_samples_ = _samples;
+	if (_samples >= occlusion_target_)
+		std::cout << "Ambient occlusion: " << _samples << " samples per vertex" << std::endl;
 }
 
-void MeshViewer::setup_anttweakbar()
+bool MeshViewer::label_components()
 {
-	GlutViewer::setup_anttweakbar();
-	TwAddButton(bar_, "Open File", tw_open_file, this, "group = 'File'");
-	TwAddButton(bar_, "Save File", tw_save_file, this, "group = 'File'");
-	
-	TwAddButton(bar_, "Clear Selection", tw_clear_select, this, "group = 'Select' ");
+	if (mesh_.F.rows() == 0) return false;
+
+	int time = glutGet(GLUT_ELAPSED_TIME);
+	mesh_.components.label(mesh_.V, mesh_.F);
+	const MeshComponents& parts = mesh_.components;
+
+	// component of every face, for the colormap and the export
+	uint32_t* label = mesh_.attributes.add<uint32_t>("component", DOMAIN_FACE, mesh_.F.rows(), 0);
+	for (int c = 0; c < parts.count(); c++)
+	{
+		for (int j = parts.first_face(c); j < parts.first_face(c + 1); j++)
+			label[parts.face_order()[j]] = c;
+	}
+	int closed = 0, nonmanifold = 0;
+	for (int c = 0; c < parts.count(); c++)
+	{
+		if (parts.stats(c).closed()) closed++;
+		if (!parts.stats(c).manifold()) nonmanifold++;
+	}
+	std::cout << parts.count() << " components (" << closed << " closed, " << nonmanifold << " non-manifold) in "
+		<< glutGet(GLUT_ELAPSED_TIME) - time << " ms" << std::endl;
+
+	pick_component(0);
+	sync_components();
+	mesh_.update_memory_stats();
+	return true;
 }
 
-void MeshViewer::tw_open_file(void *_clientData)
+void MeshViewer::show_component(int _c, bool _visible)
 {
-	std::string filename = igl::file_dialog_open();
-	if (!filename.empty())
+	mesh_.components.set_visible(_c, _visible);
+	sync_components();
+}
+
+void MeshViewer::isolate_component(int _c)
+{
+	mesh_.components.isolate(_c);
+	sync_components();
+}
+
+void MeshViewer::pick_component(int _c)
+{
+	const MeshComponents& parts = mesh_.components;
+	component_count_ = parts.count();
+	component_ = Max(Min(_c, component_count_ - 1), 0);
+	component_stats_ = parts.empty() ? ComponentStats() : parts.stats(component_);
+}
+
+// the refined mesh hides the refinement of the hidden components
+void MeshViewer::sync_components()
+{
+	const MeshComponents& parts = mesh_.components;
+	MeshComponents& refined = refined_.components;
+	if (!subdivision_.empty() && parts.hidden() > 0 && refined.empty())
+		refined.label(refined_.V, refined_.F);
+	refined.follow(parts);
+	glutPostRedisplay();
+}
+
+bool MeshViewer::compare_to(const char* _filename)
+{
+	Eigen::MatrixXd RV;
+	Eigen::MatrixXi RF;
+	if (!mesh_.V.rows() || !igl::read_triangle_mesh(_filename, RV, RF)) return false;
+	if (RF.rows() == 0)
 	{
-		MeshViewer* viewer = (MeshViewer*)_clientData;
-		viewer->open_mesh(filename.c_str());
+		std::cerr << "ERROR (compare_to): The reference has no faces." << std::endl;
+		return false;
 	}
+
+	Eigen::VectorXd D;
+	deviation_ = compare_meshes(mesh_.V, mesh_.F, RV, RF, D);
+	mesh_.attributes.add("distance", DOMAIN_VERTEX, CHANNEL_FLOAT, 1, D.rows(), MeshData::DIRTY_POSITION).set(D);
+	std::cout << "Hausdorff " << deviation_.hausdorff << ", max " << deviation_.max_error
+		<< ", mean " << deviation_.mean_error << ", RMS " << deviation_.rms_error << std::endl;
+
+	Eigen::MatrixXd C;
+	colormap(colormap_, D, 0.0, deviation_.max_error, C);
+	set_color(C);
+	return true;
 }
 
-void MeshViewer::tw_save_file(void *_clientData)
+bool MeshViewer::align_to(const char* _filename)
 {
-	std::string filename = igl::file_dialog_save();
-	if (!filename.empty())
+	stop_alignment();
+	int nv = mesh_.V.rows();
+	if (nv == 0) return false;
+
+	// the thread reads the reference and works on a copy of the mesh
+	align_base_ = mesh_.V;
+	align_moved_ = false;
+	align_iteration_ = align_pairs_ = 0;
+	align_rms_ = 0;
+	align_posted_ = 0;
+	std::shared_ptr<Eigen::MatrixXd> N = std::make_shared<Eigen::MatrixXd>();
+	if (mesh_.V_normals.rows() == nv) *N = mesh_.V_normals;
+
+	// estimated point cloud normals may point either way
+	IcpOptions options = align_options_;
+	options.oriented = !mesh_.is_point_cloud();
+	std::shared_ptr<Eigen::MatrixXd> V = std::make_shared<Eigen::MatrixXd>(mesh_.V);
+	std::string filename = _filename;
+	unsigned generation = align_generation_;
+	align_thread_ = std::thread([this, V, N, options, filename, generation]() {
+		Eigen::MatrixXd RV, RN;
+		Eigen::MatrixXi RF;
+		if (!igl::read_triangle_mesh(filename, RV, RF) || RV.rows() == 0)
+		{
+			std::cerr << "ERROR (align_to): Cannot read " << filename << std::endl;
+			return;
+		}
+		IcpOptions o = options;
+		if (RF.rows() > 0)
+			igl::per_vertex_normals(RV, RF, RN);
+		else
+		{
+			estimate_normals(RV, 10, RN);
+			o.oriented = false;
+		}
+
+		IcpRegistration icp;
+		icp.set_reference(RV, RN);
+		icp.start(*V, *N, o);
+		IcpIteration it;
+		while (!align_cancel_ && icp.step(it))
+		{
+			align_posted_ = it.iteration;
+			tasks_.post([this, generation, it]() { show_alignment(generation, it); });
+		}
+		if (icp.iterations() == 0)
+			std::cerr << "ERROR (align_to): No vertex is within reach of the reference." << std::endl;
+	});
+	start_polling();
+	return true;
+}
+
+void MeshViewer::stop_alignment()
+{
+	if (!align_thread_.joinable()) return;
+	align_cancel_ = true;
+	align_thread_.join();
+	align_cancel_ = false;
+	align_generation_++;
+}
+
+void MeshViewer::show_alignment(unsigned _generation, const IcpIteration& _it)
+{
+	if (_generation != align_generation_ || align_base_.rows() != mesh_.V.rows()) return;
+
+	align_iteration_ = _it.iteration;
+	align_pairs_ = _it.pairs;
+	align_rms_ = _it.rms;
+	std::cout << "ICP " << _it.iteration << ": RMS " << _it.rms << ", " << _it.pairs << " pairs, "
+		<< _it.rejected << " rejected" << (_it.converged ? ", converged" : "") << std::endl;
+
+	// the mesh only follows the last iteration posted
+	if (_it.iteration < align_posted_) return;
+	Eigen::MatrixXd V = align_base_;
+	_it.transform.apply(V);
+
+	// one undo step for the whole alignment
+	bool recording = mesh_.history.enabled();
+	mesh_.history.set_enabled(recording && !align_moved_);
+	mesh_.set_vertices(V);
+	mesh_.history.set_enabled(recording);
+	mesh_.refresh_geometry();
+	align_moved_ = true;
+	glutPostRedisplay();
+}
+
+double MeshViewer::clip_offset() const
+{
+	Vec3d n = clip_normal_.norm() > 0 ? Vec3d(clip_normal_.normalized()) : Vec3d(0, 0, 1);
+	Vec3d center = (mesh_.p_min + mesh_.p_max) / 2;
+	double reach = ((mesh_.p_max - mesh_.p_min) / 2).cwiseAbs().dot(n.cwiseAbs());
+	return n.dot(center) + (2 * clip_position_ - 1) * reach;
+}
+
+bool MeshViewer::slice(int _count)
+{
+	sections_.clear();
+	section_loops_ = 0;
+	if (mesh_.F.rows() == 0 || _count < 1 || clip_normal_.norm() == 0)
 	{
-		MeshViewer* viewer = (MeshViewer*)_clientData;
-		igl::write_triangle_mesh(filename, viewer->mesh_.V, viewer->mesh_.F);
+		show_sections();
+		return false;
+	}
+
+	std::vector<double> offsets;
+	if (_count == 1)
+		offsets.push_back(clip_offset());
+	else
+		stacked_offsets(mesh_.V, clip_normal_, _count, offsets);
+
+	int time = glutGet(GLUT_ELAPSED_TIME);
+	slice_mesh(mesh_.V, mesh_.F, clip_normal_, offsets, sections_);
+	int open = 0;
+	for (size_t k = 0; k < sections_.size(); k++)
+	{
+		section_loops_ += sections_[k].polylines();
+		for (int p = 0; p < sections_[k].polylines(); p++)
+			if (!sections_[k].closed[p]) open++;
 	}
+	if (_count > 1)
+		std::cout << section_loops_ << " polylines (" << open << " open) on " << _count << " planes in "
+			<< glutGet(GLUT_ELAPSED_TIME) - time << " ms" << std::endl;
+
+	show_sections();
+	return true;
 }
 
-void MeshViewer::tw_clear_select(void *_clientData)
+void MeshViewer::show_sections()
+{
+	std::vector<float> points;
+	std::vector<unsigned int> lines;
+	for (size_t k = 0; k < sections_.size(); k++)
+	{
+		const CrossSection& s = sections_[k];
+		unsigned int base = (unsigned int)(points.size() / 3);
+		for (size_t i = 0; i < s.points.size(); i++)
+			for (int j = 0; j < 3; j++)
+				points.push_back((float)s.points[i][j]);
+		for (int p = 0; p < s.polylines(); p++)
+		{
+			int first = s.start[p], last = s.start[p + 1] - 1;
+			for (int i = first; i < last; i++)
+			{
+				lines.push_back(base + i);
+				lines.push_back(base + i + 1);
+			}
+			if (s.closed[p] && last > first)
+			{
+				lines.push_back(base + last);
+				lines.push_back(base + first);
+			}
+		}
+	}
+	renderer_.set_overlay(points, lines);
+	glutPostRedisplay();
+}
+
+bool MeshViewer::export_slices(const char* _filename)
+{
+	if (sections_.empty()) return false;
+	return write_cross_sections(_filename, sections_);
+}
+
+bool MeshViewer::listen(const char* _name)
+{
+	if (!ipc_.start(_name)) return false;
+	std::cout << "Listening on " << _name << std::endl;
+	start_polling();
+	return true;
+}
+
+void MeshViewer::benchmark(const char* _mesh, const char* _path, double _budget_ms, const char* _report)
+{
+	bench_mesh_ = _mesh;
+	bench_path_ = _path;
+	bench_budget_ = _budget_ms;
+	bench_report_ = _report ? _report : "";
+}
+
+void MeshViewer::setup_session()
+{
+	if (bench_path_.empty()) return;
+	open_mesh(bench_mesh_.c_str());
+	if (mesh_.V.rows() == 0 || !start_replay(bench_path_, bench_report_))
+		exit(2);
+}
+
+void MeshViewer::replay_finished(const FrameTimeStats& stats)
+{
+	if (bench_path_.empty()) return;
+	bool over = bench_budget_ > 0 && stats.p95 > bench_budget_;
+	if (over)
+		std::cout << "p95 frame time " << stats.p95 << " ms is over the budget of " << bench_budget_ << " ms" << std::endl;
+	exit(over ? 1 : 0);
+}
+
+bool MeshViewer::run_script(const char* _filename)
+{
+	if (!run_python_script(*this, _filename)) return false;
+	start_polling();
+	return true;
+}
+
+void MeshViewer::invoke(const std::function<void()>& f)
+{
+	tasks_.invoke(f);
+}
+
+void MeshViewer::start_polling()
+{
+	if (polling_) return;
+	polling_ = true;
+	start_timer(10, TIMER_POLL);
+}
+
+void MeshViewer::serve_ipc()
+{
+	MeshIpc::Request* request = ipc_.pending();
+	if (request == NULL) return;
+
+	bool ok = false;
+	switch (request->command)
+	{
+	case MeshIpc::CMD_SET_MESH:
+		ok = request->V.rows() > 0 &&
+			(request->F.size() == 0 || (request->F.minCoeff() >= 0 && request->F.maxCoeff() < request->V.rows()));
+		if (ok) set_mesh(request->V, request->F);
+		break;
+	case MeshIpc::CMD_SET_VERTICES:
+		ok = request->V.rows() > 0 && request->V.rows() == mesh_.V.rows();
+		if (ok)
+		{
+			play(false);
+			mesh_.set_vertices(request->V);
+			mesh_.refresh_geometry();
+		}
+		break;
+	case MeshIpc::CMD_SET_COLORS:
+		ok = request->C.rows() == 1 || request->C.rows() == mesh_.V.rows() || request->C.rows() == mesh_.F.rows();
+		if (ok) set_color(request->C);
+		break;
+	case MeshIpc::CMD_GET_SELECTION:
+		request->selected_pts = mesh_.selected_pts;
+		request->selected_faces = mesh_.selected_faces;
+		ok = true;
+		break;
+	}
+	ipc_.reply(ok);
+	glutPostRedisplay();
+}
+
+bool MeshViewer::update_subdivision(unsigned changed)
+{
+	if (subdivision_levels_ <= 0 || mesh_.is_point_cloud())
+	{
+		if (!subdivision_.empty())
+		{
+			subdivision_.clear();
+			refined_.clear();
+			refined_renderer_.release();
+		}
+		return false;
+	}
+	// the control mesh is not updated during playback
+	if (renderer_.playing_frames()) return false;
+
+	int nv = mesh_.V.rows();
+	if (subdivision_.empty() || subdivision_.levels() != subdivision_levels_ ||
+		subdivision_.control_points() != nv || (changed & MeshData::DIRTY_FACE))
+	{
+		// new topology: new stencils, and every attribute follows
+		subdivision_.build(nv, mesh_.F, subdivision_levels_);
+		Eigen::MatrixXd RV;
+		subdivision_.evaluate(mesh_.V, RV);
+		refined_.set_mesh(RV, subdivision_.faces());
+		sync_components();
+		changed |= MeshData::DIRTY_DIFFUSE | MeshData::DIRTY_SCALAR | MeshData::DIRTY_UV;
+	}
+	else if (changed & MeshData::DIRTY_POSITION)
+	{
+		subdivision_.evaluate(mesh_.V, refined_.V);
+		refined_.p_min = refined_.V.colwise().minCoeff();
+		refined_.p_max = refined_.V.colwise().maxCoeff();
+		refined_.compute_normals();
+		refined_.dirty |= MeshData::DIRTY_POSITION;
+	}
+
+	// per vertex attributes are interpolated by the same stencils
+	if ((changed & MeshData::DIRTY_DIFFUSE) && !mesh_.face_based && mesh_.V_material_diffuse.rows() == nv)
+	{
+		subdivision_.evaluate(mesh_.V_material_diffuse, refined_.V_material_diffuse);
+		refined_.dirty |= MeshData::DIRTY_DIFFUSE;
+	}
+	if ((changed & MeshData::DIRTY_SCALAR) && mesh_.V_scalar.rows() == nv)
+	{
+		subdivision_.evaluate(mesh_.V_scalar, refined_.V_scalar);
+		refined_.dirty |= MeshData::DIRTY_SCALAR;
+	}
+	if ((changed & MeshData::DIRTY_UV) && mesh_.V_uv.rows() == nv && mesh_.F_uv.rows() == 0)
+	{
+		subdivision_.evaluate(mesh_.V_uv, refined_.V_uv);
+		refined_.dirty |= MeshData::DIRTY_UV;
+	}
+
+	refined_.dirty &= ~refined_renderer_.invalidate(refined_.dirty);
+	return true;
+}
+
+void MeshViewer::draw()
+{
+	if (!mesh_.V.rows())
+	{
+		GlutViewer::draw();
+		return;
+	}
+
+	// V changed elsewhere than in a stroke
+	if (mesh_.dirty & (MeshData::DIRTY_POSITION | MeshData::DIRTY_FACE))
+		sculptor_.clear();
+
+	// upload what changed since the last frame; sculpted vertices are
+	// updated in place, but the refined mesh and the parameterization follow
+	// them like any move
+	unsigned changed = mesh_.dirty;
+	if (!mesh_.moved_vertices.empty()) changed |= MeshData::DIRTY_POSITION;
+	update_parameterization(changed);
+	bool subdivided = update_subdivision(changed);
+	if (!(mesh_.dirty & (MeshData::DIRTY_POSITION | MeshData::DIRTY_FACE)))
+		renderer_.upload_moved(mesh_);
+	mesh_.moved_vertices.clear();
+	mesh_.moved_faces.clear();
+	mesh_.dirty &= ~renderer_.invalidate(mesh_.dirty);
+	MeshData& shown = subdivided ? refined_ : mesh_;
+	MeshRenderer& renderer = subdivided ? refined_renderer_ : renderer_;
+
+	MeshRenderer::ColorSource color = MeshRenderer::COLOR_DIFFUSE;
+	GLuint texture = show_texture_ ? current_texture() : 0;
+	if (texture)
+		color = MeshRenderer::COLOR_TEXTURE;
+	else if (show_scalar_ && mesh_.V_scalar.rows() == mesh_.V.rows())
+		color = MeshRenderer::COLOR_SCALAR;
+	renderer_.set_colormap(colormap_);
+	renderer_.set_scalar_range(scalar_min_, scalar_max_);
+
+	// the sections are of the mesh as it was
+	if ((changed & (MeshData::DIRTY_POSITION | MeshData::DIRTY_FACE)) && !sections_.empty())
+	{
+		sections_.clear();
+		section_loops_ = 0;
+		show_sections();
+	}
+
+	// the half space beyond the clipping plane is cut away, and the inside
+	// seen through the cut is lit too
+	if (clip_)
+	{
+		Vec3d n = clip_normal_.norm() > 0 ? Vec3d(clip_normal_.normalized()) : Vec3d(0, 0, 1);
+		GLdouble plane[4] = { -n[0], -n[1], -n[2], clip_offset() };
+		glClipPlane(GL_CLIP_PLANE0, plane);
+		glEnable(GL_CLIP_PLANE0);
+		glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE);
+	}
+
+	if (mesh_.is_point_cloud())
+	{
+		// a stratified subset while the view moves, grown to cover the same area
+		bool moving = false;
+		for (int i = 0; i < 5; i++) moving = moving || button_down_[i];
+		int nv = mesh_.V.rows();
+		int count = moving && interactive_points_ > 0 ? Min(interactive_points_, nv) : nv;
+		double radius = splat_size_ * mesh_.avg_edge * sqrt(double(nv) / count);
+		double scale = viewport_[3] / (2.0 * tan(fovy_ / 2.0 * M_PI / 180.0));
+
+		glEnable(GL_LIGHTING);
+		renderer_.draw_points(mesh_, color, radius, scale, count);
+		glDisable(GL_CLIP_PLANE0);
+		glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, GL_FALSE);
+
+		glEnable(GL_LIGHTING);
+		renderer_.draw_selected_points(mesh_);
+		return;
+	}
+
+	if (draw_mode_ == HIDDEN_LINE)
+	{
+		glDisable(GL_LIGHTING);
+		glColor3f(0.298, 0.298, 0.502);
+		glDepthRange(0.01, 1.0);
+		renderer.draw(shown, MeshRenderer::SHADE_SMOOTH, MeshRenderer::COLOR_NONE);
+
+		glColor3f(0.7, 0.7, 0.7);
+		glDepthRange(0.0, 1.0);
+		renderer.draw_edges(shown, shown.edges());
+	}
+
+	if (draw_mode_ == WIRE_FRAME)
+	{
+		glEnable(GL_LIGHTING);
+		glPolygonOffset(1, 1);
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		renderer.draw(shown, MeshRenderer::SHADE_FLAT, color, texture);
+		glDisable(GL_POLYGON_OFFSET_FILL);		
+
+		glDisable(GL_LIGHTING);
+		glColor3f(0.2, 0.2, 0.2);
+		renderer.draw_edges(shown, shown.edges());
+	}
+
+	if (draw_mode_ == SOLID_FLAT)
+	{
+		glEnable(GL_LIGHTING);
+		glDepthRange(0.01, 1.0);
+		renderer.draw(shown, MeshRenderer::SHADE_FLAT, color, texture);
+	}
+
+	if (draw_mode_ == SOLID_SMOOTH || draw_mode_ == FEATURE_EDGES)
+	{
+		glEnable(GL_LIGHTING);
+		glDepthRange(0.01, 1.0);
+		renderer.draw(shown, MeshRenderer::SHADE_SMOOTH, color, texture);
+	}
+
+	// boundaries, non-manifold edges and creases over the surface
+	if (draw_mode_ == FEATURE_EDGES)
+	{
+		glDisable(GL_LIGHTING);
+		glDepthRange(0.0, 1.0);
+		glColor3f(0.1, 0.1, 0.1);
+		renderer.draw_edges(shown, shown.edges(), feature_angle_);
+	}
+
+	// the control mesh over its refinement
+	if (subdivided)
+	{
+		glDisable(GL_LIGHTING);
+		glDepthRange(0.0, 1.0);
+		glColor3f(0.2, 0.2, 0.2);
+		renderer_.draw_edges(mesh_, mesh_.edges());
+	}
+
+	glDisable(GL_CLIP_PLANE0);
+	glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, GL_FALSE);
+
+	// cross-sections over the mesh, on the cut too
+	if (!sections_.empty())
+	{
+		glDisable(GL_LIGHTING);
+		glDepthRange(0.0, 1.0);
+		glLineWidth(2.0f);
+		glColor3f(0.9, 0.2, 0.1);
+		renderer_.draw_overlay();
+		glLineWidth(1.0f);
+	}
+
+	// the selection follows the mesh, which is not updated during playback
+	if (renderer_.playing_frames()) return;
+
+	glEnable(GL_LIGHTING);
+	renderer_.draw_selected_points(mesh_);
+	//glPolygonOffset(1, 1);
+	glDepthRange(0.0, 1.0);
+	renderer_.draw_selected_faces(mesh_);
+}
+
+// the point under pixel (x, y), at the given depth or else at the depth
+// buffer value; false on the background
+bool MeshViewer::unproject(int x, int y, Vec3d& p, float* depth) const
+{
+	GLdouble winX = double(x);
+	GLdouble winY = double(viewport_[3] - y);
+	GLfloat winZ = 0.0;
+	if (depth && *depth > 0)
+		winZ = *depth;
+	else
+		glReadPixels((int)winX, (int)winY, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &winZ);
+	if (winZ >= 1.0f) return false;
+
+	GLdouble pt[3];
+	gluUnProject(winX, winY, (GLdouble)winZ, modelview_matrix_, projection_matrix_, viewport_, &pt[0], &pt[1], &pt[2]);
+	p = Vec3d(pt[0], pt[1], pt[2]);
+	if (depth) *depth = winZ;
+	return true;
+}
+
+void MeshViewer::mouse(int button, int state, int x, int y)
+{
+	// sculpt
+	int modifier = glutGetModifiers();
+	if (sculptor_.in_stroke() && state == GLUT_UP)
+	{
+		sculptor_.end_stroke(mesh_);
+		return;
+	}
+	if (modifier == GLUT_ACTIVE_SHIFT && button == GLUT_LEFT_BUTTON && state == GLUT_DOWN &&
+		brush_ != BRUSH_NONE && mesh_.F.rows() > 0)
+	{
+		Vec3d p;
+		stroke_depth_ = 0;
+		if (unproject(x, y, p, &stroke_depth_))
+		{
+			double radius = brush_radius_ * (mesh_.p_max - mesh_.p_min).norm();
+			sculptor_.begin_stroke(mesh_, (BrushType)brush_, p, radius, brush_strength_);
+		}
+		return;
+	}
+
+	// select point
+	if (( modifier == GLUT_ACTIVE_CTRL ||modifier == GLUT_ACTIVE_ALT) && state == GLUT_DOWN)
+	{
+		// nothing to select on the background
+		Vec3d pt;
+		if (!unproject(x, y, pt)) return;
+		if (modifier == GLUT_ACTIVE_CTRL)
+			mesh_.select_pt(pt);
+		else
+			mesh_.select_face(pt);
+
+		// the tweak bar shows the component of the last selected face
+		if (modifier == GLUT_ACTIVE_ALT && !mesh_.components.empty() && !mesh_.selected_faces.empty())
+			pick_component(mesh_.components.vertex_component(mesh_.F(mesh_.selected_faces.back(), 0)));
+	}
+	else{
+		GlutViewer::mouse(button, state, x, y);
+
+		// back to all the points
+		if (state == GLUT_UP && mesh_.is_point_cloud())
+			glutPostRedisplay();
+	}
+
+}
+
+void MeshViewer::motion(int x, int y)
+{
+	if (!sculptor_.in_stroke())
+	{
+		GlutViewer::motion(x, y);
+		return;
+	}
+
+	// grab follows the cursor in the plane of the stroke start, the other
+	// brushes slide on the surface
+	Vec3d p;
+	float depth = brush_ == BRUSH_GRAB ? stroke_depth_ : 0.0f;
+	if (unproject(x, y, p, &depth))
+		sculptor_.stroke_to(mesh_, p);
+}
+
+void MeshViewer::keyboard(int key, int x, int y)
+{
+	switch (key)
+	{
+	case 26: // ctrl + z
+		undo();
+		break;
+	case 25: // ctrl + y
+		redo();
+		break;
+	default:
+		GlutViewer::keyboard(key, x, y);
+		break;
+	}
+}
+
+void MeshViewer::timer(int value)
+{
+	if (value == TIMER_PLAYBACK)
+	{
+		step_playback();
+		return;
+	}
+	if (value == TIMER_POLL)
+	{
+		serve_ipc();
+		if (tasks_.run_pending()) glutPostRedisplay();
+		start_timer(10, TIMER_POLL);
+		return;
+	}
+	if (value != TIMER_TEXTURE) return;
+
+	if (textures_.update()) glutPostRedisplay();
+	if (textures_.pending()) start_timer(50, TIMER_TEXTURE);
+}
+
+GLuint MeshViewer::current_texture()
+{
+	if (!mesh_.texture_file.empty())
+		return textures_.get(mesh_.texture_file);
+
+	// in-memory texture, uploaded again when it changes
+	if ((mesh_.dirty & MeshData::DIRTY_TEXTURE) || !mesh_texture_)
+	{
+		mesh_texture_ = textures_.upload("#mesh", mesh_.texture);
+		mesh_.dirty &= ~MeshData::DIRTY_TEXTURE;
+	}
+	return mesh_texture_;
+}
+
+void MeshViewer::setup_anttweakbar()
+{
+	GlutViewer::setup_anttweakbar();
+	TwAddButton(bar_, "Open File", tw_open_file, this, "group = 'File'");
+	TwAddButton(bar_, "Save File", tw_save_file, this, "group = 'File'");
+	TwAddButton(bar_, "Open Texture", tw_open_texture, this, "group = 'File'");
+	TwAddVarRW(bar_, "Clean On Load", TW_TYPE_BOOLCPP, &clean_on_load_, "group = 'File'");
+	TwAddVarRW(bar_, "Mesh Cache", TW_TYPE_BOOLCPP, &use_cache_, "group = 'File'");
+	TwAddVarRW(bar_, "Weld Tolerance", TW_TYPE_FLOAT, &weld_tolerance_, "group = 'File' min=0 max=0.01 step=0.000001 precision=7");
+	TwAddVarRW(bar_, "Show Texture", TW_TYPE_BOOLCPP, &show_texture_, "group = 'Draw'");
+
+	TwEnumVal ColormapEV[COLORMAP_COUNT] = { { COLORMAP_JET, "Jet" }, { COLORMAP_HOT, "Hot" },
+	{ COLORMAP_GREY, "Grey" }, { COLORMAP_COOLWARM, "Cool Warm" } };
+	TwType ColormapType = TwDefineEnum("Colormap", ColormapEV, COLORMAP_COUNT);
+	TwAddVarRW(bar_, "Show Scalar", TW_TYPE_BOOLCPP, &show_scalar_, "group = 'Color'");
+	TwAddVarRW(bar_, "Colormap", ColormapType, &colormap_, "group = 'Color'");
+	TwAddVarRW(bar_, "Scalar Min", TW_TYPE_DOUBLE, &scalar_min_, "group = 'Color' step=0.01");
+	TwAddVarRW(bar_, "Scalar Max", TW_TYPE_DOUBLE, &scalar_max_, "group = 'Color' step=0.01");
+	
+	TwAddVarRW(bar_, "Splat Size", TW_TYPE_FLOAT, &splat_size_, "group = 'Points' min=0.1 max=10 step=0.1");
+	TwAddVarRW(bar_, "Interactive Points", TW_TYPE_INT32, &interactive_points_, "group = 'Points' min=0 step=100000");
+
+	TwAddVarRW(bar_, "Feature Angle", TW_TYPE_FLOAT, &feature_angle_,
+		"group = 'Draw' min=1 max=180 step=1 help='Creases of the Feature Edges mode, in degrees between face normals'");
+	TwAddVarRW(bar_, "Subdivision Levels", TW_TYPE_INT32, &subdivision_levels_, "group = 'Draw' min=0 max=5");
+
+	TwAddButton(bar_, "Clear Selection", tw_clear_select, this, "group = 'Select' ");
+
+	TwAddButton(bar_, "Undo", tw_undo, this, "group = 'Edit'");
+	TwAddButton(bar_, "Redo", tw_redo, this, "group = 'Edit'");
+	TwAddVarCB(bar_, "Undo Budget (MB)", TW_TYPE_UINT32, tw_set_undo_budget, tw_get_undo_budget,
+		this, "group = 'Edit' min=0 max=65536 step=64");
+
+	TwEnumVal CurvatureEV[CURVATURE_COUNT + 1] = { { -1, "None" }, { CURVATURE_MEAN, "Mean" },
+	{ CURVATURE_GAUSSIAN, "Gaussian" }, { CURVATURE_MAX, "Max Principal" }, { CURVATURE_MIN, "Min Principal" } };
+	TwType CurvatureEnum = TwDefineEnum("Curvature", CurvatureEV, CURVATURE_COUNT + 1);
+	TwAddVarCB(bar_, "Curvature", CurvatureEnum, tw_set_curvature, tw_get_curvature, this, "group = 'Curvature'");
+	TwAddButton(bar_, "Export Curvature", tw_export_curvature, this, "group = 'Curvature'");
+
+	TwAddVarCB(bar_, "Channel", TW_TYPE_INT32, tw_set_channel, tw_get_channel, this,
+		"group = 'Channels' min=-1 help='Named vertex, face and edge quantities: distance, occlusion, component...'");
+	TwAddVarRO(bar_, "Channel Name", TW_TYPE_CSSTRING(sizeof(channel_name_)), channel_name_, "group = 'Channels'");
+	TwAddButton(bar_, "Export Vertex Channels", tw_export_vertex_channels, this, "group = 'Channels'");
+	TwAddButton(bar_, "Export Face Channels", tw_export_face_channels, this, "group = 'Channels'");
+
+	TwEnumVal BrushEV[BRUSH_COUNT + 1] = { { BRUSH_NONE, "None" }, { BRUSH_GRAB, "Grab" },
+	{ BRUSH_INFLATE, "Inflate" }, { BRUSH_SMOOTH, "Smooth" }, { BRUSH_FLATTEN, "Flatten" } };
+	TwType BrushEnum = TwDefineEnum("Brush", BrushEV, BRUSH_COUNT + 1);
+	TwAddVarRW(bar_, "Brush", BrushEnum, &brush_, "group = 'Sculpt' help='Shift + left drag'");
+	TwAddVarRW(bar_, "Brush Radius", TW_TYPE_FLOAT, &brush_radius_, "group = 'Sculpt' min=0.001 max=0.5 step=0.005");
+	TwAddVarRW(bar_, "Brush Strength", TW_TYPE_FLOAT, &brush_strength_, "group = 'Sculpt' min=0 max=1 step=0.05");
+
+	TwEnumVal ParamEV[PARAM_COUNT] = { { PARAM_HARMONIC, "Harmonic" }, { PARAM_LSCM, "LSCM" } };
+	TwType ParamEnum = TwDefineEnum("ParamMethod", ParamEV, PARAM_COUNT);
+	TwAddVarRW(bar_, "Method", ParamEnum, &param_choice_, "group = 'Parameterization'");
+	TwAddButton(bar_, "Parameterize", tw_parameterize, this, "group = 'Parameterization'");
+	TwAddVarRW(bar_, "Follow Edits", TW_TYPE_BOOLCPP, &param_follow_, "group = 'Parameterization'");
+
+	TwAddButton(bar_, "Bake", tw_bake_occlusion, this, "group = 'Occlusion'");
+	TwAddButton(bar_, "Stop", tw_stop_occlusion, this, "group = 'Occlusion'");
+	TwAddVarRW(bar_, "Target Samples", TW_TYPE_INT32, &occlusion_target_, "group = 'Occlusion' min=16 max=4096 step=16");
+	TwAddVarRW(bar_, "Ray Length", TW_TYPE_FLOAT, &occlusion_distance_,
+		"group = 'Occlusion' min=0 max=2 step=0.01 help='Relative to the bounding box diagonal, 0 for unlimited'");
+	TwAddVarRO(bar_, "Samples", TW_TYPE_INT32, &occlusion_samples_, "group = 'Occlusion'");
+
+	TwAddButton(bar_, "Label Components", tw_label_components, this, "group = 'Components'");
+	TwAddVarRO(bar_, "Count", TW_TYPE_INT32, &component_count_, "group = 'Components'");
+	TwAddVarCB(bar_, "Component", TW_TYPE_INT32, tw_set_component, tw_get_component, this,
+		"group = 'Components' min=0 help='Alt + click picks the component of a face'");
+	TwAddVarCB(bar_, "Visible", TW_TYPE_BOOLCPP, tw_set_component_visible, tw_get_component_visible, this, "group = 'Components'");
+	TwAddVarRO(bar_, "Faces", TW_TYPE_INT32, &component_stats_.faces, "group = 'Components'");
+	TwAddVarRO(bar_, "Area", TW_TYPE_DOUBLE, &component_stats_.area, "group = 'Components'");
+	TwAddVarRO(bar_, "Boundary Loops", TW_TYPE_INT32, &component_stats_.boundary_loops, "group = 'Components'");
+	TwAddVarRO(bar_, "Non-manifold Edges", TW_TYPE_INT32, &component_stats_.nonmanifold_edges, "group = 'Components'");
+	TwAddVarRO(bar_, "Euler Characteristic", TW_TYPE_INT32, &component_stats_.euler, "group = 'Components'");
+	TwAddVarRO(bar_, "Genus", TW_TYPE_INT32, &component_stats_.genus, "group = 'Components' help='-1 if not an orientable manifold'");
+	TwAddButton(bar_, "Isolate", tw_isolate_component, this, "group = 'Components'");
+	TwAddButton(bar_, "Show All", tw_show_components, this, "group = 'Components'");
+	TwAddVarRW(bar_, "Min Faces", TW_TYPE_INT32, &min_component_faces_, "group = 'Components' min=1");
+	TwAddButton(bar_, "Hide Smaller", tw_hide_small_components, this, "group = 'Components'");
+
+	TwAddVarRW(bar_, "Clip", TW_TYPE_BOOLCPP, &clip_, "group = 'Slice'");
+	TwAddVarRW(bar_, "Clip Normal", TW_TYPE_DIR3D, clip_normal_.data(), "group = 'Slice' opened=false");
+	TwAddVarCB(bar_, "Clip Position", TW_TYPE_FLOAT, tw_set_clip_position, tw_get_clip_position, this,
+		"group = 'Slice' min=0 max=1 step=0.005 help='Across the bounding box along the normal; moves a single slice along'");
+	TwAddVarRW(bar_, "Planes", TW_TYPE_INT32, &slice_count_,
+		"group = 'Slice' min=1 max=10000 help='One cuts at the clipping plane, more are spread over the mesh'");
+	TwAddButton(bar_, "Slice", tw_slice, this, "group = 'Slice'");
+	TwAddButton(bar_, "Clear Slices", tw_clear_slices, this, "group = 'Slice'");
+	TwAddVarRO(bar_, "Polylines", TW_TYPE_INT32, &section_loops_, "group = 'Slice'");
+	TwAddButton(bar_, "Export Slices", tw_export_slices, this, "group = 'Slice'");
+
+	TwAddButton(bar_, "Compare To...", tw_compare, this, "group = 'Compare'");
+	TwAddVarRO(bar_, "Hausdorff", TW_TYPE_DOUBLE, &deviation_.hausdorff, "group = 'Compare'");
+	TwAddVarRO(bar_, "Max Error", TW_TYPE_DOUBLE, &deviation_.max_error, "group = 'Compare'");
+	TwAddVarRO(bar_, "Mean Error", TW_TYPE_DOUBLE, &deviation_.mean_error, "group = 'Compare'");
+	TwAddVarRO(bar_, "RMS Error", TW_TYPE_DOUBLE, &deviation_.rms_error, "group = 'Compare'");
+
+	TwAddButton(bar_, "Align To...", tw_align, this, "group = 'Align'");
+	TwAddButton(bar_, "Stop Align", tw_stop_alignment, this, "group = 'Align'");
+	TwAddVarRW(bar_, "Align Samples", TW_TYPE_INT32, &align_options_.samples,
+		"group = 'Align' min=1000 max=10000000 step=10000 help='Vertices matched per iteration'");
+	TwAddVarRW(bar_, "Max Iterations", TW_TYPE_INT32, &align_options_.max_iterations, "group = 'Align' min=1 max=1000");
+	TwAddVarRW(bar_, "Max Distance", TW_TYPE_DOUBLE, &align_options_.max_distance,
+		"group = 'Align' min=0.001 max=10 step=0.01 help='Farthest match at the start, relative to the reference bounding box diagonal'");
+	TwAddVarRW(bar_, "Reject", TW_TYPE_DOUBLE, &align_options_.reject,
+		"group = 'Align' min=1 max=100 step=0.5 help='Pairs farther than this times the median distance are outliers'");
+	TwAddVarRW(bar_, "Max Angle", TW_TYPE_DOUBLE, &align_options_.max_angle,
+		"group = 'Align' min=0 max=180 step=5 help='Pairs whose normals differ by more are outliers'");
+	TwAddVarRO(bar_, "Iteration", TW_TYPE_INT32, &align_iteration_, "group = 'Align'");
+	TwAddVarRO(bar_, "Pairs", TW_TYPE_INT32, &align_pairs_, "group = 'Align'");
+	TwAddVarRO(bar_, "RMS", TW_TYPE_DOUBLE, &align_rms_, "group = 'Align'");
+
+	TwAddButton(bar_, "Print Memory", tw_print_memory, this, "group = 'Memory'");
+
+	TwAddVarCB(bar_, "Threads", TW_TYPE_INT32, tw_set_threads, tw_get_threads, this,
+		"group = 'Tasks' min=1 max=256 help='Threads of the task scheduler'");
+	TwAddButton(bar_, "Print Task Times", tw_print_task_times, this, "group = 'Tasks'");
+
+	TwAddButton(bar_, "Open Sequence", tw_open_sequence, this, "group = 'Playback'");
+	TwAddVarCB(bar_, "Play", TW_TYPE_BOOLCPP, tw_set_play, tw_get_play, this, "group = 'Playback'");
+	TwAddVarCB(bar_, "Frame", TW_TYPE_INT32, tw_set_frame, tw_get_frame, this, "group = 'Playback' min=0");
+	TwAddVarRW(bar_, "Target FPS", TW_TYPE_FLOAT, &target_fps_, "group = 'Playback' min=1 max=240");
+	TwAddVarRW(bar_, "Loop", TW_TYPE_BOOLCPP, &loop_, "group = 'Playback'");
+	TwAddVarRO(bar_, "Playback FPS", TW_TYPE_FLOAT, &playback_fps_, "group = 'Playback' precision=1");
+}
+
+void MeshViewer::tw_open_file(void *_clientData)
+{
+	std::string filename = igl::file_dialog_open();
+	if (!filename.empty())
+	{
+		MeshViewer* viewer = (MeshViewer*)_clientData;
+		viewer->open_mesh(filename.c_str());
+	}
+}
+
+void MeshViewer::tw_open_texture(void *_clientData)
+{
+	std::string filename = igl::file_dialog_open();
+	if (!filename.empty())
+	{
+		MeshViewer* viewer = (MeshViewer*)_clientData;
+		viewer->open_texture(filename.c_str());
+	}
+}
+
+void MeshViewer::tw_save_file(void *_clientData)
+{
+	std::string filename = igl::file_dialog_save();
+	if (!filename.empty())
+	{
+		MeshViewer* viewer = (MeshViewer*)_clientData;
+		igl::write_triangle_mesh(filename, viewer->mesh_.V, viewer->mesh_.F);
+	}
+}
+
+void MeshViewer::tw_clear_select(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->mesh_.clear_selection();
+}
+
+void MeshViewer::tw_undo(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->undo();
+}
+
+void MeshViewer::tw_redo(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->redo();
+}
+
+void MeshViewer::tw_set_undo_budget(const void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	size_t mb = *(const unsigned int*)_value;
+	viewer->mesh_.history.set_budget(mb << 20);
+}
+
+void MeshViewer::tw_get_undo_budget(void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	*(unsigned int*)_value = (unsigned int)(viewer->mesh_.history.budget() >> 20);
+}
+
+void MeshViewer::tw_open_sequence(void *_clientData)
+{
+	std::string filename = igl::file_dialog_open();
+	if (!filename.empty())
+	{
+		MeshViewer* viewer = (MeshViewer*)_clientData;
+		viewer->open_sequence(filename.c_str());
+	}
+}
+
+void MeshViewer::tw_compare(void *_clientData)
+{
+	std::string filename = igl::file_dialog_open();
+	if (!filename.empty())
+	{
+		MeshViewer* viewer = (MeshViewer*)_clientData;
+		viewer->compare_to(filename.c_str());
+	}
+}
+
+void MeshViewer::tw_align(void *_clientData)
+{
+	std::string filename = igl::file_dialog_open();
+	if (!filename.empty())
+	{
+		MeshViewer* viewer = (MeshViewer*)_clientData;
+		viewer->align_to(filename.c_str());
+	}
+}
+
+void MeshViewer::tw_stop_alignment(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->stop_alignment();
+}
+
+void MeshViewer::tw_set_curvature(const void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	int type = *(const int*)_value;
+	if (type < 0)
+	{
+		viewer->curvature_shown_ = -1;
+		viewer->show_scalar_ = false;
+		glutPostRedisplay();
+	}
+	else
+		viewer->show_curvature((CurvatureType)type);
+}
+
+void MeshViewer::tw_get_curvature(void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	*(int*)_value = viewer->show_scalar_ ? viewer->curvature_shown_ : -1;
+}
+
+void MeshViewer::tw_export_curvature(void *_clientData)
+{
+	std::string filename = igl::file_dialog_save();
+	if (!filename.empty())
+	{
+		MeshViewer* viewer = (MeshViewer*)_clientData;
+		viewer->export_curvature(filename.c_str());
+	}
+}
+
+void MeshViewer::tw_set_channel(const void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	int i = *(const int*)_value;
+	if (i >= viewer->mesh_.attributes.count()) i = viewer->mesh_.attributes.count() - 1;
+	viewer->show_channel(i);
+}
+
+void MeshViewer::tw_get_channel(void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	*(int*)_value = viewer->channel_;
+}
+
+void MeshViewer::tw_export_vertex_channels(void *_clientData)
+{
+	std::string filename = igl::file_dialog_save();
+	if (!filename.empty())
+	{
+		MeshViewer* viewer = (MeshViewer*)_clientData;
+		viewer->export_channels(filename.c_str(), DOMAIN_VERTEX);
+	}
+}
+
+void MeshViewer::tw_export_face_channels(void *_clientData)
+{
+	std::string filename = igl::file_dialog_save();
+	if (!filename.empty())
+	{
+		MeshViewer* viewer = (MeshViewer*)_clientData;
+		viewer->export_channels(filename.c_str(), DOMAIN_FACE);
+	}
+}
+
+// the scheduler takes the new count while tasks run, from the bake, the
+// alignment, scripts or IPC loads alike
+void MeshViewer::tw_set_threads(const void *_value, void *)
+{
+	set_worker_count(*(const int*)_value);
+}
+
+void MeshViewer::tw_get_threads(void *_value, void *)
+{
+	*(int*)_value = worker_count();
+}
+
+void MeshViewer::tw_print_task_times(void *)
+{
+	print_task_timings(std::cout);
+}
+
+void MeshViewer::tw_print_memory(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->mesh_.update_memory_stats();
+	viewer->refined_.update_memory_stats();
+	memstats::print(std::cout);
+}
+
+void MeshViewer::tw_parameterize(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	if (viewer->parameterize(viewer->param_choice_))
+		viewer->show_texture_ = true;
+}
+
+void MeshViewer::tw_bake_occlusion(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->bake_occlusion();
+}
+
+void MeshViewer::tw_stop_occlusion(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->stop_occlusion();
+}
+
+void MeshViewer::tw_label_components(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->label_components();
+}
+
+void MeshViewer::tw_set_component(const void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->pick_component(*(const int*)_value);
+}
+
+void MeshViewer::tw_get_component(void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	*(int*)_value = viewer->component_;
+}
+
+void MeshViewer::tw_set_component_visible(const void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->show_component(viewer->component_, *(const bool*)_value);
+}
+
+void MeshViewer::tw_get_component_visible(void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	const MeshComponents& parts = viewer->mesh_.components;
+	*(bool*)_value = parts.empty() || parts.visible(viewer->component_);
+}
+
+void MeshViewer::tw_show_components(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->mesh_.components.show_all();
+	viewer->sync_components();
+}
+
+void MeshViewer::tw_isolate_component(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->isolate_component(viewer->component_);
+}
+
+void MeshViewer::tw_hide_small_components(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->mesh_.components.hide_smaller(viewer->min_component_faces_);
+	viewer->sync_components();
+}
+
+void MeshViewer::tw_set_clip_position(const void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->clip_position_ = *(const float*)_value;
+	// a single section follows the plane
+	if (viewer->sections_.size() == 1)
+		viewer->slice(1);
+	glutPostRedisplay();
+}
+
+void MeshViewer::tw_get_clip_position(void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	*(float*)_value = viewer->clip_position_;
+}
+
+void MeshViewer::tw_slice(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->slice(viewer->slice_count_);
+}
+
+void MeshViewer::tw_clear_slices(void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->sections_.clear();
+	viewer->section_loops_ = 0;
+	viewer->show_sections();
+}
+
+void MeshViewer::tw_export_slices(void *_clientData)
+{
+	std::string filename = igl::file_dialog_save();
+	if (!filename.empty())
+	{
+		MeshViewer* viewer = (MeshViewer*)_clientData;
+		viewer->export_slices(filename.c_str());
+	}
+}
+
+void MeshViewer::tw_set_play(const void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->play(*(const bool*)_value);
+}
+
+void MeshViewer::tw_get_play(void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	*(bool*)_value = viewer->playing_;
+}
+
+void MeshViewer::tw_set_frame(const void *_value, void *_clientData)
+{
+	MeshViewer* viewer = (MeshViewer*)_clientData;
+	viewer->seek(*(const int*)_value);
+}
+
+void MeshViewer::tw_get_frame(void *_value, void *_clientData)
 {
 	MeshViewer* viewer = (MeshViewer*)_clientData;
-	viewer->mesh_.selected_pts.clear();
-	viewer->mesh_.selected_faces.clear();
+	*(int*)_value = viewer->frame_index_;
 }
\ No newline at end of file
@@ -2,23 +2,145 @@
 #define MESH_VIEWER_WIDGET_HH
 
 #include "GlutViewer.hh"
-#include "ViewerData.h"
+#include "MeshData.h"
+#include "TextureCache.h"
+#include "MeshRenderer.h"
+#include "VertexSequence.h"
+#include "MeshIpc.h"
+#include "TaskQueue.h"
+#include "MeshDistance.h"
+#include "MeshCleanup.h"
+#include "Subdivision.h"
+#include "Parameterization.h"
+#include "MeshCache.h"
+#include "Sculpt.h"
+#include "AmbientOcclusion.h"
+#include "CrossSection.h"
+#include "Registration.h"
+#include <atomic>
+#include <thread>
 
 class MeshViewer : public GlutViewer
 {
 public:
 	/// default constructor
 	MeshViewer(const char* _title, int _width, int _height);
+	~MeshViewer();
 
-	/// open mesh
+	/// open mesh; with the mesh cache on, a file opened before is read
+	/// from its cache file along with its normals
 	void open_mesh(const char* _filename);
 
+	/// open texture image, decoded in the background
+	void open_texture(const char* _filename);
+
 	/// set mesh
 	void set_mesh(Eigen::MatrixXd &_V, Eigen::MatrixXi &_F);
 
-	/// set color
+	/// set mesh, taking over the storage of V and F without a copy
+	void take_mesh(Eigen::MatrixXd &_V, Eigen::MatrixXi &_F);
+
+	/// redraw after the arrays of mesh() were written in place
+	void update_mesh();
+
+	/// set color, only the color stream is uploaded again
 	void set_color(Eigen::MatrixXd &C);
 
+	/// set a per vertex scalar field shown through the colormap
+	void set_scalar(Eigen::VectorXd &S);
+
+	/// set the scalar range mapped onto the colormap
+	void set_scalar_range(double _min, double _max);
+
+	/// undo/redo the last edit
+	void undo();
+	void redo();
+
+	/// open a vertex sequence cache (.vseq), or build one from numbered
+	/// mesh files given the first of them
+	bool open_sequence(const char* _filename);
+
+	/// start/stop the playback of the sequence
+	void play(bool _on);
+
+	/// show frame i of the sequence
+	void seek(int i);
+
+	/// show a curvature of the mesh through the colormap
+	void show_curvature(CurvatureType _type);
+
+	/// write the curvature of every vertex, in the vertex order of the loaded file
+	bool export_curvature(const char* _filename);
+
+	/// show channel i of the mesh attributes through the colormap: vertex
+	/// channels as scalars, face channels as face colors, the first component
+	/// of a vector channel
+	bool show_channel(int _i);
+
+	/// write the channels of a domain, see write_attributes
+	bool export_channels(const char* _filename, AttributeDomain _domain);
+
+	/// replace the texture coordinates by a parameterization of the mesh,
+	/// which must be a single patch with a boundary
+	bool parameterize(ParamMethod _method);
+
+	/// label the connected components of the mesh and print how many there
+	/// are; all of them start visible
+	bool label_components();
+
+	/// show or hide connected component c, or all but c
+	void show_component(int _c, bool _visible);
+	void isolate_component(int _c);
+
+	/// bake ambient occlusion into the vertex colors, darkening the colors
+	/// the mesh had before its first bake. A pass of few samples is shown
+	/// first, then passes on a thread of their own refine it up to the
+	/// target sample count. The result is kept for the mesh, and for a file
+	/// with the mesh cache on, in "<file>.mpao".
+	bool bake_occlusion();
+
+	/// stop the baking, keeping the colors shown
+	void stop_occlusion();
+
+	/// cut the mesh by count planes normal to the clipping plane, spread over
+	/// the mesh, or by the clipping plane itself if count is 1, and show the
+	/// cross-sections over the mesh until it changes
+	bool slice(int _count);
+
+	/// write the cross-sections as OBJ polylines
+	bool export_slices(const char* _filename);
+
+	/// compare the mesh with a reference mesh file: colors the mesh by the
+	/// distance of its vertices to the reference surface
+	bool compare_to(const char* _filename);
+
+	/// rigidly align the mesh to a reference mesh or point cloud file by
+	/// point to plane ICP (see IcpRegistration), on a thread of its own; the
+	/// mesh moves after every iteration, and the whole alignment is one undo
+	/// step
+	bool align_to(const char* _filename);
+
+	/// stop the alignment, keeping the mesh where it is
+	void stop_alignment();
+
+	/// accept meshes, vertices and colors from other processes (see MeshIpcClient)
+	bool listen(const char* _name);
+
+	/// run a Python script in its own thread (needs USE_PYTHON)
+	bool run_script(const char* _filename);
+
+	/// once the window is up, open a mesh, replay a camera path over it and
+	/// exit: with 1 if the p95 frame time is over budget_ms (0 for no budget),
+	/// 0 otherwise. The frame times are written to report, if given.
+	void benchmark(const char* _mesh, const char* _path, double _budget_ms, const char* _report);
+
+	/// run f on the viewer thread and wait for it, for scripts and
+	/// other threads that must not touch the mesh or GL themselves
+	void invoke(const std::function<void()>& f);
+
+	/// the mesh on screen, to be changed on the viewer thread only
+	MeshData& mesh() { return mesh_; }
+
 protected:
 	/// setup anttweakbar
 	virtual void setup_anttweakbar(void);
@@ -26,17 +148,209 @@ protected:
 	/// mouse
 	virtual void mouse(int button, int state, int x, int y);
 
+	/// motion, for sculpt strokes
+	virtual void motion(int x, int y);
+
+	/// keyboard
+	virtual void keyboard(int key, int x, int y);
+
+	/// timer
+	virtual void timer(int value);
+
+	/// start the benchmark, if any
+	virtual void setup_session();
+
+	/// end the benchmark, if any
+	virtual void replay_finished(const FrameTimeStats& stats);
+
 	/// draw the scene
 	virtual void draw();
 
 private:
-	void create_display_list();
+	enum { TIMER_TEXTURE = 1, TIMER_PLAYBACK, TIMER_POLL };
+
+	GLuint current_texture();
+	void step_playback();
+	void sync_frame();
+	void serve_ipc();
+	bool update_subdivision(unsigned changed);
+	void update_parameterization(unsigned changed);
+	void start_polling();
+	bool unproject(int x, int y, Vec3d& p, float* depth = NULL) const;
+	void reset_mesh_state();
+	void show_occlusion(unsigned _generation, const Eigen::VectorXd& _A, int _samples);
+	void show_alignment(unsigned _generation, const IcpIteration& _it);
+	void pick_component(int _c);
+	void sync_components();
+	// offset of the clipping plane along its normal, from clip_position_
+	double clip_offset() const;
+	// upload sections_ as the overlay
+	void show_sections();
+	void use_file_uv(const Eigen::MatrixXd& TC, const Eigen::MatrixXi& FTC, const std::string& filename);
 	static void TW_CALL tw_open_file(void *_clientData);
+	static void TW_CALL tw_open_texture(void *_clientData);
 	static void TW_CALL tw_save_file(void *_clientData);
 	static void TW_CALL tw_clear_select(void *_clientData);
+	static void TW_CALL tw_undo(void *_clientData);
+	static void TW_CALL tw_redo(void *_clientData);
+	static void TW_CALL tw_set_undo_budget(const void *_value, void *_clientData);
+	static void TW_CALL tw_get_undo_budget(void *_value, void *_clientData);
+	static void TW_CALL tw_open_sequence(void *_clientData);
+	static void TW_CALL tw_compare(void *_clientData);
+	static void TW_CALL tw_align(void *_clientData);
+	static void TW_CALL tw_stop_alignment(void *_clientData);
+	static void TW_CALL tw_set_curvature(const void *_value, void *_clientData);
+	static void TW_CALL tw_get_curvature(void *_value, void *_clientData);
+	static void TW_CALL tw_export_curvature(void *_clientData);
+	static void TW_CALL tw_set_channel(const void *_value, void *_clientData);
+	static void TW_CALL tw_get_channel(void *_value, void *_clientData);
+	static void TW_CALL tw_export_vertex_channels(void *_clientData);
+	static void TW_CALL tw_export_face_channels(void *_clientData);
+	static void TW_CALL tw_print_memory(void *_clientData);
+	static void TW_CALL tw_set_threads(const void *_value, void *_clientData);
+	static void TW_CALL tw_get_threads(void *_value, void *_clientData);
+	static void TW_CALL tw_print_task_times(void *_clientData);
+	static void TW_CALL tw_parameterize(void *_clientData);
+	static void TW_CALL tw_bake_occlusion(void *_clientData);
+	static void TW_CALL tw_stop_occlusion(void *_clientData);
+	static void TW_CALL tw_label_components(void *_clientData);
+	static void TW_CALL tw_set_component(const void *_value, void *_clientData);
+	static void TW_CALL tw_get_component(void *_value, void *_clientData);
+	static void TW_CALL tw_set_component_visible(const void *_value, void *_clientData);
+	static void TW_CALL tw_get_component_visible(void *_value, void *_clientData);
+	static void TW_CALL tw_show_components(void *_clientData);
+	static void TW_CALL tw_isolate_component(void *_clientData);
+	static void TW_CALL tw_hide_small_components(void *_clientData);
+	static void TW_CALL tw_set_clip_position(const void *_value, void *_clientData);
+	static void TW_CALL tw_get_clip_position(void *_value, void *_clientData);
+	static void TW_CALL tw_slice(void *_clientData);
+	static void TW_CALL tw_clear_slices(void *_clientData);
+	static void TW_CALL tw_export_slices(void *_clientData);
+	static void TW_CALL tw_set_play(const void *_value, void *_clientData);
+	static void TW_CALL tw_get_play(void *_value, void *_clientData);
+	static void TW_CALL tw_set_frame(const void *_value, void *_clientData);
+	static void TW_CALL tw_get_frame(void *_value, void *_clientData);
 
 private:
-	GLuint draw_list_;
+	MeshRenderer renderer_;
+
+	// scalar field display
+	bool show_scalar_;
+	ColorMapType colormap_;
+	double scalar_min_, scalar_max_;
+
+	// cleanup of loaded meshes
+	bool clean_on_load_;
+	float weld_tolerance_;   // relative to the bounding box diagonal
+	bool use_cache_;         // read and write mesh cache files
+
+	TextureCache textures_;
+	GLuint mesh_texture_;
+	bool show_texture_;
+
+	// vertex sequence playback
+	VertexSequence sequence_;
+	SequenceFrame frame_;
+	int frame_index_;        // frame on screen
+	bool playing_;
+	bool playback_timer_;    // a playback timer is pending
+	bool loop_;
+	float target_fps_;
+	float playback_fps_;     // measured
+	int fps_frames_, fps_time_;
+
+	// point clouds
+	float splat_size_;       // splat radius over the point spacing
+	int interactive_points_; // points drawn while the view moves
+
+	// curvature shown as scalar, -1 if none
+	int curvature_shown_;
+
+	// attribute channel last shown, -1 if none, and its description
+	int channel_;
+	char channel_name_[96];
+
+	// creases of the FEATURE_EDGES draw mode, in degrees
+	float feature_angle_;
+
+	// Loop subdivision shown in place of the control mesh when levels > 0;
+	// refined_ follows mesh_ through the stencils of subdivision_
+	int subdivision_levels_;
+	LoopSubdivision subdivision_;
+	MeshData refined_;
+	MeshRenderer refined_renderer_;
+
+	// texture coordinates from parameterizer_, -1 if none; with follow_edits_
+	// they are solved again, warm started, when the vertices move
+	int param_method_;
+	bool param_follow_;
+	ParamMethod param_choice_;
+	Parameterizer parameterizer_;
+
+	// deviation from the last reference mesh
+	DeviationStats deviation_;
+
+	// ambient occlusion refined on occlusion_thread_ and shown through tasks_;
+	// results of an older bake or mesh carry an older generation. The
+	// distance is relative to the bounding box diagonal, 0 for unlimited.
+	AmbientOcclusion occlusion_;
+	std::thread occlusion_thread_;
+	std::atomic<bool> occlusion_cancel_;
+	unsigned occlusion_generation_;
+	int occlusion_target_, occlusion_samples_;
+	float occlusion_distance_;
+	Eigen::MatrixXd occlusion_base_;  // colors before the first bake
+
+	// alignment on align_thread_, each iteration shown through tasks_ by
+	// moving align_base_, the vertices it started from; iterations of an
+	// older alignment or mesh carry an older generation
+	std::thread align_thread_;
+	std::atomic<bool> align_cancel_;
+	std::atomic<int> align_posted_;   // last iteration posted
+	unsigned align_generation_;
+	IcpOptions align_options_;
+	Eigen::MatrixXd align_base_;
+	bool align_moved_;                // the undo step is recorded
+	int align_iteration_;
+	int align_pairs_;
+	double align_rms_;
+
+	// file of the mesh, empty if it did not come from a file
+	std::string mesh_file_;
+
+	// connected component shown in the tweak bar, and a copy of its
+	// statistics for the read-only fields
+	int component_;
+	int component_count_;
+	ComponentStats component_stats_;
+	int min_component_faces_;
+
+	// clipping plane: the half space beyond it along clip_normal_ is cut
+	// away; clip_position_ runs from 0 to 1 over the bounding box
+	bool clip_;
+	Vec3d clip_normal_;
+	float clip_position_;
+
+	// cross-sections of the last slice(), shown until the mesh changes
+	std::vector<CrossSection> sections_;
+	int slice_count_;
+	int section_loops_;
+
+	// sculpting: shift + left drag with the brush, the radius relative to the
+	// bounding box diagonal; a grab stroke stays at the depth it started at
+	int brush_;
+	float brush_radius_;
+	float brush_strength_;
+	float stroke_depth_;
+	Sculptor sculptor_;
+
+	// benchmark run from the command line, see benchmark()
+	std::string bench_mesh_, bench_path_, bench_report_;
+	double bench_budget_;
+
+	MeshIpcServer ipc_;
+	TaskQueue tasks_;
+	bool polling_;
 
 protected:
 	MeshData  mesh_;
@@ -0,0 +1,479 @@
+#include "stdafx.h"
+#include "PythonScript.h"
+#include "MeshViewer.hh"
+
+#ifdef USE_PYTHON
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+	MeshViewer* viewer = NULL;
+
+	// storage of alloc_mesh(), owned by the capsule that is the base of both
+	// arrays; taken once handed to the mesh
+	struct Staging
+	{
+		Eigen::MatrixXd V;
+		Eigen::MatrixXi F;
+		bool taken;
+		Staging() : taken(false) {}
+	};
+	const char* kStaging = "meshprocessing.staging";
+
+	void free_staging(PyObject* capsule)
+	{
+		delete (Staging*)PyCapsule_GetPointer(capsule, kStaging);
+	}
+
+	// a copy of viewer data, owned by the capsule that is the base of its
+	// array; words keep any element type aligned, and there is always one so
+	// that numpy does not allocate storage of its own
+	struct Copy
+	{
+		std::vector<uint64_t> words;
+		void assign(const void* data, size_t bytes)
+		{
+			words.assign(Max<size_t>((bytes + 7) / 8, 1), 0);
+			if (bytes) memcpy(&words[0], data, bytes);
+		}
+	};
+	const char* kCopy = "meshprocessing.copy";
+
+	void free_copy(PyObject* capsule)
+	{
+		delete (Copy*)PyCapsule_GetPointer(capsule, kCopy);
+	}
+
+	// numpy view of column major storage; base, if any, keeps it alive
+	PyObject* view(void* data, npy_intp rows, npy_intp cols, int type, PyObject* base)
+	{
+		npy_intp dims[2] = { rows, cols };
+		PyObject* a = PyArray_New(&PyArray_Type, cols < 0 ? 1 : 2, dims, type, NULL,
+			data, 0, NPY_ARRAY_FARRAY, NULL);
+		if (a && base)
+		{
+			Py_INCREF(base);
+			PyArray_SetBaseObject((PyArrayObject*)a, base);
+		}
+		return a;
+	}
+
+	// array owning copy, which it deletes
+	PyObject* array_of(Copy* copy, npy_intp rows, npy_intp cols, int type)
+	{
+		PyObject* capsule = PyCapsule_New(copy, kCopy, free_copy);
+		if (capsule == NULL)
+		{
+			delete copy;
+			return NULL;
+		}
+		PyObject* a = view(&copy->words[0], rows, cols, type, capsule);
+		Py_DECREF(capsule);
+		return a;
+	}
+
+	// numpy array as column major storage, converted only if it is not already
+	PyArrayObject* column_major(PyObject* obj, int type, int cols)
+	{
+		PyArrayObject* a = (PyArrayObject*)PyArray_FROMANY(obj, type, 1, 2,
+			NPY_ARRAY_F_CONTIGUOUS | NPY_ARRAY_ALIGNED);
+		if (a == NULL) return NULL;
+
+		bool ok = cols < 0 ? PyArray_NDIM(a) == 1 : (PyArray_NDIM(a) == 2 && PyArray_DIM(a, 1) == cols);
+		if (!ok)
+		{
+			PyErr_Format(PyExc_ValueError, cols < 0 ? "expected a vector" : "expected an n x %d array", cols);
+			Py_DECREF(a);
+			return NULL;
+		}
+		return a;
+	}
+
+	PyObject* done(bool ok, const char* error)
+	{
+		if (!ok)
+		{
+			PyErr_SetString(PyExc_ValueError, error);
+			return NULL;
+		}
+		Py_RETURN_NONE;
+	}
+
+	// -----------
+	// the mesh arrays are copied on the viewer thread: the mesh frees or
+	// moves its storage on every load, edit and undo
+	template <typename Matrix, Matrix MeshData::*member, int type>
+	PyObject* py_mesh_array(PyObject*, PyObject*)
+	{
+		Copy* copy = new Copy;
+		npy_intp rows = 0, cols = 0;
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() {
+			const Matrix& M = viewer->mesh().*member;
+			rows = M.rows();
+			cols = Matrix::ColsAtCompileTime == 1 ? -1 : M.cols();
+			copy->assign(M.data(), M.size() * sizeof(typename Matrix::Scalar));
+		});
+		Py_END_ALLOW_THREADS
+		return array_of(copy, rows, cols, type);
+	}
+
+	template <std::vector<int> MeshData::*member>
+	PyObject* py_selection(PyObject*, PyObject*)
+	{
+		Copy* copy = new Copy;
+		npy_intp rows = 0;
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() {
+			const std::vector<int>& list = viewer->mesh().*member;
+			rows = list.size();
+			copy->assign(list.empty() ? NULL : &list[0], list.size() * sizeof(int));
+		});
+		Py_END_ALLOW_THREADS
+		return array_of(copy, rows, -1, NPY_INT);
+	}
+
+	PyObject* py_alloc_mesh(PyObject*, PyObject* args)
+	{
+		Py_ssize_t nv, nf;
+		if (!PyArg_ParseTuple(args, "nn", &nv, &nf)) return NULL;
+
+		Staging* staging = new Staging;
+		staging->V.resize(nv, 3);
+		staging->F.resize(nf, 3);
+		PyObject* capsule = PyCapsule_New(staging, kStaging, free_staging);
+
+		PyObject* V = view(staging->V.data(), nv, 3, NPY_DOUBLE, capsule);
+		PyObject* F = view(staging->F.data(), nf, 3, NPY_INT, capsule);
+		Py_DECREF(capsule);
+		return Py_BuildValue("NN", V, F);
+	}
+
+	PyObject* py_take_mesh(PyObject*, PyObject* args)
+	{
+		PyObject *V, *F;
+		if (!PyArg_ParseTuple(args, "O!O!", &PyArray_Type, &V, &PyArray_Type, &F)) return NULL;
+
+		PyObject* base = PyArray_BASE((PyArrayObject*)V);
+		if (base == NULL || base != PyArray_BASE((PyArrayObject*)F) || !PyCapsule_IsValid(base, kStaging))
+			return done(false, "take_mesh() takes the arrays of alloc_mesh(), use set_mesh() otherwise");
+		Staging* staging = (Staging*)PyCapsule_GetPointer(base, kStaging);
+		if (staging->taken)
+			return done(false, "the arrays were taken already, alloc_mesh() new ones");
+		const Eigen::MatrixXi& SF = staging->F;
+		if (staging->V.rows() == 0 || (SF.rows() > 0 && (SF.minCoeff() < 0 || SF.maxCoeff() >= staging->V.rows())))
+			return done(false, "faces refer to missing vertices");
+
+		// the storage now belongs to the mesh, which frees it with the next
+		// load: the arrays become empty and read only
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() { viewer->take_mesh(staging->V, staging->F); });
+		Py_END_ALLOW_THREADS
+		staging->taken = true;
+		PyArrayObject* arrays[2] = { (PyArrayObject*)V, (PyArrayObject*)F };
+		for (int i = 0; i < 2; i++)
+		{
+			PyArray_DIMS(arrays[i])[0] = 0;
+			PyArray_CLEARFLAGS(arrays[i], NPY_ARRAY_WRITEABLE);
+		}
+		Py_RETURN_NONE;
+	}
+
+	PyObject* py_set_mesh(PyObject*, PyObject* args)
+	{
+		PyObject *objV, *objF;
+		if (!PyArg_ParseTuple(args, "OO", &objV, &objF)) return NULL;
+		PyArrayObject* arrV = column_major(objV, NPY_DOUBLE, 3);
+		PyArrayObject* arrF = arrV ? column_major(objF, NPY_INT, 3) : NULL;
+		if (arrF == NULL)
+		{
+			Py_XDECREF(arrV);
+			return NULL;
+		}
+
+		Eigen::Map<Eigen::MatrixXd> mV((double*)PyArray_DATA(arrV), PyArray_DIM(arrV, 0), 3);
+		Eigen::Map<Eigen::MatrixXi> mF((int*)PyArray_DATA(arrF), PyArray_DIM(arrF, 0), 3);
+		bool ok = mV.rows() > 0 && (mF.rows() == 0 || (mF.minCoeff() >= 0 && mF.maxCoeff() < mV.rows()));
+		if (ok)
+		{
+			Py_BEGIN_ALLOW_THREADS
+			Eigen::MatrixXd V = mV;
+			Eigen::MatrixXi F = mF;
+			viewer->invoke([&]() { viewer->take_mesh(V, F); });
+			Py_END_ALLOW_THREADS
+		}
+		Py_DECREF(arrV);
+		Py_DECREF(arrF);
+		return done(ok, "faces refer to missing vertices");
+	}
+
+	PyObject* py_set_vertices(PyObject*, PyObject* args)
+	{
+		PyObject* obj;
+		if (!PyArg_ParseTuple(args, "O", &obj)) return NULL;
+		PyArrayObject* V = column_major(obj, NPY_DOUBLE, 3);
+		if (V == NULL) return NULL;
+
+		Eigen::Map<Eigen::MatrixXd> mV((double*)PyArray_DATA(V), PyArray_DIM(V, 0), 3);
+		bool ok = false;
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() {
+			MeshData& mesh = viewer->mesh();
+			ok = mV.rows() == mesh.V.rows();
+			if (!ok) return;
+			// a playing sequence would overwrite them on its next frame
+			viewer->play(false);
+			mesh.set_vertices(mV);
+			mesh.refresh_geometry();
+		});
+		Py_END_ALLOW_THREADS
+		Py_DECREF(V);
+		return done(ok, "the number of vertices does not match the mesh");
+	}
+
+	PyObject* py_set_colors(PyObject*, PyObject* args)
+	{
+		PyObject* obj;
+		if (!PyArg_ParseTuple(args, "O", &obj)) return NULL;
+		PyArrayObject* C = column_major(obj, NPY_DOUBLE, 3);
+		if (C == NULL) return NULL;
+
+		Eigen::MatrixXd mC = Eigen::Map<Eigen::MatrixXd>((double*)PyArray_DATA(C), PyArray_DIM(C, 0), 3);
+		Py_DECREF(C);
+		bool ok = false;
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() {
+			MeshData& mesh = viewer->mesh();
+			ok = mC.rows() == 1 || mC.rows() == mesh.V.rows() || mC.rows() == mesh.F.rows();
+			if (ok) viewer->set_color(mC);
+		});
+		Py_END_ALLOW_THREADS
+		return done(ok, "expected one color, or one per vertex or face");
+	}
+
+	PyObject* py_channels(PyObject*, PyObject*)
+	{
+		struct Entry
+		{
+			std::string name;
+			AttributeDomain domain;
+			ChannelType type;
+			int components;
+			bool valid;
+		};
+		std::vector<Entry> entries;
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() {
+			const AttributeRegistry& A = viewer->mesh().attributes;
+			for (int i = 0; i < A.count(); i++)
+			{
+				const AttributeChannel& a = A.channel(i);
+				Entry e = { a.name(), a.domain(), a.type(), a.components(), a.valid() };
+				entries.push_back(e);
+			}
+		});
+		Py_END_ALLOW_THREADS
+
+		PyObject* list = PyList_New(0);
+		for (size_t i = 0; list && i < entries.size(); i++)
+		{
+			const Entry& a = entries[i];
+			PyObject* item = Py_BuildValue("(sssiO)", a.name.c_str(), domain_name(a.domain),
+				channel_type_name(a.type), a.components, a.valid ? Py_True : Py_False);
+			if (item == NULL || PyList_Append(list, item) < 0)
+			{
+				Py_XDECREF(item);
+				Py_DECREF(list);
+				return NULL;
+			}
+			Py_DECREF(item);
+		}
+		return list;
+	}
+
+	PyObject* py_channel(PyObject*, PyObject* args)
+	{
+		const char* name;
+		const char* domain = "vertex";
+		if (!PyArg_ParseTuple(args, "s|s", &name, &domain)) return NULL;
+
+		int d = 0;
+		while (d < DOMAIN_COUNT && strcmp(domain, domain_name((AttributeDomain)d)) != 0) d++;
+
+		Copy* copy = new Copy;
+		bool found = false;
+		npy_intp rows = 0, cols = 0;
+		ChannelType type = CHANNEL_FLOAT;
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() {
+			AttributeChannel* a = d < DOMAIN_COUNT ? viewer->mesh().attributes.find(name, (AttributeDomain)d) : NULL;
+			found = a && a->valid();
+			if (!found) return;
+			rows = a->rows();
+			cols = a->components() > 1 ? a->components() : -1;
+			type = a->type();
+			copy->assign(a->raw(), size_t(a->rows()) * a->components() * channel_type_size(a->type()));
+		});
+		Py_END_ALLOW_THREADS
+		if (!found)
+		{
+			delete copy;
+			PyErr_Format(PyExc_KeyError, "no valid %s channel %s", domain, name);
+			return NULL;
+		}
+		// the components are the columns of a column major matrix
+		static const int types[CHANNEL_TYPE_COUNT] = { NPY_FLOAT32, NPY_UINT8, NPY_UINT32 };
+		return array_of(copy, rows, cols, types[type]);
+	}
+
+	PyObject* py_set_scalars(PyObject*, PyObject* args)
+	{
+		PyObject* obj;
+		if (!PyArg_ParseTuple(args, "O", &obj)) return NULL;
+		PyArrayObject* S = column_major(obj, NPY_DOUBLE, -1);
+		if (S == NULL) return NULL;
+
+		Eigen::VectorXd mS = Eigen::Map<Eigen::VectorXd>((double*)PyArray_DATA(S), PyArray_DIM(S, 0));
+		Py_DECREF(S);
+		bool ok = false;
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() {
+			ok = mS.rows() == viewer->mesh().V.rows();
+			if (ok) viewer->set_scalar(mS);
+		});
+		Py_END_ALLOW_THREADS
+		return done(ok, "expected one scalar per vertex");
+	}
+
+	PyObject* py_set_scalar_range(PyObject*, PyObject* args)
+	{
+		double lo, hi;
+		if (!PyArg_ParseTuple(args, "dd", &lo, &hi)) return NULL;
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() { viewer->set_scalar_range(lo, hi); });
+		Py_END_ALLOW_THREADS
+		Py_RETURN_NONE;
+	}
+
+	PyObject* py_open_mesh(PyObject*, PyObject* args)
+	{
+		const char* filename;
+		if (!PyArg_ParseTuple(args, "s", &filename)) return NULL;
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() { viewer->open_mesh(filename); });
+		Py_END_ALLOW_THREADS
+		Py_RETURN_NONE;
+	}
+
+	PyObject* py_open_texture(PyObject*, PyObject* args)
+	{
+		const char* filename;
+		if (!PyArg_ParseTuple(args, "s", &filename)) return NULL;
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() { viewer->open_texture(filename); });
+		Py_END_ALLOW_THREADS
+		Py_RETURN_NONE;
+	}
+
+	PyObject* py_update(PyObject*, PyObject*)
+	{
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() { viewer->update_mesh(); });
+		Py_END_ALLOW_THREADS
+		Py_RETURN_NONE;
+	}
+
+	PyObject* py_undo(PyObject*, PyObject*)
+	{
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() { viewer->undo(); });
+		Py_END_ALLOW_THREADS
+		Py_RETURN_NONE;
+	}
+
+	PyObject* py_redo(PyObject*, PyObject*)
+	{
+		Py_BEGIN_ALLOW_THREADS
+		viewer->invoke([&]() { viewer->redo(); });
+		Py_END_ALLOW_THREADS
+		Py_RETURN_NONE;
+	}
+
+	PyMethodDef methods[] = {
+		{ "V", py_mesh_array<Eigen::MatrixXd, &MeshData::V, NPY_DOUBLE>, METH_NOARGS, "vertices, #V x 3 copy" },
+		{ "F", py_mesh_array<Eigen::MatrixXi, &MeshData::F, NPY_INT>, METH_NOARGS, "faces, #F x 3 copy" },
+		{ "V_normals", py_mesh_array<Eigen::MatrixXd, &MeshData::V_normals, NPY_DOUBLE>, METH_NOARGS, "vertex normals copy" },
+		{ "F_normals", py_mesh_array<Eigen::MatrixXd, &MeshData::F_normals, NPY_DOUBLE>, METH_NOARGS, "face normals copy" },
+		{ "V_colors", py_mesh_array<Eigen::MatrixXd, &MeshData::V_material_diffuse, NPY_DOUBLE>, METH_NOARGS, "vertex colors copy" },
+		{ "F_colors", py_mesh_array<Eigen::MatrixXd, &MeshData::F_material_diffuse, NPY_DOUBLE>, METH_NOARGS, "face colors copy" },
+		{ "scalars", py_mesh_array<Eigen::VectorXd, &MeshData::V_scalar, NPY_DOUBLE>, METH_NOARGS, "vertex scalars copy" },
+		{ "channels", py_channels, METH_NOARGS, "list of (name, domain, type, components, valid) attribute channels" },
+		{ "channel", py_channel, METH_VARARGS, "channel(name, domain='vertex') copy of an attribute channel" },
+		{ "selected_points", py_selection<&MeshData::selected_pts>, METH_NOARGS, "selected vertices copy" },
+		{ "selected_faces", py_selection<&MeshData::selected_faces>, METH_NOARGS, "selected faces copy" },
+		{ "alloc_mesh", py_alloc_mesh, METH_VARARGS, "alloc_mesh(nv, nf) -> V, F to fill for take_mesh()" },
+		{ "take_mesh", py_take_mesh, METH_VARARGS, "take_mesh(V, F) shows the arrays of alloc_mesh() without a copy, leaving them empty" },
+		{ "set_mesh", py_set_mesh, METH_VARARGS, "set_mesh(V, F)" },
+		{ "set_vertices", py_set_vertices, METH_VARARGS, "set_vertices(V), undoable" },
+		{ "set_colors", py_set_colors, METH_VARARGS, "set_colors(C), one color or one per vertex or face" },
+		{ "set_scalars", py_set_scalars, METH_VARARGS, "set_scalars(S), shown through the colormap" },
+		{ "set_scalar_range", py_set_scalar_range, METH_VARARGS, "set_scalar_range(lo, hi)" },
+		{ "open_mesh", py_open_mesh, METH_VARARGS, "open_mesh(filename)" },
+		{ "open_texture", py_open_texture, METH_VARARGS, "open_texture(filename)" },
+		{ "update", py_update, METH_NOARGS, "rebuild the render data and redraw" },
+		{ "undo", py_undo, METH_NOARGS, "undo the last edit" },
+		{ "redo", py_redo, METH_NOARGS, "redo the last undone edit" },
+		{ NULL, NULL, 0, NULL }
+	};
+
+	PyModuleDef module = { PyModuleDef_HEAD_INIT, "meshprocessing", "The running mesh viewer", -1, methods };
+
+	PyObject* init_module()
+	{
+		import_array();
+		return PyModule_Create(&module);
+	}
+}
+
+bool run_python_script(MeshViewer& _viewer, const std::string& filename)
+{
+	if (viewer)
+	{
+		std::cerr << "ERROR (run_python_script): A script was run already" << std::endl;
+		return false;
+	}
+	viewer = &_viewer;
+
+	std::thread([filename]() {
+		PyImport_AppendInittab("meshprocessing", init_module);
+		Py_Initialize();
+		// runpy.run_path(filename, run_name="__main__")
+		PyObject* runpy = PyImport_ImportModule("runpy");
+		PyObject* run_path = runpy ? PyObject_GetAttrString(runpy, "run_path") : NULL;
+		PyObject* args = Py_BuildValue("(s)", filename.c_str());
+		PyObject* kwargs = Py_BuildValue("{s:s}", "run_name", "__main__");
+		PyObject* result = run_path ? PyObject_Call(run_path, args, kwargs) : NULL;
+		if (result == NULL) PyErr_Print();
+		Py_XDECREF(result);
+		Py_XDECREF(kwargs);
+		Py_XDECREF(args);
+		Py_XDECREF(run_path);
+		Py_XDECREF(runpy);
+		Py_Finalize();
+	}).detach();
+	return true;
+}
+
+#else
+
+bool run_python_script(MeshViewer&, const std::string& filename)
+{
+	std::cerr << "ERROR (run_python_script): Built without USE_PYTHON, can not run " << filename << std::endl;
+	return false;
+}
+
+#endif
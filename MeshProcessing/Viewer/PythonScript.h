@@ -0,0 +1,21 @@
+#pragma once
+#include "stdafx.h"
+
+class MeshViewer;
+
+// Run a Python script in a thread of its own. The script imports the module
+// "meshprocessing", e.g.
+//
+//   import meshprocessing as mp
+//   V, F = mp.alloc_mesh(nv, nf)   # filled in place, then
+//   mp.take_mesh(V, F)             # handed over without a copy
+//   V = mp.V(); V[:, 2] *= 2       # a copy, edited
+//   mp.set_vertices(V)
+//
+// A mesh goes to the viewer without a copy through alloc_mesh() and
+// take_mesh(), after which its arrays are empty. The arrays read from the
+// viewer are copies, since the mesh frees or moves its storage on every
+// load, edit and undo. Viewer operations, reads included, run on the
+// viewer thread, with the GIL released.
+// Needs USE_PYTHON, Python 3 and numpy; one script per session.
+bool run_python_script(MeshViewer& viewer, const std::string& filename);
@@ -0,0 +1,113 @@
+#include "stdafx.h"
+#include "TextureCache.h"
+#include "GLExt.h"
+
+GLuint TextureCache::get(const std::string& filename)
+{
+	auto it = textures_.find(filename);
+	if (it != textures_.end()) return it->second;
+
+	if (!failed_.count(filename)) loader_.request(filename);
+	return 0;
+}
+
+GLuint TextureCache::upload(const std::string& key, const Image& img)
+{
+	if (img.empty()) return 0;
+
+	GLuint tex = 0;
+	auto it = textures_.find(key);
+	if (it != textures_.end())
+		tex = it->second;
+	else
+		glGenTextures(1, &tex);
+
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+	// rows are packed without padding
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	GLenum format = img.channels == 4 ? GL_RGBA : GL_RGB;
+
+	// the image as it is, with mipmaps made by the GPU; without that, or
+	// past the largest size, glu resamples it on the CPU
+	GLint max_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+	bool ok;
+	while (glGetError() != GL_NO_ERROR) {}  // earlier errors are not ours
+	if (glext::has_generate_mipmap() && img.width <= max_size && img.height <= max_size)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, format, img.width, img.height, 0, format, GL_UNSIGNED_BYTE, &img.data[0]);
+		glext::GenerateMipmap(GL_TEXTURE_2D);
+		GLenum error = glGetError();
+		ok = error == GL_NO_ERROR;
+		if (!ok)
+			std::cerr << "ERROR (TextureCache): Can not upload " << key << ": " << gluErrorString(error) << std::endl;
+	}
+	else
+	{
+		GLint error = gluBuild2DMipmaps(GL_TEXTURE_2D, img.channels, img.width, img.height,
+			format, GL_UNSIGNED_BYTE, &img.data[0]);
+		ok = error == 0;
+		if (!ok)
+			std::cerr << "ERROR (TextureCache): Can not build the mipmaps of " << key << ": "
+				<< gluErrorString(error) << std::endl;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (!ok)
+	{
+		glDeleteTextures(1, &tex);
+		textures_.erase(key);
+		return 0;
+	}
+	textures_[key] = tex;
+	return tex;
+}
+
+bool TextureCache::update()
+{
+	bool uploaded = false;
+	std::vector<std::string> names = loader_.finished();
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		Image img;
+		bool ok = false;
+		if (!loader_.fetch(names[i], img, ok)) continue;
+
+		// the decoded pixels are dropped once they live on the GPU
+		if (ok && upload(names[i], img))
+			uploaded = true;
+		else
+			failed_.insert(names[i]);
+	}
+	return uploaded;
+}
+
+bool TextureCache::pending()
+{
+	return loader_.pending() > 0 || !loader_.finished().empty();
+}
+
+void TextureCache::release(const std::string& key)
+{
+	auto it = textures_.find(key);
+	if (it != textures_.end())
+	{
+		glDeleteTextures(1, &it->second);
+		textures_.erase(it);
+	}
+	failed_.erase(key);
+}
+
+void TextureCache::clear()
+{
+	for (auto it = textures_.begin(); it != textures_.end(); ++it)
+		glDeleteTextures(1, &it->second);
+	textures_.clear();
+	failed_.clear();
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "stdafx.h"
+#include "ImageLoader.h"
+#include <map>
+#include <set>
+
+// OpenGL textures, uploaded once with mipmaps and cached by file name.
+// Image files are decoded on the loader thread; call update() from the GL
+// thread to upload the images that finished decoding.
+class TextureCache
+{
+public:
+	// texture of an image file, 0 until the file is decoded and uploaded
+	GLuint get(const std::string& filename);
+
+	// upload an in-memory image under the given key, replacing the previous
+	// one; 0 if it is empty or the upload failed
+	GLuint upload(const std::string& key, const Image& img);
+
+	// upload the decoded images; returns true if a texture became available
+	bool update();
+
+	// true while files are still being decoded
+	bool pending();
+
+	// delete one or all textures, needs a current GL context
+	void release(const std::string& key);
+	void clear();
+
+private:
+	ImageLoader loader_;
+	std::map<std::string, GLuint> textures_;
+	std::set<std::string> failed_;
+};
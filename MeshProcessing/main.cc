@@ -1,10 +1,132 @@
 #include "stdafx.h"
 #include "MeshViewer.hh"
+#include "MeshIpc.h"
+#include "MeshDistance.h"
+#include "Parallel.h"
+#include <cstring>
+
+// push a mesh into a viewer started with -listen, and print its selection
+static int send_mesh(const char* name, const char* filename)
+{
+  Eigen::MatrixXd V;
+  Eigen::MatrixXi F;
+  if (!igl::read_triangle_mesh(filename, V, F)) return 1;
+
+  MeshIpcClient client;
+  if (!client.connect(name) || !client.set_mesh(V, F)) return 1;
+
+  std::vector<int> pts, faces;
+  if (!client.get_selection(pts, faces)) return 1;
+  std::cout << pts.size() << " selected points, " << faces.size() << " selected faces" << std::endl;
+  return 0;
+}
+
+static int ipc_failures = 0;
+
+static void ipc_check(const char* what, bool ok)
+{
+  std::cout << (ok ? "ok      " : "FAILED  ") << what << std::endl;
+  if (!ok) ipc_failures++;
+}
+
+// the status of a raw message sent to the viewer, STATUS_BAD_MESSAGE if
+// the connection is lost
+static int ipc_status(MeshIpcClient& client, uint32_t magic, uint32_t command, uint32_t rows, const char* segment)
+{
+  MeshIpc::Message msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.magic = magic;
+  msg.command = command;
+  msg.rows[0] = rows;
+  strncpy(msg.segment, segment, sizeof(msg.segment) - 1);
+  return client.send(msg) ? msg.status : MeshIpc::STATUS_BAD_MESSAGE;
+}
+
+// round trip every command through a viewer started with -listen, the
+// rejected cases included; replaces its mesh with a tetrahedron
+static int test_ipc(const char* name)
+{
+  MeshIpcClient client;
+  if (!client.connect(name)) return 1;
+
+  Eigen::MatrixXd V(4, 3);
+  V << 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1;
+  Eigen::MatrixXi F(4, 3);
+  F << 0, 2, 1, 0, 1, 3, 0, 3, 2, 1, 2, 3;
+  ipc_check("set_mesh", client.set_mesh(V, F));
+  Eigen::MatrixXi bad = F;
+  bad(2, 1) = 4;
+  ipc_check("set_mesh rejects a face past the last vertex", !client.set_mesh(V, bad));
+  bad(2, 1) = -1;
+  ipc_check("set_mesh rejects a negative face index", !client.set_mesh(V, bad));
+  ipc_check("set_mesh rejects an empty mesh", !client.set_mesh(Eigen::MatrixXd(0, 3), Eigen::MatrixXi(0, 3)));
+
+  ipc_check("set_vertices", client.set_vertices(2 * V));
+  ipc_check("set_vertices rejects another vertex count", !client.set_vertices(V.topRows(3)));
+
+  ipc_check("set_colors, one color", client.set_colors(Eigen::MatrixXd::Constant(1, 3, 0.5)));
+  ipc_check("set_colors, one per vertex", client.set_colors(Eigen::MatrixXd::Constant(4, 3, 0.5)));
+  ipc_check("set_colors rejects another count", !client.set_colors(Eigen::MatrixXd::Constant(2, 3, 0.5)));
+
+  std::vector<int> pts, faces;
+  ipc_check("get_selection", client.get_selection(pts, faces));
+
+  // malformed messages get an error reply and keep the connection
+  ipc_check("bad magic", ipc_status(client, 0, MeshIpc::CMD_GET_SELECTION, 0, "") == MeshIpc::STATUS_BAD_MESSAGE);
+  ipc_check("bad command", ipc_status(client, MeshIpc::MAGIC, 99, 0, "") == MeshIpc::STATUS_BAD_MESSAGE);
+  ipc_check("rows past the end of the segment",
+    ipc_status(client, MeshIpc::MAGIC, MeshIpc::CMD_SET_VERTICES, 1 << 20, "") == MeshIpc::STATUS_BAD_MESSAGE);
+  ipc_check("the largest row count",
+    ipc_status(client, MeshIpc::MAGIC, MeshIpc::CMD_SET_VERTICES, 0xffffffff, "") == MeshIpc::STATUS_BAD_MESSAGE);
+  ipc_check("a segment that does not exist",
+    ipc_status(client, MeshIpc::MAGIC, MeshIpc::CMD_SET_VERTICES, 4, "no_such_segment") == MeshIpc::STATUS_BAD_MESSAGE);
+  ipc_check("still connected", client.get_selection(pts, faces));
+
+  std::cout << ipc_failures << " failed" << std::endl;
+  return ipc_failures ? 1 : 0;
+}
+
+// print the deviation of a mesh from a reference mesh, without a window
+static int compare(const char* filename, const char* reference)
+{
+  Eigen::MatrixXd V, RV;
+  Eigen::MatrixXi F, RF;
+  if (!igl::read_triangle_mesh(filename, V, F) || !igl::read_triangle_mesh(reference, RV, RF)) return 1;
+
+  Eigen::VectorXd D;
+  DeviationStats stats = compare_meshes(V, F, RV, RF, D);
+  std::cout << "hausdorff " << stats.hausdorff << "\nmax " << stats.max_error
+    << "\nmean " << stats.mean_error << "\nrms " << stats.rms_error << std::endl;
+  return 0;
+}
 
 int main(int argc, char **argv)
 {
+  // -threads n ahead of the other options: threads of the task scheduler
+  if (argc >= 3 && strcmp(argv[1], "-threads") == 0)
+  {
+    set_worker_count(atoi(argv[2]));
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
+  }
+
+  if (argc == 4 && strcmp(argv[1], "-send") == 0)
+    return send_mesh(argv[2], argv[3]);
+  if (argc == 3 && strcmp(argv[1], "-test-ipc") == 0)
+    return test_ipc(argv[2]);
+  if (argc == 4 && strcmp(argv[1], "-compare") == 0)
+    return compare(argv[2], argv[3]);
+
   glutInit(&argc, argv);
   MeshViewer viewer("Mesh Viewer", 1000, 600);
+  if (argc == 3 && strcmp(argv[1], "-listen") == 0)
+    viewer.listen(argv[2]);
+  if (argc == 3 && strcmp(argv[1], "-script") == 0)
+    viewer.run_script(argv[2]);
+  // -replay mesh camera_path [p95_budget_ms [report]]: exits 1 over budget
+  if (argc >= 4 && argc <= 6 && strcmp(argv[1], "-replay") == 0)
+    viewer.benchmark(argv[2], argv[3], argc >= 5 ? atof(argv[4]) : 0.0, argc >= 6 ? argv[5] : NULL);
   viewer.launch();
   return 0;
 }
\ No newline at end of file